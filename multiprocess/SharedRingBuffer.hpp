@@ -0,0 +1,207 @@
+/**
+ * Multiprocess solution - shared memory layout
+ * Included by the server, client and recorder so all three map the same
+ * structure
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <string>
+
+#include "common/ConsumerTable.hpp"
+#include "common/Message.hpp"
+#include "common/RingBuffer.hpp"
+#include "common/TscClock.hpp"
+#include "common/Types.hpp"
+
+namespace replay::ipc {
+
+// Shared memory name
+inline constexpr const char* SHM_NAME = "/mktdata_rb";
+
+// Shared memory size
+constexpr size_t SHM_RING_BUFFER_SIZE = 1024 * 64;  // 64K entries
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Layout tag ("RPSHRNG1") and version, checked before a persistent ring file
+// is reused
+constexpr uint64_t SHARED_RING_MAGIC = 0x52505348524E4731ull;
+constexpr uint32_t SHARED_RING_VERSION = 1;
+
+// Shared ring buffer structure
+struct alignas(CACHE_LINE_SIZE) SharedSlot {
+  Msg msg;
+  std::atomic<SeqNum> seq;
+  char padding[CACHE_LINE_SIZE - sizeof(Msg) - sizeof(std::atomic<SeqNum>)];
+};
+
+// The ring lives either in POSIX shared memory (SHM_NAME, rebuilt by every
+// server start) or, with --ring-file, in a file on tmpfs, DAX or a regular
+// filesystem that outlives the processes. A server restarting on such a file
+// continues the sequence space (warmStart()) and consumers resume from the
+// cursors they left in the consumer table.
+struct SharedRingBuffer {
+  // Layout and restart bookkeeping; magic is set last by init()
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> magic;
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t capacity;
+  std::atomic<uint64_t> generation;  // Server starts on this ring
+  std::atomic<uint32_t> clean_shutdown;  // Last server exited cleanly
+
+  // Control information
+  alignas(CACHE_LINE_SIZE) std::atomic<SeqNum> write_seq;
+  alignas(CACHE_LINE_SIZE) std::atomic<bool> server_running;
+  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> total_messages;
+
+  // Timestamp clock calibration, owned by the server. Clients convert TSC
+  // readings with the same parameters, so message timestamps and their own
+  // clock reads share one time base.
+  TscCalibration clock;
+
+  // Clients and recorders register here and publish their cursors; the
+  // server counts the messages it overwrites before they were read
+  ConsumerTable consumers;
+  LapTracker lap_tracker;
+
+  // Data slots
+  SharedSlot slots[SHM_RING_BUFFER_SIZE];
+
+  // Server only: called on freshly created (zero-filled) memory, or on a
+  // ring file of another layout, whose consumer cursors and lap counts
+  // belong to a different sequence space and are dropped
+  void init() {
+    write_seq.store(0, std::memory_order_relaxed);
+    server_running.store(true, std::memory_order_relaxed);
+    total_messages.store(0, std::memory_order_relaxed);
+    consumers.clear();
+    lap_tracker.reset();
+
+    for (auto& slot : slots) {
+      slot.seq.store(INVALID_SEQ, std::memory_order_relaxed);
+    }
+
+    version = SHARED_RING_VERSION;
+    capacity = SHM_RING_BUFFER_SIZE;
+    generation.store(1, std::memory_order_relaxed);
+    clean_shutdown.store(0, std::memory_order_relaxed);
+    magic.store(SHARED_RING_MAGIC, std::memory_order_release);
+  }
+
+  // Initialized by a server built with this layout
+  bool isCompatible() const {
+    return magic.load(std::memory_order_acquire) == SHARED_RING_MAGIC &&
+           version == SHARED_RING_VERSION && capacity == SHM_RING_BUFFER_SIZE;
+  }
+
+  // Server only: take over a ring a previous server left behind, continuing
+  // its sequence space. After a crash the one message that may have been
+  // claimed but never published is given up (its seq is reused). Returns
+  // whether the previous server shut down cleanly.
+  bool warmStart() {
+    bool was_clean = clean_shutdown.load(std::memory_order_acquire) != 0;
+    clean_shutdown.store(0, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_relaxed);
+    SeqNum next = write_seq.load(std::memory_order_relaxed);
+    if (!was_clean && next > 0 &&
+        slots[(next - 1) % SHM_RING_BUFFER_SIZE].seq.load(
+            std::memory_order_relaxed) != next - 1) {
+      write_seq.store(next - 1, std::memory_order_relaxed);
+    }
+    server_running.store(true, std::memory_order_release);
+    return was_clean;
+  }
+
+  // Server only: last call before unmapping a persistent ring
+  void markCleanShutdown() {
+    server_running.store(false, std::memory_order_release);
+    clean_shutdown.store(1, std::memory_order_release);
+  }
+
+  SeqNum push(const Msg& msg) {
+    SeqNum seq = write_seq.fetch_add(1, std::memory_order_relaxed);
+    size_t index = seq % SHM_RING_BUFFER_SIZE;
+
+    SharedSlot& slot = slots[index];
+    SeqNum old_seq = slot.seq.load(std::memory_order_relaxed);
+    if (old_seq != INVALID_SEQ) {
+      lap_tracker.onOverwrite(consumers, old_seq);
+    }
+    slot.msg = msg;
+    slot.msg.seq_num = seq;
+    slot.seq.store(seq, std::memory_order_release);
+
+    return seq;
+  }
+
+  // Read with explicit status, as RingBuffer::readEx(): OVERWRITTEN once the
+  // slot holds a later sequence (the reader was lapped and expected_seq is
+  // gone), NOT_READY while it has not been published yet. The copy is
+  // re-validated against the slot sequence, so a message overwritten while
+  // it was being copied is reported as OVERWRITTEN rather than returned torn.
+  ReadResult readEx(SeqNum expected_seq) const {
+    if (expected_seq < 0) {
+      return {ReadStatus::NOT_READY, {}};
+    }
+
+    size_t index = expected_seq % SHM_RING_BUFFER_SIZE;
+    const SharedSlot& slot = slots[index];
+
+    SeqNum published_seq = slot.seq.load(std::memory_order_acquire);
+    if (published_seq == expected_seq) {
+      Msg local_msg = slot.msg;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == expected_seq) {
+        return {ReadStatus::OK, local_msg};
+      }
+      return {ReadStatus::OVERWRITTEN, {}};
+    }
+    if (published_seq > expected_seq) {
+      return {ReadStatus::OVERWRITTEN, {}};
+    }
+    return {ReadStatus::NOT_READY, {}};
+  }
+
+  // Cannot distinguish NOT_READY from OVERWRITTEN; prefer readEx()
+  std::optional<Msg> read(SeqNum expected_seq) const {
+    auto result = readEx(expected_seq);
+    if (result.status == ReadStatus::OK) {
+      return result.msg;
+    }
+    return std::nullopt;
+  }
+
+  SeqNum getLatestSeq() const {
+    return write_seq.load(std::memory_order_acquire) - 1;
+  }
+
+  // Oldest sequence number still resident (0 before the first wrap)
+  SeqNum getOldestSeq() const {
+    return std::max(SeqNum(0), getLatestSeq() -
+                                   static_cast<SeqNum>(SHM_RING_BUFFER_SIZE) +
+                                   1);
+  }
+
+  bool isServerRunning() const {
+    return server_running.load(std::memory_order_acquire);
+  }
+};
+
+// Open the ring's backing object: POSIX shared memory SHM_NAME when
+// ring_file is empty, otherwise the file ring_file. Returns the descriptor,
+// or -1 with errno set.
+inline int openRing(const std::string& ring_file, bool create) {
+  int flags = create ? O_CREAT | O_RDWR : O_RDWR;
+  return ring_file.empty() ? shm_open(SHM_NAME, flags, 0666)
+                           : open(ring_file.c_str(), flags, 0666);
+}
+
+}  // namespace replay::ipc
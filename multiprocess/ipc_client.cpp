@@ -8,6 +8,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <array>
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <csignal>
@@ -16,60 +18,20 @@
 #include <optional>
 #include <thread>
 
+#include "SharedRingBuffer.hpp"
 #include "common/CpuAffinity.hpp"
+#include "common/LatencyHistogram.hpp"
 #include "common/Logging.hpp"
 #include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/PayloadSum.hpp"
+#include "common/TscClock.hpp"
 #include "common/Types.hpp"
 
 namespace {
 
-// Shared memory name (consistent with server)
-const char* SHM_NAME = "/mktdata_rb";
-
-// Shared memory size
-constexpr size_t SHM_RING_BUFFER_SIZE = 1024 * 64;
-constexpr size_t CACHE_LINE_SIZE = 64;
-
-// Shared ring buffer structure (consistent with server)
-struct alignas(CACHE_LINE_SIZE) SharedSlot {
-  replay::Msg msg;
-  std::atomic<replay::SeqNum> seq;
-  char padding[CACHE_LINE_SIZE - sizeof(replay::Msg) -
-               sizeof(std::atomic<replay::SeqNum>)];
-};
-
-struct SharedRingBuffer {
-  alignas(CACHE_LINE_SIZE) std::atomic<replay::SeqNum> write_seq;
-  alignas(CACHE_LINE_SIZE) std::atomic<bool> server_running;
-  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> total_messages;
-
-  SharedSlot slots[SHM_RING_BUFFER_SIZE];
-
-  std::optional<replay::Msg> read(replay::SeqNum expected_seq) const {
-    if (expected_seq < 0) {
-      return std::nullopt;
-    }
-
-    size_t index = expected_seq % SHM_RING_BUFFER_SIZE;
-    const SharedSlot& slot = slots[index];
-
-    replay::SeqNum published_seq = slot.seq.load(std::memory_order_acquire);
-
-    if (published_seq == expected_seq) {
-      return slot.msg;
-    }
-
-    return std::nullopt;
-  }
-
-  replay::SeqNum getLatestSeq() const {
-    return write_seq.load(std::memory_order_acquire) - 1;
-  }
-
-  bool isServerRunning() const {
-    return server_running.load(std::memory_order_acquire);
-  }
-};
+using replay::ipc::SHM_NAME;
+using replay::ipc::SharedRingBuffer;
 
 // Global variables
 SharedRingBuffer* g_buffer = nullptr;
@@ -77,6 +39,9 @@ std::atomic<bool> g_stop_requested{false};
 
 int g_shm_fd = -1;
 
+// Persistent ring file (--ring-file), empty = POSIX shared memory
+std::string g_ring_file;
+
 // Signal handler
 void signalHandler(int sig) {
   std::cout << "\nReceived signal " << sig << ", stopping..." << std::endl;
@@ -85,13 +50,22 @@ void signalHandler(int sig) {
 
 // Connect to shared memory
 bool connectToSharedMemory() {
-  g_shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
+  g_shm_fd = replay::ipc::openRing(g_ring_file, false);
   if (g_shm_fd == -1) {
     std::cerr << "shm_open failed: " << strerror(errno) << std::endl;
     LOG_ERROR(replay::logger(), "shm_open failed: {}", strerror(errno));
     return false;
   }
 
+  // A ring file the server has not sized yet cannot be mapped safely
+  struct stat st {};
+  if (fstat(g_shm_fd, &st) == -1 ||
+      static_cast<size_t>(st.st_size) < sizeof(SharedRingBuffer)) {
+    close(g_shm_fd);
+    g_shm_fd = -1;
+    return false;
+  }
+
   g_buffer = static_cast<SharedRingBuffer*>(
       mmap(nullptr, sizeof(SharedRingBuffer), PROT_READ | PROT_WRITE,
            MAP_SHARED, g_shm_fd, 0));
@@ -103,9 +77,37 @@ bool connectToSharedMemory() {
     return false;
   }
 
+  // A ring file outlives its server: wait until one has initialized (or
+  // warm-restarted) it
+  if (!g_ring_file.empty() &&
+      (!g_buffer->isCompatible() || !g_buffer->isServerRunning())) {
+    munmap(g_buffer, sizeof(SharedRingBuffer));
+    g_buffer = nullptr;
+    close(g_shm_fd);
+    g_shm_fd = -1;
+    return false;
+  }
+
   return true;
 }
 
+// First sequence number a client without state reads, per policy: the head,
+// or the oldest message safely in the ring (a sixteenth of the ring above the
+// producer's overwrite edge). There is no disk path here, so anything older
+// is not replayed.
+replay::SeqNum joinSeq(replay::JoinPolicy policy) {
+  replay::SeqNum head = g_buffer->getLatestSeq() + 1;
+  if (policy != replay::JoinPolicy::OLDEST_RESIDENT) {
+    return head;
+  }
+  replay::SeqNum oldest = g_buffer->getOldestSeq();
+  if (oldest == 0) {
+    return 0;
+  }
+  return std::min(head, oldest + static_cast<replay::SeqNum>(
+                                     replay::ipc::SHM_RING_BUFFER_SIZE / 16));
+}
+
 // Disconnect from shared memory
 void disconnectFromSharedMemory() {
   if (g_buffer && g_buffer != MAP_FAILED) {
@@ -127,13 +129,24 @@ int main(int argc, char* argv[]) {
 
   // Parse command line arguments
   int cpu_core = replay::CPU_CORE_UNSET;
+  replay::JoinPolicy join_policy = replay::JoinPolicy::OLDEST_RESIDENT;
   for (int i = 1; i < argc; ++i) {
     std::string arg = argv[i];
     if (arg.find("--cpu=") == 0) {
       cpu_core = std::stoi(arg.substr(6));
+    } else if (arg.find("--ring-file=") == 0) {
+      g_ring_file = arg.substr(12);
+    } else if (arg == "--join=head") {
+      join_policy = replay::JoinPolicy::HEAD;
+    } else if (arg == "--join=oldest") {
+      join_policy = replay::JoinPolicy::OLDEST_RESIDENT;
     } else if (arg == "--help") {
       std::cout << "Usage: " << argv[0] << " [options]\n"
-                << "  --cpu=<core>  Pin process to CPU core\n"
+                << "  --cpu=<core>        Pin process to CPU core\n"
+                << "  --ring-file=<path>  Persistent ring file the server "
+                   "uses (default: shared memory)\n"
+                << "  --join=<policy>     Where a new client joins a running "
+                   "stream: head, oldest (default: oldest)\n"
                 << std::endl;
       return 0;
     }
@@ -169,33 +182,135 @@ int main(int argc, char* argv[]) {
   std::cout << "Connected to shared memory" << std::endl;
   LOG_INFO(logger, "Connected to shared memory {}", "");
 
+  // Server's timestamp clock, for cross-process latency
+  replay::TscClock clock(g_buffer->clock, replay::TscClock::Role::READER);
+
   // Consume messages
   replay::SeqNum read_seq = 0;
   int64_t processed_count = 0;
+  int64_t lost_count = 0;  // Overwritten before they were read
   double sum = 0.0;
   double kahan_c = 0.0;  // Kahan summation compensation
 
+  std::array<replay::Msg, replay::CONSUME_BATCH_SIZE> batch;
+
+  // Server timestamp -> client read latency, one clock read per batch
+  replay::LatencyHistogram latency;
+
+  // Live metrics for replay_top (the run goes on without them)
+  replay::Counter processed_metric;
+  replay::Gauge seq_metric;
+  replay::Gauge batch_metric;
+  replay::Counter lost_metric;
+  auto metrics = replay::MetricsRegistry::openShared(
+      replay::METRICS_SHM_NAME, replay::MetricsRegistry::Access::PUBLISH);
+  if (metrics) {
+    metrics->bind(processed_metric, "ipc_client.processed");
+    metrics->bind(seq_metric, "ipc_client.seq");
+    metrics->bind(batch_metric, "ipc_client.batch");
+    metrics->bind(lost_metric, "ipc_client.lost");
+  }
+
+  int64_t join_start_ns = clock.nowNs();
+  int64_t time_to_live_ns = -1;
+  replay::SeqNum join_seq = joinSeq(join_policy);
+
+  // Register with the server so it can track our lag (a crashed client's
+  // slot is released by the server). On a persistent ring a restarted client
+  // resumes from the cursor its predecessor left in the table; otherwise it
+  // joins by its policy.
+  int consumer_id;
+  if (g_ring_file.empty()) {
+    read_seq = join_seq;
+    consumer_id = g_buffer->consumers.registerConsumer("ipc_client", join_seq,
+                                                       join_start_ns);
+  } else {
+    consumer_id = g_buffer->consumers.resumeConsumer(
+        "ipc_client", join_seq, join_start_ns, read_seq);
+  }
+  if (consumer_id < 0) {
+    LOG_WARNING(logger, "Consumer table full, lag not tracked {}", "");
+  }
+  if (read_seq == join_seq) {
+    std::cout << "Joining at seq " << join_seq
+              << " (join=" << replay::toString(join_policy) << ")"
+              << std::endl;
+    LOG_INFO(logger, "Joining at seq {}, join={}", join_seq,
+             replay::toString(join_policy));
+  } else {
+    replay::SeqNum oldest = g_buffer->getOldestSeq();
+    std::cout << "Resuming at seq " << std::max(read_seq, oldest)
+              << " (ring generation " << g_buffer->generation.load() << ")"
+              << std::endl;
+    if (read_seq < oldest) {
+      std::cout << "Messages " << read_seq << ".." << oldest - 1
+                << " are no longer in the ring" << std::endl;
+      LOG_WARNING(logger, "Resume cursor {} behind the ring, skipping to {}",
+                  read_seq, oldest);
+      read_seq = oldest;
+    }
+  }
+
   auto start_time = std::chrono::high_resolution_clock::now();
 
   while (!g_stop_requested) {
-    auto msg = g_buffer->read(read_seq);
+    // Drain everything already published (up to one batch)
+    size_t count = 0;
+    replay::ReadStatus status = replay::ReadStatus::OK;
+    while (count < batch.size()) {
+      auto result =
+          g_buffer->readEx(read_seq + static_cast<replay::SeqNum>(count));
+      status = result.status;
+      if (status != replay::ReadStatus::OK) {
+        break;
+      }
+      batch[count++] = result.msg;
+    }
 
-    if (msg) {
-      // Kahan summation
-      double y = msg->payload - kahan_c;
+    if (count > 0) {
+      int64_t now = clock.nowNs();
+      for (size_t i = 0; i < count; ++i) {
+        latency.record(now - batch[i].timestamp_ns);
+      }
+
+      // Kahan summation, one step per batch
+      std::span<const replay::Msg> ready(batch.data(), count);
+      double y = replay::sumPayloads(ready) - kahan_c;
       double t = sum + y;
       kahan_c = (t - sum) - y;
       sum = t;
 
-      processed_count++;
-      read_seq++;
+      int64_t prev_count = processed_count;
+      processed_count += static_cast<int64_t>(count);
+      read_seq += static_cast<replay::SeqNum>(count);
+
+      processed_metric.add(static_cast<int64_t>(count));
+      seq_metric.set(read_seq - 1);
+      batch_metric.set(static_cast<int64_t>(count));
+      g_buffer->consumers.publish(consumer_id, read_seq, now);
 
       // Progress display
-      if (processed_count % 10000 == 0) {
+      if (processed_count / 10000 != prev_count / 10000) {
         std::cout << "Processed: " << processed_count
                   << " messages, current sum: " << sum << std::endl;
       }
+    } else if (status == replay::ReadStatus::OVERWRITTEN) {
+      // Lapped: the server overwrote read_seq before we read it. Those
+      // messages are gone; rejoin the ring as a new client would.
+      replay::SeqNum resume = std::max(read_seq + 1, joinSeq(join_policy));
+      lost_count += resume - read_seq;
+      lost_metric.add(resume - read_seq);
+      g_buffer->consumers.recordLapped(consumer_id);
+      LOG_WARNING(logger, "ipc_client lapped at seq={}, resuming at {}",
+                  read_seq, resume);
+      read_seq = resume;
+      g_buffer->consumers.publish(consumer_id, read_seq, clock.nowNs());
     } else {
+      // Caught up with the server for the first time since the join
+      if (time_to_live_ns < 0) {
+        time_to_live_ns = clock.nowNs() - join_start_ns;
+      }
+
       // Check if server is still running
       if (!g_buffer->isServerRunning()) {
         // Server has stopped, try to process remaining messages
@@ -204,10 +319,13 @@ int main(int argc, char* argv[]) {
           break;  // All messages processed
         }
       }
+      g_buffer->consumers.heartbeat(consumer_id, clock.nowNs());
       std::this_thread::yield();
     }
   }
 
+  g_buffer->consumers.unregisterConsumer(consumer_id);
+
   auto end_time = std::chrono::high_resolution_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
       end_time - start_time);
@@ -218,12 +336,23 @@ int main(int argc, char* argv[]) {
             << std::endl;
   std::cout << "Sum: " << std::fixed << sum << std::endl;
   std::cout << "Last sequence number: " << read_seq - 1 << std::endl;
+  if (lost_count > 0) {
+    std::cout << "Lost (lapped by the server): " << lost_count << " messages"
+              << std::endl;
+  }
   std::cout << "Time: " << duration.count() << " ms" << std::endl;
+  if (time_to_live_ns >= 0) {
+    std::cout << "Time to live: " << time_to_live_ns / 1000 << " us (join="
+              << replay::toString(join_policy) << ")" << std::endl;
+  }
+  std::cout << "Latency (ns, " << (clock.usesTsc() ? "TSC" : "system")
+            << " clock): " << latency.snapshot().summary() << std::endl;
 
   LOG_INFO(
       logger,
-      "ipc_client complete: processed={}, sum={}, last_seq={}, duration_ms={}",
-      processed_count, sum, read_seq - 1, duration.count());
+      "ipc_client complete: processed={}, lost={}, sum={}, last_seq={}, "
+      "duration_ms={}",
+      processed_count, lost_count, sum, read_seq - 1, duration.count());
 
   if (processed_count > 0) {
     double throughput =
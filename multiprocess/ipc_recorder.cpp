@@ -20,71 +20,33 @@
 #include <thread>
 #include <vector>
 
+#include "SharedRingBuffer.hpp"
 #include "channel/FileChannel.hpp"
 #include "common/CpuAffinity.hpp"
 #include "common/Logging.hpp"
 #include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/PayloadSum.hpp"
+#include "common/TscClock.hpp"
 #include "common/Types.hpp"
 
 namespace {
 
-// Shared memory name (consistent with server)
-const char* SHM_NAME = "/mktdata_rb";
-
-// Shared memory size
-constexpr size_t SHM_RING_BUFFER_SIZE = 1024 * 64;
-constexpr size_t CACHE_LINE_SIZE = 64;
+using replay::ipc::SHM_NAME;
+using replay::ipc::SharedRingBuffer;
 
 // Batch write size
 constexpr size_t BATCH_SIZE = 1024;
 
-// Shared ring buffer structure (consistent with server)
-struct alignas(CACHE_LINE_SIZE) SharedSlot {
-  replay::Msg msg;
-  std::atomic<replay::SeqNum> seq;
-  char padding[CACHE_LINE_SIZE - sizeof(replay::Msg) -
-               sizeof(std::atomic<replay::SeqNum>)];
-};
-
-struct SharedRingBuffer {
-  alignas(CACHE_LINE_SIZE) std::atomic<replay::SeqNum> write_seq;
-  alignas(CACHE_LINE_SIZE) std::atomic<bool> server_running;
-  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> total_messages;
-
-  SharedSlot slots[SHM_RING_BUFFER_SIZE];
-
-  std::optional<replay::Msg> read(replay::SeqNum expected_seq) const {
-    if (expected_seq < 0) {
-      return std::nullopt;
-    }
-
-    size_t index = expected_seq % SHM_RING_BUFFER_SIZE;
-    const SharedSlot& slot = slots[index];
-
-    replay::SeqNum published_seq = slot.seq.load(std::memory_order_acquire);
-
-    if (published_seq == expected_seq) {
-      return slot.msg;
-    }
-
-    return std::nullopt;
-  }
-
-  replay::SeqNum getLatestSeq() const {
-    return write_seq.load(std::memory_order_acquire) - 1;
-  }
-
-  bool isServerRunning() const {
-    return server_running.load(std::memory_order_acquire);
-  }
-};
-
 // Global variables
 SharedRingBuffer* g_buffer = nullptr;
 std::atomic<bool> g_stop_requested{false};
 
 int g_shm_fd = -1;
 
+// Persistent ring file (--ring-file), empty = POSIX shared memory
+std::string g_ring_file;
+
 // Signal handler
 void signalHandler(int sig) {
   std::cout << "\nReceived signal " << sig << ", stopping..." << std::endl;
@@ -93,11 +55,20 @@ void signalHandler(int sig) {
 
 // Connect to shared memory
 bool connectToSharedMemory() {
-  g_shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
+  g_shm_fd = replay::ipc::openRing(g_ring_file, false);
   if (g_shm_fd == -1) {
     return false;
   }
 
+  // A ring file the server has not sized yet cannot be mapped safely
+  struct stat st {};
+  if (fstat(g_shm_fd, &st) == -1 ||
+      static_cast<size_t>(st.st_size) < sizeof(SharedRingBuffer)) {
+    close(g_shm_fd);
+    g_shm_fd = -1;
+    return false;
+  }
+
   g_buffer = static_cast<SharedRingBuffer*>(
       mmap(nullptr, sizeof(SharedRingBuffer), PROT_READ | PROT_WRITE,
            MAP_SHARED, g_shm_fd, 0));
@@ -107,6 +78,17 @@ bool connectToSharedMemory() {
     return false;
   }
 
+  // A ring file outlives its server: wait until one has initialized (or
+  // warm-restarted) it
+  if (!g_ring_file.empty() &&
+      (!g_buffer->isCompatible() || !g_buffer->isServerRunning())) {
+    munmap(g_buffer, sizeof(SharedRingBuffer));
+    g_buffer = nullptr;
+    close(g_shm_fd);
+    g_shm_fd = -1;
+    return false;
+  }
+
   return true;
 }
 
@@ -145,17 +127,43 @@ int main(int argc, char* argv[]) {
 
   // Parse command line arguments
   int cpu_core = replay::CPU_CORE_UNSET;
+  bool resume = false;
+  replay::FileFormat format = replay::FileFormat::COLUMNAR;
+  replay::CodecId codec = replay::CodecId::NONE;
   for (int i = 1; i < argc; ++i) {
     std::string arg = argv[i];
     if (arg.find("--output=") == 0) {
       output_file = arg.substr(9);
     } else if (arg.find("--cpu=") == 0) {
       cpu_core = std::stoi(arg.substr(6));
+    } else if (arg.find("--ring-file=") == 0) {
+      g_ring_file = arg.substr(12);
+    } else if (arg == "--resume") {
+      resume = true;
+    } else if (arg == "--format=v2") {
+      format = replay::FileFormat::RAW;
+    } else if (arg == "--format=v3") {
+      format = replay::FileFormat::COLUMNAR;
+    } else if (arg.find("--codec=") == 0) {
+      auto parsed = replay::codecFromName(arg.substr(8));
+      if (!parsed) {
+        std::cerr << "Unknown codec: " << arg.substr(8) << std::endl;
+        return 1;
+      }
+      codec = *parsed;
     } else if (arg == "--help") {
       std::cout << "Usage: " << argv[0] << " [options]\n"
                 << "  --output=<file>  Output file path (default: "
                    "data/mktdata_ipc_YYYYMMDD.bin)\n"
                 << "  --cpu=<core>     Pin process to CPU core\n"
+                << "  --ring-file=<path>  Persistent ring file the server "
+                   "uses (default: shared memory)\n"
+                << "  --resume         Continue an existing output file "
+                   "after a crash\n"
+                << "  --format=v2|v3   File layout: raw records or column "
+                   "blocks (default: v3)\n"
+                << "  --codec=<name>   Compress v3 blocks: none, lz, lz4, "
+                   "zstd (lz4/zstd if built in; default: none)\n"
                 << std::endl;
       return 0;
     }
@@ -193,9 +201,17 @@ int main(int argc, char* argv[]) {
 
   std::cout << "Connected to shared memory" << std::endl;
 
-  // Create file write channel
-  replay::FileWriteChannel channel(output_file);
-  if (!channel.open()) {
+  // Create file write channel; a resumed file is validated and its tail
+  // trimmed to the last consistent message (and keeps its own layout)
+  replay::FileWriteChannel channel(output_file, format);
+  if (!channel.setCodec(codec)) {
+    std::cerr << "Codec not built in: " << replay::toString(codec)
+              << std::endl;
+    LOG_ERROR(logger, "Codec not built in: {}", replay::toString(codec));
+    disconnectFromSharedMemory();
+    return 1;
+  }
+  if (!(resume ? channel.openAppend() : channel.open())) {
     std::cerr << "Cannot create output file: " << output_file << std::endl;
     LOG_ERROR(logger, "Cannot create output file: {}", output_file);
     disconnectFromSharedMemory();
@@ -211,6 +227,90 @@ int main(int argc, char* argv[]) {
   std::vector<replay::Msg> batch;
   batch.reserve(BATCH_SIZE);
 
+  // Live metrics for replay_top (the run goes on without them)
+  replay::Counter recorded_metric;
+  replay::Gauge seq_metric;
+  replay::Counter written_metric;
+  auto metrics = replay::MetricsRegistry::openShared(
+      replay::METRICS_SHM_NAME, replay::MetricsRegistry::Access::PUBLISH);
+  if (metrics) {
+    metrics->bind(recorded_metric, "ipc_recorder.recorded");
+    metrics->bind(seq_metric, "ipc_recorder.seq");
+    metrics->bind(written_metric, "ipc_recorder.written");
+  }
+
+  // Register with the server so it can track our lag; the cursor and
+  // heartbeat are published once per flushed batch. With --resume on a
+  // persistent ring a restarted recorder takes over the cursor its
+  // predecessor left in the table; a fresh file always records from seq 0.
+  // A resumed file is the authority over the table: recording continues
+  // right after its last message, so the file stays gap-free.
+  replay::TscClock clock(g_buffer->clock, replay::TscClock::Role::READER);
+  int consumer_id;
+  if (resume && !g_ring_file.empty()) {
+    consumer_id = g_buffer->consumers.resumeConsumer(
+        "ipc_recorder", 0, clock.nowNs(), read_seq);
+  } else {
+    consumer_id =
+        g_buffer->consumers.registerConsumer("ipc_recorder", 0, clock.nowNs());
+  }
+  if (consumer_id < 0) {
+    LOG_WARNING(logger, "Consumer table full, lag not tracked {}", "");
+  }
+  if (resume && channel.getLastSeq() != replay::INVALID_SEQ) {
+    replay::SeqNum file_next = channel.getLastSeq() + 1;
+    std::cout << "Resuming " << output_file << ": kept "
+              << channel.getMessageCount() << " messages, trimmed "
+              << channel.getTrimmedCount() << std::endl;
+    LOG_INFO(logger, "Resume file: kept={}, trimmed={}, next_seq={}, "
+             "table_cursor={}", channel.getMessageCount(),
+             channel.getTrimmedCount(), file_next, read_seq);
+    if (file_next < g_buffer->getOldestSeq()) {
+      // Continuing would leave a gap in the file; it needs a replay instead
+      std::cerr << "Seq " << file_next << " is no longer in the ring (oldest "
+                << g_buffer->getOldestSeq() << "), cannot resume "
+                << output_file << std::endl;
+      LOG_ERROR(logger, "Resume seq {} behind the ring (oldest {}), file "
+                "left at last_seq={}", file_next, g_buffer->getOldestSeq(),
+                channel.getLastSeq());
+      g_buffer->consumers.unregisterConsumer(consumer_id);
+      channel.close();
+      disconnectFromSharedMemory();
+      return 1;
+    }
+    read_seq = file_next;
+    std::cout << "Resuming at seq " << read_seq << " (ring generation "
+              << g_buffer->generation.load() << ")" << std::endl;
+  } else if (read_seq > 0) {
+    replay::SeqNum oldest = g_buffer->getOldestSeq();
+    if (read_seq < oldest) {
+      LOG_ERROR(logger, "Resume cursor {} behind the ring, {} messages lost",
+                read_seq, oldest - read_seq);
+      read_seq = oldest;
+    }
+    std::cout << "Resuming at seq " << read_seq << " (ring generation "
+              << g_buffer->generation.load() << ")" << std::endl;
+  }
+
+  // Write the pending batch and fold its payloads into the expected sum with
+  // one compensated-sum kernel call and one Kahan step
+  auto flushBatch = [&]() {
+    if (batch.empty()) {
+      return;
+    }
+    double y = replay::sumPayloads(batch) - kahan_c;
+    double t = expected_sum + y;
+    kahan_c = (t - expected_sum) - y;
+    expected_sum = t;
+
+    for (const auto& m : batch) {
+      channel.write(m);
+    }
+    written_metric.add(static_cast<int64_t>(batch.size()));
+    batch.clear();
+    channel.periodicFlush();
+  };
+
   auto start_time = std::chrono::high_resolution_clock::now();
 
   while (!g_stop_requested) {
@@ -218,23 +318,15 @@ int main(int argc, char* argv[]) {
 
     if (msg) {
       batch.push_back(*msg);
-
-      // Kahan summation
-      double y = msg->payload - kahan_c;
-      double t = expected_sum + y;
-      kahan_c = (t - expected_sum) - y;
-      expected_sum = t;
-
       recorded_count++;
       read_seq++;
+      recorded_metric.add();
+      seq_metric.set(msg->seq_num);
 
       // Batch write
       if (batch.size() >= BATCH_SIZE) {
-        for (const auto& m : batch) {
-          channel.write(m);
-        }
-        batch.clear();
-        channel.flush();
+        flushBatch();
+        g_buffer->consumers.publish(consumer_id, read_seq, clock.nowNs());
       }
 
       // Progress display
@@ -243,13 +335,8 @@ int main(int argc, char* argv[]) {
       }
     } else {
       // Write remaining data
-      if (!batch.empty()) {
-        for (const auto& m : batch) {
-          channel.write(m);
-        }
-        batch.clear();
-        channel.flush();
-      }
+      flushBatch();
+      g_buffer->consumers.publish(consumer_id, read_seq, clock.nowNs());
 
       // Check if server is still running
       if (!g_buffer->isServerRunning()) {
@@ -263,12 +350,8 @@ int main(int argc, char* argv[]) {
   }
 
   // Write remaining data
-  if (!batch.empty()) {
-    for (const auto& m : batch) {
-      channel.write(m);
-    }
-    channel.flush();
-  }
+  flushBatch();
+  g_buffer->consumers.unregisterConsumer(consumer_id);
 
   channel.close();
 
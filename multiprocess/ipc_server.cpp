@@ -16,64 +16,20 @@
 #include <iostream>
 #include <random>
 #include <thread>
+#include <vector>
 
+#include "SharedRingBuffer.hpp"
 #include "common/CpuAffinity.hpp"
 #include "common/Logging.hpp"
 #include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/TscClock.hpp"
 #include "common/Types.hpp"
 
 namespace {
 
-// Shared memory name
-const char* SHM_NAME = "/mktdata_rb";
-
-// Shared memory size
-constexpr size_t SHM_RING_BUFFER_SIZE = 1024 * 64;  // 64K entries
-constexpr size_t CACHE_LINE_SIZE = 64;
-
-// Shared ring buffer structure
-struct alignas(CACHE_LINE_SIZE) SharedSlot {
-  replay::Msg msg;
-  std::atomic<replay::SeqNum> seq;
-  char padding[CACHE_LINE_SIZE - sizeof(replay::Msg) -
-               sizeof(std::atomic<replay::SeqNum>)];
-};
-
-struct SharedRingBuffer {
-  // Control information
-  alignas(CACHE_LINE_SIZE) std::atomic<replay::SeqNum> write_seq;
-  alignas(CACHE_LINE_SIZE) std::atomic<bool> server_running;
-  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> total_messages;
-
-  // Data slots
-  SharedSlot slots[SHM_RING_BUFFER_SIZE];
-
-  void init() {
-    write_seq.store(0, std::memory_order_relaxed);
-    server_running.store(true, std::memory_order_relaxed);
-    total_messages.store(0, std::memory_order_relaxed);
-
-    for (auto& slot : slots) {
-      slot.seq.store(replay::INVALID_SEQ, std::memory_order_relaxed);
-    }
-  }
-
-  replay::SeqNum push(const replay::Msg& msg) {
-    replay::SeqNum seq = write_seq.fetch_add(1, std::memory_order_relaxed);
-    size_t index = seq % SHM_RING_BUFFER_SIZE;
-
-    SharedSlot& slot = slots[index];
-    slot.msg = msg;
-    slot.msg.seq_num = seq;
-    slot.seq.store(seq, std::memory_order_release);
-
-    return seq;
-  }
-
-  replay::SeqNum getLatestSeq() const {
-    return write_seq.load(std::memory_order_acquire) - 1;
-  }
-};
+using replay::ipc::SHM_NAME;
+using replay::ipc::SharedRingBuffer;
 
 // Global variables
 SharedRingBuffer* g_buffer = nullptr;
@@ -81,6 +37,22 @@ std::atomic<bool> g_stop_requested{false};
 
 int g_shm_fd = -1;
 
+// Persistent ring file (--ring-file), empty = POSIX shared memory
+std::string g_ring_file;
+
+// Registered consumers and how far each trails the write position
+void printConsumers(const SharedRingBuffer& buffer) {
+  std::vector<replay::ConsumerInfo> consumers;
+  buffer.consumers.snapshot(consumers, replay::tscTimestampNs());
+  replay::SeqNum next_seq = buffer.getLatestSeq() + 1;
+  for (const auto& c : consumers) {
+    std::cout << "  consumer " << c.name << " (pid " << c.pid
+              << "): lag=" << next_seq - c.cursor
+              << " lapped=" << c.lapped_count
+              << (c.live ? "" : " [stale]") << std::endl;
+  }
+}
+
 // Signal handler
 void signalHandler(int sig) {
   std::cout << "\nReceived signal " << sig << ", stopping..." << std::endl;
@@ -90,18 +62,31 @@ void signalHandler(int sig) {
   }
 }
 
-// Create shared memory
-bool createSharedMemory() {
-  // First try to remove existing shared memory
-  shm_unlink(SHM_NAME);
+// Create shared memory. A persistent ring file of the right layout is taken
+// over as it is (warm restart); anything else starts a fresh ring.
+bool createSharedMemory(bool& warm) {
+  warm = false;
+  if (g_ring_file.empty()) {
+    // First try to remove existing shared memory
+    shm_unlink(SHM_NAME);
+  }
 
-  g_shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+  g_shm_fd = replay::ipc::openRing(g_ring_file, true);
   if (g_shm_fd == -1) {
     std::cerr << "shm_open failed: " << strerror(errno) << std::endl;
     LOG_ERROR(replay::logger(), "shm_open failed: {}", strerror(errno));
     return false;
   }
 
+  struct stat st {};
+  bool reuse = !g_ring_file.empty() && fstat(g_shm_fd, &st) == 0 &&
+               static_cast<size_t>(st.st_size) == sizeof(SharedRingBuffer);
+  if (!reuse && ftruncate(g_shm_fd, 0) == -1) {
+    std::cerr << "ftruncate failed: " << strerror(errno) << std::endl;
+    LOG_ERROR(replay::logger(), "ftruncate failed: {}", strerror(errno));
+    close(g_shm_fd);
+    return false;
+  }
   if (ftruncate(g_shm_fd, sizeof(SharedRingBuffer)) == -1) {
     std::cerr << "ftruncate failed: " << strerror(errno) << std::endl;
     LOG_ERROR(replay::logger(), "ftruncate failed: {}", strerror(errno));
@@ -122,19 +107,29 @@ bool createSharedMemory() {
     return false;
   }
 
+  if (reuse && g_buffer->isCompatible()) {
+    warm = true;
+    return true;
+  }
+
   // Initialize shared memory
   g_buffer->init();
 
   return true;
 }
 
-// Cleanup shared memory
+// Cleanup shared memory. A persistent ring is flushed and kept, marked as
+// cleanly shut down, for the next server to continue.
 void cleanupSharedMemory() {
   if (g_buffer) {
     g_buffer->server_running.store(false, std::memory_order_release);
   }
 
   if (g_buffer && g_buffer != MAP_FAILED) {
+    if (!g_ring_file.empty()) {
+      g_buffer->markCleanShutdown();
+      msync(g_buffer, sizeof(SharedRingBuffer), MS_SYNC);
+    }
     munmap(g_buffer, sizeof(SharedRingBuffer));
     g_buffer = nullptr;
   }
@@ -142,7 +137,9 @@ void cleanupSharedMemory() {
     close(g_shm_fd);
     g_shm_fd = -1;
   }
-  shm_unlink(SHM_NAME);
+  if (g_ring_file.empty()) {
+    shm_unlink(SHM_NAME);
+  }
 }
 
 }  // namespace
@@ -151,6 +148,9 @@ int main(int argc, char* argv[]) {
   auto* logger = replay::initLogger("ipc_server");
   std::cout << "=== Multiprocess Server ===" << std::endl;
 
+  // Calibrate the process-wide clock (tscTimestampNs()) before the send loop
+  replay::TscClock::global();
+
   // Default parameters
   int64_t message_count = 10000;
   int64_t message_rate = 1000;
@@ -165,11 +165,15 @@ int main(int argc, char* argv[]) {
       message_rate = std::stoll(arg.substr(7));
     } else if (arg.find("--cpu=") == 0) {
       cpu_core = std::stoi(arg.substr(6));
+    } else if (arg.find("--ring-file=") == 0) {
+      g_ring_file = arg.substr(12);
     } else if (arg == "--help") {
       std::cout << "Usage: " << argv[0] << " [options]\n"
                 << "  --messages=<count>  Message count (default: 10000)\n"
                 << "  --rate=<rate>       Messages per second (default: 1000)\n"
                 << "  --cpu=<core>        Pin process to CPU core\n"
+                << "  --ring-file=<path>  Keep the ring in this file across "
+                   "restarts (tmpfs/DAX/disk) instead of shared memory\n"
                 << std::endl;
       return 0;
     }
@@ -191,16 +195,47 @@ int main(int argc, char* argv[]) {
   std::signal(SIGTERM, signalHandler);
 
   // Create shared memory
-  if (!createSharedMemory()) {
+  bool warm = false;
+  if (!createSharedMemory(warm)) {
     std::cerr << "Failed to create shared memory" << std::endl;
     LOG_ERROR(logger, "Failed to create shared memory {}", "");
     return 1;
   }
+  if (warm) {
+    bool was_clean = g_buffer->warmStart();
+    std::cout << "Warm restart on " << g_ring_file << ": generation "
+              << g_buffer->generation.load() << ", continuing at seq "
+              << g_buffer->getLatestSeq() + 1
+              << (was_clean ? "" : " (previous server did not shut down "
+                                   "cleanly)")
+              << std::endl;
+    LOG_INFO(logger, "Warm restart: file={}, generation={}, next_seq={}, "
+             "clean={}", g_ring_file, g_buffer->generation.load(),
+             g_buffer->getLatestSeq() + 1, was_clean);
+  }
 
   std::cout << "Shared memory created, waiting for client connection..."
             << std::endl;
   LOG_INFO(logger, "Shared memory created {}", "");
 
+  // Calibrate the timestamp clock into shared memory; clients convert their
+  // own TSC reads with the same parameters
+  replay::TscClock clock(g_buffer->clock, replay::TscClock::Role::OWNER);
+  std::cout << "Timestamp clock: " << (clock.usesTsc() ? "TSC" : "system")
+            << std::endl;
+  LOG_INFO(logger, "Timestamp clock: tsc={}, mult={}", clock.usesTsc(),
+           clock.getParams().mult);
+
+  // Live metrics for replay_top (the run goes on without them)
+  replay::Counter sent_metric;
+  replay::Gauge seq_metric;
+  auto metrics = replay::MetricsRegistry::openShared(
+      replay::METRICS_SHM_NAME, replay::MetricsRegistry::Access::PUBLISH);
+  if (metrics) {
+    metrics->bind(sent_metric, "server.sent");
+    metrics->bind(seq_metric, "server.seq");
+  }
+
   // Random number generator
   std::mt19937 rng(std::random_device{}());
   std::uniform_real_distribution<double> dist(0.0, 100.0);
@@ -214,11 +249,13 @@ int main(int argc, char* argv[]) {
 
   for (int64_t i = 0; i < message_count && !g_stop_requested; ++i) {
     double payload = dist(rng);
-    int64_t timestamp = replay::getCurrentTimestampNs();
+    int64_t timestamp = clock.nowNs();
 
     replay::Msg msg(replay::INVALID_SEQ, timestamp, payload);
-    g_buffer->push(msg);
+    replay::SeqNum seq = g_buffer->push(msg);
     g_buffer->total_messages.fetch_add(1, std::memory_order_release);
+    sent_metric.add();
+    seq_metric.set(seq);
 
     total_payload += payload;
 
@@ -235,6 +272,12 @@ int main(int argc, char* argv[]) {
     if ((i + 1) % (message_count / 10) == 0) {
       std::cout << "Progress: " << (i + 1) * 100 / message_count << "%"
                 << std::endl;
+      size_t reaped = g_buffer->consumers.reapDeadProcesses();
+      if (reaped > 0) {
+        LOG_WARNING(logger, "Released {} consumer slot(s) of exited processes",
+                    reaped);
+      }
+      printConsumers(*g_buffer);
     }
   }
 
@@ -247,16 +290,23 @@ int main(int argc, char* argv[]) {
             << " messages" << std::endl;
   std::cout << "Sum: " << std::fixed << total_payload << std::endl;
   std::cout << "Time: " << duration.count() << " ms" << std::endl;
+  std::cout << "Lapped (overwritten unread): "
+            << g_buffer->lap_tracker.getLappedCount() << std::endl;
+  printConsumers(*g_buffer);
 
-  LOG_INFO(logger, "ipc_server complete: sent={}, sum={}, duration_ms={}",
-           g_buffer->total_messages.load(), total_payload, duration.count());
+  LOG_INFO(logger,
+           "ipc_server complete: sent={}, sum={}, duration_ms={}, lapped={}",
+           g_buffer->total_messages.load(), total_payload, duration.count(),
+           g_buffer->lap_tracker.getLappedCount());
 
   // Wait for clients to finish processing
   std::cout << "Waiting for clients to process..." << std::endl;
   std::this_thread::sleep_for(std::chrono::seconds(2));
 
-  // Cleanup
+  // Cleanup (the recalibration thread writes into shared memory)
+  clock.stopRecalibration();
   cleanupSharedMemory();
+  replay::MetricsRegistry::unlinkShared(replay::METRICS_SHM_NAME);
   std::cout << "Shared memory cleaned up" << std::endl;
   LOG_INFO(logger, "Shared memory cleaned up {}", "");
 
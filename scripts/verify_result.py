@@ -5,6 +5,7 @@ Result verification script
 Verifies message sum in disk files
 """
 
+import math
 import struct
 import sys
 import os
@@ -14,25 +15,49 @@ from pathlib import Path
 # File format constants
 FILE_MAGIC = 0x4D4B5444  # "MKTD"
 FILE_VERSION = 2
+FILE_VERSION_COLUMNAR = 3
+FILE_VERSION_FRAMES = 4  # Variable-length frames, see src/common/Frame.hpp
 HEADER_SIZE = 64
 MSG_SIZE = 24
 
+# Record schemas (FileHeader.schema_id, see src/common/Record.hpp)
+SCHEMA_LEGACY = 0  # Written before the field existed: Msg
+SCHEMA_MSG = 1
+
+# v3 column blocks (see src/channel/ColumnBlock.hpp)
+BLOCK_MAGIC = 0x424C4B33  # "BLK3"
+BLOCK_HEADER_SIZE = 128
+BLOCK_FLAG_SEQ_DENSE = 0x0001
+BLOCK_FLAG_PAYLOAD_XOR = 0x0002
+BLOCK_FLAG_CRC = 0x0004
+BLOCK_FLAG_ZONE_MAP = 0x0008
+BLOCK_CRC_OFFSET = 56  # BlockHeader.crc
+BLOCK_ZONE_MAP_OFFSET = 64  # BlockHeader.min_seq
+
+# Block body codecs (see src/channel/BlockCodec.hpp)
+CODEC_NONE = 0
+CODEC_LZ = 1
+CODEC_LZ4 = 2
+CODEC_ZSTD = 3
+
 # File flags
 FILE_FLAG_COMPLETE = 0x0001
 
 
 def read_header(f):
-    """Read file header (64 bytes, v2 format)"""
+    """Read file header (64 bytes, v2/v3 format)"""
     data = f.read(HEADER_SIZE)
     if len(data) < HEADER_SIZE:
         return None
 
-    # Parse file header (v2, 64 bytes):
-    #   magic(4) + version(2) + flags(2) + date(4) + reserved1(4)
-    #   + msg_count(8) + first_seq(8) + last_seq(8) + reserved2(24)
-    (magic, version, flags, date, reserved1,
+    # Parse file header (64 bytes):
+    #   magic(4) + version(2) + flags(2) + date(4) + block_messages(4)
+    #   + msg_count(8) + first_seq(8) + last_seq(8) + data_end(8)
+    #   + schema_id(4) + record_size(4) + reserved2(8)
+    (magic, version, flags, date, block_messages,
      msg_count, first_seq, last_seq,
-     _r2_0, _r2_1, _r2_2) = struct.unpack('<IHHIIqqqqqq', data)
+     data_end, schema_id, record_size,
+     _r2) = struct.unpack('<IHHIIqqqqIIq', data)
 
     return {
         'magic': magic,
@@ -42,22 +67,227 @@ def read_header(f):
         'msg_count': msg_count,
         'first_seq': first_seq,
         'last_seq': last_seq,
+        'block_messages': block_messages,
+        'data_end': data_end,
+        'schema_id': schema_id,
+        'record_size': record_size,
         'complete': (flags & FILE_FLAG_COMPLETE) != 0
     }
 
 
-def read_messages(f, count):
+def read_raw_records(f, count):
+    """Yield (seq_num, timestamp_ns, payload) from a v2 body"""
+    for _ in range(count):
+        data = f.read(MSG_SIZE)
+        if len(data) < MSG_SIZE:
+            break
+        yield struct.unpack('<qqd', data)
+
+
+def get_varint(data, pos):
+    """Decode a LEB128 varint, return (value, next_pos)"""
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, pos
+        shift += 7
+
+
+def zigzag_decode(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def xor_decode(data, n):
+    """Decode n XOR-coded payloads (see src/common/PayloadCodec.hpp)"""
+    bits = int.from_bytes(data, 'big')
+    total = len(data) * 8
+    pos = 0
+
+    def take(width):
+        nonlocal pos
+        pos += width
+        return (bits >> (total - pos)) & ((1 << width) - 1)
+
+    value = take(64)
+    values = [value]
+    trailing = 0
+    width = 0
+    for _ in range(1, n):
+        if take(1):
+            if take(1):
+                leading = take(5)
+                width = take(6) or 64
+                trailing = 64 - leading - width
+            value ^= take(width) << trailing
+        values.append(value)
+    return [struct.unpack('<d', struct.pack('<Q', v))[0] for v in values]
+
+
+def make_crc32c_table():
+    table = []
+    for byte in range(256):
+        crc = byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 if crc & 1 else 0)
+        table.append(crc)
+    return table
+
+
+CRC32C_TABLE = make_crc32c_table()
+
+
+def crc32c(data, crc=0):
+    """CRC32C (see src/common/Crc32c.hpp)"""
+    crc ^= 0xFFFFFFFF
+    for byte in data:
+        crc = (crc >> 8) ^ CRC32C_TABLE[(crc ^ byte) & 0xFF]
+    return crc ^ 0xFFFFFFFF
+
+
+def block_checksum_ok(header_bytes, body, flags, crc):
+    """Check a block's CRC32C: header with the crc field zeroed, then body"""
+    if not flags & BLOCK_FLAG_CRC:
+        return True
+    zeroed = (header_bytes[:BLOCK_CRC_OFFSET] + bytes(4) +
+              header_bytes[BLOCK_CRC_OFFSET + 4:])
+    return crc32c(body, crc32c(zeroed)) == crc
+
+
+def zone_map_ok(header_bytes, seqs, timestamps, payloads):
+    """Check a block's min/max zone map against its decoded messages"""
+    zone = struct.unpack_from('<qqqqdd', header_bytes, BLOCK_ZONE_MAP_OFFSET)
+    if any(math.isnan(p) for p in payloads):
+        payload_range = (-math.inf, math.inf)  # NaN widens the range
+    else:
+        payload_range = (min(payloads), max(payloads))
+    return zone == (min(seqs), max(seqs), min(timestamps), max(timestamps),
+                    *payload_range)
+
+
+def lz_decompress(data, out_size):
+    """Decompress an in-tree LZ body (see src/channel/LzCodec.hpp)"""
+    out = bytearray()
+    pos = 0
+
+    def length(value):
+        nonlocal pos
+        while True:
+            byte = data[pos]
+            pos += 1
+            value += byte
+            if byte != 255:
+                return value
+
+    while pos < len(data):
+        token = data[pos]
+        pos += 1
+        literals = token >> 4
+        if literals == 15:
+            literals = length(literals)
+        out += data[pos:pos + literals]
+        pos += literals
+        if pos >= len(data):
+            break
+        offset = data[pos] | (data[pos + 1] << 8)
+        pos += 2
+        match = token & 15
+        if match == 15:
+            match = length(match)
+        match += 4
+        start = len(out) - offset
+        for i in range(match):
+            out.append(out[start + i])
+    if len(out) != out_size:
+        raise ValueError('LZ body decodes to %d bytes, expected %d'
+                         % (len(out), out_size))
+    return bytes(out)
+
+
+def decompress_body(codec, body, raw_size):
+    """Column bytes of a stored block body"""
+    if codec == CODEC_NONE:
+        return body
+    if codec == CODEC_LZ:
+        return lz_decompress(body, raw_size)
+    if codec == CODEC_LZ4:
+        import lz4.block
+        return lz4.block.decompress(body, uncompressed_size=raw_size)
+    if codec == CODEC_ZSTD:
+        import zstandard
+        return zstandard.ZstdDecompressor().decompress(
+            body, max_output_size=raw_size)
+    raise ValueError('unknown block codec %d' % codec)
+
+
+def read_column_blocks(f, count):
+    """Yield (seq_num, timestamp_ns, payload) from a v3 body"""
+    read = 0
+    while read < count:
+        data = f.read(BLOCK_HEADER_SIZE)
+        if len(data) < BLOCK_HEADER_SIZE:
+            break
+        (magic, n, body_bytes, flags, codec, _r0, first_seq, _last_seq,
+         first_ts, seq_bytes, ts_bytes, payload_bytes, raw_body_bytes,
+         crc) = struct.unpack_from('<IIIHBBqqqIIIII', data)
+        body = f.read(body_bytes)
+        if magic != BLOCK_MAGIC or len(body) < body_bytes:
+            break
+        if not block_checksum_ok(data, body, flags, crc):
+            print(f"Error: checksum mismatch in block at seq {first_seq}")
+            break
+        try:
+            body = decompress_body(codec, body, raw_body_bytes)
+        except (ImportError, ValueError, IndexError) as e:
+            print(f"Error: cannot decompress block at seq {first_seq}: {e}")
+            break
+
+        # Seq column: dense, or gap bitmap + zigzag varint skips
+        seqs = [first_seq]
+        skip_pos = (n + 7) // 8
+        for i in range(1, n):
+            seq = seqs[-1] + 1
+            if not (flags & BLOCK_FLAG_SEQ_DENSE) and (body[i // 8] >> (i % 8)) & 1:
+                skip, skip_pos = get_varint(body, skip_pos)
+                seq += zigzag_decode(skip)
+            seqs.append(seq)
+
+        # Timestamp column: zigzag varint deltas
+        timestamps = [first_ts]
+        pos = seq_bytes
+        for _ in range(1, n):
+            delta, pos = get_varint(body, pos)
+            timestamps.append(timestamps[-1] + zigzag_decode(delta))
+
+        payload_at = seq_bytes + ts_bytes
+        if flags & BLOCK_FLAG_PAYLOAD_XOR:
+            payloads = xor_decode(body[payload_at:payload_at + payload_bytes], n)
+        else:
+            payloads = struct.unpack_from(f'<{n}d', body, payload_at)
+        if flags & BLOCK_FLAG_ZONE_MAP and not zone_map_ok(
+                data, seqs, timestamps, payloads):
+            print(f"Error: zone map does not match block at seq {first_seq}")
+            break
+        for i in range(min(n, count - read)):
+            yield seqs[i], timestamps[i], payloads[i]
+        read += n
+
+
+def read_messages(f, header):
     """Read messages and calculate sum"""
     total_sum = 0.0
     kahan_c = 0.0  # Kahan summation compensation value
     messages = []
 
-    for i in range(count):
-        data = f.read(MSG_SIZE)
-        if len(data) < MSG_SIZE:
-            break
+    if header['version'] == FILE_VERSION_COLUMNAR:
+        records = read_column_blocks(f, header['msg_count'])
+    else:
+        records = read_raw_records(f, header['msg_count'])
 
-        seq_num, timestamp_ns, payload = struct.unpack('<qqd', data)
+    for seq_num, timestamp_ns, payload in records:
         messages.append({
             'seq_num': seq_num,
             'timestamp_ns': timestamp_ns,
@@ -98,21 +328,39 @@ def verify_file(filepath):
             return False
 
         # Verify version
-        if header['version'] != FILE_VERSION:
-            print(f"Warning: Version mismatch {header['version']} (expected {FILE_VERSION})")
+        if header['version'] not in (FILE_VERSION, FILE_VERSION_COLUMNAR):
+            print(f"Warning: Version mismatch {header['version']} (expected {FILE_VERSION} or {FILE_VERSION_COLUMNAR})")
 
         print(f"File version: {header['version']}")
+
+        if header['version'] == FILE_VERSION_FRAMES:
+            print("Error: Variable-length frame recording (v4), not a Msg "
+                  "recording")
+            return False
+
+        # Only Msg recordings can be verified here
+        if header['schema_id'] != SCHEMA_LEGACY and (
+                header['schema_id'] != SCHEMA_MSG or
+                header['record_size'] != MSG_SIZE):
+            print(f"Error: Not a Msg recording (schema {header['schema_id']}, "
+                  f"{header['record_size']}-byte records)")
+            return False
         print(f"File flags: 0x{header['flags']:04X} (complete={header['complete']})")
         print(f"Message count: {header['msg_count']}")
         print(f"Sequence range: [{header['first_seq']}, {header['last_seq']}]")
 
         # Calculate expected file size
-        expected_size = HEADER_SIZE + header['msg_count'] * MSG_SIZE
+        if header['version'] == FILE_VERSION_COLUMNAR:
+            expected_size = header['data_end']
+        else:
+            expected_size = HEADER_SIZE + header['msg_count'] * MSG_SIZE
         if file_size != expected_size:
             print(f"Warning: File size mismatch (expected {expected_size} bytes)")
+        if header['msg_count'] > 0:
+            print(f"Bytes per message: {(file_size - HEADER_SIZE) / header['msg_count']:.2f}")
 
         # Read messages
-        messages, total_sum = read_messages(f, header['msg_count'])
+        messages, total_sum = read_messages(f, header)
 
         print(f"Read messages: {len(messages)} messages")
         print(f"Sum: {total_sum:.10f}")
@@ -208,7 +456,7 @@ def main():
         with open(files[0], 'rb') as f:
             header = read_header(f)
             if header:
-                _, actual_sum = read_messages(f, header['msg_count'])
+                _, actual_sum = read_messages(f, header)
                 if not compare_sums(expected_sum, actual_sum):
                     all_passed = False
 
@@ -0,0 +1,291 @@
+#include "LineArbitrator.hpp"
+
+#include <algorithm>
+#include <span>
+#include <string>
+
+#include "common/Logging.hpp"
+#include "common/TscClock.hpp"
+
+namespace replay {
+
+LineArbitrator::LineArbitrator(RingBufferType& line_a, RingBufferType& line_b,
+                               RingBufferType& downstream)
+    : lines_{Line(line_a), Line(line_b)},
+      downstream_(downstream),
+      next_seq_(INVALID_SEQ),
+      pass_count_(0),
+      stall_since_ns_(0),
+      gap_timeout_ns_(DEFAULT_GAP_TIMEOUT_NS),
+      out_size_(0),
+      next_seq_shared_(INVALID_SEQ),
+      running_(false),
+      stop_requested_(false) {}
+
+LineArbitrator::~LineArbitrator() { stop(); }
+
+void LineArbitrator::start() {
+  if (running_) {
+    LOG_WARNING(replay::logger(),
+                "LineArbitrator already running, ignoring start {}", "");
+    return;
+  }
+
+  stop_requested_ = false;
+  running_ = true;
+
+  LOG_INFO(replay::logger(), "LineArbitrator start: gap_timeout={}ns",
+           gap_timeout_ns_);
+  thread_ = std::thread(&LineArbitrator::run, this);
+}
+
+void LineArbitrator::stop() {
+  stop_requested_ = true;
+
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  if (running_) {
+    running_ = false;
+    ArbitrationStats stats = getStats();
+    LOG_INFO(replay::logger(),
+             "LineArbitrator stopped: published={}, lost={}, a.wins={}, "
+             "b.wins={}",
+             stats.published, stats.lost, stats.line(FeedLine::A).wins,
+             stats.line(FeedLine::B).wins);
+  }
+}
+
+bool LineArbitrator::isRunning() const { return running_; }
+
+void LineArbitrator::setGapTimeout(int64_t timeout_ns) {
+  gap_timeout_ns_ = timeout_ns;
+}
+
+void LineArbitrator::setCpuCore(int core_id) { cpu_core_ = core_id; }
+
+void LineArbitrator::attachMetrics(MetricsRegistry& registry,
+                                   std::string_view prefix) {
+  std::string name(prefix);
+  registry.bind(published_metric_, name + ".published");
+  registry.bind(seq_metric_, name + ".seq");
+  registry.bind(lost_metric_, name + ".lost");
+  for (FeedLine line : {FeedLine::A, FeedLine::B}) {
+    std::string line_name = name + "." + feedLineName(line);
+    LineMetrics& metrics = line_metrics_[static_cast<size_t>(line)];
+    registry.bind(metrics.wins, line_name + ".wins");
+    registry.bind(metrics.duplicates, line_name + ".duplicates");
+    registry.bind(metrics.gaps, line_name + ".gaps");
+  }
+}
+
+SeqNum LineArbitrator::getNextSeq() const {
+  return next_seq_shared_.load(std::memory_order_acquire);
+}
+
+ArbitrationStats LineArbitrator::getStats() const {
+  SpinLockGuard guard(stats_lock_);
+  return stats_;
+}
+
+// ---------------------------------------------------------------------------
+// Arbitration pass
+// ---------------------------------------------------------------------------
+size_t LineArbitrator::poll() {
+  const int64_t published_before = work_.published;
+  for (size_t i = 0; i < lines_.size(); ++i) {
+    refill(lines_[i], work_.lines[i]);
+  }
+
+  if (next_seq_ == INVALID_SEQ) {
+    // Start at the lowest feed sequence either line has
+    for (const Line& line : lines_) {
+      if (line.holding()) {
+        SeqNum seq = line.buffer[line.head].seq_num;
+        next_seq_ = next_seq_ == INVALID_SEQ ? seq : std::min(next_seq_, seq);
+      }
+    }
+    if (next_seq_ == INVALID_SEQ) {
+      return 0;
+    }
+  }
+
+  const size_t first = pass_count_++ & 1;
+  while (true) {
+    // Either line's progress may fill the gap the other is held at
+    bool progress;
+    do {
+      progress = drain(lines_[first], work_.lines[first]);
+      progress |= drain(lines_[first ^ 1], work_.lines[first ^ 1]);
+    } while (progress);
+
+    // Each line is now empty or held at a message past next_seq_
+    const Line& a = lines_[0];
+    const Line& b = lines_[1];
+    if (a.holding() && b.holding()) {
+      skipTo(std::min(a.buffer[a.head].seq_num, b.buffer[b.head].seq_num),
+             false);
+      continue;
+    }
+    if (a.holding() || b.holding()) {
+      const Line& held = a.holding() ? a : b;
+      int64_t now = tscTimestampNs();
+      if (stall_since_ns_ == 0 || work_.published != published_before) {
+        stall_since_ns_ = now;
+      } else if (now - stall_since_ns_ >= gap_timeout_ns_) {
+        skipTo(held.buffer[held.head].seq_num, true);
+        continue;
+      }
+    } else {
+      stall_since_ns_ = 0;
+    }
+    break;
+  }
+
+  flush();
+  bool changed = work_.lost != published_stats_.lost;
+  for (size_t i = 0; i < lines_.size(); ++i) {
+    changed |= work_.lines[i].received != published_stats_.lines[i].received ||
+               work_.lines[i].lapped != published_stats_.lines[i].lapped;
+  }
+  if (changed) {
+    publishStats();
+  }
+  return static_cast<size_t>(work_.published - published_before);
+}
+
+void LineArbitrator::refill(Line& line, LineStats& stats) {
+  if (line.holding()) {
+    return;
+  }
+  line.head = 0;
+  line.size = line.ring.readBatch(line.cursor, line.buffer);
+  if (line.size > 0) {
+    line.cursor += static_cast<SeqNum>(line.size);
+    stats.received += static_cast<int64_t>(line.size);
+    line.ring.consumers().publish(line.consumer_id, line.cursor,
+                                  tscTimestampNs());
+    return;
+  }
+
+  if (line.ring.readEx(line.cursor).status == ReadStatus::OVERWRITTEN) {
+    // Lapped: the line's next messages are gone, which shows up as a gap
+    // in its feed sequence once it resumes
+    SeqNum resume = std::max(line.cursor + 1, line.ring.getOldestSeq());
+    stats.lapped += resume - line.cursor;
+    line.ring.consumers().recordLapped(line.consumer_id);
+    line.cursor = resume;
+  }
+}
+
+bool LineArbitrator::drain(Line& line, LineStats& stats) {
+  const size_t head = line.head;
+  SeqNum next = next_seq_;
+  while (line.holding()) {
+    const Msg& msg = line.buffer[line.head];
+    const SeqNum seq = msg.seq_num;
+    if (seq > next) {
+      break;  // Gap on this line: wait for the other one
+    }
+    ++line.head;
+
+    if (seq > line.expected && line.expected != INVALID_SEQ) {
+      ++stats.gaps;
+      stats.gap_messages += seq - line.expected;
+    }
+    line.expected = std::max(line.expected, seq + 1);
+
+    if (seq < next) {
+      ++stats.duplicates;
+      continue;
+    }
+    out_[out_size_++] = msg;
+    if (out_size_ == out_.size()) {
+      flush();
+    }
+    ++stats.wins;
+    ++work_.published;
+    ++next;
+  }
+  next_seq_ = next;
+
+  // A held message may still be behind a gap the line itself skipped
+  if (line.holding()) {
+    SeqNum seq = line.buffer[line.head].seq_num;
+    if (seq > line.expected && line.expected != INVALID_SEQ) {
+      ++stats.gaps;
+      stats.gap_messages += seq - line.expected;
+      line.expected = seq;
+    }
+  }
+  return line.head != head;
+}
+
+void LineArbitrator::skipTo(SeqNum seq, bool timed_out) {
+  const int64_t lost = seq - next_seq_;
+  work_.lost += lost;
+  if (timed_out) {
+    ++work_.timeouts;
+  }
+  LOG_WARNING(replay::logger(), "LineArbitrator: skipped seq {}..{} ({})",
+              next_seq_, seq - 1,
+              timed_out ? "gap timeout" : "missing on both lines");
+  next_seq_ = seq;
+  stall_since_ns_ = 0;
+}
+
+void LineArbitrator::flush() {
+  if (out_size_ > 0) {
+    downstream_.pushBatchKeepSeq(std::span<const Msg>(out_.data(), out_size_));
+    out_size_ = 0;
+  }
+}
+
+void LineArbitrator::publishStats() {
+  next_seq_shared_.store(next_seq_, std::memory_order_release);
+  {
+    SpinLockGuard guard(stats_lock_);
+    stats_ = work_;
+  }
+
+  published_metric_.add(work_.published - published_stats_.published);
+  seq_metric_.set(next_seq_ - 1);
+  lost_metric_.add(work_.lost - published_stats_.lost);
+  for (size_t i = 0; i < line_metrics_.size(); ++i) {
+    const LineStats& now = work_.lines[i];
+    const LineStats& before = published_stats_.lines[i];
+    line_metrics_[i].wins.add(now.wins - before.wins);
+    line_metrics_[i].duplicates.add(now.duplicates - before.duplicates);
+    line_metrics_[i].gaps.add(now.gaps - before.gaps);
+  }
+  published_stats_ = work_;
+}
+
+// ---------------------------------------------------------------------------
+// Arbitration loop: busy-poll both lines, registered as a consumer of each
+// ---------------------------------------------------------------------------
+void LineArbitrator::run() {
+  setCpuAffinity(cpu_core_, "LineArbitrator");
+
+  for (FeedLine id : {FeedLine::A, FeedLine::B}) {
+    Line& line = lines_[static_cast<size_t>(id)];
+    line.consumer_id = line.ring.consumers().registerConsumer(
+        std::string("arb.") + feedLineName(id), line.cursor,
+        tscTimestampNs());
+  }
+
+  while (!stop_requested_) {
+    if (poll() == 0) {
+      std::this_thread::yield();
+    }
+  }
+  publishStats();
+
+  for (Line& line : lines_) {
+    line.ring.consumers().unregisterConsumer(line.consumer_id);
+    line.consumer_id = -1;
+  }
+}
+
+}  // namespace replay
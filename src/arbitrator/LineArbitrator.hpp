@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <thread>
+
+#include "common/CpuAffinity.hpp"
+#include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/RingBuffer.hpp"
+#include "common/SpinLock.hpp"
+#include "common/Types.hpp"
+
+namespace replay {
+
+// One of the two redundant lines of a feed
+enum class FeedLine : uint8_t { A = 0, B = 1 };
+
+constexpr const char* feedLineName(FeedLine line) {
+  return line == FeedLine::A ? "a" : "b";
+}
+
+// Counters of one line
+struct LineStats {
+  int64_t received = 0;      // Messages read from the line ring
+  int64_t wins = 0;          // Published from this line (it had them first)
+  int64_t duplicates = 0;    // Already published from the other line
+  int64_t gaps = 0;          // Jumps in the line's own feed sequence
+  int64_t gap_messages = 0;  // Feed sequence numbers the line skipped
+  int64_t lapped = 0;        // Overwritten in the line ring before read
+};
+
+struct ArbitrationStats {
+  std::array<LineStats, 2> lines;
+  int64_t published = 0;  // Messages in the downstream ring
+  int64_t lost = 0;       // Skipped: missing on both lines or timed out
+  int64_t timeouts = 0;   // Gaps given up on after the gap timeout
+
+  const LineStats& line(FeedLine l) const {
+    return lines[static_cast<size_t>(l)];
+  }
+
+  // Share of the published messages that came from line l
+  double winRate(FeedLine l) const {
+    return published > 0 ? static_cast<double>(line(l).wins) / published
+                         : 0.0;
+  }
+};
+
+// A/B line arbitrator
+// Merges two rings carrying the same feed (lines A and B, each in feed
+// sequence order but with its own losses) into one clean stream in a
+// downstream ring. Messages are matched by seq_num, which must be the feed
+// sequence (see RingBuffer::pushBatchKeepSeq()); the downstream ring keeps
+// it as well.
+//
+// The first line to deliver the next feed sequence number wins and the other
+// line's copy is dropped as a duplicate. A line that skips ahead is held at
+// the message after its gap while the other line fills it. Since each line
+// is in order, a sequence number that both lines have moved past is lost on
+// both: it is counted and skipped at once. If the other line stays silent,
+// the gap is given up on after the gap timeout.
+//
+// Lines are read in batches of CONSUME_BATCH_SIZE. When both lines already
+// hold the next message, the line drained first in that pass takes it; the
+// first line alternates from pass to pass so neither line is favoured.
+class LineArbitrator {
+ public:
+  using RingBufferType = RingBuffer<DEFAULT_RING_BUFFER_SIZE>;
+
+  // A line gap is given up on when the other line delivers nothing for
+  // this long
+  static constexpr int64_t DEFAULT_GAP_TIMEOUT_NS = 1'000'000;
+
+  // The rings must outlive the arbitrator
+  LineArbitrator(RingBufferType& line_a, RingBufferType& line_b,
+                 RingBufferType& downstream);
+  ~LineArbitrator();
+
+  // Disable copy and move
+  LineArbitrator(const LineArbitrator&) = delete;
+  LineArbitrator& operator=(const LineArbitrator&) = delete;
+  LineArbitrator(LineArbitrator&&) = delete;
+  LineArbitrator& operator=(LineArbitrator&&) = delete;
+
+  // Start arbitrating on a dedicated thread (busy-polls both lines)
+  void start();
+
+  void stop();
+
+  bool isRunning() const;
+
+  // One arbitration pass on the calling thread (not while running): read
+  // what both lines have and publish what can be published. Returns the
+  // number of messages published.
+  size_t poll();
+
+  // Time a line gap may wait for the other line (call before start())
+  void setGapTimeout(int64_t timeout_ns);
+
+  // Set CPU core for this thread (call before start())
+  void setCpuCore(int core_id);
+
+  // Publish <prefix>.published, .seq (last published feed seq), .lost and,
+  // per line, <prefix>.a.wins, .a.duplicates, .a.gaps (and .b.*) into a
+  // metrics registry (call before start())
+  void attachMetrics(MetricsRegistry& registry,
+                     std::string_view prefix = "arb");
+
+  // Next feed sequence number to publish (INVALID_SEQ before the first)
+  SeqNum getNextSeq() const;
+
+  // Counters as of the last pass
+  ArbitrationStats getStats() const;
+
+ private:
+  struct Line {
+    RingBufferType& ring;
+    SeqNum cursor = 0;                // Next ring sequence to read
+    SeqNum expected = INVALID_SEQ;    // Next feed sequence on this line
+    std::array<Msg, CONSUME_BATCH_SIZE> buffer;
+    size_t head = 0;
+    size_t size = 0;
+    int consumer_id = -1;
+
+    explicit Line(RingBufferType& r) : ring(r) {}
+
+    bool holding() const { return head < size; }
+  };
+
+  struct LineMetrics {
+    Counter wins;
+    Counter duplicates;
+    Counter gaps;
+  };
+
+  void run();
+
+  // Read the next batch of an empty line
+  void refill(Line& line, LineStats& stats);
+
+  // Publish or drop the line's messages up to its first one past next_seq_;
+  // false if it had none to take
+  bool drain(Line& line, LineStats& stats);
+
+  // Skip next_seq_ forward to seq, counting the skipped numbers as lost
+  void skipTo(SeqNum seq, bool timed_out);
+
+  void flush();
+
+  void publishStats();
+
+  std::array<Line, 2> lines_;
+  RingBufferType& downstream_;
+
+  // Arbitration state, owned by the polling thread
+  SeqNum next_seq_;
+  uint64_t pass_count_;
+  int64_t stall_since_ns_;  // First pass of the current wait on a gap
+  int64_t gap_timeout_ns_;
+  ArbitrationStats work_;
+  ArbitrationStats published_stats_;  // work_ at the last publishStats()
+  std::array<Msg, CONSUME_BATCH_SIZE> out_;
+  size_t out_size_;
+
+  std::atomic<SeqNum> next_seq_shared_;
+  mutable SpinLock stats_lock_;
+  ArbitrationStats stats_;
+
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<bool> stop_requested_;
+
+  // Published metrics, written once per pass that did something
+  Counter published_metric_;
+  Gauge seq_metric_;
+  Counter lost_metric_;
+  std::array<LineMetrics, 2> line_metrics_;
+
+  int cpu_core_ = CPU_CORE_UNSET;
+};
+
+}  // namespace replay
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "LzCodec.hpp"
+
+#ifdef REPLAY_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef REPLAY_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace replay {
+
+// General-purpose compression of v3 block bodies (stored in
+// BlockHeader.codec). The in-tree LZ codec is always available; lz4 and
+// zstd are compiled in when CMake finds them (REPLAY_HAVE_LZ4 /
+// REPLAY_HAVE_ZSTD).
+enum class CodecId : uint8_t {
+  NONE = 0,
+  LZ = 1,
+  LZ4 = 2,
+  ZSTD = 3,
+};
+
+inline const char* toString(CodecId id) {
+  switch (id) {
+    case CodecId::LZ:
+      return "lz";
+    case CodecId::LZ4:
+      return "lz4";
+    case CodecId::ZSTD:
+      return "zstd";
+    default:
+      return "none";
+  }
+}
+
+inline std::optional<CodecId> codecFromName(std::string_view name) {
+  for (CodecId id :
+       {CodecId::NONE, CodecId::LZ, CodecId::LZ4, CodecId::ZSTD}) {
+    if (name == toString(id)) {
+      return id;
+    }
+  }
+  return std::nullopt;
+}
+
+// Block compressor. Implementations are stateless and safe to call from
+// several threads at once.
+class BlockCodec {
+ public:
+  virtual ~BlockCodec() = default;
+
+  virtual CodecId id() const = 0;
+
+  // Largest compress() result for n input bytes
+  virtual size_t compressBound(size_t n) const = 0;
+
+  // Compress n bytes of src into dst (capacity >= compressBound(n)).
+  // Returns the compressed size, 0 on failure.
+  virtual size_t compress(const uint8_t* src, size_t n, uint8_t* dst) const = 0;
+
+  // Decompress n bytes of src into exactly out_size bytes of dst. Returns
+  // false on malformed input.
+  virtual bool decompress(const uint8_t* src, size_t n, uint8_t* dst,
+                          size_t out_size) const = 0;
+};
+
+class LzBlockCodec : public BlockCodec {
+ public:
+  CodecId id() const override { return CodecId::LZ; }
+
+  size_t compressBound(size_t n) const override { return lzCompressBound(n); }
+
+  size_t compress(const uint8_t* src, size_t n, uint8_t* dst) const override {
+    return lzCompress(src, n, dst);
+  }
+
+  bool decompress(const uint8_t* src, size_t n, uint8_t* dst,
+                  size_t out_size) const override {
+    return lzDecompress(src, n, dst, out_size);
+  }
+};
+
+#ifdef REPLAY_HAVE_LZ4
+class Lz4BlockCodec : public BlockCodec {
+ public:
+  CodecId id() const override { return CodecId::LZ4; }
+
+  size_t compressBound(size_t n) const override {
+    return static_cast<size_t>(LZ4_compressBound(static_cast<int>(n)));
+  }
+
+  size_t compress(const uint8_t* src, size_t n, uint8_t* dst) const override {
+    int size = LZ4_compress_default(reinterpret_cast<const char*>(src),
+                                    reinterpret_cast<char*>(dst),
+                                    static_cast<int>(n),
+                                    static_cast<int>(compressBound(n)));
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+  bool decompress(const uint8_t* src, size_t n, uint8_t* dst,
+                  size_t out_size) const override {
+    int size = LZ4_decompress_safe(reinterpret_cast<const char*>(src),
+                                   reinterpret_cast<char*>(dst),
+                                   static_cast<int>(n),
+                                   static_cast<int>(out_size));
+    return size >= 0 && static_cast<size_t>(size) == out_size;
+  }
+};
+#endif
+
+#ifdef REPLAY_HAVE_ZSTD
+class ZstdBlockCodec : public BlockCodec {
+ public:
+  // Fast levels only: the recorder compresses on its write path
+  static constexpr int LEVEL = 1;
+
+  CodecId id() const override { return CodecId::ZSTD; }
+
+  size_t compressBound(size_t n) const override {
+    return ZSTD_compressBound(n);
+  }
+
+  size_t compress(const uint8_t* src, size_t n, uint8_t* dst) const override {
+    size_t size = ZSTD_compress(dst, compressBound(n), src, n, LEVEL);
+    return ZSTD_isError(size) ? 0 : size;
+  }
+
+  bool decompress(const uint8_t* src, size_t n, uint8_t* dst,
+                  size_t out_size) const override {
+    size_t size = ZSTD_decompress(dst, out_size, src, n);
+    return !ZSTD_isError(size) && size == out_size;
+  }
+};
+#endif
+
+// Codec for id, or nullptr for NONE and codecs not compiled in
+inline const BlockCodec* findCodec(CodecId id) {
+  switch (id) {
+    case CodecId::LZ: {
+      static const LzBlockCodec codec;
+      return &codec;
+    }
+#ifdef REPLAY_HAVE_LZ4
+    case CodecId::LZ4: {
+      static const Lz4BlockCodec codec;
+      return &codec;
+    }
+#endif
+#ifdef REPLAY_HAVE_ZSTD
+    case CodecId::ZSTD: {
+      static const ZstdBlockCodec codec;
+      return &codec;
+    }
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace replay
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ColumnBlock.hpp"
+
+namespace replay {
+
+// Reads and decodes the blocks of a v3 recording on a pool of threads ahead
+// of a sequential reader (FileChannel).
+//
+// Blocks are handed out in file order from start(first): each worker claims
+// the next block index, reads it through its own stream, decompresses and
+// decodes it into a slot of a ring of 2 x threads slots, and take() returns
+// the blocks in order. Workers never run more than the ring's depth ahead of
+// the reader, so memory stays bounded however fast they are. Reading from
+// another place means start() again (the pool is restarted).
+class BlockPrefetcher {
+ public:
+  BlockPrefetcher(std::string filepath, std::vector<int64_t> block_offsets,
+                  size_t threads)
+      : filepath_(std::move(filepath)),
+        offsets_(std::move(block_offsets)),
+        threads_(threads > 0 ? threads : 1),
+        slots_(2 * threads_) {}
+
+  ~BlockPrefetcher() { stop(); }
+
+  BlockPrefetcher(const BlockPrefetcher&) = delete;
+  BlockPrefetcher& operator=(const BlockPrefetcher&) = delete;
+
+  // (Re)start decoding at block index first
+  void start(size_t first) {
+    stop();
+    for (Slot& slot : slots_) {
+      slot.ready = false;
+    }
+    next_ = first;
+    claim_ = first;
+    stopping_ = false;
+    started_ = true;
+    for (size_t i = 0; i < threads_; ++i) {
+      workers_.emplace_back([this] { work(); });
+    }
+  }
+
+  // Stop and join the workers
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    work_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+    workers_.clear();
+    started_ = false;
+  }
+
+  // Index of the block the next take() returns (meaningful once started)
+  size_t nextIndex() const { return next_; }
+
+  bool isStarted() const { return started_; }
+
+  // Wait for block nextIndex() and swap its messages into out. Returns false
+  // past the last block or if the block could not be read or decoded.
+  bool take(std::vector<Msg>& out) {
+    if (!started_ || next_ >= offsets_.size()) {
+      return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    Slot& slot = slots_[next_ % slots_.size()];
+    ready_cv_.wait(lock, [&] { return slot.ready; });
+    slot.ready = false;
+    bool ok = slot.ok;
+    out.swap(slot.messages);
+    ++next_;
+    lock.unlock();
+    work_cv_.notify_all();  // A slot is free again
+    return ok;
+  }
+
+ private:
+  struct Slot {
+    bool ready = false;
+    bool ok = false;
+    std::vector<Msg> messages;
+  };
+
+  void work() {
+    std::ifstream in(filepath_, std::ios::binary | std::ios::in);
+    std::vector<uint8_t> body;
+    std::vector<uint8_t> scratch;
+    std::vector<Msg> decoded;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      work_cv_.wait(lock, [&] {
+        return stopping_ ||
+               (claim_ < offsets_.size() && claim_ < next_ + slots_.size());
+      });
+      if (stopping_) {
+        return;
+      }
+      size_t index = claim_++;
+      lock.unlock();
+
+      bool ok = in.is_open() &&
+                readBlockAt(in, offsets_[index], body, scratch, decoded);
+
+      lock.lock();
+      Slot& slot = slots_[index % slots_.size()];
+      slot.messages.swap(decoded);
+      slot.ok = ok;
+      slot.ready = true;
+      ready_cv_.notify_all();
+    }
+  }
+
+  const std::string filepath_;
+  const std::vector<int64_t> offsets_;
+  const size_t threads_;
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;   // Workers: a block can be claimed
+  std::condition_variable ready_cv_;  // Reader: a slot was filled
+  std::vector<Slot> slots_;
+  size_t next_ = 0;   // Block the reader takes next
+  size_t claim_ = 0;  // Block the next idle worker decodes
+  bool stopping_ = false;
+  bool started_ = false;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace replay
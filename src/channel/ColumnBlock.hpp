@@ -0,0 +1,424 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <span>
+#include <vector>
+
+#include "BlockCodec.hpp"
+#include "common/Crc32c.hpp"
+#include "common/Message.hpp"
+#include "common/MessageFilter.hpp"
+#include "common/PayloadCodec.hpp"
+#include "common/Types.hpp"
+
+namespace replay {
+
+// Messages per full block written by FileWriteChannel (v3)
+constexpr uint32_t DEFAULT_BLOCK_MESSAGES = 4096;
+
+// Block tag ("BLK3")
+constexpr uint32_t BLOCK_MAGIC = 0x424C4B33;
+
+// Block flags (stored in BlockHeader.flags)
+constexpr uint16_t BLOCK_FLAG_SEQ_DENSE = 0x0001;  // seq_nums are consecutive
+constexpr uint16_t BLOCK_FLAG_PAYLOAD_XOR = 0x0002;  // XOR-coded payloads
+constexpr uint16_t BLOCK_FLAG_CRC = 0x0004;  // BlockHeader.crc is set
+constexpr uint16_t BLOCK_FLAG_ZONE_MAP = 0x0008;  // min_* / max_* are set
+
+// Column block of a v3 recording: this header, then the columns.
+//
+//   seq column        empty if BLOCK_FLAG_SEQ_DENSE; otherwise a gap bitmap
+//                     (bit i set when message i is not prev + 1) followed by
+//                     one zigzag varint (seq - (prev + 1)) per set bit
+//   timestamp column  zigzag varint delta to the previous timestamp for
+//                     messages 1..n-1 (message 0 is first_timestamp_ns)
+//   payload column    n raw doubles, or with BLOCK_FLAG_PAYLOAD_XOR their
+//                     XOR encoding (common/PayloadCodec.hpp) when that is
+//                     smaller, i.e. when the payloads move slowly
+//
+// With consecutive seq_nums and sub-millisecond tick spacing a message costs
+// 10-11 bytes instead of 24 with raw payloads, 3-5 with tick-sized payload
+// moves. Blocks are self-contained, so a reader can start
+// at any block and the block headers form an index of the file.
+//
+// With a codec set (BlockCodec.hpp) the body is stored compressed as a whole:
+// body_bytes is then the stored size and raw_body_bytes the size of the
+// columns above once decompressed. A block is only stored compressed when
+// that makes it smaller.
+//
+// With BLOCK_FLAG_CRC, crc is the CRC32C of the header (crc field zero)
+// followed by the stored body, so torn writes and bit flips anywhere in the
+// block are caught before it is decoded. Blocks written before checksums
+// existed have no flag and are taken as is.
+//
+// With BLOCK_FLAG_ZONE_MAP the min_* / max_* fields hold the block's zone map
+// (common/MessageFilter.hpp), so filtered reads can rule a block out from
+// its header alone. Older blocks have no flag and may hold anything.
+struct alignas(8) BlockHeader {
+  uint32_t magic;       // BLOCK_MAGIC
+  uint32_t msg_count;   // Messages in the block (> 0)
+  uint32_t body_bytes;  // Column bytes following the header
+  uint16_t flags;       // BLOCK_FLAG_*
+  uint8_t codec;        // CodecId of the stored body (0: uncompressed)
+  uint8_t reserved0;
+  int64_t first_seq;
+  int64_t last_seq;
+  int64_t first_timestamp_ns;
+  uint32_t seq_bytes;        // Column sizes within the body, in order
+  uint32_t timestamp_bytes;
+  uint32_t payload_bytes;
+  uint32_t raw_body_bytes;  // Decompressed body size (0 if codec is 0)
+  uint32_t crc;             // See BLOCK_FLAG_CRC
+  uint32_t reserved1;
+  int64_t min_seq;  // Zone map (BLOCK_FLAG_ZONE_MAP)
+  int64_t max_seq;
+  int64_t min_timestamp_ns;
+  int64_t max_timestamp_ns;
+  double min_payload;
+  double max_payload;
+  int64_t reserved2[2];  // Zero; room for further per-block metadata
+
+  // Column bytes once decompressed
+  [[nodiscard]] uint32_t columnBytes() const {
+    return codec != 0 ? raw_body_bytes : body_bytes;
+  }
+
+  // Zone map of the block's messages (everything() without one)
+  [[nodiscard]] ZoneMap zoneMap() const {
+    if ((flags & BLOCK_FLAG_ZONE_MAP) == 0) {
+      return ZoneMap::everything();
+    }
+    return {min_seq,          max_seq,     min_timestamp_ns,
+            max_timestamp_ns, min_payload, max_payload};
+  }
+
+  // Structurally plausible (says nothing about the body's contents)
+  [[nodiscard]] bool isValid() const {
+    return magic == BLOCK_MAGIC && msg_count > 0 &&
+           static_cast<uint64_t>(seq_bytes) + timestamp_bytes +
+                   payload_bytes ==
+               columnBytes();
+  }
+};
+
+static_assert(sizeof(BlockHeader) == 128, "BlockHeader must be 128 bytes");
+
+// Zigzag maps small signed values to small unsigned ones
+inline uint64_t zigzagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// LEB128: 7 bits per byte, high bit set on all but the last byte
+inline void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+// Returns the byte after the varint, or nullptr if it runs past end
+inline const uint8_t* getVarint(const uint8_t* p, const uint8_t* end,
+                                uint64_t& value) {
+  if (p < end && *p < 0x80) {
+    value = *p;  // Fast path: deltas below 128 ns
+    return p + 1;
+  }
+  value = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Encode messages (non-empty) into header and body; body is overwritten
+// (any seq_num order is representable, runs of prev + 1 are free)
+inline void encodeBlock(std::span<const Msg> messages, BlockHeader& header,
+                        std::vector<uint8_t>& body) {
+  const size_t n = messages.size();
+  header = BlockHeader{};
+  header.magic = BLOCK_MAGIC;
+  header.msg_count = static_cast<uint32_t>(n);
+  header.first_seq = messages.front().seq_num;
+  header.last_seq = messages.back().seq_num;
+  header.first_timestamp_ns = messages.front().timestamp_ns;
+  ZoneMap zone = ZoneMap::of(messages);
+  header.flags |= BLOCK_FLAG_ZONE_MAP;
+  header.min_seq = zone.min_seq;
+  header.max_seq = zone.max_seq;
+  header.min_timestamp_ns = zone.min_timestamp_ns;
+  header.max_timestamp_ns = zone.max_timestamp_ns;
+  header.min_payload = zone.min_payload;
+  header.max_payload = zone.max_payload;
+  body.clear();
+
+  // Seq column
+  bool dense = true;
+  for (size_t i = 1; i < n && dense; ++i) {
+    dense = messages[i].seq_num == messages[i - 1].seq_num + 1;
+  }
+  if (dense) {
+    header.flags |= BLOCK_FLAG_SEQ_DENSE;
+  } else {
+    size_t bitmap_bytes = (n + 7) / 8;
+    body.resize(bitmap_bytes, 0);
+    for (size_t i = 1; i < n; ++i) {
+      int64_t skip = messages[i].seq_num - (messages[i - 1].seq_num + 1);
+      if (skip != 0) {
+        body[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+        putVarint(body, zigzagEncode(skip));
+      }
+    }
+  }
+  header.seq_bytes = static_cast<uint32_t>(body.size());
+
+  // Timestamp column
+  for (size_t i = 1; i < n; ++i) {
+    putVarint(body, zigzagEncode(messages[i].timestamp_ns -
+                                 messages[i - 1].timestamp_ns));
+  }
+  header.timestamp_bytes =
+      static_cast<uint32_t>(body.size()) - header.seq_bytes;
+
+  // Payload column: XOR-coded unless that does not pay off
+  size_t payload_at = body.size();
+  size_t xor_bytes = xorEncode(
+      n, [&](size_t i) { return messages[i].payload; }, body);
+  if (xor_bytes < n * sizeof(double)) {
+    header.flags |= BLOCK_FLAG_PAYLOAD_XOR;
+  } else {
+    body.resize(payload_at + n * sizeof(double));
+    for (size_t i = 0; i < n; ++i) {
+      std::memcpy(body.data() + payload_at + i * sizeof(double),
+                  &messages[i].payload, sizeof(double));
+    }
+  }
+  header.payload_bytes = static_cast<uint32_t>(body.size() - payload_at);
+  header.body_bytes = static_cast<uint32_t>(body.size());
+}
+
+// Decode a block body into out (resized to header.msg_count). Returns false
+// if the body does not match its header.
+inline bool decodeBlock(const BlockHeader& header, const uint8_t* body,
+                        std::vector<Msg>& out) {
+  const size_t n = header.msg_count;
+  const bool xor_payloads = (header.flags & BLOCK_FLAG_PAYLOAD_XOR) != 0;
+  if (!header.isValid() ||
+      (!xor_payloads && header.payload_bytes != n * sizeof(double))) {
+    return false;
+  }
+  out.resize(n);
+
+  // Timestamps
+  const uint8_t* p = body + header.seq_bytes;
+  const uint8_t* end = p + header.timestamp_bytes;
+  int64_t ts = header.first_timestamp_ns;
+  out[0].timestamp_ns = ts;
+  for (size_t i = 1; i < n; ++i) {
+    uint64_t delta;
+    p = getVarint(p, end, delta);
+    if (p == nullptr) {
+      return false;
+    }
+    ts += zigzagDecode(delta);
+    out[i].timestamp_ns = ts;
+  }
+
+  // Seq numbers
+  SeqNum seq = header.first_seq;
+  if ((header.flags & BLOCK_FLAG_SEQ_DENSE) != 0) {
+    for (size_t i = 0; i < n; ++i) {
+      out[i].seq_num = seq + static_cast<SeqNum>(i);
+    }
+    seq += static_cast<SeqNum>(n - 1);
+  } else {
+    size_t bitmap_bytes = (n + 7) / 8;
+    if (header.seq_bytes < bitmap_bytes) {
+      return false;
+    }
+    const uint8_t* skips = body + bitmap_bytes;
+    const uint8_t* skips_end = body + header.seq_bytes;
+    out[0].seq_num = seq;
+    for (size_t i = 1; i < n; ++i) {
+      ++seq;
+      if ((body[i / 8] >> (i % 8)) & 1u) {
+        uint64_t skip;
+        skips = getVarint(skips, skips_end, skip);
+        if (skips == nullptr) {
+          return false;
+        }
+        seq += zigzagDecode(skip);
+      }
+      out[i].seq_num = seq;
+    }
+  }
+
+  // Payloads
+  const uint8_t* payloads = body + header.seq_bytes + header.timestamp_bytes;
+  if (xor_payloads) {
+    Msg* msgs = out.data();
+    return xorDecode(payloads, header.payload_bytes, n,
+                     [msgs](size_t i, double value) {
+                       msgs[i].payload = value;
+                     }) &&
+           seq == header.last_seq;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    std::memcpy(&out[i].payload, payloads + i * sizeof(double),
+                sizeof(double));
+  }
+  return seq == header.last_seq;
+}
+
+// CRC32C of a block as stored: header with the crc field zeroed, then body
+inline uint32_t blockChecksum(const BlockHeader& header,
+                              const uint8_t* stored) {
+  BlockHeader copy = header;
+  copy.crc = 0;
+  return crc32c(stored, header.body_bytes, crc32c(&copy, sizeof(copy)));
+}
+
+// Set the checksum of a block about to be written (after compressBlock())
+inline void sealChecksum(BlockHeader& header, const uint8_t* stored) {
+  header.flags |= BLOCK_FLAG_CRC;
+  header.crc = blockChecksum(header, stored);
+}
+
+// Whether a stored block matches its checksum (true without one)
+inline bool checksumMatches(const BlockHeader& header, const uint8_t* stored) {
+  return (header.flags & BLOCK_FLAG_CRC) == 0 ||
+         blockChecksum(header, stored) == header.crc;
+}
+
+// Compress an encoded body in place with codec (nullptr: leave it as is).
+// The block keeps its uncompressed body unless compression makes it smaller.
+inline void compressBlock(BlockHeader& header, std::vector<uint8_t>& body,
+                          const BlockCodec* codec,
+                          std::vector<uint8_t>& scratch) {
+  if (codec == nullptr || body.empty()) {
+    return;
+  }
+  scratch.resize(codec->compressBound(body.size()));
+  size_t size = codec->compress(body.data(), body.size(), scratch.data());
+  if (size == 0 || size >= body.size()) {
+    return;
+  }
+  scratch.resize(size);
+  header.codec = static_cast<uint8_t>(codec->id());
+  header.raw_body_bytes = header.body_bytes;
+  header.body_bytes = static_cast<uint32_t>(size);
+  body.swap(scratch);
+}
+
+// Decode a block as stored in the file (body_bytes at stored), checking its
+// checksum and decompressing through scratch first if it has a codec.
+// Returns false on a checksum mismatch, malformed data or a codec this build
+// does not include.
+inline bool decodeStoredBlock(const BlockHeader& header, const uint8_t* stored,
+                              std::vector<uint8_t>& scratch,
+                              std::vector<Msg>& out) {
+  if (!checksumMatches(header, stored)) {
+    return false;
+  }
+  if (header.codec == 0) {
+    return decodeBlock(header, stored, out);
+  }
+  const BlockCodec* codec = findCodec(static_cast<CodecId>(header.codec));
+  if (codec == nullptr || !header.isValid()) {
+    return false;
+  }
+  scratch.resize(header.raw_body_bytes);
+  return codec->decompress(stored, header.body_bytes, scratch.data(),
+                           scratch.size()) &&
+         decodeBlock(header, scratch.data(), out);
+}
+
+// Read and decode the block at offset of a v3 file; body and scratch are
+// working buffers. Returns false (stream state cleared) if the block cannot
+// be read or decoded.
+inline bool readBlockAt(std::istream& in, int64_t offset,
+                        std::vector<uint8_t>& body,
+                        std::vector<uint8_t>& scratch, std::vector<Msg>& out) {
+  BlockHeader header;
+  in.seekg(static_cast<std::streamoff>(offset));
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(BlockHeader)) ||
+      !header.isValid()) {
+    in.clear();
+    return false;
+  }
+  body.resize(header.body_bytes);
+  if (!in.read(reinterpret_cast<char*>(body.data()),
+               static_cast<std::streamsize>(header.body_bytes)) ||
+      !decodeStoredBlock(header, body.data(), scratch, out)) {
+    in.clear();
+    return false;
+  }
+  return true;
+}
+
+// Outcome of checking one stored block against its checksum
+enum class BlockCheck : uint8_t {
+  VALID,      // Checksum matches
+  UNCHECKED,  // Readable, written without a checksum
+  CORRUPT,    // Unreadable, malformed or checksum mismatch
+};
+
+// Read the block at offset of a v3 file and check its checksum without
+// decoding it; body is a working buffer
+inline BlockCheck checkBlockAt(std::istream& in, int64_t offset,
+                               std::vector<uint8_t>& body) {
+  BlockHeader header;
+  in.seekg(static_cast<std::streamoff>(offset));
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(BlockHeader)) ||
+      !header.isValid()) {
+    in.clear();
+    return BlockCheck::CORRUPT;
+  }
+  body.resize(header.body_bytes);
+  if (!in.read(reinterpret_cast<char*>(body.data()),
+               static_cast<std::streamsize>(header.body_bytes))) {
+    in.clear();
+    return BlockCheck::CORRUPT;
+  }
+  if ((header.flags & BLOCK_FLAG_CRC) == 0) {
+    return BlockCheck::UNCHECKED;
+  }
+  return blockChecksum(header, body.data()) == header.crc
+             ? BlockCheck::VALID
+             : BlockCheck::CORRUPT;
+}
+
+// Same check on a v3 file held in memory (size bytes, e.g. a read-only
+// mapping): the checksum runs over the block in place, without a copy
+inline BlockCheck checkBlockIn(const uint8_t* file, size_t size,
+                               int64_t offset) {
+  if (offset < 0 || static_cast<size_t>(offset) > size ||
+      size - static_cast<size_t>(offset) < sizeof(BlockHeader)) {
+    return BlockCheck::CORRUPT;
+  }
+  BlockHeader header;
+  std::memcpy(&header, file + offset, sizeof(BlockHeader));
+  size_t body = static_cast<size_t>(offset) + sizeof(BlockHeader);
+  if (!header.isValid() || size - body < header.body_bytes) {
+    return BlockCheck::CORRUPT;
+  }
+  if ((header.flags & BLOCK_FLAG_CRC) == 0) {
+    return BlockCheck::UNCHECKED;
+  }
+  return blockChecksum(header, file + body) == header.crc
+             ? BlockCheck::VALID
+             : BlockCheck::CORRUPT;
+}
+
+}  // namespace replay
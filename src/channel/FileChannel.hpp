@@ -1,13 +1,52 @@
 #pragma once
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
 
+#include "BlockPrefetcher.hpp"
+#include "ColumnBlock.hpp"
 #include "IChannel.hpp"
+#include "common/MessageFilter.hpp"
 
 namespace replay {
 
+// Outcome of checking the block checksums of a v3 file on open (see
+// FileChannel::setVerifyThreads())
+struct BlockVerifyStats {
+  size_t verified_blocks = 0;    // Checksum matched
+  size_t unchecked_blocks = 0;   // Written without a checksum
+  bool corrupt = false;          // A block failed; the file ends before it
+  int64_t dropped_messages = 0;  // Messages from the failed block on
+  int64_t bytes = 0;             // Block bytes checked
+  double seconds = 0.0;
+};
+
+// Work done by filtered reads (see FileChannel::setFilter()); bytes_read
+// counts every block loaded since open() or setFilter(). Instrument-filtered
+// record files (RecordFileChannel::setInstrumentFilter()) count their index
+// blocks, and the record and index bytes read.
+struct FilterStats {
+  size_t blocks_skipped = 0;   // Ruled out by their zone map, never read
+  size_t blocks_whole = 0;     // Zone map inside the filter: all match
+  size_t blocks_selected = 0;  // Run through the selection kernel
+  int64_t bytes_read = 0;      // Stored block bytes, headers included
+};
+
 // File channel (for replay)
 // Sequentially reads historical messages from disk files
 //
@@ -15,6 +54,29 @@ namespace replay {
 // If the file was not cleanly closed (FILE_FLAG_COMPLETE missing), the reader
 // falls back to the msg_count stored in the header (which is periodically
 // flushed) and logs a warning. This allows partial recovery after a crash.
+//
+// Both body layouts are read transparently: v2 files are read straight into
+// the caller's buffer; for v3 files the block headers are indexed on open
+// and one block at a time is decoded on demand. Positions (seek(),
+// getCurrentSeq()) are message indexes in both.
+//
+// v3 blocks carry a CRC32C, checked whenever a block is loaded. A file that
+// was not cleanly closed is indexed past the header's msg_count up to the
+// last whole block that passes its checksum, so blocks sealed after the last
+// header update are recovered and a torn tail is cut off. With
+// setVerifyThreads(n > 0) every block is checked on open as well (on n
+// threads), and the file ends before the first corrupt block.
+//
+// With setDecodeThreads(n > 0), v3 blocks are read, decompressed and decoded
+// on n threads ahead of the reader (BlockPrefetcher); the caller only copies
+// decoded messages out. Sequential reads benefit; a read elsewhere than the
+// next block restarts the prefetch there.
+//
+// setFilter() restricts reads to the messages matching a MessageFilter. A v3
+// block whose zone map rules the filter out is skipped without being read
+// (nor prefetched), one that lies inside it is returned whole, and the
+// others are decoded and run through the selection kernel. v2 files have no
+// zone maps and are filtered message by message.
 class FileChannel : public IChannel {
  public:
   explicit FileChannel(std::string_view filepath)
@@ -24,7 +86,13 @@ class FileChannel : public IChannel {
         msg_count_(0),
         first_seq_(INVALID_SEQ),
         last_seq_(INVALID_SEQ),
-        was_cleanly_closed_(false) {}
+        was_cleanly_closed_(false),
+        columnar_(false),
+        loaded_block_(NO_BLOCK),
+        data_end_(0),
+        decode_threads_(0),
+        verify_threads_(0),
+        selection_all_(false) {}
 
   ~FileChannel() override { close(); }
 
@@ -42,7 +110,8 @@ class FileChannel : public IChannel {
     FileHeader header;
     file_.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
 
-    if (!file_.good() || !header.isValid()) {
+    if (!file_.good() || !header.isValid() ||
+        !header.holdsRecords(SCHEMA_MSG, sizeof(Msg))) {
       file_.close();
       return false;
     }
@@ -63,6 +132,17 @@ class FileChannel : public IChannel {
       was_cleanly_closed_ = header.isComplete();
     }
 
+    columnar_ = header.isColumnar();
+    verify_stats_ = BlockVerifyStats{};
+    filter_stats_ = FilterStats{};
+    if (columnar_) {
+      indexBlocks(header.isConsistent() ? header.msg_count : 0);
+      if (verify_threads_ > 0) {
+        verifyBlocks(verify_threads_);
+      }
+      resetPrefetch();
+    }
+
     current_seq_ = 0;
     is_open_ = true;
 
@@ -70,11 +150,15 @@ class FileChannel : public IChannel {
   }
 
   void close() override {
+    prefetcher_.reset();
+    prefetch_blocks_.clear();
     if (file_.is_open()) {
       file_.close();
     }
     is_open_ = false;
     current_seq_ = 0;
+    blocks_.clear();
+    loaded_block_ = NO_BLOCK;
   }
 
   bool isOpen() const override { return is_open_; }
@@ -85,21 +169,93 @@ class FileChannel : public IChannel {
     }
 
     Msg msg;
-    file_.read(reinterpret_cast<char*>(&msg), sizeof(Msg));
+    if (columnar_) {
+      if (filter_ ? !advanceToMatch() : !loadBlockAt(current_seq_)) {
+        return std::nullopt;
+      }
+      msg = decoded_[blockOffset(current_seq_)];
+    } else {
+      if (filter_ && !advanceToMatchRaw()) {
+        return std::nullopt;
+      }
+      file_.read(reinterpret_cast<char*>(&msg), sizeof(Msg));
 
-    if (!file_.good()) {
-      return std::nullopt;
+      if (!file_.good()) {
+        return std::nullopt;
+      }
     }
 
     current_seq_++;
     return msg;
   }
 
+  // Read up to out.size() consecutive messages with a single stream read
+  // (v2) or straight out of the decoded blocks (v3); with a filter, up to
+  // out.size() matching messages.
+  // Returns the number of messages read (0 at end of file).
+  size_t readBatch(std::span<Msg> out) {
+    if (!is_open_ || current_seq_ >= msg_count_) {
+      return 0;
+    }
+
+    auto count = static_cast<size_t>(
+        std::min<int64_t>(static_cast<int64_t>(out.size()),
+                          msg_count_ - current_seq_));
+
+    if (columnar_ && filter_) {
+      return readSelected(out.first(count));
+    }
+    if (filter_) {
+      // v2: select within each batch read until something matches
+      size_t kept = 0;
+      while (kept == 0 && current_seq_ < msg_count_) {
+        auto want = static_cast<size_t>(
+            std::min<int64_t>(static_cast<int64_t>(out.size()),
+                              msg_count_ - current_seq_));
+        size_t got = readRecords(out.first(want));
+        if (got == 0) {
+          break;
+        }
+        selection_.resize(got);
+        kept = selectMessages(out.first(got), *filter_, selection_.data());
+        for (size_t k = 0; k < kept; ++k) {
+          out[k] = out[selection_[k]];
+        }
+      }
+      return kept;
+    }
+
+    if (columnar_) {
+      size_t done = 0;
+      while (done < count && loadBlockAt(current_seq_)) {
+        size_t offset = blockOffset(current_seq_);
+        size_t take = std::min(count - done, decoded_.size() - offset);
+        std::copy_n(decoded_.begin() + static_cast<std::ptrdiff_t>(offset),
+                    take, out.begin() + static_cast<std::ptrdiff_t>(done));
+        done += take;
+        current_seq_ += static_cast<SeqNum>(take);
+      }
+      return done;
+    }
+
+    return readRecords(out.first(count));
+  }
+
   std::optional<Msg> peek() override {
     if (!is_open_ || current_seq_ >= msg_count_) {
       return std::nullopt;
     }
 
+    if (columnar_) {
+      if (filter_ ? !advanceToMatch() : !loadBlockAt(current_seq_)) {
+        return std::nullopt;
+      }
+      return decoded_[blockOffset(current_seq_)];
+    }
+    if (filter_ && !advanceToMatchRaw()) {
+      return std::nullopt;
+    }
+
     // Save current position
     auto pos = file_.tellg();
 
@@ -127,6 +283,12 @@ class FileChannel : public IChannel {
       return false;
     }
 
+    if (columnar_) {
+      // The block is decoded by the next read
+      current_seq_ = seq;
+      return true;
+    }
+
     // Calculate file offset (skip file header)
     std::streamoff offset = sizeof(FileHeader) + seq * sizeof(Msg);
     file_.seekg(offset);
@@ -139,6 +301,56 @@ class FileChannel : public IChannel {
     return true;
   }
 
+  // Position of the first message whose seq_num is >= seq, or
+  // getMessageCount() if there is none. A recording's seq_nums increase but
+  // may skip (a lapped recorder jumps ahead), so a position is not
+  // seq - getFirstSeq(): the block seq ranges (v3) or the records (v2) are
+  // binary-searched instead. The read position is left where it was.
+  int64_t positionOfSeq(SeqNum seq) {
+    if (!is_open_) {
+      return 0;
+    }
+
+    if (columnar_) {
+      auto block = std::lower_bound(
+          blocks_.begin(), blocks_.end(), seq,
+          [](const BlockRef& ref, SeqNum s) { return ref.last_seq < s; });
+      if (block == blocks_.end()) {
+        return msg_count_;
+      }
+      std::vector<Msg> msgs;
+      if (!readBlockAt(file_, block->offset, block_body_, block_scratch_,
+                       msgs)) {
+        return block->first_position;
+      }
+      auto msg = std::lower_bound(
+          msgs.begin(), msgs.end(), seq,
+          [](const Msg& m, SeqNum s) { return m.seq_num < s; });
+      return block->first_position + (msg - msgs.begin());
+    }
+
+    int64_t lo = 0;
+    int64_t hi = msg_count_;
+    while (lo < hi) {
+      int64_t mid = lo + (hi - lo) / 2;
+      Msg msg;
+      file_.clear();
+      file_.seekg(static_cast<std::streamoff>(sizeof(FileHeader) +
+                                              mid * sizeof(Msg)));
+      if (!file_.read(reinterpret_cast<char*>(&msg), sizeof(Msg))) {
+        hi = mid;  // Unreadable tail
+      } else if (msg.seq_num < seq) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    file_.clear();
+    file_.seekg(static_cast<std::streamoff>(sizeof(FileHeader) +
+                                            current_seq_ * sizeof(Msg)));
+    return lo;
+  }
+
   // Get total message count
   int64_t getMessageCount() const { return msg_count_; }
 
@@ -157,7 +369,405 @@ class FileChannel : public IChannel {
   // Whether the file was cleanly closed by the writer
   bool wasCleanlyClose() const { return was_cleanly_closed_; }
 
+  // Whether the file uses the v3 block-columnar layout
+  bool isColumnar() const { return columnar_; }
+
+  // Number of v3 blocks indexed on open (0 for v2)
+  size_t getBlockCount() const { return blocks_.size(); }
+
+  // Threads decoding v3 blocks ahead of the reader; 0 (the default) decodes
+  // on the reading thread. Takes effect on the next open().
+  void setDecodeThreads(size_t threads) { decode_threads_ = threads; }
+
+  size_t getDecodeThreads() const { return decode_threads_; }
+
+  // Check the checksum of every v3 block on open, on this many threads
+  // (0, the default, checks blocks as they are loaded). Takes effect on the
+  // next open().
+  void setVerifyThreads(size_t threads) { verify_threads_ = threads; }
+
+  size_t getVerifyThreads() const { return verify_threads_; }
+
+  // Result of the checks on the last open() with setVerifyThreads()
+  const BlockVerifyStats& getVerifyStats() const { return verify_stats_; }
+
+  // Return only messages matching filter from readNext(), readBatch() and
+  // peek(), from the current position on (the non-matching ones are passed
+  // over: getCurrentSeq() still counts every message). Resets the
+  // FilterStats.
+  void setFilter(const MessageFilter& filter) {
+    filter_ = filter;
+    if (loaded_block_ != NO_BLOCK) {
+      selectLoaded();
+    }
+    filter_stats_ = FilterStats{};
+    if (is_open_ && columnar_) {
+      resetPrefetch();
+    }
+  }
+
+  // Return every message again
+  void clearFilter() {
+    filter_.reset();
+    if (is_open_ && columnar_) {
+      resetPrefetch();
+    }
+  }
+
+  const std::optional<MessageFilter>& getFilter() const { return filter_; }
+
+  const FilterStats& getFilterStats() const { return filter_stats_; }
+
  private:
+  static constexpr size_t NO_BLOCK = static_cast<size_t>(-1);
+
+  // Location of one v3 block: file offset of its header, the position of its
+  // first message, its message count, last seq_num and zone map
+  struct BlockRef {
+    int64_t offset;
+    int64_t first_position;
+    uint32_t msg_count;
+    SeqNum last_seq;
+    ZoneMap zone;
+  };
+
+  // v3: walk the block headers. A cleanly closed file is indexed up to the
+  // header's msg_count; otherwise the walk continues past the trusted
+  // messages (those of a consistent header) to the end of the file, taking
+  // blocks that pass their checksum (or, written without one, decode). A
+  // missing, malformed, truncated or corrupt block ends the readable data
+  // (crash tail), and msg_count is set to what the index covers.
+  void indexBlocks(int64_t trusted) {
+    blocks_.clear();
+    loaded_block_ = NO_BLOCK;
+
+    std::error_code ec;
+    auto file_size =
+        static_cast<int64_t>(std::filesystem::file_size(filepath_, ec));
+    const bool to_end = !was_cleanly_closed_;
+    int64_t offset = sizeof(FileHeader);
+    int64_t position = 0;
+    SeqNum first_seq = INVALID_SEQ;
+    while (!ec && (to_end || position < msg_count_) &&
+           offset + static_cast<int64_t>(sizeof(BlockHeader)) <= file_size) {
+      BlockHeader block;
+      file_.seekg(offset);
+      if (!file_.read(reinterpret_cast<char*>(&block), sizeof(BlockHeader)) ||
+          !block.isValid() ||
+          offset + static_cast<int64_t>(sizeof(BlockHeader) +
+                                        block.body_bytes) >
+              file_size) {
+        break;
+      }
+      if (position >= trusted) {
+        BlockCheck check = checkBlockAt(file_, offset, block_body_);
+        if (check == BlockCheck::CORRUPT ||
+            (check == BlockCheck::UNCHECKED &&
+             !decodeStoredBlock(block, block_body_.data(), block_scratch_,
+                                decoded_))) {
+          break;
+        }
+      }
+      if (position == 0) {
+        first_seq = block.first_seq;
+      }
+      blocks_.push_back({offset, position, block.msg_count, block.last_seq,
+                         block.zoneMap()});
+      position += block.msg_count;
+      offset += static_cast<int64_t>(sizeof(BlockHeader) + block.body_bytes);
+    }
+    file_.clear();
+    data_end_ = offset;
+
+    if (to_end) {
+      if (position > trusted) {
+        // Blocks the header never covered: the range comes from them
+        if (first_seq_ == INVALID_SEQ) {
+          first_seq_ = first_seq;
+        }
+        last_seq_ = blocks_.back().last_seq;
+      }
+      msg_count_ = position;
+    } else {
+      msg_count_ = std::min(msg_count_, position);
+    }
+  }
+
+  // Check every indexed block's checksum on up to threads threads
+  // (contiguous ranges), and end the file before the first corrupt block.
+  // The blocks are checked in place in a read-only mapping of the file;
+  // should mapping fail, each thread reads its range through its own stream.
+  void verifyBlocks(size_t threads) {
+    auto start = std::chrono::steady_clock::now();
+    const size_t count = blocks_.size();
+    std::vector<BlockCheck> results(count, BlockCheck::CORRUPT);
+    threads = std::clamp<size_t>(threads, 1, std::max<size_t>(count, 1));
+    const size_t per_thread = (count + threads - 1) / threads;
+
+    size_t map_size = 0;
+    void* map = MAP_FAILED;
+    int fd = ::open(filepath_.c_str(), O_RDONLY);
+    struct stat st {};
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+      map_size = static_cast<size_t>(st.st_size);
+      map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED) {
+        madvise(map, map_size, MADV_SEQUENTIAL);
+      }
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    const auto* mapped =
+        map != MAP_FAILED ? static_cast<const uint8_t*>(map) : nullptr;
+
+    auto check = [this, &results, count, per_thread, mapped,
+                  map_size](size_t t) {
+      size_t end = std::min(count, (t + 1) * per_thread);
+      if (mapped != nullptr) {
+        for (size_t i = t * per_thread; i < end; ++i) {
+          results[i] = checkBlockIn(mapped, map_size, blocks_[i].offset);
+        }
+        return;
+      }
+      std::ifstream in(filepath_, std::ios::binary | std::ios::in);
+      std::vector<uint8_t> body;
+      for (size_t i = t * per_thread; i < end && in.is_open(); ++i) {
+        results[i] = checkBlockAt(in, blocks_[i].offset, body);
+      }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) {
+      workers.emplace_back(check, t);
+    }
+    check(0);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+    if (map != MAP_FAILED) {
+      munmap(map, map_size);
+    }
+
+    BlockVerifyStats stats;
+    int64_t end = data_end_;
+    for (size_t i = 0; i < count; ++i) {
+      if (results[i] == BlockCheck::CORRUPT) {
+        stats.corrupt = true;
+        stats.dropped_messages = msg_count_ - blocks_[i].first_position;
+        end = blocks_[i].offset;
+        msg_count_ = blocks_[i].first_position;
+        blocks_.resize(i);
+        last_seq_ = blocks_.empty() ? INVALID_SEQ : blocks_.back().last_seq;
+        first_seq_ = blocks_.empty() ? INVALID_SEQ : first_seq_;
+        data_end_ = end;
+        break;
+      }
+      ++(results[i] == BlockCheck::VALID ? stats.verified_blocks
+                                         : stats.unchecked_blocks);
+    }
+    stats.bytes = end - static_cast<int64_t>(sizeof(FileHeader));
+    stats.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    verify_stats_ = stats;
+  }
+
+  // Index of the block holding position (NO_BLOCK if none does)
+  size_t blockIndexOf(int64_t position) const {
+    auto it = std::upper_bound(
+        blocks_.begin(), blocks_.end(), position,
+        [](int64_t pos, const BlockRef& ref) {
+          return pos < ref.first_position;
+        });
+    if (it == blocks_.begin()) {
+      return NO_BLOCK;
+    }
+    return static_cast<size_t>(it - blocks_.begin()) - 1;
+  }
+
+  // Stored size of a block, header included
+  int64_t blockBytes(size_t index) const {
+    int64_t end = index + 1 < blocks_.size() ? blocks_[index + 1].offset
+                                             : data_end_;
+    return end - blocks_[index].offset;
+  }
+
+  // Hand the blocks a read may need (all, or those the filter does not rule
+  // out) to a new prefetcher, if decoding ahead
+  void resetPrefetch() {
+    prefetcher_.reset();
+    prefetch_blocks_.clear();
+    if (decode_threads_ == 0) {
+      return;
+    }
+    std::vector<int64_t> offsets;
+    for (size_t i = 0; i < blocks_.size(); ++i) {
+      if (!filter_ || filter_->mayMatch(blocks_[i].zone)) {
+        prefetch_blocks_.push_back(i);
+        offsets.push_back(blocks_[i].offset);
+      }
+    }
+    if (offsets.size() > 1) {
+      prefetcher_ = std::make_unique<BlockPrefetcher>(
+          filepath_, std::move(offsets), decode_threads_);
+    }
+  }
+
+  // Decode the block holding position into decoded_ (if not already there)
+  bool loadBlockAt(int64_t position) {
+    if (loaded_block_ != NO_BLOCK) {
+      const BlockRef& ref = blocks_[loaded_block_];
+      if (position >= ref.first_position &&
+          position < ref.first_position + ref.msg_count) {
+        return true;
+      }
+    }
+
+    size_t index = blockIndexOf(position);
+    if (index == NO_BLOCK) {
+      return false;
+    }
+
+    bool ok;
+    auto slot = std::lower_bound(prefetch_blocks_.begin(),
+                                 prefetch_blocks_.end(), index);
+    if (prefetcher_ && slot != prefetch_blocks_.end() && *slot == index) {
+      auto next = static_cast<size_t>(slot - prefetch_blocks_.begin());
+      if (!prefetcher_->isStarted() || prefetcher_->nextIndex() != next) {
+        prefetcher_->start(next);
+      }
+      ok = prefetcher_->take(decoded_);
+    } else {
+      ok = readBlockAt(file_, blocks_[index].offset, block_body_,
+                       block_scratch_, decoded_);
+    }
+    if (!ok) {
+      loaded_block_ = NO_BLOCK;
+      return false;
+    }
+    loaded_block_ = index;
+    filter_stats_.bytes_read += blockBytes(index);
+    if (filter_) {
+      selectLoaded();
+    }
+    return true;
+  }
+
+  // Select the messages of the loaded block that match the filter
+  void selectLoaded() {
+    selection_all_ = filter_->contains(blocks_[loaded_block_].zone);
+    if (selection_all_) {
+      selection_.clear();
+      ++filter_stats_.blocks_whole;
+      return;
+    }
+    selection_.resize(decoded_.size());
+    selection_.resize(selectMessages(decoded_, *filter_, selection_.data()));
+    ++filter_stats_.blocks_selected;
+  }
+
+  // Filtered v3 reads: move to the next matching message, skipping the
+  // blocks ruled out by their zone map, and load its block. Returns false if
+  // there is none (or its block cannot be read).
+  bool advanceToMatch() {
+    while (current_seq_ < msg_count_) {
+      size_t index = blockIndexOf(current_seq_);
+      if (index == NO_BLOCK) {
+        return false;
+      }
+      const BlockRef& ref = blocks_[index];
+      int64_t block_end = ref.first_position + ref.msg_count;
+      if (!filter_->mayMatch(ref.zone)) {
+        ++filter_stats_.blocks_skipped;
+        current_seq_ = block_end;
+        continue;
+      }
+      if (!loadBlockAt(current_seq_)) {
+        return false;
+      }
+      if (selection_all_) {
+        return true;
+      }
+      auto it = std::lower_bound(
+          selection_.begin(), selection_.end(),
+          static_cast<uint32_t>(blockOffset(current_seq_)));
+      if (it != selection_.end()) {
+        current_seq_ = ref.first_position + *it;
+        return true;
+      }
+      current_seq_ = block_end;
+    }
+    return false;
+  }
+
+  // Filtered v3 batch read: matching messages into out, block by block
+  size_t readSelected(std::span<Msg> out) {
+    size_t done = 0;
+    while (done < out.size() && advanceToMatch()) {
+      size_t offset = blockOffset(current_seq_);
+      size_t take;
+      if (selection_all_) {
+        take = std::min(out.size() - done, decoded_.size() - offset);
+        std::copy_n(decoded_.begin() + static_cast<std::ptrdiff_t>(offset),
+                    take, out.begin() + static_cast<std::ptrdiff_t>(done));
+        current_seq_ += static_cast<SeqNum>(take);
+      } else {
+        // advanceToMatch() stopped on a selected offset
+        auto it = std::lower_bound(selection_.begin(), selection_.end(),
+                                   static_cast<uint32_t>(offset));
+        take = std::min(out.size() - done,
+                        static_cast<size_t>(selection_.end() - it));
+        for (size_t k = 0; k < take; ++k) {
+          out[done + k] = decoded_[it[k]];
+        }
+        current_seq_ = blocks_[loaded_block_].first_position + it[take - 1] + 1;
+      }
+      done += take;
+    }
+    return done;
+  }
+
+  // v2: read consecutive records into out with a single stream read
+  size_t readRecords(std::span<Msg> out) {
+    file_.read(reinterpret_cast<char*>(out.data()),
+               static_cast<std::streamsize>(out.size() * sizeof(Msg)));
+
+    // A short read means the file is shorter than the header claims
+    auto count = static_cast<size_t>(file_.gcount()) / sizeof(Msg);
+    if (!file_.good()) {
+      file_.clear();
+    }
+
+    current_seq_ += static_cast<SeqNum>(count);
+    return count;
+  }
+
+  // Filtered v2 reads: move the position and stream to the next matching
+  // record. Returns false if there is none.
+  bool advanceToMatchRaw() {
+    Msg msg;
+    while (current_seq_ < msg_count_) {
+      auto pos = file_.tellg();
+      if (!file_.read(reinterpret_cast<char*>(&msg), sizeof(Msg))) {
+        file_.clear();
+        return false;
+      }
+      if (filter_->matches(msg)) {
+        file_.seekg(pos);
+        return true;
+      }
+      ++current_seq_;
+    }
+    return false;
+  }
+
+  // Index of position within the loaded block
+  size_t blockOffset(int64_t position) const {
+    return static_cast<size_t>(position -
+                               blocks_[loaded_block_].first_position);
+  }
+
   std::string filepath_;
   std::ifstream file_;
   bool is_open_;
@@ -166,6 +776,26 @@ class FileChannel : public IChannel {
   SeqNum first_seq_;
   SeqNum last_seq_;
   bool was_cleanly_closed_;
+
+  // v3 state
+  bool columnar_;
+  std::vector<BlockRef> blocks_;
+  size_t loaded_block_;
+  std::vector<uint8_t> block_body_;
+  std::vector<uint8_t> block_scratch_;  // Decompressed body
+  std::vector<Msg> decoded_;
+  int64_t data_end_;  // Offset past the last indexed block
+  size_t decode_threads_;
+  std::unique_ptr<BlockPrefetcher> prefetcher_;
+  std::vector<size_t> prefetch_blocks_;  // Block index of each prefetched one
+  size_t verify_threads_;
+  BlockVerifyStats verify_stats_;
+
+  // Filtered reads
+  std::optional<MessageFilter> filter_;
+  FilterStats filter_stats_;
+  std::vector<uint32_t> selection_;  // Matching offsets (in the loaded block)
+  bool selection_all_;               // ... or all of them
 };
 
 // File write channel — maintains first_seq / last_seq / flags for integrity.
@@ -173,22 +803,79 @@ class FileChannel : public IChannel {
 // Invariants maintained:
 //   - first_seq is set on the first write and never changes
 //   - last_seq is updated on every write
-//   - msg_count == (last_seq - first_seq + 1)
+//   - msg_count <= (last_seq - first_seq + 1), equal unless the writer
+//     skipped seq_nums (a lapped recorder jumps ahead)
 //   - FILE_FLAG_COMPLETE is set only in close()
 //   - Header is flushed periodically (on flush()) so crash recovery can read
 //     partial data up to the last flushed msg_count
+//
+// In the v3 layout (FileFormat::COLUMNAR) messages are buffered until a
+// block of getBlockMessages() is full; the block is then encoded, compressed
+// with the codec set by setCodec() (if any), appended and the header updated
+// to cover it. flush() seals a partial block, so it
+// stays a durability point, but every call costs a short block: writers that
+// flush after each batch use periodicFlush() instead. The header only ever
+// counts sealed blocks.
+//
+// openAppend() continues an existing file after a crash instead of
+// truncating it: the tail is validated and trimmed to the last consistent
+// message (v2) or block (v3), and the invariants above keep holding for the
+// appended data.
 class FileWriteChannel : public IWritableChannel {
  public:
-  explicit FileWriteChannel(std::string_view filepath)
+  explicit FileWriteChannel(std::string_view filepath,
+                            FileFormat format = FileFormat::RAW)
       : filepath_(filepath),
+        format_(format),
         is_open_(false),
         msg_count_(0),
         first_seq_(INVALID_SEQ),
         last_seq_(INVALID_SEQ),
-        header_() {}
+        trimmed_count_(0),
+        header_(),
+        block_messages_(DEFAULT_BLOCK_MESSAGES),
+        data_end_(sizeof(FileHeader)),
+        sealed_count_(0),
+        sealed_last_seq_(INVALID_SEQ),
+        codec_(nullptr) {}
 
   ~FileWriteChannel() override { close(); }
 
+  // Body layout of files created by open() (call before opening).
+  // openAppend() keeps the layout of the file it continues.
+  void setFormat(FileFormat format) {
+    if (!is_open_) {
+      format_ = format;
+    }
+  }
+
+  FileFormat getFormat() const { return format_; }
+
+  // Messages per full v3 block (call before open())
+  void setBlockMessages(uint32_t block_messages) {
+    if (!is_open_ && block_messages > 0) {
+      block_messages_ = block_messages;
+    }
+  }
+
+  uint32_t getBlockMessages() const { return block_messages_; }
+
+  // Compress v3 blocks sealed from now on with codec (CodecId::NONE stores
+  // them uncompressed, the default). Returns false, leaving the codec
+  // unchanged, if this build does not include it.
+  bool setCodec(CodecId codec) {
+    const BlockCodec* found = findCodec(codec);
+    if (codec != CodecId::NONE && found == nullptr) {
+      return false;
+    }
+    codec_ = found;
+    return true;
+  }
+
+  CodecId getCodec() const {
+    return codec_ != nullptr ? codec_->id() : CodecId::NONE;
+  }
+
   bool open() override {
     if (is_open_) {
       return true;
@@ -201,6 +888,13 @@ class FileWriteChannel : public IWritableChannel {
 
     // Write file header (placeholder, will be updated on flush/close)
     header_ = FileHeader();
+    header_.schema_id = SCHEMA_MSG;
+    header_.record_size = sizeof(Msg);
+    if (format_ == FileFormat::COLUMNAR) {
+      header_.version = FILE_VERSION_COLUMNAR;
+      header_.block_messages = block_messages_;
+      header_.data_end = sizeof(FileHeader);
+    }
     file_.write(reinterpret_cast<const char*>(&header_), sizeof(FileHeader));
 
     if (!file_.good()) {
@@ -211,12 +905,85 @@ class FileWriteChannel : public IWritableChannel {
     msg_count_ = 0;
     first_seq_ = INVALID_SEQ;
     last_seq_ = INVALID_SEQ;
+    trimmed_count_ = 0;
+    resetBlocks(sizeof(FileHeader), 0, INVALID_SEQ);
     is_open_ = true;
     return true;
   }
 
+  // Reopen an existing recording to continue it (crash restart).
+  //
+  // The messages covered by the last flushed header are trusted; only the
+  // tail written after that flush is scanned. The file is trimmed after the
+  // last consistent message (whole record, valid seq_num, consecutive with
+  // its predecessor) — in v3 after the last whole block continuing the
+  // sequence — FILE_FLAG_COMPLETE is cleared and writes continue at
+  // getLastSeq() + 1 in the file's own layout. A missing file is created
+  // as by open(). Returns false, leaving the file untouched, for one that is
+  // unreadable, lacks a valid header or holds another record type, and on
+  // I/O errors.
+  bool openAppend() {
+    if (is_open_) {
+      return true;
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::exists(filepath_, ec)) {
+      return !ec && open();
+    }
+    auto file_size = std::filesystem::file_size(filepath_, ec);
+    std::ifstream in(filepath_, std::ios::binary | std::ios::in);
+    FileHeader header;
+    if (ec || !in.is_open() || file_size < sizeof(FileHeader) ||
+        !in.read(reinterpret_cast<char*>(&header), sizeof(FileHeader)) ||
+        !header.isValid()) {
+      return false;  // Damaged header: keep the file for inspection
+    }
+    if (!header.holdsRecords(SCHEMA_MSG, sizeof(Msg))) {
+      return false;  // Another record type's recording: leave it alone
+    }
+
+    Extent kept = header.isColumnar() ? scanBlocks(in, header, file_size)
+                                      : scanRecords(in, header, file_size);
+    in.close();
+
+    // Drop everything after the last consistent message
+    if (kept.size != file_size) {
+      std::filesystem::resize_file(filepath_, kept.size, ec);
+      if (ec) {
+        return false;
+      }
+    }
+
+    file_.open(filepath_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file_.is_open()) {
+      return false;
+    }
+    file_.seekp(0, std::ios::end);
+
+    header_ = header;
+    header_.flags &= static_cast<uint16_t>(~FILE_FLAG_COMPLETE);
+    header_.schema_id = SCHEMA_MSG;
+    header_.record_size = sizeof(Msg);
+    format_ = header.isColumnar() ? FileFormat::COLUMNAR : FileFormat::RAW;
+    if (format_ == FileFormat::COLUMNAR && header.block_messages > 0) {
+      block_messages_ = header.block_messages;
+    }
+    msg_count_ = kept.count;
+    first_seq_ = kept.first_seq;
+    last_seq_ = kept.last_seq;
+    trimmed_count_ = kept.trimmed;
+    resetBlocks(static_cast<int64_t>(kept.size), kept.count, kept.last_seq);
+    is_open_ = true;
+
+    // Persist the trimmed state before any new data goes in
+    updateHeader();
+    return file_.good();
+  }
+
   void close() override {
     if (is_open_) {
+      sealBlock();
       // Mark file as cleanly closed and update header
       header_.flags |= FILE_FLAG_COMPLETE;
       updateHeader();
@@ -252,18 +1019,19 @@ class FileWriteChannel : public IWritableChannel {
       return false;
     }
 
+    if (format_ == FileFormat::COLUMNAR) {
+      pending_.push_back(msg);
+      trackWrite(msg);
+      return pending_.size() < block_messages_ || sealBlock();
+    }
+
     file_.write(reinterpret_cast<const char*>(&msg), sizeof(Msg));
 
     if (!file_.good()) {
       return false;
     }
 
-    // Track sequence range
-    if (first_seq_ == INVALID_SEQ) {
-      first_seq_ = msg.seq_num;
-    }
-    last_seq_ = msg.seq_num;
-    msg_count_++;
+    trackWrite(msg);
     return true;
   }
 
@@ -271,26 +1039,231 @@ class FileWriteChannel : public IWritableChannel {
     if (is_open_) {
       // Update header so other processes / crash recovery can read latest data.
       // Note: FILE_FLAG_COMPLETE is NOT set here — only on clean close().
-      updateHeader();
+      if (!pending_.empty()) {
+        sealBlock();  // Updates the header
+      } else {
+        updateHeader();
+      }
+    }
+  }
+
+  // Flush for writers that call it after every batch: the same as flush() in
+  // v2; a no-op in v3, where full blocks are persisted as they are sealed
+  // and sealing early would only produce short blocks.
+  void periodicFlush() {
+    if (format_ == FileFormat::RAW) {
+      flush();
     }
   }
 
   // Get count of written messages
   int64_t getMessageCount() const { return msg_count_; }
 
+  // Messages handed to the file so far: every written one in v2, only those
+  // of sealed blocks in v3 (the rest wait in the open block until it fills,
+  // or until flush() or close())
+  int64_t getPersistedCount() const {
+    return format_ == FileFormat::COLUMNAR ? sealed_count_ : msg_count_;
+  }
+
   // Get file path
   const std::string& getFilePath() const { return filepath_; }
 
+  // Sequence range written so far (INVALID_SEQ while empty); after
+  // openAppend() this includes the messages kept from the existing file
+  SeqNum getFirstSeq() const { return first_seq_; }
+  SeqNum getLastSeq() const { return last_seq_; }
+
+  // Whole messages dropped from the tail by openAppend() (in v3, those of
+  // the blocks that could still be read)
+  int64_t getTrimmedCount() const { return trimmed_count_; }
+
  private:
+  // Messages read per step while validating the tail in openAppend()
+  static constexpr size_t APPEND_SCAN_CHUNK = 4096;
+
+  // What openAppend() keeps of an existing file
+  struct Extent {
+    size_t size;  // Bytes, header included
+    int64_t count;
+    SeqNum first_seq;
+    SeqNum last_seq;
+    int64_t trimmed;
+  };
+
+  // v2 tail validation: consecutive, valid records
+  static Extent scanRecords(std::ifstream& in, const FileHeader& header,
+                            size_t file_size) {
+    auto present =
+        static_cast<int64_t>((file_size - sizeof(FileHeader)) / sizeof(Msg));
+    int64_t count = 0;
+    SeqNum first_seq = INVALID_SEQ;
+    SeqNum last_seq = INVALID_SEQ;
+
+    // Trusted prefix: the flushed header, if its last message checks out
+    if (header.isConsistent() && header.msg_count > 0 &&
+        header.msg_count <= present) {
+      Msg last;
+      in.seekg(static_cast<std::streamoff>(
+          sizeof(FileHeader) + (header.msg_count - 1) * sizeof(Msg)));
+      if (in.read(reinterpret_cast<char*>(&last), sizeof(Msg)) &&
+          last.seq_num == header.last_seq) {
+        count = header.msg_count;
+        first_seq = header.first_seq;
+        last_seq = header.last_seq;
+      }
+    }
+
+    // Validate the unflushed tail (the whole file if the header is stale)
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(sizeof(FileHeader) +
+                                         count * sizeof(Msg)));
+    std::vector<Msg> chunk(APPEND_SCAN_CHUNK);
+    bool consistent = true;
+    while (consistent && count < present) {
+      auto want = static_cast<size_t>(std::min<int64_t>(
+          static_cast<int64_t>(chunk.size()), present - count));
+      if (!in.read(reinterpret_cast<char*>(chunk.data()),
+                   static_cast<std::streamsize>(want * sizeof(Msg)))) {
+        break;
+      }
+      for (size_t i = 0; i < want; ++i) {
+        const Msg& msg = chunk[i];
+        if (!msg.isValid() || msg.seq_num < 0 ||
+            (last_seq != INVALID_SEQ && msg.seq_num != last_seq + 1)) {
+          consistent = false;
+          break;
+        }
+        if (first_seq == INVALID_SEQ) {
+          first_seq = msg.seq_num;
+        }
+        last_seq = msg.seq_num;
+        ++count;
+      }
+    }
+
+    return {sizeof(FileHeader) + static_cast<size_t>(count) * sizeof(Msg),
+            count, first_seq, last_seq, present - count};
+  }
+
+  // v3 tail validation: whole blocks with consecutive seq_nums that pass
+  // their checksum (decode, for blocks written without one), continuing
+  // from the flushed header's data_end when that checks out
+  static Extent scanBlocks(std::ifstream& in, const FileHeader& header,
+                           size_t file_size) {
+    Extent kept{sizeof(FileHeader), 0, INVALID_SEQ, INVALID_SEQ, 0};
+    if (header.isConsistent() && header.msg_count > 0 &&
+        header.data_end > static_cast<int64_t>(sizeof(FileHeader)) &&
+        header.data_end <= static_cast<int64_t>(file_size)) {
+      kept = {static_cast<size_t>(header.data_end), header.msg_count,
+              header.first_seq, header.last_seq, 0};
+    }
+
+    BlockHeader block;
+    std::vector<uint8_t> body;
+    std::vector<uint8_t> scratch;
+    std::vector<Msg> decoded;
+    size_t offset = kept.size;
+    bool consistent = true;
+    while (offset + sizeof(BlockHeader) <= file_size) {
+      in.seekg(static_cast<std::streamoff>(offset));
+      if (!in.read(reinterpret_cast<char*>(&block), sizeof(BlockHeader)) ||
+          !block.isValid()) {
+        break;
+      }
+      size_t end = offset + sizeof(BlockHeader) + block.body_bytes;
+      body.resize(block.body_bytes);
+      if (end > file_size ||
+          !in.read(reinterpret_cast<char*>(body.data()),
+                   static_cast<std::streamsize>(block.body_bytes))) {
+        break;
+      }
+      if (consistent) {
+        consistent = (block.flags & BLOCK_FLAG_SEQ_DENSE) != 0 &&
+                     block.first_seq >= 0 &&
+                     (kept.last_seq == INVALID_SEQ ||
+                      block.first_seq == kept.last_seq + 1) &&
+                     ((block.flags & BLOCK_FLAG_CRC) != 0
+                          ? checksumMatches(block, body.data())
+                          : decodeStoredBlock(block, body.data(), scratch,
+                                              decoded));
+      }
+      if (!consistent) {
+        kept.trimmed += block.msg_count;  // Readable, but cut off
+      } else {
+        if (kept.first_seq == INVALID_SEQ) {
+          kept.first_seq = block.first_seq;
+        }
+        kept.last_seq = block.last_seq;
+        kept.count += block.msg_count;
+        kept.size = end;
+      }
+      offset = end;
+    }
+    return kept;
+  }
+
+  // Track sequence range
+  void trackWrite(const Msg& msg) {
+    if (first_seq_ == INVALID_SEQ) {
+      first_seq_ = msg.seq_num;
+    }
+    last_seq_ = msg.seq_num;
+    msg_count_++;
+  }
+
+  // Set the v3 block state to cover the file up to data_end
+  void resetBlocks(int64_t data_end, int64_t sealed_count,
+                   SeqNum sealed_last_seq) {
+    pending_.clear();
+    data_end_ = data_end;
+    sealed_count_ = sealed_count;
+    sealed_last_seq_ = sealed_last_seq;
+  }
+
+  // v3: encode the pending messages as one block, append it and update the
+  // header to cover it. No-op without pending messages.
+  bool sealBlock() {
+    if (pending_.empty()) {
+      return true;
+    }
+
+    BlockHeader block;
+    encodeBlock(pending_, block, block_body_);
+    compressBlock(block, block_body_, codec_, compress_scratch_);
+    sealChecksum(block, block_body_.data());
+    file_.write(reinterpret_cast<const char*>(&block), sizeof(BlockHeader));
+    file_.write(reinterpret_cast<const char*>(block_body_.data()),
+                static_cast<std::streamsize>(block_body_.size()));
+    if (!file_.good()) {
+      return false;
+    }
+
+    data_end_ += static_cast<int64_t>(sizeof(BlockHeader) + block.body_bytes);
+    sealed_count_ += static_cast<int64_t>(pending_.size());
+    sealed_last_seq_ = pending_.back().seq_num;
+    pending_.clear();
+    updateHeader();
+    return true;
+  }
+
   void updateHeader() {
     // Save current write position
     auto current_pos = file_.tellp();
 
     // Go back to file beginning to update header atomically
     file_.seekp(0);
-    header_.msg_count = msg_count_;
-    header_.first_seq = first_seq_;
-    header_.last_seq = last_seq_;
+    if (format_ == FileFormat::COLUMNAR) {
+      // Only sealed blocks are on disk
+      header_.msg_count = sealed_count_;
+      header_.first_seq = sealed_count_ > 0 ? first_seq_ : INVALID_SEQ;
+      header_.last_seq = sealed_last_seq_;
+      header_.data_end = data_end_;
+    } else {
+      header_.msg_count = msg_count_;
+      header_.first_seq = first_seq_;
+      header_.last_seq = last_seq_;
+    }
     file_.write(reinterpret_cast<const char*>(&header_), sizeof(FileHeader));
 
     // Restore write position to end of file
@@ -299,12 +1272,24 @@ class FileWriteChannel : public IWritableChannel {
   }
 
   std::string filepath_;
-  std::ofstream file_;
+  FileFormat format_;
+  std::fstream file_;
   bool is_open_;
   int64_t msg_count_;
   SeqNum first_seq_;
   SeqNum last_seq_;
+  int64_t trimmed_count_;
   FileHeader header_;
+
+  // v3 state
+  uint32_t block_messages_;
+  int64_t data_end_;        // Offset past the last sealed block
+  int64_t sealed_count_;    // Messages in sealed blocks
+  SeqNum sealed_last_seq_;  // Last seq_num in a sealed block
+  std::vector<Msg> pending_;
+  std::vector<uint8_t> block_body_;
+  std::vector<uint8_t> compress_scratch_;
+  const BlockCodec* codec_;  // nullptr: blocks stored uncompressed
 };
 
 }  // namespace replay
@@ -0,0 +1,466 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "common/Frame.hpp"
+#include "common/Message.hpp"
+#include "common/Types.hpp"
+
+namespace replay {
+
+// Writes a v4 recording: a FileHeader (FILE_VERSION_FRAMES, SCHEMA_FRAMES)
+// followed by variable-length frames back to back, encoded as in
+// VarRingBuffer (see common/Frame.hpp) without the ring's padding frames.
+// The header's msg_count counts frames and data_end is the offset past the
+// last one; both are updated on flush() and close().
+class FrameFileWriteChannel {
+ public:
+  explicit FrameFileWriteChannel(std::string_view filepath)
+      : filepath_(filepath),
+        is_open_(false),
+        frame_count_(0),
+        first_seq_(INVALID_SEQ),
+        last_seq_(INVALID_SEQ),
+        data_end_(sizeof(FileHeader)),
+        header_() {}
+
+  ~FrameFileWriteChannel() { close(); }
+
+  // Disable copy and move
+  FrameFileWriteChannel(const FrameFileWriteChannel&) = delete;
+  FrameFileWriteChannel& operator=(const FrameFileWriteChannel&) = delete;
+
+  bool open() {
+    if (is_open_) {
+      return true;
+    }
+
+    file_.open(filepath_, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file_.is_open()) {
+      return false;
+    }
+
+    // Placeholder, updated on flush/close
+    header_ = FileHeader();
+    header_.version = FILE_VERSION_FRAMES;
+    header_.schema_id = SCHEMA_FRAMES;
+    header_.data_end = sizeof(FileHeader);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(FileHeader));
+    if (!file_.good()) {
+      file_.close();
+      return false;
+    }
+
+    frame_count_ = 0;
+    first_seq_ = INVALID_SEQ;
+    last_seq_ = INVALID_SEQ;
+    data_end_ = sizeof(FileHeader);
+    is_open_ = true;
+    return true;
+  }
+
+  void close() {
+    if (is_open_) {
+      header_.flags |= FILE_FLAG_COMPLETE;
+      updateHeader();
+      file_.close();
+    }
+    is_open_ = false;
+  }
+
+  bool isOpen() const { return is_open_; }
+
+  // Append a frame with this sequence number
+  bool write(SeqNum seq, const FrameRef& frame) {
+    if (!is_open_) {
+      return false;
+    }
+    const size_t length = frame.payload.size();
+    FrameHeader header{seq, frame.timestamp_ns, static_cast<uint32_t>(length),
+                       frame.type, 0};
+    static constexpr char ZEROS[FRAME_ALIGNMENT] = {};
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(FrameHeader));
+    file_.write(reinterpret_cast<const char*>(frame.payload.data()),
+                static_cast<std::streamsize>(length));
+    file_.write(ZEROS, static_cast<std::streamsize>(
+                           frameBytes(length) - sizeof(FrameHeader) - length));
+    if (!file_.good()) {
+      return false;
+    }
+    track(header);
+    return true;
+  }
+
+  // Append a frame read elsewhere, keeping its header
+  bool write(const FrameView& frame) {
+    return write(frame.header.seq_num,
+                 FrameRef{frame.header.type, frame.header.timestamp_ns,
+                          frame.payload});
+  }
+
+  // Append encoded frames as VarRingBuffer::readBatch() returns them, with a
+  // single stream write. Fails, writing nothing, if they do not end on a
+  // frame boundary.
+  bool writeFrames(std::span<const std::byte> frames) {
+    if (!is_open_) {
+      return false;
+    }
+
+    size_t offset = 0;
+    while (offset < frames.size()) {
+      if (frames.size() - offset < sizeof(FrameHeader)) {
+        return false;
+      }
+      FrameHeader header;
+      std::memcpy(&header, &frames[offset], sizeof(FrameHeader));
+      offset += frameBytes(header.length);
+      if (offset > frames.size()) {
+        return false;
+      }
+    }
+
+    file_.write(reinterpret_cast<const char*>(frames.data()),
+                static_cast<std::streamsize>(frames.size()));
+    if (!file_.good()) {
+      return false;
+    }
+    for (offset = 0; offset < frames.size();) {
+      FrameHeader header;
+      std::memcpy(&header, &frames[offset], sizeof(FrameHeader));
+      track(header);
+      offset += frameBytes(header.length);
+    }
+    return true;
+  }
+
+  // Update the header so readers and crash recovery see the frames written
+  // so far (FILE_FLAG_COMPLETE is only set by close())
+  void flush() {
+    if (is_open_) {
+      updateHeader();
+    }
+  }
+
+  // Same as flush(), as for v2 FileWriteChannel
+  void periodicFlush() { flush(); }
+
+  int64_t getFrameCount() const { return frame_count_; }
+
+  // Bytes written, header included
+  int64_t getBytesWritten() const { return data_end_; }
+
+  const std::string& getFilePath() const { return filepath_; }
+
+  SeqNum getFirstSeq() const { return first_seq_; }
+  SeqNum getLastSeq() const { return last_seq_; }
+
+ private:
+  void track(const FrameHeader& header) {
+    if (first_seq_ == INVALID_SEQ) {
+      first_seq_ = header.seq_num;
+    }
+    last_seq_ = header.seq_num;
+    ++frame_count_;
+    data_end_ += static_cast<int64_t>(frameBytes(header.length));
+  }
+
+  void updateHeader() {
+    auto current_pos = file_.tellp();
+    file_.seekp(0);
+    header_.msg_count = frame_count_;
+    header_.first_seq = first_seq_;
+    header_.last_seq = last_seq_;
+    header_.data_end = data_end_;
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(FileHeader));
+    file_.seekp(current_pos);
+    file_.flush();
+  }
+
+  std::string filepath_;
+  std::ofstream file_;
+  bool is_open_;
+  int64_t frame_count_;
+  SeqNum first_seq_;
+  SeqNum last_seq_;
+  int64_t data_end_;
+  FileHeader header_;
+};
+
+// Reads a v4 recording (see FrameFileWriteChannel)
+//
+// Frames are parsed out of a read buffer of READ_CHUNK_BYTES; the payload of
+// a returned FrameView points into it and is valid until the next read,
+// peek() or seek(). Positions are frame indexes. seek() starts from the
+// nearest frame whose offset has been seen (one every SEEK_INDEX_INTERVAL
+// frames is kept) and walks forward from there.
+//
+// A file that was not cleanly closed is walked past the header's data_end on
+// open: whole frames continuing the sequence are recovered and a torn tail
+// is cut off.
+class FrameFileChannel {
+ public:
+  static constexpr size_t READ_CHUNK_BYTES = 256 * 1024;
+  static constexpr int64_t SEEK_INDEX_INTERVAL = 4096;
+
+  explicit FrameFileChannel(std::string_view filepath)
+      : filepath_(filepath),
+        is_open_(false),
+        frame_count_(0),
+        first_seq_(INVALID_SEQ),
+        last_seq_(INVALID_SEQ),
+        was_cleanly_closed_(false),
+        recovered_count_(0),
+        data_end_(0),
+        current_index_(0),
+        buffer_offset_(0),
+        buf_pos_(0),
+        buf_end_(0) {}
+
+  ~FrameFileChannel() { close(); }
+
+  // Disable copy and move
+  FrameFileChannel(const FrameFileChannel&) = delete;
+  FrameFileChannel& operator=(const FrameFileChannel&) = delete;
+
+  // Fails on a file that is not a v4 recording
+  bool open() {
+    if (is_open_) {
+      return true;
+    }
+
+    std::error_code ec;
+    auto file_size = static_cast<int64_t>(
+        std::filesystem::file_size(filepath_, ec));
+    file_.open(filepath_, std::ios::binary | std::ios::in);
+    if (ec || !file_.is_open()) {
+      return false;
+    }
+
+    FileHeader header;
+    file_.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+    if (!file_.good() || !header.isValid() || !header.isFramed() ||
+        header.schema_id != SCHEMA_FRAMES) {
+      file_.close();
+      return false;
+    }
+
+    const auto body = static_cast<int64_t>(sizeof(FileHeader));
+    if (header.isConsistent() && header.data_end >= body &&
+        header.data_end <= file_size) {
+      frame_count_ = header.msg_count;
+      first_seq_ = header.first_seq;
+      last_seq_ = header.last_seq;
+      data_end_ = header.data_end;
+    } else {
+      frame_count_ = 0;
+      first_seq_ = INVALID_SEQ;
+      last_seq_ = INVALID_SEQ;
+      data_end_ = body;
+    }
+    was_cleanly_closed_ = header.isConsistent() && header.isComplete();
+    recovered_count_ = 0;
+    seek_index_.assign(1, body);
+    is_open_ = true;
+
+    if (!was_cleanly_closed_ && data_end_ < file_size) {
+      recoverTail(file_size);
+    }
+    rewind(0, body);
+    return true;
+  }
+
+  void close() {
+    if (file_.is_open()) {
+      file_.close();
+    }
+    is_open_ = false;
+    current_index_ = 0;
+    buf_pos_ = 0;
+    buf_end_ = 0;
+  }
+
+  bool isOpen() const { return is_open_; }
+
+  std::optional<FrameView> readNext() {
+    auto frame = peek();
+    if (frame) {
+      advance(*frame);
+    }
+    return frame;
+  }
+
+  std::optional<FrameView> peek() {
+    if (!is_open_ || current_index_ >= frame_count_) {
+      return std::nullopt;
+    }
+    if (!fill(sizeof(FrameHeader))) {
+      return std::nullopt;
+    }
+    FrameView frame;
+    std::memcpy(&frame.header, &buffer_[buf_pos_], sizeof(FrameHeader));
+    const size_t size = frameBytes(frame.header.length);
+    auto left = data_end_ - buffer_offset_ - static_cast<int64_t>(buf_pos_);
+    if (static_cast<int64_t>(size) > left || !fill(size)) {
+      return std::nullopt;  // Torn (or, while recovering, garbage) frame
+    }
+    frame.payload = std::span<const std::byte>(
+        &buffer_[buf_pos_ + sizeof(FrameHeader)], frame.header.length);
+    return frame;
+  }
+
+  // Move to frame index (not sequence number)
+  bool seek(int64_t index) {
+    if (!is_open_ || index < 0 || index >= frame_count_) {
+      return false;
+    }
+    auto known = std::min(index / SEEK_INDEX_INTERVAL,
+                          static_cast<int64_t>(seek_index_.size()) - 1);
+    if (index < current_index_ ||
+        known * SEEK_INDEX_INTERVAL > current_index_) {
+      rewind(known * SEEK_INDEX_INTERVAL,
+             seek_index_[static_cast<size_t>(known)]);
+    }
+    while (current_index_ < index) {
+      auto frame = readNext();
+      if (!frame) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Get total frame count
+  int64_t getFrameCount() const { return frame_count_; }
+
+  // Get current read position (frame index)
+  int64_t getCurrentIndex() const { return current_index_; }
+
+  const std::string& getFilePath() const { return filepath_; }
+
+  // Sequence range of the frames (INVALID_SEQ if empty)
+  SeqNum getFirstSeq() const { return first_seq_; }
+  SeqNum getFileLastSeq() const { return last_seq_; }
+
+  // Whether the file was cleanly closed by the writer
+  bool wasCleanlyClose() const { return was_cleanly_closed_; }
+
+  // Frames found past the header's data_end on open
+  int64_t getRecoveredCount() const { return recovered_count_; }
+
+  // Bytes of the frames, header excluded
+  int64_t getDataBytes() const {
+    return data_end_ - static_cast<int64_t>(sizeof(FileHeader));
+  }
+
+ private:
+  // Restart reading at frame index, found at offset
+  void rewind(int64_t index, int64_t offset) {
+    file_.clear();
+    file_.seekg(offset);
+    current_index_ = index;
+    buffer_offset_ = offset;
+    buf_pos_ = 0;
+    buf_end_ = 0;
+  }
+
+  // Make need bytes available at buf_pos_, reading no further than data_end_
+  bool fill(size_t need) {
+    if (buf_end_ - buf_pos_ >= need) {
+      return true;
+    }
+    if (buf_pos_ > 0) {
+      std::memmove(buffer_.data(), &buffer_[buf_pos_], buf_end_ - buf_pos_);
+      buffer_offset_ += static_cast<int64_t>(buf_pos_);
+      buf_end_ -= buf_pos_;
+      buf_pos_ = 0;
+    }
+    if (buffer_.size() < std::max(need, READ_CHUNK_BYTES)) {
+      buffer_.resize(std::max(need, READ_CHUNK_BYTES));
+    }
+
+    auto unread = data_end_ - buffer_offset_ - static_cast<int64_t>(buf_end_);
+    auto want = std::min<int64_t>(
+        static_cast<int64_t>(buffer_.size() - buf_end_), unread);
+    if (want > 0) {
+      file_.read(reinterpret_cast<char*>(&buffer_[buf_end_]), want);
+      buf_end_ += static_cast<size_t>(file_.gcount());
+      if (!file_.good()) {
+        file_.clear();
+      }
+    }
+    return buf_end_ >= need;
+  }
+
+  void advance(const FrameView& frame) {
+    buf_pos_ += frameBytes(frame.header.length);
+    ++current_index_;
+    if (current_index_ % SEEK_INDEX_INTERVAL == 0 &&
+        current_index_ / SEEK_INDEX_INTERVAL ==
+            static_cast<int64_t>(seek_index_.size())) {
+      seek_index_.push_back(buffer_offset_ + static_cast<int64_t>(buf_pos_));
+    }
+  }
+
+  // Count the whole frames after data_end_ that continue the sequence
+  void recoverTail(int64_t file_size) {
+    const int64_t trusted_end = data_end_;
+    const int64_t trusted_count = frame_count_;
+    rewind(trusted_count, trusted_end);
+    data_end_ = file_size;
+    frame_count_ = INT64_MAX;  // Let peek() read on
+
+    int64_t end = trusted_end;
+    int64_t count = trusted_count;
+    while (auto frame = peek()) {
+      SeqNum seq = frame->header.seq_num;
+      if (frame->header.isPadding() || seq < 0 ||
+          (last_seq_ != INVALID_SEQ && seq != last_seq_ + 1)) {
+        break;
+      }
+      if (first_seq_ == INVALID_SEQ) {
+        first_seq_ = seq;
+      }
+      last_seq_ = seq;
+      advance(*frame);
+      end = buffer_offset_ + static_cast<int64_t>(buf_pos_);
+      ++count;
+    }
+
+    recovered_count_ = count - trusted_count;
+    data_end_ = end;
+    frame_count_ = count;
+  }
+
+  std::string filepath_;
+  std::ifstream file_;
+  bool is_open_;
+  int64_t frame_count_;
+  SeqNum first_seq_;
+  SeqNum last_seq_;
+  bool was_cleanly_closed_;
+  int64_t recovered_count_;
+  int64_t data_end_;
+  int64_t current_index_;
+
+  // Read buffer: bytes [buffer_offset_, buffer_offset_ + buf_end_) of the
+  // file, of which those from buf_pos_ on are unread
+  std::vector<std::byte> buffer_;
+  int64_t buffer_offset_;
+  size_t buf_pos_;
+  size_t buf_end_;
+
+  // File offset of every SEEK_INDEX_INTERVAL-th frame seen so far
+  std::vector<int64_t> seek_index_;
+};
+
+}  // namespace replay
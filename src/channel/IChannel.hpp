@@ -4,15 +4,18 @@
 #include <string>
 
 #include "common/Message.hpp"
+#include "common/Record.hpp"
 
 namespace replay {
 
 // Channel abstract interface
 // Defines unified interface for message reading, supports different data
-// sources (shared memory, files, etc.)
-class IChannel {
+// sources (shared memory, files, etc.). T is the record read (see
+// common/Record.hpp); IChannel reads Msg.
+template <Record T>
+class BasicChannel {
  public:
-  virtual ~IChannel() = default;
+  virtual ~BasicChannel() = default;
 
   // Open channel
   virtual bool open() = 0;
@@ -24,10 +27,10 @@ class IChannel {
   virtual bool isOpen() const = 0;
 
   // Read next message
-  virtual std::optional<Msg> readNext() = 0;
+  virtual std::optional<T> readNext() = 0;
 
   // Peek at next message without consuming
-  virtual std::optional<Msg> peek() = 0;
+  virtual std::optional<T> peek() = 0;
 
   // Get channel name/description
   virtual std::string getName() const = 0;
@@ -40,13 +43,17 @@ class IChannel {
 };
 
 // Writable channel interface
-class IWritableChannel : public IChannel {
+template <Record T>
+class BasicWritableChannel : public BasicChannel<T> {
  public:
   // Write message
-  virtual bool write(const Msg& msg) = 0;
+  virtual bool write(const T& msg) = 0;
 
   // Flush buffer to underlying storage
   virtual void flush() = 0;
 };
 
+using IChannel = BasicChannel<Msg>;
+using IWritableChannel = BasicWritableChannel<Msg>;
+
 }  // namespace replay
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "ColumnBlock.hpp"
+#include "common/Crc32c.hpp"
+#include "common/Types.hpp"
+
+namespace replay {
+
+// Records per index block written by RecordFileWriteChannel
+constexpr uint32_t DEFAULT_INDEX_BLOCK_RECORDS = 256;
+
+// Index tag ("IIX1")
+constexpr uint32_t INSTRUMENT_INDEX_MAGIC = 0x31584949;
+
+// Instrument index of a v2 record file
+// Written by RecordFileWriteChannel on close() for records that carry an
+// instrument_id (InstrumentRecord): the records are cut into index blocks of
+// block_records and each instrument has a posting list of the blocks it
+// occurs in, so replaying a few instruments only reads their blocks. It
+// follows the records, at FileHeader.data_end:
+//
+//   InstrumentIndexHeader
+//   directory   instrument_count InstrumentPostingEntry, by instrument_id
+//   postings    per directory entry, varint (block - (previous block + 1))
+//               for each of its blocks, the previous block starting at -1
+//
+// crc is the CRC32C of the directory, checked when it is loaded; posting
+// lists are bounds-checked as they are decoded. FILE_FLAG_INSTRUMENT_INDEX
+// is only set in the file header once the index is written, so a file that
+// was not cleanly closed has none and is scanned instead.
+struct alignas(8) InstrumentIndexHeader {
+  uint32_t magic;             // INSTRUMENT_INDEX_MAGIC
+  uint32_t block_records;     // Records per index block
+  uint32_t instrument_count;  // Directory entries
+  uint32_t crc;               // CRC32C of the directory
+  int64_t block_count;        // Index blocks covered
+  int64_t postings_bytes;     // Bytes of all posting lists
+};
+
+static_assert(sizeof(InstrumentIndexHeader) == 32,
+              "InstrumentIndexHeader size must be 32 bytes");
+
+struct alignas(8) InstrumentPostingEntry {
+  uint32_t instrument_id;
+  uint32_t block_count;  // Blocks the instrument occurs in
+  uint64_t offset;       // Of its posting list, from the start of postings
+};
+
+static_assert(sizeof(InstrumentPostingEntry) == 16,
+              "InstrumentPostingEntry size must be 16 bytes");
+
+// Collects the posting lists while records are written, in record order
+class InstrumentIndexBuilder {
+ public:
+  explicit InstrumentIndexBuilder(
+      uint32_t block_records = DEFAULT_INDEX_BLOCK_RECORDS)
+      : block_records_(block_records) {}
+
+  // Start over with index blocks of block_records
+  void reset(uint32_t block_records) {
+    block_records_ = block_records;
+    postings_.clear();
+  }
+
+  // Record number index (ascending across calls) is of this instrument
+  void add(uint32_t instrument_id, int64_t index) {
+    const int64_t block = index / block_records_;
+    Posting& posting = postings_[instrument_id];
+    if (block != posting.last_block) {
+      putVarint(posting.deltas,
+                static_cast<uint64_t>(block - (posting.last_block + 1)));
+      posting.last_block = block;
+      ++posting.blocks;
+    }
+  }
+
+  uint32_t blockRecords() const { return block_records_; }
+
+  size_t instrumentCount() const { return postings_.size(); }
+
+  // The index of a file of record_count records, as written after them
+  std::vector<std::byte> serialize(int64_t record_count) const {
+    std::vector<uint32_t> ids;
+    ids.reserve(postings_.size());
+    size_t postings_bytes = 0;
+    for (const auto& [id, posting] : postings_) {
+      ids.push_back(id);
+      postings_bytes += posting.deltas.size();
+    }
+    std::sort(ids.begin(), ids.end());
+
+    const size_t directory_bytes = ids.size() * sizeof(InstrumentPostingEntry);
+    std::vector<std::byte> out(sizeof(InstrumentIndexHeader) +
+                               directory_bytes + postings_bytes);
+    std::byte* directory = out.data() + sizeof(InstrumentIndexHeader);
+    std::byte* postings = directory + directory_bytes;
+    uint64_t offset = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+      const Posting& posting = postings_.at(ids[i]);
+      InstrumentPostingEntry entry{ids[i], posting.blocks, offset};
+      std::memcpy(directory + i * sizeof(entry), &entry, sizeof(entry));
+      std::memcpy(postings + offset, posting.deltas.data(),
+                  posting.deltas.size());
+      offset += posting.deltas.size();
+    }
+
+    InstrumentIndexHeader header{};
+    header.magic = INSTRUMENT_INDEX_MAGIC;
+    header.block_records = block_records_;
+    header.instrument_count = static_cast<uint32_t>(ids.size());
+    header.crc = crc32c(directory, directory_bytes);
+    header.block_count = (record_count + block_records_ - 1) / block_records_;
+    header.postings_bytes = static_cast<int64_t>(postings_bytes);
+    std::memcpy(out.data(), &header, sizeof(header));
+    return out;
+  }
+
+ private:
+  struct Posting {
+    int64_t last_block = -1;
+    uint32_t blocks = 0;
+    std::vector<uint8_t> deltas;
+  };
+
+  uint32_t block_records_;
+  std::unordered_map<uint32_t, Posting> postings_;
+};
+
+// Blocks of a record file that hold any of a set of instruments
+struct InstrumentBlocks {
+  uint32_t block_records = 0;
+  int64_t block_count = 0;      // Index blocks in the file
+  std::vector<int64_t> blocks;  // Ascending, without duplicates
+  int64_t bytes_read = 0;       // Index bytes loaded
+};
+
+// Look up instruments (sorted, unique) in the index of size bytes at offset
+// of in. Returns std::nullopt if the index is missing or damaged.
+inline std::optional<InstrumentBlocks> readInstrumentBlocks(
+    std::istream& in, int64_t offset, int64_t size,
+    std::span<const uint32_t> instruments) {
+  InstrumentBlocks result;
+  InstrumentIndexHeader header;
+  in.clear();
+  in.seekg(offset);
+  if (size < static_cast<int64_t>(sizeof(header)) ||
+      !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != INSTRUMENT_INDEX_MAGIC || header.block_records == 0 ||
+      header.block_count < 0 || header.postings_bytes < 0) {
+    return std::nullopt;
+  }
+
+  const int64_t directory_bytes =
+      static_cast<int64_t>(header.instrument_count) *
+      static_cast<int64_t>(sizeof(InstrumentPostingEntry));
+  if (static_cast<int64_t>(sizeof(header)) + directory_bytes +
+          header.postings_bytes !=
+      size) {
+    return std::nullopt;
+  }
+  std::vector<InstrumentPostingEntry> directory(header.instrument_count);
+  if (!in.read(reinterpret_cast<char*>(directory.data()), directory_bytes) ||
+      crc32c(directory.data(), static_cast<size_t>(directory_bytes)) !=
+          header.crc) {
+    return std::nullopt;
+  }
+  result.bytes_read = static_cast<int64_t>(sizeof(header)) + directory_bytes;
+
+  const int64_t postings_start = offset + result.bytes_read;
+  std::vector<uint8_t> posting;
+  for (uint32_t id : instruments) {
+    auto entry = std::lower_bound(
+        directory.begin(), directory.end(), id,
+        [](const InstrumentPostingEntry& e, uint32_t v) {
+          return e.instrument_id < v;
+        });
+    if (entry == directory.end() || entry->instrument_id != id) {
+      continue;
+    }
+    const uint64_t end = entry + 1 == directory.end()
+                             ? static_cast<uint64_t>(header.postings_bytes)
+                             : (entry + 1)->offset;
+    if (entry->offset > end ||
+        end > static_cast<uint64_t>(header.postings_bytes)) {
+      return std::nullopt;
+    }
+    posting.resize(end - entry->offset);
+    in.seekg(postings_start + static_cast<int64_t>(entry->offset));
+    if (!in.read(reinterpret_cast<char*>(posting.data()),
+                 static_cast<std::streamsize>(posting.size()))) {
+      return std::nullopt;
+    }
+    result.bytes_read += static_cast<int64_t>(posting.size());
+
+    const uint8_t* p = posting.data();
+    const uint8_t* p_end = p + posting.size();
+    int64_t block = -1;
+    for (uint32_t i = 0; i < entry->block_count; ++i) {
+      uint64_t delta;
+      p = getVarint(p, p_end, delta);
+      if (p == nullptr ||
+          delta >= static_cast<uint64_t>(header.block_count - block - 1)) {
+        return std::nullopt;
+      }
+      block += static_cast<int64_t>(delta) + 1;
+      result.blocks.push_back(block);
+    }
+  }
+
+  std::sort(result.blocks.begin(), result.blocks.end());
+  result.blocks.erase(std::unique(result.blocks.begin(), result.blocks.end()),
+                      result.blocks.end());
+  result.block_records = header.block_records;
+  result.block_count = header.block_count;
+  in.clear();
+  return result;
+}
+
+}  // namespace replay
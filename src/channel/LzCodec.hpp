@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace replay {
+
+// In-tree LZ77 block compressor (LZ4-style sequences, no framing).
+//
+// The output is a run of sequences, each
+//
+//   token          literal count (high nibble) and match length - 4 (low
+//                  nibble); 15 in a nibble means more bytes follow
+//   [length bytes] 255 per byte until a byte below 255, added to the nibble
+//   literals
+//   offset         2 bytes little endian, distance back to the match
+//   [length bytes] match length continuation
+//
+// and the last sequence has literals only. Matches are found through a
+// 16K-entry hash of the next 4 bytes; runs without matches are skipped
+// faster the longer they get, so incompressible input costs little. The
+// decoder validates every length and offset against the buffers.
+
+// Largest compressed size of n input bytes
+constexpr size_t lzCompressBound(size_t n) { return n + n / 255 + 16; }
+
+namespace lz_detail {
+
+constexpr int HASH_BITS = 14;
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+
+inline uint32_t load32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t hash4(uint32_t v) {
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Append a length continuation (value already reduced by 15)
+inline uint8_t* putLength(uint8_t* op, size_t value) {
+  while (value >= 255) {
+    *op++ = 255;
+    value -= 255;
+  }
+  *op++ = static_cast<uint8_t>(value);
+  return op;
+}
+
+// Read a length continuation onto value; nullptr if it runs past end
+inline const uint8_t* getLength(const uint8_t* ip, const uint8_t* end,
+                                size_t& value) {
+  uint8_t byte;
+  do {
+    if (ip >= end) {
+      return nullptr;
+    }
+    byte = *ip++;
+    value += byte;
+  } while (byte == 255);
+  return ip;
+}
+
+// One sequence: literals [anchor, anchor + literals), then (if match_length
+// > 0) a match
+inline uint8_t* putSequence(uint8_t* op, const uint8_t* anchor,
+                            size_t literals, size_t offset,
+                            size_t match_length) {
+  uint8_t* token = op++;
+  size_t match_code = match_length > 0 ? match_length - MIN_MATCH : 0;
+  *token = static_cast<uint8_t>(((literals < 15 ? literals : 15) << 4) |
+                                (match_code < 15 ? match_code : 15));
+  if (literals >= 15) {
+    op = putLength(op, literals - 15);
+  }
+  if (literals > 0) {
+    std::memcpy(op, anchor, literals);
+    op += literals;
+  }
+  if (match_length > 0) {
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    if (match_code >= 15) {
+      op = putLength(op, match_code - 15);
+    }
+  }
+  return op;
+}
+
+}  // namespace lz_detail
+
+// Compress n bytes of src into dst (capacity >= lzCompressBound(n)).
+// Returns the compressed size.
+inline size_t lzCompress(const uint8_t* src, size_t n, uint8_t* dst) {
+  using namespace lz_detail;
+  thread_local std::vector<uint32_t> table(size_t(1) << HASH_BITS);
+  std::fill(table.begin(), table.end(), 0);
+
+  uint8_t* op = dst;
+  size_t anchor = 0;
+  size_t ip = 1;
+  while (n >= MIN_MATCH && ip + MIN_MATCH <= n) {
+    uint32_t seq = load32(src + ip);
+    uint32_t& slot = table[hash4(seq)];
+    size_t ref = slot;
+    slot = static_cast<uint32_t>(ip);
+    if (ref >= ip || ip - ref > MAX_OFFSET || load32(src + ref) != seq) {
+      ip += 1 + ((ip - anchor) >> 6);  // Skip faster through literals
+      continue;
+    }
+
+    size_t length = MIN_MATCH;
+    while (ip + length < n && src[ref + length] == src[ip + length]) {
+      ++length;
+    }
+    op = putSequence(op, src + anchor, ip - anchor, ip - ref, length);
+    ip += length;
+    anchor = ip;
+  }
+  op = putSequence(op, src + anchor, n - anchor, 0, 0);
+  return static_cast<size_t>(op - dst);
+}
+
+// Decompress n bytes of src into exactly out_size bytes of dst. Returns
+// false if src is malformed or does not decode to out_size bytes.
+inline bool lzDecompress(const uint8_t* src, size_t n, uint8_t* dst,
+                         size_t out_size) {
+  using namespace lz_detail;
+  const uint8_t* ip = src;
+  const uint8_t* const end = src + n;
+  uint8_t* op = dst;
+  uint8_t* const out_end = dst + out_size;
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+
+    size_t literals = token >> 4;
+    if (literals == 15 && (ip = getLength(ip, end, literals)) == nullptr) {
+      return false;
+    }
+    if (literals > static_cast<size_t>(end - ip) ||
+        literals > static_cast<size_t>(out_end - op)) {
+      return false;
+    }
+    if (literals > 0) {
+      std::memcpy(op, ip, literals);
+      ip += literals;
+      op += literals;
+    }
+    if (ip == end) {
+      break;  // Last sequence
+    }
+
+    if (end - ip < 2) {
+      return false;
+    }
+    size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    size_t length = token & 15;
+    if (length == 15 && (ip = getLength(ip, end, length)) == nullptr) {
+      return false;
+    }
+    length += MIN_MATCH;
+    if (offset == 0 || offset > static_cast<size_t>(op - dst) ||
+        length > static_cast<size_t>(out_end - op)) {
+      return false;
+    }
+
+    const uint8_t* match = op - offset;
+    if (offset >= length) {
+      std::memcpy(op, match, length);
+      op += length;
+    } else {
+      for (size_t i = 0; i < length; ++i) {
+        *op++ = match[i];  // Overlapping: repeats the last offset bytes
+      }
+    }
+  }
+  return op == out_end;
+}
+
+}  // namespace replay
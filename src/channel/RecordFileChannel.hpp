@@ -0,0 +1,569 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "FileChannel.hpp"
+#include "IChannel.hpp"
+#include "InstrumentIndex.hpp"
+#include "common/Record.hpp"
+
+namespace replay {
+
+// Recordings of any record type
+// The v2 layout (header, then a raw array of records) for records other than
+// Msg: the header's schema_id and record_size name the record type, and a
+// file is only opened as the type it was written with. Msg keeps
+// FileChannel/FileWriteChannel, with their v3 blocks, filters and recovery;
+// FileChannelFor<T>/FileWriteChannelFor<T> pick the right pair for a record.
+//
+// As with v2 FileChannel, the reader trusts the header's msg_count (flushed
+// periodically) when the file was not cleanly closed.
+//
+// For an InstrumentRecord, setInstrumentFilter() restricts reads to some
+// instruments. A cleanly closed file carries an instrument index (see
+// InstrumentIndex.hpp): index blocks that hold none of the instruments are
+// skipped without being read, and the others are filtered record by record.
+// Files without an index are scanned and filtered the same way.
+template <Record T>
+class RecordFileChannel : public BasicChannel<T> {
+ public:
+  static constexpr uint32_t SCHEMA_ID = RecordSchema<T>::ID;
+  static constexpr uint32_t RECORD_SIZE = sizeof(T);
+
+  explicit RecordFileChannel(std::string_view filepath)
+      : filepath_(filepath),
+        is_open_(false),
+        current_seq_(0),
+        msg_count_(0),
+        first_seq_(INVALID_SEQ),
+        last_seq_(INVALID_SEQ),
+        was_cleanly_closed_(false),
+        index_offset_(0),
+        index_bytes_(0),
+        instrument_filter_(false),
+        use_index_(false),
+        block_records_(0),
+        last_block_read_(-1) {}
+
+  ~RecordFileChannel() override { close(); }
+
+  // Fails on a file of another record type (or in the v3/v4 layouts)
+  bool open() override {
+    if (is_open_) {
+      return true;
+    }
+
+    std::error_code ec;
+    auto file_size = static_cast<int64_t>(
+        std::filesystem::file_size(filepath_, ec));
+    file_.open(filepath_, std::ios::binary | std::ios::in);
+    if (ec || !file_.is_open()) {
+      return false;
+    }
+
+    FileHeader header;
+    file_.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+    if (!file_.good() || !header.isValid() || header.isColumnar() ||
+        header.isFramed() || !header.holdsRecords(SCHEMA_ID, RECORD_SIZE)) {
+      file_.close();
+      return false;
+    }
+
+    msg_count_ = header.msg_count;
+    if (header.isConsistent()) {
+      first_seq_ = header.first_seq;
+      last_seq_ = header.last_seq;
+      was_cleanly_closed_ = header.isComplete();
+    } else {
+      first_seq_ = INVALID_SEQ;
+      last_seq_ = INVALID_SEQ;
+      was_cleanly_closed_ = false;
+    }
+
+    // The index is only trusted behind a clean close
+    index_offset_ = 0;
+    index_bytes_ = 0;
+    if (was_cleanly_closed_ && (header.flags & FILE_FLAG_INSTRUMENT_INDEX) &&
+        header.data_end == recordOffset(msg_count_) &&
+        header.data_end < file_size) {
+      index_offset_ = header.data_end;
+      index_bytes_ = file_size - header.data_end;
+    }
+    use_index_ = false;
+    filter_stats_ = FilterStats{};
+
+    current_seq_ = 0;
+    is_open_ = true;
+    if (instrument_filter_) {
+      loadInstrumentBlocks();
+    }
+    return true;
+  }
+
+  void close() override {
+    if (file_.is_open()) {
+      file_.close();
+    }
+    is_open_ = false;
+    current_seq_ = 0;
+  }
+
+  bool isOpen() const override { return is_open_; }
+
+  std::optional<T> readNext() override {
+    T record;
+    if (readBatch(std::span<T>(&record, 1)) == 0) {
+      return std::nullopt;
+    }
+    return record;
+  }
+
+  // Read up to out.size() consecutive records with a single stream read
+  // (with an instrument filter, up to out.size() matching records). Returns
+  // the number read (0 at end of file).
+  size_t readBatch(std::span<T> out) {
+    if (!is_open_ || current_seq_ >= msg_count_) {
+      return 0;
+    }
+    if constexpr (InstrumentRecord<T>) {
+      if (instrument_filter_) {
+        return readFiltered(out);
+      }
+    }
+
+    auto count = static_cast<size_t>(
+        std::min<int64_t>(static_cast<int64_t>(out.size()),
+                          msg_count_ - current_seq_));
+    file_.read(reinterpret_cast<char*>(out.data()),
+               static_cast<std::streamsize>(count * sizeof(T)));
+    auto got = static_cast<size_t>(file_.gcount()) / sizeof(T);
+    if (got < count) {
+      // Torn tail: keep the whole records and stop there
+      file_.clear();
+      msg_count_ = current_seq_ + static_cast<SeqNum>(got);
+      file_.seekg(recordOffset(msg_count_));
+    }
+    current_seq_ += static_cast<SeqNum>(got);
+    return got;
+  }
+
+  std::optional<T> peek() override {
+    std::optional<T> record = readNext();
+    if (record) {
+      seek(current_seq_ - 1);
+    }
+    return record;
+  }
+
+  std::string getName() const override {
+    return "RecordFileChannel: " + filepath_;
+  }
+
+  SeqNum getLatestSeq() const override {
+    return msg_count_ > 0 ? msg_count_ - 1 : INVALID_SEQ;
+  }
+
+  bool seek(SeqNum seq) override {
+    if (!is_open_ || seq < 0 || seq >= msg_count_) {
+      return false;
+    }
+    file_.seekg(recordOffset(seq));
+    if (!file_.good()) {
+      return false;
+    }
+    current_seq_ = seq;
+    return true;
+  }
+
+  // Get total record count
+  int64_t getMessageCount() const { return msg_count_; }
+
+  // Get current read position
+  SeqNum getCurrentSeq() const { return current_seq_; }
+
+  const std::string& getFilePath() const { return filepath_; }
+
+  // Sequence range recorded in the header
+  SeqNum getFirstSeq() const { return first_seq_; }
+  SeqNum getFileLastSeq() const { return last_seq_; }
+
+  // Whether the file was cleanly closed by the writer
+  bool wasCleanlyClose() const { return was_cleanly_closed_; }
+
+  // Return only records of these instruments from readNext(), readBatch()
+  // and peek(), from the current position on (the others are passed over:
+  // getCurrentSeq() still counts every record). Resets the FilterStats.
+  void setInstrumentFilter(std::span<const uint32_t> instruments)
+    requires InstrumentRecord<T>
+  {
+    instruments_.assign(instruments.begin(), instruments.end());
+    std::sort(instruments_.begin(), instruments_.end());
+    instruments_.erase(std::unique(instruments_.begin(), instruments_.end()),
+                       instruments_.end());
+    instrument_filter_ = true;
+    filter_stats_ = FilterStats{};
+    if (is_open_) {
+      loadInstrumentBlocks();
+    }
+  }
+
+  // Return every record again
+  void clearInstrumentFilter() {
+    instrument_filter_ = false;
+    use_index_ = false;
+  }
+
+  // Whether the file has an instrument index
+  bool hasInstrumentIndex() const { return index_bytes_ > 0; }
+
+  // Whether the instrument filter skips blocks with the index (false: the
+  // file is scanned)
+  bool usesInstrumentIndex() const { return use_index_; }
+
+  // Index blocks skipped and selected, and record and index bytes read since
+  // open() or setInstrumentFilter()
+  const FilterStats& getFilterStats() const { return filter_stats_; }
+
+ private:
+  static std::streamoff recordOffset(SeqNum seq) {
+    return static_cast<std::streamoff>(sizeof(FileHeader) +
+                                       static_cast<size_t>(seq) * sizeof(T));
+  }
+
+  // Look the filter's instruments up in the index; without a usable index
+  // the file is scanned
+  void loadInstrumentBlocks() {
+    use_index_ = false;
+    filter_blocks_.clear();
+    if (index_bytes_ == 0) {
+      return;
+    }
+    auto blocks =
+        readInstrumentBlocks(file_, index_offset_, index_bytes_, instruments_);
+    file_.clear();
+    file_.seekg(recordOffset(current_seq_));
+    if (!blocks || blocks->block_count * blocks->block_records < msg_count_) {
+      index_bytes_ = 0;  // Damaged: scan
+      return;
+    }
+    filter_blocks_ = std::move(blocks->blocks);
+    block_records_ = blocks->block_records;
+    last_block_read_ = -1;
+    filter_stats_.bytes_read += blocks->bytes_read;
+    use_index_ = true;
+  }
+
+  // readBatch() with the instrument filter: jump to the next index block
+  // that holds one of the instruments (or, without the index, read on),
+  // read up to the end of the run of consecutive such blocks, and keep the
+  // matching ones; until something matches, as for v2 FileChannel
+  size_t readFiltered(std::span<T> out)
+    requires InstrumentRecord<T>
+  {
+    size_t kept = 0;
+    while (kept == 0 && current_seq_ < msg_count_) {
+      SeqNum end = msg_count_;
+      if (use_index_) {
+        const auto records = static_cast<SeqNum>(block_records_);
+        const SeqNum block = current_seq_ / records;
+        auto next = std::lower_bound(filter_blocks_.begin(),
+                                     filter_blocks_.end(), block);
+        const SeqNum unread = (current_seq_ + records - 1) / records;
+        if (next == filter_blocks_.end()) {
+          filter_stats_.blocks_skipped += static_cast<size_t>(
+              std::max<SeqNum>(0, (msg_count_ + records - 1) / records -
+                                      unread));
+          current_seq_ = msg_count_;
+          break;
+        }
+        if (*next > block) {
+          filter_stats_.blocks_skipped +=
+              static_cast<size_t>(*next - unread);
+          current_seq_ = *next * records;
+          file_.seekg(recordOffset(current_seq_));
+        }
+        // One read across adjacent blocks, as far as out has room
+        const SeqNum room = current_seq_ + static_cast<SeqNum>(out.size());
+        auto last = next;
+        while (last + 1 != filter_blocks_.end() && *(last + 1) == *last + 1 &&
+               (*last + 1) * records < room) {
+          ++last;
+        }
+        end = std::min(msg_count_, (*last + 1) * records);
+      }
+
+      auto count = static_cast<size_t>(std::min<int64_t>(
+          static_cast<int64_t>(out.size()), end - current_seq_));
+      file_.read(reinterpret_cast<char*>(out.data()),
+                 static_cast<std::streamsize>(count * sizeof(T)));
+      auto got = static_cast<size_t>(file_.gcount()) / sizeof(T);
+      filter_stats_.bytes_read += static_cast<int64_t>(got * sizeof(T));
+      if (use_index_ && got > 0) {
+        const auto records = static_cast<SeqNum>(block_records_);
+        const SeqNum last_block =
+            (current_seq_ + static_cast<SeqNum>(got) - 1) / records;
+        const SeqNum first_block =
+            std::max(current_seq_ / records, last_block_read_ + 1);
+        if (last_block >= first_block) {
+          filter_stats_.blocks_selected +=
+              static_cast<size_t>(last_block - first_block + 1);
+          last_block_read_ = last_block;
+        }
+      }
+      if (instruments_.size() == 1) {
+        const uint32_t instrument = instruments_.front();
+        for (size_t i = 0; i < got; ++i) {
+          if (static_cast<uint32_t>(out[i].instrument_id) == instrument) {
+            out[kept++] = out[i];
+          }
+        }
+      } else {
+        for (size_t i = 0; i < got; ++i) {
+          if (std::binary_search(
+                  instruments_.begin(), instruments_.end(),
+                  static_cast<uint32_t>(out[i].instrument_id))) {
+            out[kept++] = out[i];
+          }
+        }
+      }
+      current_seq_ += static_cast<SeqNum>(got);
+      if (got < count) {
+        // Torn tail: keep the whole records and stop there
+        file_.clear();
+        msg_count_ = current_seq_;
+        file_.seekg(recordOffset(msg_count_));
+        break;
+      }
+    }
+    return kept;
+  }
+
+  std::string filepath_;
+  std::ifstream file_;
+  bool is_open_;
+  SeqNum current_seq_;
+  int64_t msg_count_;
+  SeqNum first_seq_;
+  SeqNum last_seq_;
+  bool was_cleanly_closed_;
+
+  // Instrument index (index_bytes_ == 0: none) and filter
+  int64_t index_offset_;
+  int64_t index_bytes_;
+  bool instrument_filter_;
+  std::vector<uint32_t> instruments_;  // Sorted
+  bool use_index_;
+  uint32_t block_records_;
+  std::vector<int64_t> filter_blocks_;  // Index blocks holding instruments_
+  int64_t last_block_read_;
+  FilterStats filter_stats_;
+};
+
+// Writes a v2 recording of T records (see RecordFileChannel)
+//
+// For an InstrumentRecord the instrument index is built as records are
+// written and appended on close(), which then sets
+// FILE_FLAG_INSTRUMENT_INDEX and data_end.
+template <Record T>
+class RecordFileWriteChannel : public BasicWritableChannel<T> {
+ public:
+  static constexpr uint32_t SCHEMA_ID = RecordSchema<T>::ID;
+  static constexpr uint32_t RECORD_SIZE = sizeof(T);
+
+  explicit RecordFileWriteChannel(std::string_view filepath)
+      : filepath_(filepath),
+        is_open_(false),
+        msg_count_(0),
+        first_seq_(INVALID_SEQ),
+        last_seq_(INVALID_SEQ),
+        header_(),
+        index_block_records_(DEFAULT_INDEX_BLOCK_RECORDS) {}
+
+  ~RecordFileWriteChannel() override { close(); }
+
+  // Records per index block (takes effect on open()): smaller blocks skip
+  // more precisely for a larger index
+  void setIndexBlockRecords(uint32_t records)
+    requires InstrumentRecord<T>
+  {
+    index_block_records_ = std::max<uint32_t>(records, 1);
+  }
+
+  bool open() override {
+    if (is_open_) {
+      return true;
+    }
+
+    file_.open(filepath_, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file_.is_open()) {
+      return false;
+    }
+
+    // Placeholder, updated on flush/close
+    header_ = FileHeader();
+    header_.schema_id = SCHEMA_ID;
+    header_.record_size = RECORD_SIZE;
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(FileHeader));
+    if (!file_.good()) {
+      file_.close();
+      return false;
+    }
+
+    msg_count_ = 0;
+    first_seq_ = INVALID_SEQ;
+    last_seq_ = INVALID_SEQ;
+    index_.reset(index_block_records_);
+    is_open_ = true;
+    return true;
+  }
+
+  void close() override {
+    if (is_open_) {
+      if constexpr (InstrumentRecord<T>) {
+        writeIndex();
+      }
+      header_.flags |= FILE_FLAG_COMPLETE;
+      updateHeader();
+      file_.close();
+    }
+    is_open_ = false;
+  }
+
+  bool isOpen() const override { return is_open_; }
+
+  std::optional<T> readNext() override { return std::nullopt; }
+
+  std::optional<T> peek() override { return std::nullopt; }
+
+  std::string getName() const override {
+    return "RecordFileWriteChannel: " + filepath_;
+  }
+
+  SeqNum getLatestSeq() const override {
+    return msg_count_ > 0 ? msg_count_ - 1 : INVALID_SEQ;
+  }
+
+  bool seek(SeqNum /*seq*/) override { return false; }
+
+  bool write(const T& record) override {
+    return writeBatch(std::span<const T>(&record, 1));
+  }
+
+  // Append records with a single stream write
+  bool writeBatch(std::span<const T> records) {
+    if (!is_open_) {
+      return false;
+    }
+    if (records.empty()) {
+      return true;
+    }
+
+    file_.write(reinterpret_cast<const char*>(records.data()),
+                static_cast<std::streamsize>(records.size_bytes()));
+    if (!file_.good()) {
+      return false;
+    }
+
+    if constexpr (InstrumentRecord<T>) {
+      for (size_t i = 0; i < records.size(); ++i) {
+        index_.add(static_cast<uint32_t>(records[i].instrument_id),
+                   msg_count_ + static_cast<int64_t>(i));
+      }
+    }
+    if (first_seq_ == INVALID_SEQ) {
+      first_seq_ = records.front().seq_num;
+    }
+    last_seq_ = records.back().seq_num;
+    msg_count_ += static_cast<int64_t>(records.size());
+    return true;
+  }
+
+  // Update the header so readers and crash recovery see the data written
+  // so far (FILE_FLAG_COMPLETE is only set by close())
+  void flush() override {
+    if (is_open_) {
+      updateHeader();
+    }
+  }
+
+  // Same as flush(), as for v2 FileWriteChannel
+  void periodicFlush() { flush(); }
+
+  int64_t getMessageCount() const { return msg_count_; }
+
+  // Same as getMessageCount(): records are written through, as in v2
+  int64_t getPersistedCount() const { return msg_count_; }
+
+  const std::string& getFilePath() const { return filepath_; }
+
+  SeqNum getFirstSeq() const { return first_seq_; }
+  SeqNum getLastSeq() const { return last_seq_; }
+
+ private:
+  // Append the instrument index after the records
+  void writeIndex() {
+    if (msg_count_ == 0) {
+      return;
+    }
+    auto index = index_.serialize(msg_count_);
+    auto data_end = static_cast<int64_t>(file_.tellp());
+    file_.write(reinterpret_cast<const char*>(index.data()),
+                static_cast<std::streamsize>(index.size()));
+    if (file_.good()) {
+      header_.flags |= FILE_FLAG_INSTRUMENT_INDEX;
+      header_.block_messages = index_.blockRecords();
+      header_.data_end = data_end;
+    }
+  }
+
+  void updateHeader() {
+    auto current_pos = file_.tellp();
+    file_.seekp(0);
+    header_.msg_count = msg_count_;
+    header_.first_seq = first_seq_;
+    header_.last_seq = last_seq_;
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(FileHeader));
+    file_.seekp(current_pos);
+    file_.flush();
+  }
+
+  std::string filepath_;
+  std::ofstream file_;
+  bool is_open_;
+  int64_t msg_count_;
+  SeqNum first_seq_;
+  SeqNum last_seq_;
+  FileHeader header_;
+  uint32_t index_block_records_;
+  InstrumentIndexBuilder index_;
+};
+
+// File channel pair for a record type: FileChannel/FileWriteChannel for Msg,
+// RecordFileChannel/RecordFileWriteChannel for any other record
+template <Record T>
+struct FileChannelSelector {
+  using Reader = RecordFileChannel<T>;
+  using Writer = RecordFileWriteChannel<T>;
+};
+
+template <>
+struct FileChannelSelector<Msg> {
+  using Reader = FileChannel;
+  using Writer = FileWriteChannel;
+};
+
+template <Record T>
+using FileChannelFor = typename FileChannelSelector<T>::Reader;
+
+template <Record T>
+using FileWriteChannelFor = typename FileChannelSelector<T>::Writer;
+
+}  // namespace replay
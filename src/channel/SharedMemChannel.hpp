@@ -8,11 +8,11 @@
 namespace replay {
 
 // Shared memory channel (based on ring buffer)
-// Used for real-time data transmission
-template <size_t Capacity = DEFAULT_RING_BUFFER_SIZE>
-class SharedMemChannel : public IChannel {
+// Used for real-time data transmission of records of type T
+template <size_t Capacity = DEFAULT_RING_BUFFER_SIZE, Record T = Msg>
+class SharedMemChannel : public BasicChannel<T> {
  public:
-  explicit SharedMemChannel(RingBuffer<Capacity>& buffer,
+  explicit SharedMemChannel(RingBuffer<Capacity, T>& buffer,
                             const std::string& name = "SharedMemChannel")
       : buffer_(buffer), name_(name), is_open_(false), cursor_() {}
 
@@ -28,7 +28,7 @@ class SharedMemChannel : public IChannel {
 
   bool isOpen() const override { return is_open_; }
 
-  std::optional<Msg> readNext() override {
+  std::optional<T> readNext() override {
     if (!is_open_) {
       return std::nullopt;
     }
@@ -43,7 +43,7 @@ class SharedMemChannel : public IChannel {
     return msg;
   }
 
-  std::optional<Msg> peek() override {
+  std::optional<T> peek() override {
     if (!is_open_) {
       return std::nullopt;
     }
@@ -63,8 +63,7 @@ class SharedMemChannel : public IChannel {
 
     // Check if sequence number is within buffer range
     SeqNum latest = buffer_.getLatestSeq();
-    SeqNum oldest =
-        std::max(SeqNum(0), latest - static_cast<SeqNum>(Capacity) + 1);
+    SeqNum oldest = buffer_.getOldestSeq();
 
     if (seq > latest || seq < oldest) {
       return false;  // Sequence number out of range
@@ -81,7 +80,7 @@ class SharedMemChannel : public IChannel {
   void setCurrentSeq(SeqNum seq) { cursor_.setReadSeq(seq); }
 
  private:
-  RingBuffer<Capacity>& buffer_;
+  RingBuffer<Capacity, T>& buffer_;
   std::string name_;
   bool is_open_;
   ConsumerCursor cursor_;
@@ -1,17 +1,24 @@
 #include "MktDataClient.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 
+#include "channel/FileChannel.hpp"
 #include "common/Logging.hpp"
+#include "common/PayloadSum.hpp"
+#include "common/Record.hpp"
+#include "common/TscClock.hpp"
 #include "replay/ReplayEngine.hpp"
 
 namespace replay {
 
 MktDataClient::MktDataClient(RingBufferType& buffer,
-                             const std::string& disk_file)
+                             const std::string& disk_file,
+                             JoinPolicy join_policy)
     : buffer_(buffer),
       disk_file_(disk_file),
+      join_policy_(join_policy),
       running_(false),
       stop_requested_(false),
       sum_(0.0),
@@ -20,9 +27,12 @@ MktDataClient::MktDataClient(RingBufferType& buffer,
       processed_count_(0),
       state_(ClientState::NORMAL),
       in_recovery_(false),
+      consumer_parked_(false),
       fault_callback_(nullptr),
       auto_fault_detection_(true),
-      metrics_() {}
+      metrics_(),
+      recovery_threads_(
+          std::max(1u, std::thread::hardware_concurrency())) {}
 
 MktDataClient::~MktDataClient() { stop(); }
 
@@ -36,8 +46,11 @@ void MktDataClient::start() {
   stop_requested_ = false;
   running_ = true;
   state_ = ClientState::NORMAL;
+  join_start_ns_ = tscTimestampNs();
+  live_ = false;
 
-  LOG_INFO(replay::logger(), "MktDataClient start {}", "");
+  LOG_INFO(replay::logger(), "MktDataClient start: join={}",
+           toString(join_policy_));
   thread_ = std::thread(&MktDataClient::run, this);
 }
 
@@ -56,6 +69,8 @@ void MktDataClient::stop() {
            metrics_.seq_gap_count.load(std::memory_order_relaxed),
            metrics_.overwrite_count.load(std::memory_order_relaxed),
            metrics_.recovery_count.load(std::memory_order_relaxed));
+  LOG_INFO(replay::logger(), "MktDataClient consume latency ns: {}",
+           metrics_.consume_latency_ns.snapshot().summary());
 }
 
 void MktDataClient::waitForRecovery() {
@@ -86,6 +101,8 @@ ClientState MktDataClient::getState() const {
   return state_.load(std::memory_order_acquire);
 }
 
+JoinPolicy MktDataClient::getJoinPolicy() const { return join_policy_; }
+
 void MktDataClient::setFaultCallback(FaultCallback callback) {
   fault_callback_ = std::move(callback);
 }
@@ -98,39 +115,124 @@ const ClientMetrics& MktDataClient::getMetrics() const { return metrics_; }
 
 void MktDataClient::setCpuCore(int core_id) { cpu_core_ = core_id; }
 
+void MktDataClient::attachMetrics(MetricsRegistry& registry,
+                                  std::string_view prefix) {
+  std::string name(prefix);
+  registry.bind(processed_metric_, name + ".processed");
+  registry.bind(seq_metric_, name + ".seq");
+  registry.bind(batch_metric_, name + ".batch");
+  registry.bind(gap_metric_, name + ".gaps");
+  registry.bind(overwrite_metric_, name + ".overwrites");
+  registry.bind(recovery_metric_, name + ".recoveries");
+  registry.bind(time_to_live_metric_, name + ".time_to_live_ns");
+}
+
+void MktDataClient::setRecoveryThreads(size_t num_threads) {
+  recovery_threads_ = std::max<size_t>(1, num_threads);
+}
+
+void MktDataClient::setCheckpoint(const std::string& path, int64_t interval) {
+  checkpoint_path_ = path;
+  checkpoint_interval_ = std::max<int64_t>(1, interval);
+}
+
 // ---------------------------------------------------------------------------
 // Main consumer loop
 //
-// Uses readEx() to distinguish "not ready" from "overwritten". When an
-// overwrite is detected, the consumer knows it has been lapped by the producer
-// and triggers automatic recovery (if enabled), since the missing messages
-// can only be recovered from disk.
+// Drains every message already published (up to CONSUME_BATCH_SIZE) in one
+// readBatch() and processes them with a single compensated-sum kernel call.
+// When nothing is ready, readEx() distinguishes "not ready" from
+// "overwritten". When an overwrite is detected, the consumer knows it has
+// been lapped by the producer and triggers automatic recovery (if enabled),
+// since the missing messages can only be recovered from disk.
+//
+// Before the loop the client joins the stream according to join_policy_;
+// only a join position that is gone from the ring costs a disk catch-up.
 // ---------------------------------------------------------------------------
 void MktDataClient::run() {
   setCpuAffinity(cpu_core_, "MktDataClient");
 
   cursor_.reset(0);
+  bool parked = false;
+  next_checkpoint_count_ = checkpoint_interval_;
+
+  SeqNum join_seq = joinSeq();
+  if (isResidentInRing(join_seq)) {
+    cursor_.reset(join_seq);
+  } else {
+    in_recovery_.store(true, std::memory_order_release);
+    state_.store(ClientState::REPLAYING, std::memory_order_release);
+    catchUp(join_seq);
+    in_recovery_.store(false, std::memory_order_release);
+    state_.store(ClientState::NORMAL, std::memory_order_release);
+  }
+  LOG_INFO(replay::logger(), "MktDataClient joined: policy={}, seq={}",
+           toString(join_policy_), cursor_.getReadSeq());
+
+  ConsumerTable& consumers = buffer_.consumers();
+  consumer_id_ = consumers.registerConsumer("client", cursor_.getReadSeq(),
+                                            tscTimestampNs());
+  if (consumer_id_ < 0) {
+    LOG_WARNING(replay::logger(),
+                "MktDataClient: consumer table full, lag not tracked {}", "");
+  }
 
   while (!stop_requested_) {
+    // Parking handshake with waitForConsumerParked(): clear the flag before
+    // re-checking in_recovery_, so a fault raised concurrently either sees us
+    // parked or we see its in_recovery_ store (both are seq_cst).
+    if (parked) {
+      consumer_parked_.store(false);
+      parked = false;
+    }
     if (in_recovery_) {
       // Recovery mode: wait for recovery to complete
+      consumer_parked_.store(true);
+      parked = true;
+      consumers.heartbeat(consumer_id_, tscTimestampNs());
       std::this_thread::sleep_for(std::chrono::milliseconds(1));
       continue;
     }
 
     SeqNum seq = cursor_.getReadSeq();
+    size_t count = buffer_.readBatch(seq, read_batch_);
+    if (count > 0) {
+      std::span<const Msg> batch(read_batch_.data(), count);
+      // The batch is a copy: publish the cursor before processing it
+      int64_t now = recordConsumeLatency(batch);
+      consumers.publish(consumer_id_, seq + static_cast<SeqNum>(count), now);
+      processBatch(batch);
+      batch_metric_.set(static_cast<int64_t>(count));
+      cursor_.setReadSeq(seq + static_cast<SeqNum>(count));
+      if (!live_ &&
+          batch.back().seq_num >= buffer_.getLatestSeq() - CATCHUP_THRESHOLD) {
+        markLive();
+      }
+      maybeCheckpoint(batch.back());
+      continue;
+    }
+
     auto result = buffer_.readEx(seq);
 
     switch (result.status) {
-      case ReadStatus::OK:
+      case ReadStatus::OK: {
+        int64_t now =
+            recordConsumeLatency(std::span<const Msg>(&result.msg, 1));
         processMessage(result.msg);
+        batch_metric_.set(1);
         cursor_.advance();
+        consumers.publish(consumer_id_, seq + 1, now);
+        maybeCheckpoint(result.msg);
         break;
+      }
 
       case ReadStatus::OVERWRITTEN:
         // The producer has lapped us — we lost one or more messages.
         metrics_.overwrite_count.fetch_add(1, std::memory_order_relaxed);
         metrics_.seq_gap_count.fetch_add(1, std::memory_order_relaxed);
+        overwrite_metric_.add();
+        gap_metric_.add();
+        consumers.recordLapped(consumer_id_);
         LOG_WARNING(replay::logger(),
                     "Ring buffer overwrite detected at seq={}, triggering "
                     "recovery", seq);
@@ -150,11 +252,17 @@ void MktDataClient::run() {
 
       case ReadStatus::NOT_READY:
         // No new messages, wait briefly
+        if (!live_) {
+          markLive();
+        }
+        consumers.heartbeat(consumer_id_, tscTimestampNs());
         std::this_thread::yield();
         break;
     }
   }
 
+  consumers.unregisterConsumer(consumer_id_);
+  consumer_id_ = -1;
   running_ = false;
 }
 
@@ -174,6 +282,7 @@ void MktDataClient::processMessage(const Msg& msg) {
                 "Sequence monotonicity violation: prev={}, got={}", prev_seq,
                 msg.seq_num);
     metrics_.seq_gap_count.fetch_add(1, std::memory_order_relaxed);
+    gap_metric_.add();
     return;
   }
 
@@ -181,6 +290,7 @@ void MktDataClient::processMessage(const Msg& msg) {
   if (prev_seq != INVALID_SEQ && msg.seq_num != prev_seq + 1) {
     int64_t gap = msg.seq_num - prev_seq - 1;
     metrics_.seq_gap_count.fetch_add(gap, std::memory_order_relaxed);
+    gap_metric_.add(gap);
     LOG_WARNING(replay::logger(),
                 "Sequence gap detected: expected={}, got={}, gap={}",
                 prev_seq + 1, msg.seq_num, gap);
@@ -195,6 +305,73 @@ void MktDataClient::processMessage(const Msg& msg) {
 
   last_seq_.store(msg.seq_num, std::memory_order_release);
   processed_count_.fetch_add(1, std::memory_order_release);
+  processed_metric_.add();
+  seq_metric_.set(msg.seq_num);
+}
+
+// ---------------------------------------------------------------------------
+// Process a run of consecutive messages from readBatch().
+//
+// Within a run of consecutive seq_nums INV-C1 only needs checking at the
+// run boundary. The server publishes with pushBatch(), so a readBatch() run
+// is normally one such run; a ring fed by pushBatchKeepSeq() may skip or
+// repeat seq_nums, and is folded one consecutive run at a time. The payloads
+// are summed by the SIMD kernel and folded into the running Kahan sum with
+// one step, and the shared counters are published once per run instead of
+// once per message.
+// ---------------------------------------------------------------------------
+void MktDataClient::processBatch(std::span<const Msg> batch) {
+  size_t run = consecutiveRun(batch);
+  if (run < batch.size()) {
+    for (; !batch.empty(); batch = batch.subspan(run)) {
+      run = consecutiveRun(batch);
+      processBatch(batch.first(run));
+    }
+    return;
+  }
+
+  SeqNum prev_seq = last_seq_.load(std::memory_order_relaxed);
+  const Msg& first = batch.front();
+
+  if (prev_seq != INVALID_SEQ && first.seq_num <= prev_seq) {
+    // Overlaps what we already have: take the per-message path, which skips
+    // and counts the duplicates.
+    for (const Msg& msg : batch) {
+      processMessage(msg);
+    }
+    return;
+  }
+
+  if (prev_seq != INVALID_SEQ && first.seq_num != prev_seq + 1) {
+    int64_t gap = first.seq_num - prev_seq - 1;
+    metrics_.seq_gap_count.fetch_add(gap, std::memory_order_relaxed);
+    gap_metric_.add(gap);
+    LOG_WARNING(replay::logger(),
+                "Sequence gap detected: expected={}, got={}, gap={}",
+                prev_seq + 1, first.seq_num, gap);
+  }
+
+  double y = sumPayloads(batch) - kahan_c_;
+  double current_sum = sum_.load(std::memory_order_relaxed);
+  double t = current_sum + y;
+  kahan_c_ = (t - current_sum) - y;
+  sum_.store(t, std::memory_order_release);
+
+  last_seq_.store(batch.back().seq_num, std::memory_order_release);
+  processed_count_.fetch_add(static_cast<int64_t>(batch.size()),
+                             std::memory_order_release);
+  processed_metric_.add(static_cast<int64_t>(batch.size()));
+  seq_metric_.set(batch.back().seq_num);
+}
+
+// One clock read per batch; every message is charged from its producer
+// timestamp to that read, which is returned (it doubles as the heartbeat).
+int64_t MktDataClient::recordConsumeLatency(std::span<const Msg> batch) {
+  int64_t now = tscTimestampNs();
+  for (const Msg& msg : batch) {
+    metrics_.consume_latency_ns.record(now - msg.timestamp_ns);
+  }
+  return now;
 }
 
 void MktDataClient::onFault(FaultType type) {
@@ -202,6 +379,11 @@ void MktDataClient::onFault(FaultType type) {
     case FaultType::CLIENT_CRASH:
       LOG_WARNING(replay::logger(),
                   "Client fault: CLIENT_CRASH, starting recovery {}", "");
+      // Stop the consumer loop before touching its state, otherwise a message
+      // it is processing right now could land after the reset below.
+      in_recovery_.store(true);
+      waitForConsumerParked();
+
       // Simulate crash: reset accumulated value
       state_.store(ClientState::FAULTED, std::memory_order_release);
       sum_.store(0.0, std::memory_order_release);
@@ -232,24 +414,38 @@ void MktDataClient::onFault(FaultType type) {
 }
 
 // ---------------------------------------------------------------------------
-// Recovery procedure: replay from disk, then switch to live ring buffer.
+// Recovery procedure: serve from the ring buffer when possible, otherwise
+// replay the missing prefix from disk, then switch to the live ring buffer.
+//
+// Let resume_seq be the first sequence number the client still needs (0 after
+// a crash, since all state was reset).
+//
+//   Ring path: if resume_seq is resident in the ring with RING_RECOVERY_MARGIN
+//   of headroom, [resume_seq, head] can be read straight from memory. We just
+//   position the cursor at resume_seq and let the consumer loop replay it —
+//   the disk file is never opened.
+//
+//   Disk path: otherwise the prefix [resume_seq, oldest_resident) only exists
+//   on disk. We replay it sequentially and hand over to the ring as soon as
+//   the next sequence number is resident again (with the same margin), rather
+//   than reading the whole file up to the live head. A long prefix is first
+//   reduced on recovery_threads_ threads (ReplayEngine::parallelReduce); its
+//   exact sum does not depend on the split, and the tail that became
+//   non-resident meanwhile is then replayed sequentially.
 //
 // The key correctness argument for the replay→live handoff:
 //
-//   1. We replay all messages from disk sequentially (seq 0, 1, 2, ... N).
+//   1. We replay messages from disk sequentially (resume_seq, ..., N).
 //      Let last_replay_seq = N.
 //   2. We set cursor to last_replay_seq + 1 and begin reading from the ring
 //      buffer.
-//   3. The ring buffer is sized so that during the time we replay from disk,
-//      it retains messages from at least (live_seq - Capacity + 1) onward.
-//   4. The CATCHUP_THRESHOLD ensures we switch while last_replay_seq + 1 is
-//      still within the ring buffer window, i.e.,
-//          last_replay_seq + 1 >= live_seq - Capacity + 1
-//      which is guaranteed when CATCHUP_THRESHOLD << Capacity.
-//   5. Therefore no message is missed at the boundary (INV-C2).
+//   3. We only hand over once last_replay_seq + 1 >= oldest_resident +
+//      RING_RECOVERY_MARGIN (or we are within CATCHUP_THRESHOLD of the head),
+//      i.e. the boundary message is still in the ring window.
+//   4. Therefore no message is missed at the boundary (INV-C2).
 //
 // If the ring buffer has already overwritten past last_replay_seq + 1 by the
-// time we switch, we fall through and the main loop's OVERWRITTEN detection
+// time the consumer loop reads it, the main loop's OVERWRITTEN detection
 // will re-trigger recovery. This is safe but indicates the buffer is too small
 // for the workload — an operational alert should fire.
 // ---------------------------------------------------------------------------
@@ -257,42 +453,68 @@ void MktDataClient::startRecovery() {
   in_recovery_.store(true, std::memory_order_release);
   state_.store(ClientState::REPLAYING, std::memory_order_release);
   metrics_.recovery_count.fetch_add(1, std::memory_order_relaxed);
+  recovery_metric_.add();
+
+  // After a crash reset the client rejoins the stream like a fresh one
+  SeqNum last = last_seq_.load(std::memory_order_acquire);
+  SeqNum resume_seq = (last == INVALID_SEQ) ? joinSeq() : last + 1;
+
+  if (catchUp(resume_seq)) {
+    metrics_.ring_recovery_count.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    metrics_.disk_recovery_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  in_recovery_.store(false, std::memory_order_release);
+  state_.store(ClientState::NORMAL, std::memory_order_release);
+}
+
+// Bring the client from resume_seq up to the live ring (see startRecovery()).
+// Returns true if served from the ring alone, false if disk was involved.
+// The caller owns in_recovery_ and the state around the call.
+bool MktDataClient::catchUp(SeqNum resume_seq) {
+  if (isResidentInRing(resume_seq)) {
+    LOG_INFO(replay::logger(),
+             "Client recovery served from ring buffer: resume_seq={}, "
+             "oldest_resident={}",
+             resume_seq, buffer_.getOldestSeq());
+
+    state_.store(ClientState::CATCHING_UP, std::memory_order_release);
+    switchToLive(resume_seq);
+    return true;
+  }
 
-  LOG_INFO(replay::logger(), "Client recovery started, replaying from disk: {}",
-           disk_file_);
+  LOG_INFO(replay::logger(),
+           "Client recovery started, replaying prefix from disk: {}, "
+           "resume_seq={}, oldest_resident={}",
+           disk_file_, resume_seq, buffer_.getOldestSeq());
   ReplayEngine replay(disk_file_);
 
   if (!replay.open()) {
     LOG_ERROR(replay::logger(), "Failed to open replay file: {}", disk_file_);
     // Cannot open replay file, start directly from current position
-    in_recovery_.store(false, std::memory_order_release);
-    state_.store(ClientState::NORMAL, std::memory_order_release);
-    return;
+    return false;
   }
 
   SeqNum last_recovered_seq = INVALID_SEQ;
   bool switched_to_live = false;
+  bool disk_exhausted = false;
 
-  // Replay from the beginning
-  while (in_recovery_ && !stop_requested_) {
-    auto msg = replay.nextMessage();
-
-    if (!msg) {
-      // Replay complete — all recorded messages consumed
-      break;
-    }
-
-    processMessage(*msg);
-    last_recovered_seq = msg->seq_num;
+  // Skip what we already have. The file may skip seq_nums (a lapped
+  // recorder jumps ahead), so positions are looked up by seq.
+  if (resume_seq > 0 && !replay.seek(replay.positionOfSeq(resume_seq))) {
+    disk_exhausted = true;  // Nothing at or after resume_seq on disk
+  }
 
-    // Check if can switch to live source
+  // Hand over as soon as the rest is resident in the ring
+  auto tryHandover = [&](SeqNum replayed_seq) {
+    SeqNum boundary_seq = replayed_seq + 1;
     SeqNum live_seq = buffer_.getLatestSeq();
 
-    if (live_seq >= 0 && msg->seq_num >= live_seq - CATCHUP_THRESHOLD) {
+    if (isResidentInRing(boundary_seq) ||
+        (live_seq >= 0 && replayed_seq >= live_seq - CATCHUP_THRESHOLD)) {
       state_.store(ClientState::CATCHING_UP, std::memory_order_release);
 
-      SeqNum boundary_seq = msg->seq_num + 1;
-
       // INV-C2 verification: the next live message we will read must be
       // exactly boundary_seq. switchToLive positions the cursor there.
       switchToLive(boundary_seq);
@@ -301,9 +523,55 @@ void MktDataClient::startRecovery() {
       LOG_INFO(replay::logger(),
                "Replay-to-live boundary: last_replay_seq={}, "
                "first_live_seq={}, live_head={}",
-               msg->seq_num, boundary_seq, live_seq);
+               replayed_seq, boundary_seq, live_seq);
+    }
+  };
+
+  // Parallel reduction of the non-resident prefix
+  int64_t begin_pos = replay.getCurrentSeq();
+  int64_t end_pos =
+      replay.positionOfSeq(buffer_.getOldestSeq() + RING_RECOVERY_MARGIN);
+  if (!disk_exhausted && recovery_threads_ > 1 &&
+      end_pos - begin_pos >= PARALLEL_RECOVERY_MIN_MSGS) {
+    auto reduction = ReplayEngine::parallelReduce(
+        disk_file_, recovery_threads_, begin_pos, end_pos);
+
+    // Only usable if it is exactly what processMessage() would have accepted
+    SeqNum last = last_seq_.load(std::memory_order_relaxed);
+    if (reduction && reduction->msg_count == end_pos - begin_pos &&
+        reduction->seq_violation_count == 0 &&
+        (last == INVALID_SEQ || reduction->first_seq > last)) {
+      applyReduction(*reduction);
+      metrics_.parallel_recovery_count.fetch_add(1,
+                                                 std::memory_order_relaxed);
+      last_recovered_seq = reduction->last_seq;
+
+      LOG_INFO(replay::logger(),
+               "Disk prefix reduced on {} threads: messages={}, seq=[{}, {}]",
+               recovery_threads_, reduction->msg_count, reduction->first_seq,
+               reduction->last_seq);
+
+      tryHandover(last_recovered_seq);
+      if (!switched_to_live && !replay.seek(end_pos)) {
+        disk_exhausted = true;  // end_pos is past the last recorded message
+      }
+    }
+  }
+
+  while (!switched_to_live && !disk_exhausted && in_recovery_ &&
+         !stop_requested_) {
+    auto msg = replay.nextMessage();
+
+    if (!msg) {
+      // Replay complete — all recorded messages consumed
       break;
     }
+
+    processMessage(*msg);
+    metrics_.disk_replayed_count.fetch_add(1, std::memory_order_relaxed);
+    last_recovered_seq = msg->seq_num;
+
+    tryHandover(last_recovered_seq);
   }
 
   replay.close();
@@ -317,10 +585,171 @@ void MktDataClient::startRecovery() {
              last_recovered_seq + 1);
   }
 
-  in_recovery_.store(false, std::memory_order_release);
-  state_.store(ClientState::NORMAL, std::memory_order_release);
   LOG_INFO(replay::logger(), "Client recovery finished: last_seq={}",
            last_recovered_seq);
+  return false;
+}
+
+// ---------------------------------------------------------------------------
+// First sequence number a client without state needs, per join_policy_. For
+// CHECKPOINT_THEN_RING the checkpointed state is restored here as well.
+// ---------------------------------------------------------------------------
+SeqNum MktDataClient::joinSeq() {
+  switch (join_policy_) {
+    case JoinPolicy::HEAD:
+      return buffer_.getNextWriteSeq();
+
+    case JoinPolicy::OLDEST_RESIDENT: {
+      SeqNum next_write = buffer_.getNextWriteSeq();
+      if (next_write <= static_cast<SeqNum>(RingBufferType::capacity())) {
+        return 0;
+      }
+      return std::min(buffer_.getOldestSeq() + RING_RECOVERY_MARGIN,
+                      next_write);
+    }
+
+    case JoinPolicy::CHECKPOINT_THEN_RING: {
+      auto checkpoint = checkpoint_path_.empty()
+                            ? std::nullopt
+                            : loadCheckpoint(checkpoint_path_);
+      if (!checkpoint || !matchesStream(*checkpoint)) {
+        LOG_WARNING(replay::logger(),
+                    "No usable checkpoint at '{}', joining from seq 0",
+                    checkpoint_path_);
+        return 0;
+      }
+      sum_.store(checkpoint->sum, std::memory_order_release);
+      kahan_c_ = checkpoint->kahan_c;
+      last_seq_.store(checkpoint->last_seq, std::memory_order_release);
+      processed_count_.store(checkpoint->processed_count,
+                             std::memory_order_release);
+      seq_metric_.set(checkpoint->last_seq);
+      LOG_INFO(replay::logger(),
+               "Restored checkpoint: last_seq={}, processed={}",
+               checkpoint->last_seq, checkpoint->processed_count);
+      return checkpoint->last_seq + 1;
+    }
+
+    case JoinPolicy::DISK_THEN_RING:
+      break;
+  }
+  return 0;
+}
+
+// A checkpoint belongs to the current stream if the message at its last_seq
+// (in the ring, else in the disk file) carries the fingerprinted timestamp
+// and payload. Sequence numbers restart with every run, so a checkpoint from
+// an earlier run must not be restored on seq alone.
+bool MktDataClient::matchesStream(const ClientCheckpoint& checkpoint) const {
+  auto matches = [&](const Msg& msg) {
+    return msg.seq_num == checkpoint.last_seq &&
+           msg.timestamp_ns == checkpoint.last_timestamp_ns &&
+           msg.payload == checkpoint.last_payload;
+  };
+
+  auto result = buffer_.readEx(checkpoint.last_seq);
+  if (result.status == ReadStatus::OK) {
+    return matches(result.msg);
+  }
+  if (result.status == ReadStatus::NOT_READY) {
+    return false;  // Ahead of this stream
+  }
+
+  FileChannel file(disk_file_);
+  if (!file.open() || !file.seek(file.positionOfSeq(checkpoint.last_seq))) {
+    return false;
+  }
+  auto msg = file.readNext();
+  return msg && matches(*msg);
+}
+
+// Consumer thread, after last has been folded into the state
+void MktDataClient::maybeCheckpoint(const Msg& last) {
+  if (checkpoint_path_.empty() ||
+      processed_count_.load(std::memory_order_relaxed) <
+          next_checkpoint_count_) {
+    return;
+  }
+
+  ClientCheckpoint checkpoint;
+  checkpoint.last_seq = last.seq_num;
+  checkpoint.processed_count = processed_count_.load(std::memory_order_relaxed);
+  checkpoint.sum = sum_.load(std::memory_order_relaxed);
+  checkpoint.kahan_c = kahan_c_;
+  checkpoint.last_timestamp_ns = last.timestamp_ns;
+  checkpoint.last_payload = last.payload;
+
+  if (saveCheckpoint(checkpoint_path_, checkpoint)) {
+    metrics_.checkpoint_count.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    LOG_WARNING(replay::logger(), "Checkpoint write to {} failed",
+                checkpoint_path_);
+  }
+  next_checkpoint_count_ = checkpoint.processed_count + checkpoint_interval_;
+}
+
+// First time the consumer is within CATCHUP_THRESHOLD of the producer
+void MktDataClient::markLive() {
+  live_ = true;
+  int64_t elapsed_ns = tscTimestampNs() - join_start_ns_;
+  metrics_.time_to_live_ns.store(elapsed_ns, std::memory_order_relaxed);
+  time_to_live_metric_.set(elapsed_ns);
+  LOG_INFO(replay::logger(),
+           "MktDataClient live: join={}, time_to_live_us={}, seq={}",
+           toString(join_policy_), elapsed_ns / 1000, cursor_.getReadSeq());
+}
+
+// Fold a disk range reduction into the client state, with the same effect as
+// calling processMessage() on each message of the range.
+void MktDataClient::applyReduction(const ReplayReduction& reduction) {
+  SeqNum prev_seq = last_seq_.load(std::memory_order_relaxed);
+  int64_t gaps = reduction.seq_gap_count;
+  if (prev_seq != INVALID_SEQ && reduction.first_seq != prev_seq + 1) {
+    gaps += reduction.first_seq - prev_seq - 1;
+  }
+  metrics_.seq_gap_count.fetch_add(gaps, std::memory_order_relaxed);
+  gap_metric_.add(gaps);
+
+  // One Kahan step with the exactly rounded range sum
+  double y = reduction.sum.value() - kahan_c_;
+  double current_sum = sum_.load(std::memory_order_relaxed);
+  double t = current_sum + y;
+  kahan_c_ = (t - current_sum) - y;
+  sum_.store(t, std::memory_order_release);
+
+  last_seq_.store(reduction.last_seq, std::memory_order_release);
+  processed_count_.fetch_add(reduction.msg_count, std::memory_order_release);
+  processed_metric_.add(reduction.msg_count);
+  seq_metric_.set(reduction.last_seq);
+  metrics_.disk_replayed_count.fetch_add(reduction.msg_count,
+                                         std::memory_order_relaxed);
+}
+
+// A sequence number is safe to resume from in memory if it has been published
+// (or is the next one to be published) and sits at least RING_RECOVERY_MARGIN
+// above the oldest resident slot. Before the first wrap the whole history is
+// resident, so no margin is required.
+bool MktDataClient::isResidentInRing(SeqNum seq) const {
+  SeqNum next_write = buffer_.getNextWriteSeq();
+  if (seq < 0 || seq > next_write) {
+    return false;
+  }
+  if (next_write <= static_cast<SeqNum>(RingBufferType::capacity())) {
+    return true;
+  }
+  return seq >= buffer_.getOldestSeq() + RING_RECOVERY_MARGIN;
+}
+
+// Block until the consumer loop has observed in_recovery_ and is idle. Called
+// from fault injection on a foreign thread; a no-op on the consumer thread
+// itself (auto-detected faults) or when the loop is not running.
+void MktDataClient::waitForConsumerParked() {
+  if (!thread_.joinable() || std::this_thread::get_id() == thread_.get_id()) {
+    return;
+  }
+  while (!consumer_parked_.load() && running_ && !stop_requested_) {
+    std::this_thread::yield();
+  }
 }
 
 // ---------------------------------------------------------------------------
@@ -336,9 +765,7 @@ void MktDataClient::switchToLive(SeqNum expected_seq) {
 
   // Verify the target position is still within the ring buffer window
   SeqNum latest = buffer_.getLatestSeq();
-  SeqNum oldest_available =
-      std::max(SeqNum(0),
-               latest - static_cast<SeqNum>(RingBufferType::capacity()) + 1);
+  SeqNum oldest_available = buffer_.getOldestSeq();
 
   if (expected_seq < oldest_available) {
     LOG_WARNING(replay::logger(),
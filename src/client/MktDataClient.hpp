@@ -1,20 +1,27 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <functional>
 #include <mutex>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
 
+#include "common/Checkpoint.hpp"
 #include "common/CpuAffinity.hpp"
+#include "common/LatencyHistogram.hpp"
 #include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
 #include "common/RingBuffer.hpp"
 #include "common/Types.hpp"
 
 namespace replay {
 
-// Forward declaration
+// Forward declarations
 class ReplayEngine;
+struct ReplayReduction;
 
 // Observability metrics for the client — all atomics for thread-safe reads
 struct ClientMetrics {
@@ -22,6 +29,16 @@ struct ClientMetrics {
   std::atomic<int64_t> overwrite_count{0};     // Ring buffer overwrites detected
   std::atomic<int64_t> recovery_count{0};      // Number of recovery cycles
   std::atomic<int64_t> auto_fault_count{0};    // Auto-detected faults
+  std::atomic<int64_t> ring_recovery_count{0}; // Recoveries served from the ring only
+  std::atomic<int64_t> disk_recovery_count{0}; // Recoveries that had to read disk
+  std::atomic<int64_t> disk_replayed_count{0}; // Messages replayed from disk
+  std::atomic<int64_t> parallel_recovery_count{0}; // Disk prefixes reduced in parallel
+  std::atomic<int64_t> checkpoint_count{0};    // Checkpoints written
+  std::atomic<int64_t> time_to_live_ns{-1};    // start() -> caught up with the producer
+
+  // Producer timestamp -> consumed from the ring (written by the consumer
+  // thread only; snapshot() from anywhere)
+  LatencyHistogram consume_latency_ns;
 };
 
 // Market data client
@@ -35,12 +52,45 @@ struct ClientMetrics {
 //           (no gap, no overlap at the boundary).
 //   INV-C3: After successful recovery, the accumulated sum equals what a
 //           fault-free client would have computed.
+//
+// Recovery source selection: if the resume position is still resident in the
+// ring buffer (with RING_RECOVERY_MARGIN of headroom against being lapped),
+// recovery is served from memory and the disk file is never opened. Otherwise
+// only the missing prefix is replayed from disk, and the client hands over to
+// the ring as soon as the next sequence number is resident again.
+//
+// Join policy: a client without state of its own (at start, and again after a
+// crash reset) joins the stream according to the JoinPolicy it was built
+// with, so a client started after the first wrap does not hit OVERWRITTEN
+// and fall into a full recovery:
+//   HEAD                  next message published; the history is skipped
+//   OLDEST_RESIDENT       oldest message safely in the ring (with
+//                         RING_RECOVERY_MARGIN), everything before is skipped
+//   DISK_THEN_RING        the full history: disk prefix, then the ring
+//   CHECKPOINT_THEN_RING  restore the checkpoint set with setCheckpoint() and
+//                         catch up from there (ring, or disk then ring);
+//                         without a usable checkpoint like DISK_THEN_RING
+// The first two give up completeness of the sum for an immediate join.
+// metrics.time_to_live_ns measures each policy from start() to the first
+// time the client is within CATCHUP_THRESHOLD of the producer.
 class MktDataClient {
  public:
   using RingBufferType = RingBuffer<DEFAULT_RING_BUFFER_SIZE>;
   using FaultCallback = std::function<void()>;
 
-  MktDataClient(RingBufferType& buffer, const std::string& disk_file);
+  // Headroom required above the oldest resident seq before recovery trusts
+  // the ring: the producer keeps advancing while the client catches up.
+  static constexpr SeqNum RING_RECOVERY_MARGIN =
+      static_cast<SeqNum>(RingBufferType::capacity() / 16);
+
+  // Disk prefixes at least this long are reduced on recovery_threads_ threads
+  static constexpr int64_t PARALLEL_RECOVERY_MIN_MSGS = 64 * 1024;
+
+  // Default messages between two checkpoints (see setCheckpoint())
+  static constexpr int64_t DEFAULT_CHECKPOINT_INTERVAL = 1 << 20;
+
+  MktDataClient(RingBufferType& buffer, const std::string& disk_file,
+                JoinPolicy join_policy = JoinPolicy::DISK_THEN_RING);
   ~MktDataClient();
 
   // Disable copy and move
@@ -79,6 +129,8 @@ class MktDataClient {
   // Get current state
   ClientState getState() const;
 
+  JoinPolicy getJoinPolicy() const;
+
   // Set fault callback
   void setFaultCallback(FaultCallback callback);
 
@@ -88,34 +140,69 @@ class MktDataClient {
   // Set CPU core for this thread (call before start())
   void setCpuCore(int core_id);
 
+  // Threads used to reduce a long disk prefix during recovery (default:
+  // hardware concurrency). 1 replays the prefix message by message.
+  void setRecoveryThreads(size_t num_threads);
+
+  // Write the client state to path every interval processed messages (at a
+  // batch boundary); CHECKPOINT_THEN_RING also joins from it. Call before
+  // start().
+  void setCheckpoint(const std::string& path,
+                     int64_t interval = DEFAULT_CHECKPOINT_INTERVAL);
+
   // Access observability metrics (thread-safe reads)
   const ClientMetrics& getMetrics() const;
 
+  // Publish <prefix>.processed, .seq, .batch, .gaps, .overwrites,
+  // .recoveries and .time_to_live_ns into a metrics registry (call before
+  // start())
+  void attachMetrics(MetricsRegistry& registry,
+                     std::string_view prefix = "client");
+
  private:
   void run();
   void processMessage(const Msg& msg);
+  void processBatch(std::span<const Msg> batch);
+  int64_t recordConsumeLatency(std::span<const Msg> batch);
   void onFault(FaultType type);
   void startRecovery();
+  bool catchUp(SeqNum resume_seq);
+  SeqNum joinSeq();
+  bool matchesStream(const ClientCheckpoint& checkpoint) const;
+  void maybeCheckpoint(const Msg& last);
+  void markLive();
+  bool isResidentInRing(SeqNum seq) const;
+  void applyReduction(const ReplayReduction& reduction);
+  void waitForConsumerParked();
   void switchToLive(SeqNum expected_seq);
 
   RingBufferType& buffer_;
   std::string disk_file_;
+  JoinPolicy join_policy_;
 
   std::thread thread_;
   std::atomic<bool> running_;
   std::atomic<bool> stop_requested_;
 
+  // Consumer state written per batch. It starts a cache line of its own:
+  // the flags above are written by other threads and polled by the consumer,
+  // and would otherwise share a line with it.
   // Kahan summation algorithm variables (improve floating point precision)
-  std::atomic<double> sum_;
+  alignas(CACHE_LINE_SIZE) std::atomic<double> sum_;
   double kahan_c_;  // Compensation value
 
   std::atomic<SeqNum> last_seq_;
   std::atomic<int64_t> processed_count_;
-  std::atomic<ClientState> state_;
+  alignas(CACHE_LINE_SIZE) std::atomic<ClientState> state_;
   std::atomic<bool> in_recovery_;
+  std::atomic<bool> consumer_parked_;  // Consumer loop is idle in recovery
 
   std::mutex switch_mutex_;
   ConsumerCursor cursor_;
+  int consumer_id_ = -1;  // Slot in buffer_.consumers() while running
+  int64_t join_start_ns_ = 0;  // start() time, for time_to_live_ns
+  bool live_ = false;          // Caught up with the producer since start()
+  std::array<Msg, CONSUME_BATCH_SIZE> read_batch_;
 
   FaultCallback fault_callback_;
 
@@ -125,7 +212,23 @@ class MktDataClient {
   // Observability
   ClientMetrics metrics_;
 
+  // Published metrics (see attachMetrics()). Written by the consumer thread,
+  // or by the recovering thread while the consumer is parked.
+  Counter processed_metric_;
+  Gauge seq_metric_;
+  Gauge batch_metric_;
+  Counter gap_metric_;
+  Counter overwrite_metric_;
+  Counter recovery_metric_;
+  Gauge time_to_live_metric_;
+
+  // Checkpointing (consumer thread), see setCheckpoint()
+  std::string checkpoint_path_;
+  int64_t checkpoint_interval_ = DEFAULT_CHECKPOINT_INTERVAL;
+  int64_t next_checkpoint_count_ = 0;
+
   int cpu_core_ = CPU_CORE_UNSET;
+  size_t recovery_threads_;
 };
 
 }  // namespace replay
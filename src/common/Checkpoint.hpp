@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+
+#include "Types.hpp"
+
+namespace replay {
+
+// File tag ("RPCKPT01")
+constexpr uint64_t CHECKPOINT_MAGIC = 0x5250434B50543031ull;
+
+// Consumer state as of one sequence number, so that a (re)joining consumer
+// can restore it and only catch up on what came after instead of replaying
+// the whole stream.
+//
+// The payload and timestamp of the last consumed message are kept as a
+// fingerprint: sequence numbers restart with every run, and a checkpoint is
+// only usable if the message at last_seq in the current stream is the same
+// one (see MktDataClient, JoinPolicy::CHECKPOINT_THEN_RING).
+struct alignas(8) ClientCheckpoint {
+  uint64_t magic = CHECKPOINT_MAGIC;
+  SeqNum last_seq = INVALID_SEQ;  // Last message folded into the state
+  int64_t processed_count = 0;
+  double sum = 0.0;
+  double kahan_c = 0.0;  // Kahan compensation at last_seq
+  int64_t last_timestamp_ns = 0;  // Fingerprint of the message at last_seq
+  double last_payload = 0.0;
+
+  [[nodiscard]] bool isValid() const {
+    return magic == CHECKPOINT_MAGIC && last_seq >= 0 && processed_count > 0;
+  }
+};
+
+static_assert(sizeof(ClientCheckpoint) == 56);
+
+// Write checkpoint to path. The file is replaced atomically (write to a
+// temporary next to it, then rename), so a reader never sees a torn one.
+inline bool saveCheckpoint(const std::string& path,
+                           const ClientCheckpoint& checkpoint) {
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&checkpoint), sizeof(checkpoint));
+    if (!out.good()) {
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  return !ec;
+}
+
+// Read the checkpoint at path; nullopt if missing or not a valid checkpoint
+inline std::optional<ClientCheckpoint> loadCheckpoint(
+    const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  ClientCheckpoint checkpoint;
+  if (!in.read(reinterpret_cast<char*>(&checkpoint), sizeof(checkpoint)) ||
+      !checkpoint.isValid()) {
+    return std::nullopt;
+  }
+  return checkpoint;
+}
+
+}  // namespace replay
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "TscClock.hpp"
+#include "Types.hpp"
+
+namespace replay {
+
+// Consumers one ring can track
+constexpr size_t MAX_CONSUMERS = 16;
+
+// Longest consumer name (including the terminator)
+constexpr size_t CONSUMER_NAME_SIZE = 24;
+
+// A consumer without a heartbeat for this long is not live: it no longer
+// holds back the slowest-consumer watermark and its slot may be taken over
+constexpr int64_t CONSUMER_STALE_NS = 1000000000;  // 1 s
+
+// Overwrites the producer lets pass between table scans while a consumer is
+// being lapped (bounds the producer's cost during a lap)
+constexpr SeqNum LAP_RESCAN_INTERVAL = 256;
+
+// One consumer per cache line. Apart from registration, only the consumer
+// writes its slot; the producer and monitors only read it.
+struct alignas(CACHE_LINE_SIZE) ConsumerSlot {
+  static constexpr uint32_t FREE = 0;
+  static constexpr uint32_t CLAIMED = 1;  // Being (re)registered
+  static constexpr uint32_t ACTIVE = 2;
+
+  std::atomic<uint32_t> state;
+  std::atomic<int32_t> pid;           // Owning process
+  std::atomic<SeqNum> cursor;         // Next seq the consumer will read
+  std::atomic<int64_t> heartbeat_ns;  // Last publish, tscTimestampNs()
+  std::atomic<int64_t> lapped_count;  // Times its next message was gone
+  char name[CONSUMER_NAME_SIZE];
+};
+
+static_assert(sizeof(ConsumerSlot) == CACHE_LINE_SIZE,
+              "ConsumerSlot must be one cache line");
+
+// Point-in-time view of one registered consumer
+struct ConsumerInfo {
+  int id;
+  std::string name;
+  int32_t pid;
+  SeqNum cursor;
+  int64_t heartbeat_ns;
+  int64_t lapped_count;
+  bool live;  // Heartbeat within CONSUMER_STALE_NS
+};
+
+// Fixed-size table of a ring's consumers, embedded in the ring (in-process
+// RingBuffer and the ipc SharedRingBuffer alike).
+//
+// Each consumer registers once, then publishes its cursor and a heartbeat
+// with two relaxed stores to its own cache line. The producer reads the table
+// only to refresh its slowest-consumer watermark (see LapTracker); monitors
+// take snapshots to compute per-consumer lag (write position - cursor).
+// Only atomics and plain bytes: the all-zero state is an empty table, so the
+// table can live in zero-filled shared memory without construction.
+struct ConsumerTable {
+  ConsumerSlot slots[MAX_CONSUMERS];
+
+  // Claim a slot with its cursor at start_seq. A never-used slot is
+  // preferred, then a free one (dropping the cursor a departed consumer left
+  // there); otherwise the slot of a consumer that has been silent for
+  // stale_ns is taken over (a consumer that stalls that long must
+  // re-register). Returns the consumer id, or -1 when every slot belongs to
+  // a live consumer or the name is too long.
+  int registerConsumer(std::string_view name, SeqNum start_seq, int64_t now_ns,
+                       int64_t stale_ns = CONSUMER_STALE_NS) {
+    if (name.size() >= CONSUMER_NAME_SIZE) {
+      return -1;
+    }
+    for (int pass = 0; pass < 3; ++pass) {
+      for (size_t i = 0; i < MAX_CONSUMERS; ++i) {
+        ConsumerSlot& slot = slots[i];
+        uint32_t expected = ConsumerSlot::FREE;
+        if (pass == 0 && slot.name[0] != '\0') {
+          continue;
+        }
+        if (pass == 2) {
+          // Last pass: take over stale slots
+          if (now_ns - slot.heartbeat_ns.load(std::memory_order_relaxed) <=
+              stale_ns) {
+            continue;
+          }
+          expected = ConsumerSlot::ACTIVE;
+        }
+        if (slot.state.compare_exchange_strong(expected,
+                                               ConsumerSlot::CLAIMED,
+                                               std::memory_order_acquire)) {
+          std::memset(slot.name, 0, CONSUMER_NAME_SIZE);
+          std::memcpy(slot.name, name.data(), name.size());
+          slot.cursor.store(start_seq, std::memory_order_relaxed);
+          slot.lapped_count.store(0, std::memory_order_relaxed);
+          activate(slot, now_ns);
+          return static_cast<int>(i);
+        }
+      }
+    }
+    return -1;
+  }
+
+  // Reclaim the slot a previous consumer called name left behind (unregistered
+  // or stale) and continue from its cursor, which is stored in cursor. This is
+  // how consumers of a persistent ring resume after a restart. Without such a
+  // slot it registers afresh at start_seq.
+  int resumeConsumer(std::string_view name, SeqNum start_seq, int64_t now_ns,
+                     SeqNum& cursor, int64_t stale_ns = CONSUMER_STALE_NS) {
+    for (size_t i = 0; i < MAX_CONSUMERS && name.size() < CONSUMER_NAME_SIZE;
+         ++i) {
+      ConsumerSlot& slot = slots[i];
+      if (strnlen(slot.name, CONSUMER_NAME_SIZE) != name.size() ||
+          std::memcmp(slot.name, name.data(), name.size()) != 0) {
+        continue;
+      }
+      uint32_t expected = slot.state.load(std::memory_order_acquire);
+      bool stale =
+          now_ns - slot.heartbeat_ns.load(std::memory_order_relaxed) >
+          stale_ns;
+      if ((expected == ConsumerSlot::FREE ||
+           (expected == ConsumerSlot::ACTIVE && stale)) &&
+          slot.state.compare_exchange_strong(expected, ConsumerSlot::CLAIMED,
+                                             std::memory_order_acquire)) {
+        cursor = slot.cursor.load(std::memory_order_relaxed);
+        activate(slot, now_ns);
+        return static_cast<int>(i);
+      }
+    }
+    cursor = start_seq;
+    return registerConsumer(name, start_seq, now_ns, stale_ns);
+  }
+
+  // Back to the all-zero (empty) state, forgetting departed consumers'
+  // cursors too. Only while no consumer is attached.
+  void clear() {
+    for (ConsumerSlot& slot : slots) {
+      slot.state.store(ConsumerSlot::FREE, std::memory_order_relaxed);
+      slot.pid.store(0, std::memory_order_relaxed);
+      slot.cursor.store(0, std::memory_order_relaxed);
+      slot.heartbeat_ns.store(0, std::memory_order_relaxed);
+      slot.lapped_count.store(0, std::memory_order_relaxed);
+      std::memset(slot.name, 0, CONSUMER_NAME_SIZE);
+    }
+  }
+
+  // The slot keeps its name and cursor for resumeConsumer()
+  void unregisterConsumer(int id) {
+    if (id >= 0) {
+      slots[id].state.store(ConsumerSlot::FREE, std::memory_order_release);
+    }
+  }
+
+  // Consumer only: cursor is the next sequence number it will read
+  void publish(int id, SeqNum cursor, int64_t now_ns) {
+    if (id >= 0) {
+      slots[id].cursor.store(cursor, std::memory_order_release);
+      slots[id].heartbeat_ns.store(now_ns, std::memory_order_relaxed);
+    }
+  }
+
+  // Consumer only: alive but idle
+  void heartbeat(int id, int64_t now_ns) {
+    if (id >= 0) {
+      slots[id].heartbeat_ns.store(now_ns, std::memory_order_relaxed);
+    }
+  }
+
+  // Consumer only: found its next message overwritten
+  void recordLapped(int id) {
+    if (id >= 0) {
+      auto& count = slots[id].lapped_count;
+      count.store(count.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+    }
+  }
+
+  // Smallest cursor of the live consumers (the slowest-consumer watermark);
+  // every message below it has been read by all of them. max() when no
+  // consumer is live.
+  SeqNum minLiveCursor(int64_t now_ns,
+                       int64_t stale_ns = CONSUMER_STALE_NS) const {
+    SeqNum watermark = std::numeric_limits<SeqNum>::max();
+    for (const ConsumerSlot& slot : slots) {
+      if (slot.state.load(std::memory_order_acquire) != ConsumerSlot::ACTIVE ||
+          now_ns - slot.heartbeat_ns.load(std::memory_order_relaxed) >
+              stale_ns) {
+        continue;
+      }
+      watermark =
+          std::min(watermark, slot.cursor.load(std::memory_order_acquire));
+    }
+    return watermark;
+  }
+
+  // Registered consumers into out (cleared first)
+  void snapshot(std::vector<ConsumerInfo>& out, int64_t now_ns,
+                int64_t stale_ns = CONSUMER_STALE_NS) const {
+    out.clear();
+    for (size_t i = 0; i < MAX_CONSUMERS; ++i) {
+      const ConsumerSlot& slot = slots[i];
+      if (slot.state.load(std::memory_order_acquire) != ConsumerSlot::ACTIVE) {
+        continue;
+      }
+      int64_t heartbeat = slot.heartbeat_ns.load(std::memory_order_relaxed);
+      out.push_back({static_cast<int>(i),
+                     std::string(slot.name,
+                                 strnlen(slot.name, CONSUMER_NAME_SIZE)),
+                     slot.pid.load(std::memory_order_relaxed),
+                     slot.cursor.load(std::memory_order_acquire), heartbeat,
+                     slot.lapped_count.load(std::memory_order_relaxed),
+                     now_ns - heartbeat <= stale_ns});
+    }
+  }
+
+  // Free the slots of consumers whose process no longer exists (crashed ipc
+  // clients). Returns how many were released.
+  size_t reapDeadProcesses() {
+    size_t reaped = 0;
+    for (ConsumerSlot& slot : slots) {
+      if (slot.state.load(std::memory_order_acquire) != ConsumerSlot::ACTIVE) {
+        continue;
+      }
+      pid_t pid = slot.pid.load(std::memory_order_relaxed);
+      if (pid > 0 && kill(pid, 0) == -1 && errno == ESRCH) {
+        uint32_t expected = ConsumerSlot::ACTIVE;
+        if (slot.state.compare_exchange_strong(expected, ConsumerSlot::FREE)) {
+          ++reaped;
+        }
+      }
+    }
+    return reaped;
+  }
+
+ private:
+  static void activate(ConsumerSlot& slot, int64_t now_ns) {
+    slot.pid.store(static_cast<int32_t>(getpid()), std::memory_order_relaxed);
+    slot.heartbeat_ns.store(now_ns, std::memory_order_relaxed);
+    slot.state.store(ConsumerSlot::ACTIVE, std::memory_order_release);
+  }
+};
+
+// Producer-side detection of messages overwritten before a live consumer
+// read them ("true" laps, as opposed to every slot reuse after the first
+// wrap).
+//
+// The producer remembers a watermark below which every live consumer has
+// read, so the common case is one comparison per overwrite. Only an
+// overwrite at or past the watermark rescans the table (with consumers
+// keeping up, about once per ring capacity). Every overwritten
+// sequence number at or above the fresh watermark was unread by the slowest
+// live consumer and is counted as lapped. While a consumer is being lapped
+// the table is rescanned every LAP_RESCAN_INTERVAL overwrites, so messages it
+// skips over between scans go uncounted. The count is approximate in the
+// other direction only by the window between a consumer copying a batch out
+// and publishing its cursor, which consumers keep to a few instructions.
+//
+// Single producer only; getLappedCount() may be read from any thread. All
+// fields are atomics with an all-zero initial state (shared-memory safe).
+class LapTracker {
+ public:
+  // The producer has overwritten every sequence number up to and including
+  // last_overwritten
+  void onOverwrite(const ConsumerTable& table, SeqNum last_overwritten) {
+    if (last_overwritten < next_check_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    SeqNum watermark = table.minLiveCursor(tscTimestampNs());
+    SeqNum checked = checked_.load(std::memory_order_relaxed);
+    SeqNum from = std::max(checked, watermark);
+    if (last_overwritten >= from) {
+      lapped_.store(lapped_.load(std::memory_order_relaxed) +
+                        (last_overwritten - from + 1),
+                    std::memory_order_relaxed);
+    }
+    checked_.store(last_overwritten + 1, std::memory_order_relaxed);
+    // Nothing can be lapped before the watermark is reached. Without live
+    // consumers keep rescanning now and then to notice new registrations.
+    bool none_live = watermark == std::numeric_limits<SeqNum>::max();
+    next_check_.store(watermark > last_overwritten && !none_live
+                          ? watermark
+                          : last_overwritten + LAP_RESCAN_INTERVAL,
+                      std::memory_order_relaxed);
+  }
+
+  int64_t getLappedCount() const {
+    return lapped_.load(std::memory_order_relaxed);
+  }
+
+  // Producer only: start over for a sequence space beginning at 0
+  void reset() {
+    next_check_.store(0, std::memory_order_relaxed);
+    checked_.store(0, std::memory_order_relaxed);
+    lapped_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<SeqNum> next_check_{0};  // Overwrites below this are safe
+  std::atomic<SeqNum> checked_{0};     // Overwrites below this are counted
+  std::atomic<int64_t> lapped_{0};
+};
+
+}  // namespace replay
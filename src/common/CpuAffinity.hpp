@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sched.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 #include <cerrno>
@@ -54,4 +55,23 @@ inline bool setCpuAffinity(int core_id,
   return true;
 }
 
+/// Set the nice value of the **calling** thread (Linux threads have their
+/// own nice value; setpriority(2) with the thread id targets just this one).
+/// Used to keep background work out of the way of the latency-critical
+/// threads when they share cores.
+///
+/// @param nice  Nice value, -20 (highest priority) to 19 (lowest).
+/// @param name  Optional descriptive name used in log messages.
+/// @return true on success, false on failure.
+inline bool setThreadNice(int nice, const std::string& name = "thread") {
+  if (setpriority(PRIO_PROCESS, static_cast<id_t>(gettid()), nice) != 0) {
+    LOG_WARNING(replay::logger(), "setpriority failed for {} (nice {}): {}",
+                name, nice, strerror(errno));
+    return false;
+  }
+  LOG_INFO(replay::logger(), "Thread priority set: {}  ->  nice {}", name,
+           nice);
+  return true;
+}
+
 }  // namespace replay
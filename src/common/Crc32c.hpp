@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define REPLAY_CRC_X86 1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define REPLAY_CRC_ARM 1
+#endif
+
+namespace replay {
+
+// CRC32C (Castagnoli), the checksum of v3 column blocks.
+//
+// x86 uses the SSE4.2 crc32 instruction, picked at runtime. The instruction
+// has a latency of 3 cycles but issues every cycle, so long inputs are cut
+// into stripes of three independent lanes whose CRCs are merged by
+// multiplying by x^(8 * lane bytes) mod P: that runs at memory bandwidth
+// rather than at a third of it. ARMv8 builds with the CRC extension use
+// __crc32cd; everything else a slicing-by-8 table.
+//
+// crc32c(data, n, crc) continues crc (the result for the preceding bytes),
+// so crc32c(b, nb, crc32c(a, na)) is the CRC of a followed by b.
+enum class CrcKernel : uint8_t {
+  TABLE = 0,
+  HARDWARE = 1,
+};
+
+inline const char* crcKernelName(CrcKernel kernel) {
+  return kernel == CrcKernel::HARDWARE ? "hardware" : "table";
+}
+
+namespace detail {
+
+constexpr uint32_t CRC32C_POLY = 0x82F63B78;  // Reflected
+
+// Slicing-by-8 tables: kCrcTable[k][b] is the CRC of byte b followed by k
+// zero bytes
+constexpr std::array<std::array<uint32_t, 256>, 8> makeCrcTables() {
+  std::array<std::array<uint32_t, 256>, 8> tables{};
+  for (uint32_t b = 0; b < 256; ++b) {
+    uint32_t crc = b;
+    for (int i = 0; i < 8; ++i) {
+      crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+    }
+    tables[0][b] = crc;
+  }
+  for (uint32_t b = 0; b < 256; ++b) {
+    for (size_t k = 1; k < 8; ++k) {
+      uint32_t prev = tables[k - 1][b];
+      tables[k][b] = (prev >> 8) ^ tables[0][prev & 0xFF];
+    }
+  }
+  return tables;
+}
+
+inline constexpr auto kCrcTable = makeCrcTables();
+
+// Raw register update (no pre/post inversion)
+inline uint32_t crcUpdateTable(uint32_t crc, const uint8_t* p, size_t n) {
+  while (n >= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));  // Little endian assumed
+    word ^= crc;
+    crc = kCrcTable[7][word & 0xFF] ^ kCrcTable[6][(word >> 8) & 0xFF] ^
+          kCrcTable[5][(word >> 16) & 0xFF] ^
+          kCrcTable[4][(word >> 24) & 0xFF] ^
+          kCrcTable[3][(word >> 32) & 0xFF] ^
+          kCrcTable[2][(word >> 40) & 0xFF] ^
+          kCrcTable[1][(word >> 48) & 0xFF] ^ kCrcTable[0][word >> 56];
+    p += 8;
+    n -= 8;
+  }
+  while (n-- > 0) {
+    crc = (crc >> 8) ^ kCrcTable[0][(crc ^ *p++) & 0xFF];
+  }
+  return crc;
+}
+
+// a * b mod P on reflected polynomials
+inline uint32_t crcMultiply(uint32_t a, uint32_t b) {
+  uint32_t product = 0;
+  for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+    if (a & m) {
+      product ^= b;
+    }
+    b = (b >> 1) ^ ((b & 1) ? CRC32C_POLY : 0);
+  }
+  return product;
+}
+
+// x^(8 * bytes) mod P: multiplying a register by it appends that many zero
+// bytes
+inline uint32_t crcShiftOperator(size_t bytes) {
+  uint32_t result = 1u << 31;  // x^0
+  uint32_t square = 1u << 23;  // x^8
+  for (; bytes != 0; bytes >>= 1) {
+    if (bytes & 1) {
+      result = crcMultiply(result, square);
+    }
+    square = crcMultiply(square, square);
+  }
+  return result;
+}
+
+#ifdef REPLAY_CRC_X86
+
+// Bytes per lane of a three-lane stripe
+constexpr size_t CRC_LANE_BYTES = 4096;
+
+__attribute__((target("sse4.2"))) inline uint32_t crcUpdateLane(
+    uint32_t crc, const uint8_t* p, size_t n) {
+#ifdef __x86_64__
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+  }
+#endif
+  for (; n >= 4; p += 4, n -= 4) {
+    uint32_t word;
+    std::memcpy(&word, p, sizeof(word));
+    crc = _mm_crc32_u32(crc, word);
+  }
+  while (n-- > 0) {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+  return crc;
+}
+
+__attribute__((target("sse4.2"))) inline uint32_t crcUpdateSse42(
+    uint32_t crc, const uint8_t* p, size_t n) {
+  static const uint32_t shift = crcShiftOperator(CRC_LANE_BYTES);
+  while (n >= 3 * CRC_LANE_BYTES) {
+    uint32_t crc1 = 0;
+    uint32_t crc2 = 0;
+#ifdef __x86_64__
+    for (size_t i = 0; i < CRC_LANE_BYTES; i += 8) {
+      uint64_t w0, w1, w2;
+      std::memcpy(&w0, p + i, 8);
+      std::memcpy(&w1, p + CRC_LANE_BYTES + i, 8);
+      std::memcpy(&w2, p + 2 * CRC_LANE_BYTES + i, 8);
+      crc = static_cast<uint32_t>(_mm_crc32_u64(crc, w0));
+      crc1 = static_cast<uint32_t>(_mm_crc32_u64(crc1, w1));
+      crc2 = static_cast<uint32_t>(_mm_crc32_u64(crc2, w2));
+    }
+#else
+    crc = crcUpdateLane(crc, p, CRC_LANE_BYTES);
+    crc1 = crcUpdateLane(0, p + CRC_LANE_BYTES, CRC_LANE_BYTES);
+    crc2 = crcUpdateLane(0, p + 2 * CRC_LANE_BYTES, CRC_LANE_BYTES);
+#endif
+    // update(r, A B) = update(r, A) * x^(8|B|) ^ update(0, B)
+    crc = crcMultiply(crcMultiply(crc, shift) ^ crc1, shift) ^ crc2;
+    p += 3 * CRC_LANE_BYTES;
+    n -= 3 * CRC_LANE_BYTES;
+  }
+  return crcUpdateLane(crc, p, n);
+}
+
+#endif  // REPLAY_CRC_X86
+
+#ifdef REPLAY_CRC_ARM
+
+inline uint32_t crcUpdateArm(uint32_t crc, const uint8_t* p, size_t n) {
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    crc = __crc32cd(crc, word);
+  }
+  while (n-- > 0) {
+    crc = __crc32cb(crc, *p++);
+  }
+  return crc;
+}
+
+#endif  // REPLAY_CRC_ARM
+
+inline CrcKernel detectCrcKernel() {
+#ifdef REPLAY_CRC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) return CrcKernel::HARDWARE;
+#elif defined(REPLAY_CRC_ARM)
+  return CrcKernel::HARDWARE;
+#endif
+  return CrcKernel::TABLE;
+}
+
+}  // namespace detail
+
+// Best kernel for this CPU (detected once)
+inline CrcKernel activeCrcKernel() {
+  static const CrcKernel kernel = detail::detectCrcKernel();
+  return kernel;
+}
+
+// CRC32C of n bytes continuing crc, with an explicit kernel (the table is
+// used if the CPU lacks the instruction)
+inline uint32_t crc32c(const void* data, size_t n, uint32_t crc,
+                       CrcKernel kernel) {
+  const auto* p = static_cast<const uint8_t*>(data);
+  uint32_t reg = ~crc;
+  if (kernel == CrcKernel::HARDWARE &&
+      activeCrcKernel() == CrcKernel::HARDWARE) {
+#if defined(REPLAY_CRC_X86)
+    return ~detail::crcUpdateSse42(reg, p, n);
+#elif defined(REPLAY_CRC_ARM)
+    return ~detail::crcUpdateArm(reg, p, n);
+#endif
+  }
+  return ~detail::crcUpdateTable(reg, p, n);
+}
+
+// CRC32C of n bytes continuing crc, with the best kernel for this CPU
+inline uint32_t crc32c(const void* data, size_t n, uint32_t crc = 0) {
+  return crc32c(data, n, crc, activeCrcKernel());
+}
+
+}  // namespace replay
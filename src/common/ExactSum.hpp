@@ -0,0 +1,208 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace replay {
+
+// Exact, order-independent sum of doubles (superaccumulator).
+//
+// Every finite double is m * 2^e with a 53-bit integer m and e >= -1074, so
+// the exact sum of any number of doubles is an integer multiple of 2^-1074.
+// We keep that integer as a wide fixed-point number split into 32-bit digits
+// stored in int64_t limbs. The spare 31 bits per limb absorb carries, so add()
+// is three limb additions with no branches on the data; carries are only
+// propagated every CARRY_INTERVAL additions.
+//
+// Because the accumulated value is exact, add() and merge() are associative
+// and commutative: summing a file on N threads in any split and merging the
+// partial accumulators yields exactly the same value() as one sequential pass.
+// value() rounds the exact result once (round-to-nearest-even), so it is also
+// at least as accurate as Kahan summation.
+//
+// Non-finite inputs are tracked separately and follow IEEE semantics:
+// NaN (or +inf plus -inf) yields NaN, otherwise an infinity dominates.
+class ExactSum {
+ public:
+  ExactSum() : limbs_{}, pending_(0), special_(0) {}
+
+  void add(double x) {
+    uint64_t bits = std::bit_cast<uint64_t>(x);
+    uint64_t exp = (bits >> 52) & 0x7FF;
+    uint64_t mant = bits & MANTISSA_MASK;
+
+    if (exp == 0x7FF) [[unlikely]] {
+      special_ |= (mant != 0) ? SPECIAL_NAN
+                              : ((bits >> 63) ? SPECIAL_NEG_INF
+                                              : SPECIAL_POS_INF);
+      return;
+    }
+
+    // Bit offset of the mantissa's LSB relative to 2^-1074
+    uint64_t offset;
+    if (exp == 0) {
+      if (mant == 0) return;  // +-0.0
+      offset = 0;              // subnormal: mant * 2^-1074
+    } else {
+      mant |= HIDDEN_BIT;
+      offset = exp - 1;        // mant * 2^(exp - 1075)
+    }
+
+    // mant << shift spans up to 85 bits: the low 64 come from the shifted
+    // word, the rest from the bits shifted out of it
+    size_t idx = offset / LIMB_BITS;
+    auto shift = static_cast<unsigned>(offset % LIMB_BITS);
+    uint64_t low = mant << shift;
+    auto c0 = static_cast<int64_t>(low & LIMB_MASK);
+    auto c1 = static_cast<int64_t>(low >> LIMB_BITS);
+    auto c2 = static_cast<int64_t>(shift == 0 ? 0 : mant >> (64 - shift));
+
+    if (bits >> 63) {
+      limbs_[idx] -= c0;
+      limbs_[idx + 1] -= c1;
+      limbs_[idx + 2] -= c2;
+    } else {
+      limbs_[idx] += c0;
+      limbs_[idx + 1] += c1;
+      limbs_[idx + 2] += c2;
+    }
+
+    if (++pending_ >= CARRY_INTERVAL) [[unlikely]] {
+      normalize();
+    }
+  }
+
+  // Fold another accumulator into this one. Exact, so the result does not
+  // depend on how the input was partitioned or in which order parts merge.
+  void merge(const ExactSum& other) {
+    ExactSum rhs = other;
+    rhs.normalize();
+    normalize();
+    for (size_t i = 0; i < NUM_LIMBS; ++i) {
+      limbs_[i] += rhs.limbs_[i];
+    }
+    pending_ = 2;  // each limb may now hold up to two normalized digits
+    special_ |= rhs.special_;
+  }
+
+  void reset() {
+    limbs_.fill(0);
+    pending_ = 0;
+    special_ = 0;
+  }
+
+  // Exact sum correctly rounded to the nearest double (ties to even).
+  [[nodiscard]] double value() const {
+    if ((special_ & SPECIAL_NAN) ||
+        (special_ & (SPECIAL_POS_INF | SPECIAL_NEG_INF)) ==
+            (SPECIAL_POS_INF | SPECIAL_NEG_INF)) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (special_ & SPECIAL_POS_INF) {
+      return std::numeric_limits<double>::infinity();
+    }
+    if (special_ & SPECIAL_NEG_INF) {
+      return -std::numeric_limits<double>::infinity();
+    }
+
+    ExactSum mag = *this;
+    mag.normalize();
+    bool negative = mag.limbs_[NUM_LIMBS - 1] < 0;
+    if (negative) {
+      for (auto& limb : mag.limbs_) limb = -limb;
+      mag.normalize();
+    }
+
+    // Highest set bit
+    size_t top = NUM_LIMBS;
+    while (top > 0 && mag.limbs_[top - 1] == 0) --top;
+    if (top == 0) return 0.0;
+    auto top_limb = static_cast<uint32_t>(mag.limbs_[top - 1]);
+    int64_t msb = static_cast<int64_t>((top - 1) * LIMB_BITS) + 31 -
+                  std::countl_zero(top_limb);
+
+    double result;
+    if (msb <= 52) {
+      // Fits in the mantissa as-is (includes the whole subnormal range)
+      result = std::ldexp(static_cast<double>(mag.extract64(0) & MANTISSA_53),
+                          -1074);
+    } else {
+      int64_t shift = msb - 52;
+      uint64_t mant = mag.extract64(shift) & MANTISSA_53;
+      bool guard = mag.extract64(shift - 1) & 1;
+      bool sticky = mag.anyBitBelow(shift - 1);
+      if (guard && (sticky || (mant & 1))) {
+        ++mant;  // may carry to 2^53, which is still exact in a double
+      }
+      result = std::ldexp(static_cast<double>(mant),
+                          static_cast<int>(shift - 1074));
+    }
+    return negative ? -result : result;
+  }
+
+ private:
+  static constexpr size_t LIMB_BITS = 32;
+  static constexpr int64_t LIMB_MASK = (int64_t{1} << LIMB_BITS) - 1;
+  static constexpr uint64_t MANTISSA_MASK = (uint64_t{1} << 52) - 1;
+  static constexpr uint64_t HIDDEN_BIT = uint64_t{1} << 52;
+  static constexpr uint64_t MANTISSA_53 = (uint64_t{1} << 53) - 1;
+
+  // Largest mantissa LSB offset is 2045 (exp 0x7FE), spanning 53 + 31 bits
+  // of shift, plus 64 bits of headroom for 2^63 additions of DBL_MAX.
+  static constexpr size_t NUM_LIMBS = 68;
+
+  // Normalized limbs hold < 2^32; each add() contributes < 2^32 per limb,
+  // so 2^30 additions cannot overflow an int64_t limb.
+  static constexpr int64_t CARRY_INTERVAL = int64_t{1} << 30;
+
+  static constexpr uint8_t SPECIAL_NAN = 0x1;
+  static constexpr uint8_t SPECIAL_POS_INF = 0x2;
+  static constexpr uint8_t SPECIAL_NEG_INF = 0x4;
+
+  // Propagate carries so limbs [0, N-2] are in [0, 2^32) and the top limb
+  // carries the sign (two's complement across limbs).
+  void normalize() {
+    for (size_t i = 0; i + 1 < NUM_LIMBS; ++i) {
+      int64_t carry = limbs_[i] >> LIMB_BITS;  // arithmetic shift = floor
+      limbs_[i] &= LIMB_MASK;
+      limbs_[i + 1] += carry;
+    }
+    pending_ = 0;
+  }
+
+  // 64 bits starting at global bit position pos (requires normalized limbs)
+  uint64_t extract64(int64_t pos) const {
+    auto idx = static_cast<size_t>(pos / LIMB_BITS);
+    auto off = static_cast<unsigned>(pos % LIMB_BITS);
+    uint32_t digit[3] = {};
+    for (size_t k = 0; k < 3 && idx + k < NUM_LIMBS; ++k) {
+      digit[k] = static_cast<uint32_t>(limbs_[idx + k]);
+    }
+    // 96-bit window digit[2]:digit[1]:digit[0], shifted right by off < 32
+    uint64_t low = (static_cast<uint64_t>(digit[1]) << LIMB_BITS) | digit[0];
+    uint64_t high =
+        off == 0 ? 0 : static_cast<uint64_t>(digit[2]) << (64 - off);
+    return (low >> off) | high;
+  }
+
+  // Whether any bit strictly below global position pos is set
+  bool anyBitBelow(int64_t pos) const {
+    if (pos <= 0) return false;
+    auto idx = static_cast<size_t>(pos / LIMB_BITS);
+    auto off = static_cast<unsigned>(pos % LIMB_BITS);
+    for (size_t i = 0; i < idx; ++i) {
+      if (limbs_[i] != 0) return true;
+    }
+    return off != 0 &&
+           (static_cast<uint32_t>(limbs_[idx]) & ((uint32_t{1} << off) - 1));
+  }
+
+  std::array<int64_t, NUM_LIMBS> limbs_;
+  int64_t pending_;  // add() calls since the last carry propagation
+  uint8_t special_;  // SPECIAL_* flags for non-finite inputs
+};
+
+}  // namespace replay
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace replay {
+
+// Lane-parallel xoshiro256+ generator for bulk uniform doubles.
+//
+// LANES independent xoshiro256+ streams are stepped together over plain
+// arrays, so the step loop is straight-line 64-bit shifts, xors and adds
+// that the compiler vectorizes (two ymm or one zmm register per state word
+// with -march=native). Doubles are built by placing the top 52 random bits
+// into the mantissa of a number in [1, 2) and subtracting 1, which also
+// vectorizes, unlike an int64 -> double conversion on AVX2.
+//
+// Statistical quality is that of xoshiro256+ (fine for synthetic payloads,
+// not for cryptography). Streams are seeded from one seed with splitmix64.
+class FastUniformRng {
+ public:
+  static constexpr size_t LANES = 8;
+
+  explicit FastUniformRng(uint64_t seed) {
+    for (size_t i = 0; i < LANES; ++i) {
+      s0_[i] = splitmix64(seed);
+      s1_[i] = splitmix64(seed);
+      s2_[i] = splitmix64(seed);
+      s3_[i] = splitmix64(seed);
+    }
+  }
+
+  // Fill out with uniform doubles in [lo, hi)
+  void fill(std::span<double> out, double lo, double hi) {
+    const double scale = hi - lo;
+    size_t i = 0;
+    for (; i + LANES <= out.size(); i += LANES) {
+      step(out.data() + i, lo, scale);
+    }
+    if (i < out.size()) {
+      alignas(64) double tail[LANES];
+      step(tail, lo, scale);
+      std::copy_n(tail, out.size() - i, out.data() + i);
+    }
+  }
+
+ private:
+  static uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // Advance every lane once and write LANES doubles in [lo, lo + scale)
+  void step(double* out, double lo, double scale) {
+    for (size_t i = 0; i < LANES; ++i) {
+      uint64_t result = s0_[i] + s3_[i];
+      uint64_t t = s1_[i] << 17;
+      s2_[i] ^= s0_[i];
+      s3_[i] ^= s1_[i];
+      s1_[i] ^= s2_[i];
+      s0_[i] ^= s3_[i];
+      s2_[i] ^= t;
+      s3_[i] = std::rotl(s3_[i], 45);
+
+      double unit =
+          std::bit_cast<double>((result >> 12) | 0x3FF0000000000000ull) - 1.0;
+      out[i] = lo + unit * scale;
+    }
+  }
+
+  alignas(64) uint64_t s0_[LANES];
+  alignas(64) uint64_t s1_[LANES];
+  alignas(64) uint64_t s2_[LANES];
+  alignas(64) uint64_t s3_[LANES];
+};
+
+}  // namespace replay
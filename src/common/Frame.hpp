@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+#include "Types.hpp"
+
+namespace replay {
+
+// Variable-length frames
+// Events of different types and sizes (trades, quotes, book updates) travel
+// as length-prefixed frames: a 24-byte FrameHeader followed by the payload,
+// padded to FRAME_ALIGNMENT. VarRingBuffer stores them this way and v4
+// recordings (FILE_VERSION_FRAMES) are the same frames back to back, so a
+// batch read from the ring is written to the file as is.
+
+// Frame flags
+constexpr uint16_t FRAME_FLAG_PADDING = 0x0001;  // Ring filler up to the wrap
+
+// Frames start on 8-byte boundaries
+constexpr size_t FRAME_ALIGNMENT = 8;
+
+struct alignas(8) FrameHeader {
+  SeqNum seq_num;        // Frame sequence number (8 bytes)
+  int64_t timestamp_ns;  // Nanosecond timestamp (8 bytes)
+  uint32_t length;       // Payload bytes, padding excluded (4 bytes)
+  uint16_t type;         // Event type, defined by the application (2 bytes)
+  uint16_t flags;        // FRAME_FLAG_* (2 bytes)
+
+  [[nodiscard]] constexpr bool isPadding() const noexcept {
+    return (flags & FRAME_FLAG_PADDING) != 0;
+  }
+};
+
+static_assert(sizeof(FrameHeader) == 24, "FrameHeader size must be 24 bytes");
+
+// Bytes a frame with this payload takes, header and padding included
+constexpr size_t frameBytes(size_t length) {
+  return (sizeof(FrameHeader) + length + FRAME_ALIGNMENT - 1) &
+         ~(FRAME_ALIGNMENT - 1);
+}
+
+// A frame to write: the header fields the writer does not assign
+struct FrameRef {
+  uint16_t type = 0;
+  int64_t timestamp_ns = 0;
+  std::span<const std::byte> payload;
+};
+
+// A frame that was read; payload points into the reader's buffer and is
+// valid until its next read
+struct FrameView {
+  FrameHeader header;
+  std::span<const std::byte> payload;
+
+  // Copy of the payload as an event struct (zero-filled past a shorter
+  // payload)
+  template <typename E>
+    requires std::is_trivially_copyable_v<E>
+  E as() const {
+    E event{};
+    std::memcpy(&event, payload.data(), std::min(sizeof(E), payload.size()));
+    return event;
+  }
+};
+
+// Payload bytes of an event struct
+template <typename E>
+  requires std::is_trivially_copyable_v<E>
+std::span<const std::byte> eventBytes(const E& event) {
+  return std::as_bytes(std::span<const E>(&event, 1));
+}
+
+}  // namespace replay
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace replay {
+
+// Log-linear bucket layout shared by LatencyHistogram and its snapshots.
+//
+// Values below 2^(SUB_BITS+1) ns get one bucket each. Above that, every
+// power-of-two range [2^k, 2^(k+1)) is split into 2^SUB_BITS equal buckets,
+// so a bucket is at most 1/2^SUB_BITS (~3%) of its values wide — the same
+// idea as HdrHistogram with ~1.5 significant digits. Values of 2^MAX_BITS ns
+// (~2.4 hours) and more land in the last bucket.
+namespace latency_buckets {
+
+constexpr int SUB_BITS = 5;
+constexpr int MAX_BITS = 43;
+constexpr size_t SUB_COUNT = size_t(1) << SUB_BITS;
+constexpr size_t BUCKET_COUNT = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+inline size_t indexOf(int64_t value_ns) {
+  auto v = static_cast<uint64_t>(std::max<int64_t>(0, value_ns));
+  if (v < 2 * SUB_COUNT) {
+    return static_cast<size_t>(v);
+  }
+  int msb = 63 - std::countl_zero(v);
+  if (msb >= MAX_BITS) {
+    return BUCKET_COUNT - 1;
+  }
+  int shift = msb - SUB_BITS;
+  return static_cast<size_t>(shift) * SUB_COUNT +
+         static_cast<size_t>(v >> shift);
+}
+
+// Smallest value mapped to bucket index
+inline int64_t lowerBound(size_t index) {
+  if (index < 2 * SUB_COUNT) {
+    return static_cast<int64_t>(index);
+  }
+  size_t shift = index / SUB_COUNT - 1;
+  size_t top = SUB_COUNT + index % SUB_COUNT;
+  return static_cast<int64_t>(top << shift);
+}
+
+// Largest value mapped to bucket index
+inline int64_t upperBound(size_t index) {
+  return index + 1 < BUCKET_COUNT ? lowerBound(index + 1) - 1 : INT64_MAX;
+}
+
+}  // namespace latency_buckets
+
+// Plain copy of a histogram: mergeable, subtractable (interval deltas) and
+// queryable. Not thread-safe; take one per reader.
+struct HistogramSnapshot {
+  std::array<uint64_t, latency_buckets::BUCKET_COUNT> counts{};
+  int64_t total_count = 0;
+  int64_t sum_ns = 0;
+  int64_t max_ns = 0;
+
+  void merge(const HistogramSnapshot& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+      counts[i] += other.counts[i];
+    }
+    total_count += other.total_count;
+    sum_ns += other.sum_ns;
+    max_ns = std::max(max_ns, other.max_ns);
+  }
+
+  // Samples recorded since an earlier snapshot of the same histogram. max_ns
+  // stays the all-time maximum (it cannot be un-merged).
+  [[nodiscard]] HistogramSnapshot since(
+      const HistogramSnapshot& earlier) const {
+    HistogramSnapshot delta = *this;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      delta.counts[i] -= earlier.counts[i];
+    }
+    delta.total_count -= earlier.total_count;
+    delta.sum_ns -= earlier.sum_ns;
+    return delta;
+  }
+
+  [[nodiscard]] double meanNs() const {
+    return total_count > 0 ? static_cast<double>(sum_ns) /
+                                 static_cast<double>(total_count)
+                           : 0.0;
+  }
+
+  // Value at quantile q in [0, 1]: the upper bound of the bucket holding the
+  // q-th sample (never above the observed maximum), 0 when empty
+  [[nodiscard]] int64_t percentileNs(double q) const {
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+      total += c;
+    }
+    if (total == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(latency_buckets::upperBound(i), max_ns);
+      }
+    }
+    return max_ns;
+  }
+
+  // One-line summary for logs: "n=... mean=... p50=... p99=... p99.9=...
+  // max=..." (ns)
+  [[nodiscard]] std::string summary() const {
+    std::ostringstream oss;
+    oss << "n=" << total_count << " mean=" << static_cast<int64_t>(meanNs())
+        << " p50=" << percentileNs(0.5) << " p99=" << percentileNs(0.99)
+        << " p99.9=" << percentileNs(0.999) << " max=" << max_ns;
+    return oss.str();
+  }
+};
+
+// Latency histogram for one recording thread.
+//
+// record() is a bucket computation plus relaxed loads and stores: no
+// read-modify-write, no locks, no allocation. That is only correct with a
+// single writer, so each stage owns one histogram written from its own
+// thread; any thread may snapshot() it concurrently (a snapshot may miss
+// samples recorded while it is taken, but never sees torn counts), and
+// snapshots from several threads or stages are combined with merge().
+class LatencyHistogram {
+ public:
+  LatencyHistogram() = default;
+
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  // Writer thread only. count records the same value count times.
+  void record(int64_t value_ns, uint64_t count = 1) {
+    value_ns = std::max<int64_t>(0, value_ns);
+    auto& bucket = counts_[latency_buckets::indexOf(value_ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + count,
+                 std::memory_order_relaxed);
+    total_count_.store(total_count_.load(std::memory_order_relaxed) +
+                           static_cast<int64_t>(count),
+                       std::memory_order_relaxed);
+    sum_ns_.store(sum_ns_.load(std::memory_order_relaxed) +
+                      value_ns * static_cast<int64_t>(count),
+                  std::memory_order_relaxed);
+    if (value_ns > max_ns_.load(std::memory_order_relaxed)) {
+      max_ns_.store(value_ns, std::memory_order_relaxed);
+    }
+  }
+
+  // Any thread
+  [[nodiscard]] HistogramSnapshot snapshot() const {
+    HistogramSnapshot snap;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      snap.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    snap.total_count = total_count_.load(std::memory_order_relaxed);
+    snap.sum_ns = sum_ns_.load(std::memory_order_relaxed);
+    snap.max_ns = max_ns_.load(std::memory_order_relaxed);
+    return snap;
+  }
+
+ private:
+  std::array<std::atomic<uint64_t>, latency_buckets::BUCKET_COUNT> counts_{};
+  std::atomic<int64_t> total_count_{0};
+  std::atomic<int64_t> sum_ns_{0};
+  std::atomic<int64_t> max_ns_{0};
+};
+
+}  // namespace replay
@@ -45,6 +45,17 @@ static_assert(sizeof(Msg) == 24, "Msg size must be 24 bytes");
 
 // File header structure: 64 bytes (expanded for integrity tracking)
 //
+// version selects the body layout: FILE_VERSION (2) is a raw array of
+// records, FILE_VERSION_COLUMNAR (3) a sequence of Msg column blocks (see
+// channel/ColumnBlock.hpp), FILE_VERSION_FRAMES (4) a sequence of
+// variable-length frames (see common/Frame.hpp). In v3 and v4 msg_count
+// covers the blocks or frames up to data_end.
+// schema_id and record_size identify the record type (see common/Record.hpp);
+// both are 0 in files written before they existed, which hold Msg.
+// With FILE_FLAG_INSTRUMENT_INDEX a v2 record file ends in an instrument
+// index (see channel/InstrumentIndex.hpp) at data_end, with block_messages
+// records per index block.
+//
 // Invariants maintained by the recorder:
 //   - first_seq <= last_seq when msg_count > 0
 //   - last_seq - first_seq + 1 == msg_count (no gaps in recording)
@@ -54,25 +65,41 @@ struct alignas(8) FileHeader {
   uint16_t version;     // Version number (2 bytes) — FILE_VERSION
   uint16_t flags;       // Flags (2 bytes) — see FILE_FLAG_*
   uint32_t date;        // Date YYYYMMDD (4 bytes)
-  uint32_t reserved1;   // Reserved (4 bytes)
+  uint32_t block_messages;  // v3: messages per full block, v2: per index block (4 bytes)
   int64_t msg_count;    // Message count (8 bytes)
   int64_t first_seq;    // First sequence number in file (8 bytes), INVALID_SEQ if empty
   int64_t last_seq;     // Last sequence number in file (8 bytes), INVALID_SEQ if empty
-  int64_t reserved2[3]; // Reserved for future use (24 bytes)
+  int64_t data_end;     // v3/v4: offset past the last block/frame counted (8 bytes)
+  uint32_t schema_id;   // Record type (4 bytes) — SCHEMA_*, 0 in older files
+  uint32_t record_size; // Bytes per record (4 bytes), 0 in older files
+  int64_t reserved2;    // Reserved for future use (8 bytes)
 
   constexpr FileHeader() noexcept
       : magic(FILE_MAGIC),
         version(FILE_VERSION),
         flags(0),
         date(0),
-        reserved1(0),
+        block_messages(0),
         msg_count(0),
         first_seq(INVALID_SEQ),
         last_seq(INVALID_SEQ),
-        reserved2{0, 0, 0} {}
+        data_end(0),
+        schema_id(0),
+        record_size(0),
+        reserved2(0) {}
 
   [[nodiscard]] constexpr bool isValid() const noexcept {
-    return magic == FILE_MAGIC && version == FILE_VERSION;
+    return magic == FILE_MAGIC &&
+           (version == FILE_VERSION || version == FILE_VERSION_COLUMNAR ||
+            version == FILE_VERSION_FRAMES);
+  }
+
+  [[nodiscard]] constexpr bool isColumnar() const noexcept {
+    return version == FILE_VERSION_COLUMNAR;
+  }
+
+  [[nodiscard]] constexpr bool isFramed() const noexcept {
+    return version == FILE_VERSION_FRAMES;
   }
 
   // Check structural consistency of header fields
@@ -85,10 +112,21 @@ struct alignas(8) FileHeader {
     // Non-empty: first_seq and last_seq must be valid and consistent
     if (first_seq < 0 || last_seq < 0) return false;
     if (first_seq > last_seq) return false;
-    if (last_seq - first_seq + 1 != msg_count) return false;
+    // Sparse ranges are fine: a lapped recorder skips seq_nums
+    if (last_seq - first_seq + 1 < msg_count) return false;
     return true;
   }
 
+  // Whether the body holds records of this schema and size (a header from
+  // before the schema fields holds Msg)
+  [[nodiscard]] constexpr bool holdsRecords(uint32_t schema,
+                                            uint32_t size) const noexcept {
+    if (schema_id == SCHEMA_LEGACY) {
+      return schema == SCHEMA_MSG && size == 24;
+    }
+    return schema_id == schema && record_size == size;
+  }
+
   // Check whether the file was properly closed
   [[nodiscard]] constexpr bool isComplete() const noexcept {
     return (flags & FILE_FLAG_COMPLETE) != 0;
@@ -0,0 +1,383 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+#include "Message.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define REPLAY_SELECT_X86 1
+#endif
+
+namespace replay {
+
+// Min/max of each field over a run of messages (a v3 block's zone map).
+// A NaN payload widens the payload range to [-inf, +inf], so a zone never
+// claims to lie inside a payload range that its NaNs do not match.
+struct ZoneMap {
+  SeqNum min_seq = std::numeric_limits<int64_t>::min();
+  SeqNum max_seq = std::numeric_limits<int64_t>::max();
+  int64_t min_timestamp_ns = std::numeric_limits<int64_t>::min();
+  int64_t max_timestamp_ns = std::numeric_limits<int64_t>::max();
+  double min_payload = -std::numeric_limits<double>::infinity();
+  double max_payload = std::numeric_limits<double>::infinity();
+
+  // Zone of unknown contents (may hold anything); the default
+  static ZoneMap everything() { return ZoneMap{}; }
+
+  // Zone of msgs (non-empty)
+  static ZoneMap of(std::span<const Msg> msgs) {
+    ZoneMap zone;
+    zone.min_seq = zone.max_seq = msgs.front().seq_num;
+    zone.min_timestamp_ns = zone.max_timestamp_ns = msgs.front().timestamp_ns;
+    zone.min_payload = std::numeric_limits<double>::infinity();
+    zone.max_payload = -std::numeric_limits<double>::infinity();
+    bool nan = false;
+    for (const Msg& msg : msgs) {
+      zone.min_seq = std::min(zone.min_seq, msg.seq_num);
+      zone.max_seq = std::max(zone.max_seq, msg.seq_num);
+      zone.min_timestamp_ns = std::min(zone.min_timestamp_ns, msg.timestamp_ns);
+      zone.max_timestamp_ns = std::max(zone.max_timestamp_ns, msg.timestamp_ns);
+      nan |= std::isnan(msg.payload);
+      zone.min_payload = std::min(zone.min_payload, msg.payload);
+      zone.max_payload = std::max(zone.max_payload, msg.payload);
+    }
+    if (nan) {
+      zone.min_payload = -std::numeric_limits<double>::infinity();
+      zone.max_payload = std::numeric_limits<double>::infinity();
+    }
+    return zone;
+  }
+};
+
+// Predicate of a filtered replay: closed ranges on seq_num, timestamp_ns and
+// payload, all of which a message must fall in. The defaults leave a field
+// unconstrained. A NaN payload only matches while the payload range is
+// unbounded.
+struct MessageFilter {
+  SeqNum min_seq = std::numeric_limits<int64_t>::min();
+  SeqNum max_seq = std::numeric_limits<int64_t>::max();
+  int64_t min_timestamp_ns = std::numeric_limits<int64_t>::min();
+  int64_t max_timestamp_ns = std::numeric_limits<int64_t>::max();
+  double min_payload = -std::numeric_limits<double>::infinity();
+  double max_payload = std::numeric_limits<double>::infinity();
+
+  // Whether the payload range constrains anything
+  [[nodiscard]] bool payloadBounded() const {
+    return !(min_payload == -std::numeric_limits<double>::infinity() &&
+             max_payload == std::numeric_limits<double>::infinity());
+  }
+
+  [[nodiscard]] bool matches(const Msg& msg) const {
+    return msg.seq_num >= min_seq && msg.seq_num <= max_seq &&
+           msg.timestamp_ns >= min_timestamp_ns &&
+           msg.timestamp_ns <= max_timestamp_ns &&
+           (!payloadBounded() ||
+            (msg.payload >= min_payload && msg.payload <= max_payload));
+  }
+
+  // Whether some message of the zone may match (false: none does)
+  [[nodiscard]] bool mayMatch(const ZoneMap& zone) const {
+    return zone.max_seq >= min_seq && zone.min_seq <= max_seq &&
+           zone.max_timestamp_ns >= min_timestamp_ns &&
+           zone.min_timestamp_ns <= max_timestamp_ns &&
+           (!payloadBounded() || (zone.max_payload >= min_payload &&
+                                  zone.min_payload <= max_payload));
+  }
+
+  // Whether every message of the zone matches
+  [[nodiscard]] bool contains(const ZoneMap& zone) const {
+    return zone.min_seq >= min_seq && zone.max_seq <= max_seq &&
+           zone.min_timestamp_ns >= min_timestamp_ns &&
+           zone.max_timestamp_ns <= max_timestamp_ns &&
+           (!payloadBounded() || (zone.min_payload >= min_payload &&
+                                  zone.max_payload <= max_payload));
+  }
+};
+
+// Selection kernels: the indexes of the messages of a batch that match a
+// MessageFilter, in order (a selection vector).
+//
+// The vector kernels compare 4 (AVX2) or 8 (AVX-512) messages per step
+// without branches: the fields are picked straight out of the 24-byte Msg
+// array with loads, blends and permutes (as in PayloadSum.hpp), the range
+// checks are combined into a lane mask, and the matching indexes are packed
+// with a shuffle table (AVX2) or vpcompressd (AVX-512). The scalar kernel appends every index and advances the output
+// by the match bit. The kernel is picked once at runtime from the CPU's
+// features; all kernels return the same selection.
+enum class SelectKernel : uint8_t {
+  SCALAR = 0,
+  AVX2 = 1,
+  AVX512 = 2,
+};
+
+inline const char* selectKernelName(SelectKernel kernel) {
+  switch (kernel) {
+    case SelectKernel::AVX2:
+      return "avx2";
+    case SelectKernel::AVX512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+namespace detail {
+
+inline size_t selectScalar(std::span<const Msg> msgs,
+                           const MessageFilter& filter, uint32_t* out) {
+  size_t count = 0;
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    out[count] = static_cast<uint32_t>(i);
+    count += filter.matches(msgs[i]) ? 1 : 0;
+  }
+  return count;
+}
+
+#ifdef REPLAY_SELECT_X86
+
+// Lane indexes of each 4-bit mask's set bits, packed to the front
+constexpr std::array<std::array<uint32_t, 4>, 16> makeCompressTable() {
+  std::array<std::array<uint32_t, 4>, 16> table{};
+  for (uint32_t mask = 0; mask < 16; ++mask) {
+    uint32_t count = 0;
+    for (uint32_t lane = 0; lane < 4; ++lane) {
+      if (mask & (1u << lane)) {
+        table[mask][count++] = lane;
+      }
+    }
+  }
+  return table;
+}
+
+alignas(16) inline constexpr auto kCompressTable = makeCompressTable();
+
+// Lanes of x outside [lo, hi] (signed 64-bit)
+__attribute__((target("avx2"))) inline __m256i outside256(__m256i x,
+                                                          __m256i lo,
+                                                          __m256i hi) {
+  return _mm256_or_si256(_mm256_cmpgt_epi64(lo, x), _mm256_cmpgt_epi64(x, hi));
+}
+
+// Four consecutive Msgs are three ymm registers, [s0 t0 p0 s1] [t1 p1 s2 t2]
+// [p2 s3 t3 p3]: two blends collect a field and a permute puts it in
+// message order (cheaper than vpgatherqq)
+__attribute__((target("avx2"))) inline void loadFields256(const Msg* p,
+                                                          __m256i& seqs,
+                                                          __m256i& stamps,
+                                                          __m256d& payloads) {
+  const auto* words = reinterpret_cast<const __m256i*>(p);
+  __m256i a = _mm256_loadu_si256(words);
+  __m256i b = _mm256_loadu_si256(words + 1);
+  __m256i c = _mm256_loadu_si256(words + 2);
+  // [s0 s3 s2 s1], [t1 t0 t3 t2], [p2 p1 p0 p3]
+  __m256i s = _mm256_blend_epi32(_mm256_blend_epi32(a, b, 0x30), c, 0x0C);
+  __m256i t = _mm256_blend_epi32(_mm256_blend_epi32(a, b, 0xC3), c, 0x30);
+  __m256i x = _mm256_blend_epi32(_mm256_blend_epi32(a, b, 0x0C), c, 0xC3);
+  seqs = _mm256_permute4x64_epi64(s, _MM_SHUFFLE(1, 2, 3, 0));
+  stamps = _mm256_permute4x64_epi64(t, _MM_SHUFFLE(2, 3, 0, 1));
+  payloads = _mm256_castsi256_pd(
+      _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 0, 1, 2)));
+}
+
+__attribute__((target("avx2,popcnt"))) inline size_t selectAvx2(
+    std::span<const Msg> msgs, const MessageFilter& filter, uint32_t* out) {
+  static_assert(offsetof(Msg, seq_num) == 0 &&
+                    offsetof(Msg, timestamp_ns) == 8 &&
+                    offsetof(Msg, payload) == 16,
+                "loadFields256 assumes the Msg field order");
+  const __m256i seq_lo = _mm256_set1_epi64x(filter.min_seq);
+  const __m256i seq_hi = _mm256_set1_epi64x(filter.max_seq);
+  const __m256i ts_lo = _mm256_set1_epi64x(filter.min_timestamp_ns);
+  const __m256i ts_hi = _mm256_set1_epi64x(filter.max_timestamp_ns);
+  const __m256d payload_lo = _mm256_set1_pd(filter.min_payload);
+  const __m256d payload_hi = _mm256_set1_pd(filter.max_payload);
+  const bool check_payload = filter.payloadBounded();
+  const size_t n = msgs.size();
+
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i seqs, stamps;
+    __m256d x;
+    loadFields256(msgs.data() + i, seqs, stamps, x);
+    __m256i reject = _mm256_or_si256(outside256(seqs, seq_lo, seq_hi),
+                                     outside256(stamps, ts_lo, ts_hi));
+    int mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(reject)) & 0xF;
+    if (check_payload) {
+      __m256d inside = _mm256_and_pd(_mm256_cmp_pd(x, payload_lo, _CMP_GE_OQ),
+                                     _mm256_cmp_pd(x, payload_hi, _CMP_LE_OQ));
+      mask &= _mm256_movemask_pd(inside);
+    }
+    // Four slots are written, count + 4 <= i + 4 <= n
+    __m128i lanes = _mm_load_si128(
+        reinterpret_cast<const __m128i*>(kCompressTable[mask].data()));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out + count),
+        _mm_add_epi32(lanes, _mm_set1_epi32(static_cast<int>(i))));
+    count += static_cast<size_t>(_mm_popcnt_u32(static_cast<uint32_t>(mask)));
+  }
+  for (; i < n; ++i) {
+    out[count] = static_cast<uint32_t>(i);
+    count += filter.matches(msgs[i]) ? 1 : 0;
+  }
+  return count;
+}
+
+// Permute indexes picking field (0: seq_num, 1: timestamp_ns, 2: payload)
+// of eight consecutive Msgs out of their three zmm registers: the first
+// permute takes what lies in the first two registers, the second the rest
+struct FieldPermute {
+  alignas(64) int64_t from_ab[8];
+  alignas(64) int64_t from_c[8];
+};
+
+constexpr FieldPermute makeFieldPermute(int64_t field) {
+  FieldPermute permute{};
+  for (int64_t k = 0; k < 8; ++k) {
+    int64_t at = field + 3 * k;
+    permute.from_ab[k] = at < 16 ? at : 0;
+    permute.from_c[k] = at < 16 ? k : 8 + (at - 16);
+  }
+  return permute;
+}
+
+inline constexpr FieldPermute kSeqPermute = makeFieldPermute(0);
+inline constexpr FieldPermute kTimestampPermute = makeFieldPermute(1);
+inline constexpr FieldPermute kPayloadPermute = makeFieldPermute(2);
+
+__attribute__((target("avx512f"))) inline __m512i gatherField512(
+    __m512i a, __m512i b, __m512i c, const FieldPermute& permute) {
+  __m512i ab = _mm512_permutex2var_epi64(
+      a, _mm512_load_si512(permute.from_ab), b);
+  return _mm512_permutex2var_epi64(ab, _mm512_load_si512(permute.from_c), c);
+}
+
+__attribute__((target("avx512f"))) inline __mmask8 inside512(__m512i x,
+                                                             __m512i lo,
+                                                             __m512i hi) {
+  return _mm512_cmp_epi64_mask(x, lo, _MM_CMPINT_NLT) &
+         _mm512_cmp_epi64_mask(x, hi, _MM_CMPINT_LE);
+}
+
+// Lane mask of the eight Msgs at p that match
+__attribute__((target("avx512f"))) inline __mmask8 match512(
+    const Msg* p, const __m512i bounds[4], __m512d payload_lo,
+    __m512d payload_hi, bool check_payload) {
+  const auto* words = reinterpret_cast<const int64_t*>(p);
+  __m512i a = _mm512_loadu_si512(words);
+  __m512i b = _mm512_loadu_si512(words + 8);
+  __m512i c = _mm512_loadu_si512(words + 16);
+  __mmask8 mask =
+      inside512(gatherField512(a, b, c, kSeqPermute), bounds[0], bounds[1]) &
+      inside512(gatherField512(a, b, c, kTimestampPermute), bounds[2],
+                bounds[3]);
+  if (check_payload) {
+    __m512d x = _mm512_castsi512_pd(gatherField512(a, b, c, kPayloadPermute));
+    mask &= _mm512_cmp_pd_mask(x, payload_lo, _CMP_GE_OQ) &
+            _mm512_cmp_pd_mask(x, payload_hi, _CMP_LE_OQ);
+  }
+  return mask;
+}
+
+__attribute__((target("avx512f,popcnt"))) inline size_t selectAvx512(
+    std::span<const Msg> msgs, const MessageFilter& filter, uint32_t* out) {
+  static_assert(offsetof(Msg, seq_num) == 0 &&
+                    offsetof(Msg, timestamp_ns) == 8 &&
+                    offsetof(Msg, payload) == 16,
+                "kSeqPermute etc. assume the Msg field order");
+  const __m512i bounds[4] = {_mm512_set1_epi64(filter.min_seq),
+                             _mm512_set1_epi64(filter.max_seq),
+                             _mm512_set1_epi64(filter.min_timestamp_ns),
+                             _mm512_set1_epi64(filter.max_timestamp_ns)};
+  const __m512d payload_lo = _mm512_set1_pd(filter.min_payload);
+  const __m512d payload_hi = _mm512_set1_pd(filter.max_payload);
+  const bool check_payload = filter.payloadBounded();
+  const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+                                          11, 12, 13, 14, 15);
+  const size_t n = msgs.size();
+
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const Msg* p = msgs.data() + i;
+    auto mask = static_cast<__mmask16>(
+        match512(p, bounds, payload_lo, payload_hi, check_payload) |
+        (match512(p + 8, bounds, payload_lo, payload_hi, check_payload)
+         << 8));
+    // Compress in a register and store all 16 slots (count + 16 <= n);
+    // vpcompressd straight to memory is microcoded on some cores
+    _mm512_storeu_si512(
+        out + count,
+        _mm512_maskz_compress_epi32(
+            mask, _mm512_add_epi32(lanes,
+                                   _mm512_set1_epi32(static_cast<int>(i)))));
+    count += static_cast<size_t>(_mm_popcnt_u32(mask));
+  }
+  for (; i < n; ++i) {
+    out[count] = static_cast<uint32_t>(i);
+    count += filter.matches(msgs[i]) ? 1 : 0;
+  }
+  return count;
+}
+
+#endif  // REPLAY_SELECT_X86
+
+inline SelectKernel detectSelectKernel() {
+#ifdef REPLAY_SELECT_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SelectKernel::AVX512;
+  if (__builtin_cpu_supports("avx2")) return SelectKernel::AVX2;
+#endif
+  return SelectKernel::SCALAR;
+}
+
+}  // namespace detail
+
+// Best kernel for this CPU (detected once)
+inline SelectKernel activeSelectKernel() {
+  static const SelectKernel kernel = detail::detectSelectKernel();
+  return kernel;
+}
+
+// Whether the given kernel can run on this CPU
+inline bool isSelectKernelSupported(SelectKernel kernel) {
+  return static_cast<uint8_t>(kernel) <=
+         static_cast<uint8_t>(activeSelectKernel());
+}
+
+// Write the indexes of the messages matching filter to out (room for
+// msgs.size() indexes) with an explicit kernel (scalar if the kernel is not
+// supported on this CPU). Returns the number of matches.
+inline size_t selectMessages(std::span<const Msg> msgs,
+                             const MessageFilter& filter, uint32_t* out,
+                             SelectKernel kernel) {
+  if (!isSelectKernelSupported(kernel)) {
+    kernel = SelectKernel::SCALAR;
+  }
+#ifdef REPLAY_SELECT_X86
+  switch (kernel) {
+    case SelectKernel::AVX512:
+      return detail::selectAvx512(msgs, filter, out);
+    case SelectKernel::AVX2:
+      return detail::selectAvx2(msgs, filter, out);
+    default:
+      break;
+  }
+#endif
+  return detail::selectScalar(msgs, filter, out);
+}
+
+// Selection with the best kernel for this CPU
+inline size_t selectMessages(std::span<const Msg> msgs,
+                             const MessageFilter& filter, uint32_t* out) {
+  return selectMessages(msgs, filter, out, activeSelectKernel());
+}
+
+}  // namespace replay
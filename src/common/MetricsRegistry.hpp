@@ -0,0 +1,279 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Logging.hpp"
+#include "Types.hpp"
+
+namespace replay {
+
+// Default shared-memory page for replay_system and the ipc processes
+inline constexpr const char* METRICS_SHM_NAME = "/replay_metrics";
+
+// Metrics per page and longest metric name (including the terminator)
+constexpr size_t METRICS_CAPACITY = 256;
+constexpr size_t METRIC_NAME_SIZE = 48;
+
+// Page tag ("RPMETRC1"), set by the first process that maps the page
+constexpr uint64_t METRICS_MAGIC = 0x52504D4554524331ull;
+
+enum class MetricKind : uint32_t {
+  COUNTER = 1,  // Monotonic total; monitors derive rates from deltas
+  GAUGE = 2     // Last published value
+};
+
+// One metric per cache line, so a writer never shares a line with another
+// writer or with a different metric. Zero-filled memory is a free slot.
+struct alignas(CACHE_LINE_SIZE) MetricSlot {
+  static constexpr uint32_t FREE = 0;
+  static constexpr uint32_t CLAIMED = 1;  // Name being written
+  static constexpr uint32_t READY = 2;
+
+  std::atomic<uint32_t> state;
+  uint32_t kind;
+  char name[METRIC_NAME_SIZE];
+  std::atomic<int64_t> value;
+};
+
+static_assert(sizeof(MetricSlot) == CACHE_LINE_SIZE,
+              "MetricSlot must be one cache line");
+
+struct MetricsPage {
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> magic;
+  MetricSlot slots[METRICS_CAPACITY];
+};
+
+// Handle a component publishes through. Values are written with a relaxed
+// load and store (no read-modify-write), so each metric must have one writer
+// at a time. An unbound handle keeps its value locally: components publish
+// the same way whether or not a registry is attached.
+class MetricHandle {
+ public:
+  MetricHandle() = default;
+
+  MetricHandle(const MetricHandle&) = delete;
+  MetricHandle& operator=(const MetricHandle&) = delete;
+
+  int64_t load() const { return value_->load(std::memory_order_relaxed); }
+
+ protected:
+  friend class MetricsRegistry;
+
+  std::atomic<int64_t> local_{0};
+  std::atomic<int64_t>* value_ = &local_;
+};
+
+class Counter : public MetricHandle {
+ public:
+  void add(int64_t n = 1) {
+    value_->store(value_->load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+  }
+};
+
+class Gauge : public MetricHandle {
+ public:
+  void set(int64_t v) { value_->store(v, std::memory_order_relaxed); }
+};
+
+// Point-in-time reading of one metric
+struct MetricSample {
+  std::string name;
+  MetricKind kind;
+  int64_t value;
+};
+
+// Named page of counters and gauges, shared between processes.
+//
+// Writers bind() their handles to slots by name once, then publish with
+// plain stores; monitors (replay_top) map the same page read-only and
+// sample() it as often as they like without touching any writer's data
+// structures. A process that restarts re-binds to its old slots by name.
+// Names are unique per writer ("client.seq", "recorder.seq"); two live
+// writers must not bind the same name.
+class MetricsRegistry {
+ public:
+  enum class Access {
+    PUBLISH,  // Map read-write, create the page if missing
+    MONITOR   // Map an existing page read-only; bind() is refused
+  };
+
+  // Process-private page (not visible to other processes)
+  MetricsRegistry()
+      : owned_(std::make_unique<MetricsPage>()), page_(owned_.get()) {
+    page_->magic.store(METRICS_MAGIC, std::memory_order_relaxed);
+  }
+
+  ~MetricsRegistry() {
+    if (mapped_) {
+      munmap(page_, sizeof(MetricsPage));
+    }
+  }
+
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  // Map the shared-memory page shm_name. Returns nullptr (and logs) on
+  // failure, e.g. when a monitor finds no page.
+  static std::unique_ptr<MetricsRegistry> openShared(
+      const std::string& shm_name, Access access) {
+    bool publish = access == Access::PUBLISH;
+    int fd = shm_open(shm_name.c_str(), publish ? O_CREAT | O_RDWR : O_RDONLY,
+                      0666);
+    if (fd == -1) {
+      LOG_ERROR(replay::logger(), "Metrics shm_open {} failed: {}", shm_name,
+                strerror(errno));
+      return nullptr;
+    }
+    // ftruncate only ever grows a fresh (zero-length) page: it is a no-op
+    // when another process already sized it
+    if (publish && ftruncate(fd, sizeof(MetricsPage)) == -1) {
+      LOG_ERROR(replay::logger(), "Metrics ftruncate {} failed: {}", shm_name,
+                strerror(errno));
+      close(fd);
+      return nullptr;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) == -1 ||
+        static_cast<size_t>(st.st_size) < sizeof(MetricsPage)) {
+      LOG_ERROR(replay::logger(), "Metrics page {} has the wrong size",
+                shm_name);
+      close(fd);
+      return nullptr;
+    }
+    void* addr = mmap(nullptr, sizeof(MetricsPage),
+                      publish ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+                      fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      LOG_ERROR(replay::logger(), "Metrics mmap {} failed: {}", shm_name,
+                strerror(errno));
+      return nullptr;
+    }
+
+    std::unique_ptr<MetricsRegistry> registry(new MetricsRegistry(
+        static_cast<MetricsPage*>(addr), shm_name, publish));
+    if (publish) {
+      uint64_t expected = 0;
+      registry->page_->magic.compare_exchange_strong(expected, METRICS_MAGIC);
+    }
+    return registry;
+  }
+
+  // Remove the page's name (mappings stay valid until they are unmapped)
+  static void unlinkShared(const std::string& shm_name) {
+    shm_unlink(shm_name.c_str());
+  }
+
+  // Bind a handle to the slot called name, claiming one if none exists. The
+  // handle's current value is carried over. Returns false (the handle stays
+  // local) when the page is full, the name is too long or the registry is a
+  // monitor.
+  bool bind(Counter& handle, std::string_view name) {
+    return bindHandle(handle, name, MetricKind::COUNTER);
+  }
+
+  bool bind(Gauge& handle, std::string_view name) {
+    return bindHandle(handle, name, MetricKind::GAUGE);
+  }
+
+  // Read every published metric into out (cleared first; its capacity is
+  // reused). Returns false if the page was never initialized.
+  bool sample(std::vector<MetricSample>& out) const {
+    out.clear();
+    if (page_->magic.load(std::memory_order_acquire) != METRICS_MAGIC) {
+      return false;
+    }
+    for (const MetricSlot& slot : page_->slots) {
+      if (slot.state.load(std::memory_order_acquire) != MetricSlot::READY) {
+        continue;
+      }
+      out.push_back({std::string(slot.name, strnlen(slot.name,
+                                                    METRIC_NAME_SIZE)),
+                     static_cast<MetricKind>(slot.kind),
+                     slot.value.load(std::memory_order_relaxed)});
+    }
+    return true;
+  }
+
+  // Shared-memory name, empty for a process-private page
+  const std::string& getShmName() const { return shm_name_; }
+
+ private:
+  MetricsRegistry(MetricsPage* page, std::string shm_name, bool writable)
+      : page_(page),
+        shm_name_(std::move(shm_name)),
+        mapped_(true),
+        writable_(writable) {}
+
+  static bool nameEquals(const MetricSlot& slot, std::string_view name) {
+    return strnlen(slot.name, METRIC_NAME_SIZE) == name.size() &&
+           std::memcmp(slot.name, name.data(), name.size()) == 0;
+  }
+
+  bool bindHandle(MetricHandle& handle, std::string_view name,
+                  MetricKind kind) {
+    if (!writable_ || name.empty() || name.size() >= METRIC_NAME_SIZE) {
+      LOG_WARNING(replay::logger(), "Metric {} not published (monitor or bad "
+                  "name)", std::string(name));
+      return false;
+    }
+    MetricSlot* slot = claim(name, kind);
+    if (slot == nullptr) {
+      LOG_WARNING(replay::logger(), "Metrics page full, {} not published",
+                  std::string(name));
+      return false;
+    }
+    slot->value.store(handle.load(), std::memory_order_relaxed);
+    handle.value_ = &slot->value;
+    return true;
+  }
+
+  // Slot already named name (re-bind after a restart), else the first free
+  // slot. Slots are never released, so the first scan cannot miss a match
+  // that a concurrent claim publishes after it: such a race leaves two slots
+  // with one name, and the monitor shows both.
+  MetricSlot* claim(std::string_view name, MetricKind kind) {
+    for (MetricSlot& slot : page_->slots) {
+      if (slot.state.load(std::memory_order_acquire) == MetricSlot::READY &&
+          slot.kind == static_cast<uint32_t>(kind) && nameEquals(slot, name)) {
+        return &slot;
+      }
+    }
+    for (MetricSlot& slot : page_->slots) {
+      uint32_t expected = MetricSlot::FREE;
+      if (slot.state.compare_exchange_strong(expected, MetricSlot::CLAIMED,
+                                             std::memory_order_acquire)) {
+        slot.kind = static_cast<uint32_t>(kind);
+        std::memset(slot.name, 0, METRIC_NAME_SIZE);
+        std::memcpy(slot.name, name.data(), name.size());
+        slot.value.store(0, std::memory_order_relaxed);
+        slot.state.store(MetricSlot::READY, std::memory_order_release);
+        return &slot;
+      }
+    }
+    return nullptr;
+  }
+
+  std::unique_ptr<MetricsPage> owned_;  // Process-private page
+  MetricsPage* page_;
+  std::string shm_name_;
+  bool mapped_ = false;
+  bool writable_ = true;
+};
+
+}  // namespace replay
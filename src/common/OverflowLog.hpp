@@ -0,0 +1,162 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+
+#include "Logging.hpp"
+#include "Message.hpp"
+#include "Types.hpp"
+
+namespace replay {
+
+// Default overflow tier: 64M messages (2 GB of sparse file)
+constexpr size_t DEFAULT_OVERFLOW_CAPACITY = size_t(1) << 26;
+
+// File tag ("RPOVFLG1")
+constexpr uint64_t OVERFLOW_MAGIC = 0x52504F56464C4731ull;
+
+// Second-tier ring behind a RingBuffer: a file-backed mmap ring of much
+// larger capacity, filled by an OverflowRelay and read by RingBuffer::readEx()
+// once a message is gone from the primary ring.
+//
+// A slot is stamped with seq + 1 so that zero-filled (sparse, never written)
+// file pages read as empty: the file is created at full size and disk space
+// is only allocated for the pages the relay reaches. Slots are written under
+// a seqlock (stamp cleared, message copied, stamp set), so readers never
+// return a torn message.
+//
+// Single writer (the relay), any number of readers. The log starts empty on
+// every open: sequence numbers restart with each run.
+class OverflowLog {
+ public:
+  struct Header {
+    uint64_t magic;
+    uint64_t capacity;
+    char reserved[CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+  };
+
+  struct Slot {
+    Msg msg;
+    std::atomic<SeqNum> stamp;  // seq + 1, 0 = empty or being written
+  };
+
+  static_assert(sizeof(Header) == CACHE_LINE_SIZE);
+  static_assert(sizeof(Slot) == 32, "Two slots per cache line");
+
+  ~OverflowLog() {
+    if (header_ != nullptr) {
+      munmap(header_, mappedSize(capacity_));
+    }
+  }
+
+  OverflowLog(const OverflowLog&) = delete;
+  OverflowLog& operator=(const OverflowLog&) = delete;
+
+  // Create (or truncate) the log file at path and map it. capacity must be a
+  // power of two. Returns nullptr (and logs) on failure.
+  static std::unique_ptr<OverflowLog> create(const std::string& path,
+                                             size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      LOG_ERROR(replay::logger(),
+                "Overflow log capacity {} is not a power of two", capacity);
+      return nullptr;
+    }
+    int fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd == -1) {
+      LOG_ERROR(replay::logger(), "Overflow log open {} failed: {}", path,
+                strerror(errno));
+      return nullptr;
+    }
+    size_t size = mappedSize(capacity);
+    if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+      LOG_ERROR(replay::logger(), "Overflow log ftruncate {} failed: {}",
+                path, strerror(errno));
+      ::close(fd);
+      return nullptr;
+    }
+    void* addr =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      LOG_ERROR(replay::logger(), "Overflow log mmap {} failed: {}", path,
+                strerror(errno));
+      return nullptr;
+    }
+    // Written front to back, read slightly behind the writer
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    std::unique_ptr<OverflowLog> log(
+        new OverflowLog(static_cast<Header*>(addr), capacity, path));
+    log->header_->magic = OVERFLOW_MAGIC;
+    log->header_->capacity = capacity;
+    return log;
+  }
+
+  // Writer only: store a run of consecutive messages (seq_nums set)
+  void append(std::span<const Msg> messages) {
+    for (const Msg& msg : messages) {
+      Slot& slot = slots_[static_cast<size_t>(msg.seq_num) & (capacity_ - 1)];
+      slot.stamp.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.msg = msg;
+      slot.stamp.store(msg.seq_num + 1, std::memory_order_release);
+    }
+    if (!messages.empty()) {
+      next_seq_.store(messages.back().seq_num + 1, std::memory_order_release);
+    }
+  }
+
+  // Copy the message with sequence number seq into out. False when the log
+  // does not hold it (not relayed yet, lost by the relay, or overwritten
+  // within the log itself).
+  bool read(SeqNum seq, Msg& out) const {
+    if (seq < 0) {
+      return false;
+    }
+    const Slot& slot = slots_[static_cast<size_t>(seq) & (capacity_ - 1)];
+    if (slot.stamp.load(std::memory_order_acquire) != seq + 1) {
+      return false;
+    }
+    out = slot.msg;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.stamp.load(std::memory_order_relaxed) == seq + 1;
+  }
+
+  // One past the newest sequence number appended
+  SeqNum getNextSeq() const {
+    return next_seq_.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return capacity_; }
+  const std::string& getPath() const { return path_; }
+
+ private:
+  OverflowLog(Header* header, size_t capacity, std::string path)
+      : header_(header),
+        slots_(reinterpret_cast<Slot*>(header + 1)),
+        capacity_(capacity),
+        path_(std::move(path)),
+        next_seq_(0) {}
+
+  static size_t mappedSize(size_t capacity) {
+    return sizeof(Header) + capacity * sizeof(Slot);
+  }
+
+  Header* header_;
+  Slot* slots_;
+  size_t capacity_;
+  std::string path_;
+  std::atomic<SeqNum> next_seq_;
+};
+
+}  // namespace replay
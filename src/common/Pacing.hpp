@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "Types.hpp"
+
+namespace replay {
+
+// Monotonic clock for schedules (high_resolution_clock may be the wall clock,
+// which can jump)
+using PacingClock = std::chrono::steady_clock;
+
+// Final stretch before a deadline that is spun instead of slept. sleep_until
+// typically wakes 50-100 us late on Linux, so anything shorter than this is
+// left to the spin loop.
+constexpr int64_t DEFAULT_SPIN_THRESHOLD_NS = 100000;
+
+// Messages emitted more than this after their scheduled time count as late
+constexpr int64_t PACING_LATE_THRESHOLD_NS = 1000;
+
+// Pause hint for spin loops (keeps the sibling hyper-thread and power usage
+// reasonable while busy-waiting)
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// Hybrid sleep-then-spin wait.
+//
+// Sleeps (in slices, so cancel is honoured within MAX_SLEEP_SLICE) until
+// spin_threshold before the deadline, then busy-spins on the clock for the
+// rest. sleep_until alone is only accurate to the scheduler wakeup latency;
+// the spin tail gives sub-microsecond accuracy at the cost of one core for
+// at most spin_threshold per wait.
+//
+// Returns the clock reading that ended the wait (>= deadline), or
+// std::nullopt if cancel was raised before the deadline was reached.
+inline std::optional<PacingClock::time_point> waitUntil(
+    PacingClock::time_point deadline, Nanoseconds spin_threshold,
+    const std::atomic<bool>* cancel = nullptr) {
+  constexpr auto MAX_SLEEP_SLICE = std::chrono::milliseconds(10);
+
+  auto now = PacingClock::now();
+  while (deadline - now > spin_threshold) {
+    if (cancel && cancel->load(std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    auto wake = std::min<PacingClock::time_point>(deadline - spin_threshold,
+                                                  now + MAX_SLEEP_SLICE);
+    std::this_thread::sleep_until(wake);
+    now = PacingClock::now();
+  }
+
+  while (now < deadline) {
+    cpuRelax();
+    now = PacingClock::now();
+  }
+  return now;
+}
+
+// Schedule adherence of a paced emitter. Lateness is the time between a
+// message's scheduled emission and the moment the wait for it returned.
+struct PacingStats {
+  int64_t emitted_count = 0;
+  int64_t late_count = 0;             // Lateness > PACING_LATE_THRESHOLD_NS
+  int64_t total_lateness_ns = 0;
+  int64_t max_lateness_ns = 0;
+  int64_t last_lateness_ns = 0;       // Lateness of the most recent message
+  int64_t compressed_gap_count = 0;   // Idle gaps compressed or dropped
+  int64_t compressed_ns = 0;          // Recorded time removed from them
+
+  void recordEmit(int64_t lateness_ns) {
+    emitted_count++;
+    last_lateness_ns = lateness_ns;
+    total_lateness_ns += lateness_ns;
+    max_lateness_ns = std::max(max_lateness_ns, lateness_ns);
+    if (lateness_ns > PACING_LATE_THRESHOLD_NS) {
+      late_count++;
+    }
+  }
+
+  [[nodiscard]] double meanLatenessNs() const {
+    return emitted_count > 0 ? static_cast<double>(total_lateness_ns) /
+                                   static_cast<double>(emitted_count)
+                             : 0.0;
+  }
+
+  void reset() { *this = PacingStats{}; }
+};
+
+// What paced replay does with an idle gap (see PacingConfig::idle_gap_ns)
+enum class IdleGapPolicy : uint8_t {
+  COMPRESS = 0,  // Shortened to idle_gap_ns
+  DROP = 1,      // Removed: the next event is due right away
+};
+
+// Time-accurate replay settings (see PacingSchedule)
+struct PacingConfig {
+  // Multiplier on the recorded inter-arrival times: 1.0 reproduces the
+  // original timing, 10.0 plays ten times faster. <= 0 replays at max speed.
+  double speed = 1.0;
+
+  // Recorded gaps longer than this are idle gaps, handled by idle_gap_policy
+  // before scaling; shorter gaps keep their recorded length. < 0 keeps every
+  // gap as recorded.
+  int64_t idle_gap_ns = -1;
+  IdleGapPolicy idle_gap_policy = IdleGapPolicy::COMPRESS;
+
+  // Final part of each wait that is spun rather than slept
+  int64_t spin_threshold_ns = DEFAULT_SPIN_THRESHOLD_NS;
+};
+
+// Emission schedule of a paced replay.
+//
+// Event k is due at anchor + elapsed_k / speed, where elapsed_k is the
+// recorded time since the first event of the schedule with every idle gap
+// (longer than idle_gap_ns) compressed to idle_gap_ns or dropped to 0, and
+// negative gaps from out-of-order timestamps counted as 0. Deadlines are
+// absolute, so per-event wait error does not accumulate; an event that is
+// already overdue is emitted immediately and the schedule is not shifted,
+// letting replay catch up after a stall.
+class PacingSchedule {
+ public:
+  // Replace the configuration; re-anchors and clears the stats
+  void configure(const PacingConfig& config) {
+    config_ = config;
+    stats_.reset();
+    anchored_ = false;
+  }
+
+  // Start a new schedule at the next event (after a seek or reset)
+  void reanchor() { anchored_ = false; }
+
+  // Wait until the event recorded at timestamp_ns is due. Returns false if
+  // cancel was raised first; the event is then still due and the next call
+  // waits for it again.
+  bool wait(int64_t timestamp_ns, const std::atomic<bool>* cancel = nullptr) {
+    if (config_.speed <= 0.0) {
+      // Max speed: no schedule
+      stats_.recordEmit(0);
+      return true;
+    }
+
+    if (!anchored_) {
+      // First event of the schedule is due immediately
+      anchored_ = true;
+      anchor_ = PacingClock::now();
+      prev_ts_ = timestamp_ns;
+      elapsed_ns_ = 0;
+      stats_.recordEmit(0);
+      return true;
+    }
+
+    int64_t recorded_gap = std::max<int64_t>(0, timestamp_ns - prev_ts_);
+    int64_t gap = recorded_gap;
+    if (config_.idle_gap_ns >= 0 && gap > config_.idle_gap_ns) {
+      gap = config_.idle_gap_policy == IdleGapPolicy::DROP
+                ? 0
+                : config_.idle_gap_ns;
+    }
+
+    auto due_ns = static_cast<int64_t>(
+        static_cast<double>(elapsed_ns_ + gap) / config_.speed);
+    auto deadline = anchor_ + Nanoseconds(due_ns);
+    auto woke =
+        waitUntil(deadline, Nanoseconds(config_.spin_threshold_ns), cancel);
+    if (!woke) {
+      return false;
+    }
+
+    if (gap < recorded_gap) {
+      stats_.compressed_gap_count++;
+      stats_.compressed_ns += recorded_gap - gap;
+    }
+    elapsed_ns_ += gap;
+    prev_ts_ = timestamp_ns;
+    stats_.recordEmit((*woke - deadline).count());
+    return true;
+  }
+
+  const PacingConfig& config() const { return config_; }
+
+  // Schedule adherence so far
+  const PacingStats& stats() const { return stats_; }
+
+ private:
+  PacingConfig config_;
+  PacingStats stats_;
+  bool anchored_ = false;             // Schedule started
+  PacingClock::time_point anchor_{};  // Wall time of the first event
+  int64_t prev_ts_ = 0;               // timestamp_ns of the last event
+  int64_t elapsed_ns_ = 0;            // Recorded time since the anchor
+};
+
+}  // namespace replay
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace replay {
+
+// XOR compression of a payload column (Gorilla, Pelkonen et al. 2015).
+//
+// Each value is XORed with its predecessor. Prices that move a tick or two
+// change only a few low mantissa bits, so the XOR is mostly zeros:
+//
+//   first value   64 bits as is
+//   '0'           same value as the previous one (the fast path)
+//   '10' bits     meaningful bits of the XOR, inside the previous window
+//                 (at least as many leading and trailing zeros)
+//   '11' lz m bits  5-bit leading-zero count (capped at 31), 6-bit length of
+//                 the meaningful bits (0 = 64), then those bits
+//
+// Bits are packed MSB-first. The encoder appends XOR_PAD_BYTES zero bytes,
+// enough for every 64-bit load of one value (at most 77 bits) past the last
+// byte of encoded data: the decode loop has one bounds check per value
+// rather than per bit field, and one branch per window kind.
+
+// Zero bytes after the encoded bits
+constexpr size_t XOR_PAD_BYTES = 16;
+
+// MSB-first bit packer appending to a byte vector
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+  // Append the low n bits of bits (1 <= n <= 64)
+  void write(uint64_t bits, unsigned n) {
+    if (n > 32) {
+      write(bits >> 32, n - 32);
+      n = 32;
+    }
+    acc_ = (acc_ << n) | (bits & (~uint64_t(0) >> (64 - n)));
+    acc_bits_ += n;
+    while (acc_bits_ >= 8) {
+      acc_bits_ -= 8;
+      out_.push_back(static_cast<uint8_t>(acc_ >> acc_bits_));
+    }
+  }
+
+  // Flush the last partial byte (zero-filled)
+  void finish() {
+    if (acc_bits_ > 0) {
+      out_.push_back(static_cast<uint8_t>(acc_ << (8 - acc_bits_)));
+      acc_bits_ = 0;
+    }
+  }
+
+ private:
+  std::vector<uint8_t>& out_;
+  uint64_t acc_ = 0;  // Pending bits in the low acc_bits_ (< 8 between calls)
+  unsigned acc_bits_ = 0;
+};
+
+// MSB-first bit reader; needs 8 readable bytes past any position it reads
+class BitReader {
+ public:
+  explicit BitReader(const uint8_t* data) : data_(data) {}
+
+  // Next n bits (1 <= n <= 57)
+  uint64_t read(unsigned n) {
+    uint64_t word;
+    std::memcpy(&word, data_ + (bit_pos_ >> 3), sizeof(word));
+    if constexpr (std::endian::native == std::endian::little) {
+      word = __builtin_bswap64(word);
+    }
+    word <<= bit_pos_ & 7;
+    bit_pos_ += n;
+    return word >> (64 - n);
+  }
+
+  // Next n bits (1 <= n <= 64)
+  uint64_t readWide(unsigned n) {
+    if (n <= 57) {
+      return read(n);
+    }
+    uint64_t high = read(n - 32);
+    return (high << 32) | read(32);
+  }
+
+  size_t bytePosition() const { return (bit_pos_ + 7) >> 3; }
+
+ private:
+  const uint8_t* data_;
+  size_t bit_pos_ = 0;
+};
+
+// Append the encoding of n values (get(i) returns value i) to out, padding
+// included. Returns the number of bytes appended.
+template <typename Get>
+size_t xorEncode(size_t n, Get&& get, std::vector<uint8_t>& out) {
+  size_t start = out.size();
+  if (n == 0) {
+    return 0;
+  }
+  BitWriter writer(out);
+
+  uint64_t prev = std::bit_cast<uint64_t>(static_cast<double>(get(0)));
+  writer.write(prev, 64);
+  unsigned window_leading = 64;  // No window yet
+  unsigned window_trailing = 0;
+
+  for (size_t i = 1; i < n; ++i) {
+    uint64_t value = std::bit_cast<uint64_t>(static_cast<double>(get(i)));
+    uint64_t x = value ^ prev;
+    prev = value;
+    if (x == 0) {
+      writer.write(0, 1);
+      continue;
+    }
+
+    auto leading = static_cast<unsigned>(std::countl_zero(x));
+    auto trailing = static_cast<unsigned>(std::countr_zero(x));
+    if (window_leading != 64 && leading >= window_leading &&
+        trailing >= window_trailing) {
+      writer.write(0b10, 2);
+      writer.write(x >> window_trailing,
+                   64 - window_leading - window_trailing);
+      continue;
+    }
+
+    leading = leading > 31 ? 31 : leading;
+    unsigned meaningful = 64 - leading - trailing;
+    writer.write(0b11, 2);
+    writer.write(leading, 5);
+    writer.write(meaningful & 63, 6);
+    writer.write(x >> trailing, meaningful);
+    window_leading = leading;
+    window_trailing = trailing;
+  }
+
+  writer.finish();
+  out.insert(out.end(), XOR_PAD_BYTES, 0);
+  return out.size() - start;
+}
+
+// Decode n values from bytes of encoded data (as written by xorEncode(),
+// padding included), calling put(i, value) for each. Returns false if the
+// encoding runs past the data.
+template <typename Put>
+bool xorDecode(const uint8_t* data, size_t bytes, size_t n, Put&& put) {
+  if (n == 0) {
+    return true;
+  }
+  if (bytes < sizeof(uint64_t) + XOR_PAD_BYTES) {
+    return false;
+  }
+  const size_t limit = bytes - XOR_PAD_BYTES;
+  BitReader reader(data);
+
+  uint64_t value = reader.readWide(64);
+  put(0, std::bit_cast<double>(value));
+  unsigned window_trailing = 0;
+  unsigned window_bits = 0;
+
+  for (size_t i = 1; i < n; ++i) {
+    if (reader.bytePosition() > limit) {
+      return false;  // Ran past the encoded data
+    }
+    if (reader.read(1) != 0) {
+      if (reader.read(1) != 0) {
+        uint64_t header = reader.read(11);
+        auto leading = static_cast<unsigned>(header >> 6);
+        window_bits = static_cast<unsigned>(header & 63);
+        window_bits = window_bits == 0 ? 64 : window_bits;
+        if (leading + window_bits > 64) {
+          return false;
+        }
+        window_trailing = 64 - leading - window_bits;
+      } else if (window_bits == 0) {
+        return false;  // '10' before any window
+      }
+      value ^= reader.readWide(window_bits) << window_trailing;
+    }
+    put(i, std::bit_cast<double>(value));
+  }
+  return reader.bytePosition() <= limit;
+}
+
+}  // namespace replay
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#include "Message.hpp"
+#include "Types.hpp"
+
+namespace replay {
+
+// Record types
+// RingBuffer, the channel interfaces, RecordFileChannel/RecordFileWriteChannel
+// and MktDataRecorder are templates over the record they carry. A record is a
+// trivially copyable, standard-layout struct with a SeqNum seq_num (assigned
+// by the ring) and an int64_t timestamp_ns, and a schema id that identifies
+// its layout in recording headers (RecordSchema, from a static SCHEMA_ID
+// member by default). Its size and alignment fix the ring's slot layout and
+// the file's record stride at compile time, so Msg keeps its 24-byte path
+// unchanged.
+
+template <typename T>
+struct RecordSchema {
+  static constexpr uint32_t ID = T::SCHEMA_ID;
+};
+
+template <>
+struct RecordSchema<Msg> {
+  static constexpr uint32_t ID = SCHEMA_MSG;
+};
+
+template <typename T>
+concept Record =
+    std::is_trivially_copyable_v<T> && std::is_standard_layout_v<T> &&
+    std::is_default_constructible_v<T> && requires(T record) {
+      { record.seq_num } -> std::same_as<SeqNum&>;
+      { record.timestamp_ns } -> std::same_as<int64_t&>;
+      { RecordSchema<T>::ID } -> std::convertible_to<uint32_t>;
+    };
+
+static_assert(Record<Msg>);
+
+// Number of records at the front of records whose seq_nums are consecutive
+// (0 if it is empty). pushBatch() numbers a ring's records consecutively, but
+// a ring fed by pushBatchKeepSeq() carries the feed's own seq_nums, which may
+// skip or repeat within one readBatch() run.
+template <Record T>
+size_t consecutiveRun(std::span<const T> records) {
+  size_t run = records.empty() ? 0 : 1;
+  while (run < records.size() &&
+         records[run].seq_num == records[run - 1].seq_num + 1) {
+    ++run;
+  }
+  return run;
+}
+
+// A record of one instrument, identified by its instrument_id. Record files
+// of such records carry an instrument index (see channel/InstrumentIndex.hpp).
+template <typename T>
+concept InstrumentRecord = Record<T> && requires(const T record) {
+  { record.instrument_id } -> std::convertible_to<uint32_t>;
+};
+
+// Side of a trade or quote update
+enum class Side : uint8_t { NONE = 0, BID = 1, ASK = 2 };
+
+// Tick flags
+constexpr uint8_t TICK_FLAG_TRADE = 0x01;     // Trade (else a quote update)
+constexpr uint8_t TICK_FLAG_SNAPSHOT = 0x02;  // Part of a book snapshot
+constexpr uint8_t TICK_FLAG_LAST = 0x04;      // Last of an exchange packet
+
+// Market data tick as real feeds deliver it: 40 bytes
+struct alignas(8) TickRecord {
+  static constexpr uint32_t SCHEMA_ID = SCHEMA_TICK;
+
+  SeqNum seq_num = INVALID_SEQ;  // Sequence number (8 bytes)
+  int64_t timestamp_ns = 0;      // Nanosecond timestamp (8 bytes)
+  double price = 0.0;            // Price (8 bytes)
+  int64_t size = 0;              // Quantity (8 bytes)
+  uint32_t instrument_id = 0;    // Instrument (4 bytes)
+  Side side = Side::NONE;        // Side (1 byte)
+  uint8_t flags = 0;             // TICK_FLAG_* (1 byte)
+  uint16_t reserved = 0;         // Zero (2 bytes)
+
+  constexpr bool operator==(const TickRecord&) const = default;
+};
+
+static_assert(sizeof(TickRecord) == 40, "TickRecord size must be 40 bytes");
+static_assert(Record<TickRecord>);
+static_assert(InstrumentRecord<TickRecord>);
+static_assert(!InstrumentRecord<Msg>);
+
+}  // namespace replay
@@ -1,22 +1,30 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstring>
 #include <optional>
 #include <span>
+#include <type_traits>
 
+#include "ConsumerTable.hpp"
 #include "Message.hpp"
+#include "OverflowLog.hpp"
+#include "Record.hpp"
 #include "Types.hpp"
 
 namespace replay {
 
 // Result of a read operation with explicit status
-struct ReadResult {
+template <typename T>
+struct BasicReadResult {
   ReadStatus status;
-  Msg msg;  // Only valid when status == ReadStatus::OK
+  T msg;  // Only valid when status == ReadStatus::OK
 };
 
+using ReadResult = BasicReadResult<Msg>;
+
 // Lock-free SPMC (Single Producer Multiple Consumer) ring buffer
 // Uses sequence numbers as indices, supports independent reading by multiple
 // consumers
@@ -30,14 +38,29 @@ struct ReadResult {
 //          (a) the exact message at expected_seq (OK),
 //          (b) a newer message (OVERWRITTEN — consumer was lapped), or
 //          (c) INVALID_SEQ / older seq (NOT_READY — producer hasn't reached here)
-template <size_t Capacity = DEFAULT_RING_BUFFER_SIZE>
+//
+// Consumers may register in the ring's ConsumerTable and publish their
+// cursor; the producer then tells slot reuse (getOverwriteCount()) apart from
+// messages a live consumer actually lost (getLappedCount()).
+//
+// With an OverflowLog attached (see attachOverflow()), a message that is gone
+// from the ring is looked up there before readEx() reports OVERWRITTEN.
+//
+// T is the record carried (Msg by default, see common/Record.hpp). Each slot
+// holds one record and its published sequence number, aligned and padded to
+// whole cache lines: one line up to 56-byte records.
+template <size_t Capacity = DEFAULT_RING_BUFFER_SIZE, Record T = Msg>
 class RingBuffer {
   static_assert(Capacity > 0, "Capacity must be positive");
   static_assert((Capacity & (Capacity - 1)) == 0,
                 "Capacity must be a power of 2 for bitmask indexing");
 
  public:
-  RingBuffer() : write_seq_(0), overwrite_count_(0) {
+  using RecordType = T;
+  using ReadResultType = BasicReadResult<T>;
+
+  RingBuffer()
+      : write_seq_(0), overwrite_count_(0), lap_tracker_(), consumers_() {
     // Initialize all slots
     for (auto& slot : buffer_) {
       slot.seq.store(INVALID_SEQ, std::memory_order_relaxed);
@@ -57,7 +80,7 @@ class RingBuffer {
   // overwrite the oldest slot. This is the correct trade-off for a market data
   // server that must not stall. Consumers detect loss via readEx() returning
   // OVERWRITTEN.
-  SeqNum push(const Msg& msg) {
+  SeqNum push(const T& msg) {
     SeqNum seq = write_seq_.fetch_add(1, std::memory_order_relaxed);
     size_t index = seq & (Capacity - 1);
 
@@ -69,6 +92,7 @@ class RingBuffer {
     SeqNum old_seq = slot.seq.load(std::memory_order_acquire);
     if (old_seq != INVALID_SEQ) {
       overwrite_count_.fetch_add(1, std::memory_order_relaxed);
+      lap_tracker_.onOverwrite(consumers_, old_seq);
     }
 
     // Write message data
@@ -84,35 +108,15 @@ class RingBuffer {
   // Batch write messages using std::span
   // Returns the first sequence number of the batch, or INVALID_SEQ if batch is
   // empty
-  SeqNum pushBatch(std::span<const Msg> messages) {
-    if (messages.empty()) {
-      return INVALID_SEQ;
-    }
-
-    // Reserve sequence numbers atomically for the entire batch
-    SeqNum first_seq = write_seq_.fetch_add(
-        static_cast<SeqNum>(messages.size()), std::memory_order_relaxed);
-
-    // Write all messages to their slots
-    for (size_t i = 0; i < messages.size(); ++i) {
-      SeqNum seq = first_seq + static_cast<SeqNum>(i);
-      size_t index = seq & (Capacity - 1);
-      Slot& slot = buffer_[index];
-
-      SeqNum old_seq = slot.seq.load(std::memory_order_acquire);
-      if (old_seq != INVALID_SEQ) {
-        overwrite_count_.fetch_add(1, std::memory_order_relaxed);
-      }
-
-      // Write message data
-      slot.msg = messages[i];
-      slot.msg.seq_num = seq;
-
-      // Publish message
-      slot.seq.store(seq, std::memory_order_release);
-    }
+  SeqNum pushBatch(std::span<const T> messages) {
+    return pushBatchImpl<false>(messages);
+  }
 
-    return first_seq;
+  // Like pushBatch(), but each message keeps its own seq_num (e.g. the feed
+  // sequence of an A/B line); only the slot comes from the ring sequence,
+  // which readers index by as usual. Returns the first ring sequence used.
+  SeqNum pushBatchKeepSeq(std::span<const T> messages) {
+    return pushBatchImpl<true>(messages);
   }
 
   // Extended read: returns explicit status so consumer can distinguish
@@ -130,7 +134,10 @@ class RingBuffer {
   //           past our position by at least one full wrap. → OVERWRITTEN
   //   Case 3: seq < expected_seq or INVALID_SEQ → the producer hasn't
   //           written this slot yet. → NOT_READY
-  ReadResult readEx(SeqNum expected_seq) const {
+  //
+  // Cases 1 (torn) and 2 fall through to the overflow log when one is
+  // attached; OVERWRITTEN then means the message is gone from both tiers.
+  ReadResultType readEx(SeqNum expected_seq) const {
     if (expected_seq < 0) {
       return {ReadStatus::NOT_READY, {}};
     }
@@ -142,7 +149,7 @@ class RingBuffer {
 
     if (published_seq == expected_seq) {
       // Copy message to a local variable before the second check.
-      Msg local_msg = slot.msg;
+      T local_msg = slot.msg;
 
       // Seqlock double-check: an acquire fence ensures the copy of msg
       // is fully visible before we re-read the sequence number.
@@ -153,17 +160,35 @@ class RingBuffer {
         return {ReadStatus::OK, local_msg};
       }
       // Slot was overwritten between the two checks — data is torn.
-      return {ReadStatus::OVERWRITTEN, {}};
+      return readOverflow(expected_seq);
     } else if (published_seq > expected_seq) {
-      return {ReadStatus::OVERWRITTEN, {}};
+      return readOverflow(expected_seq);
     } else {
       return {ReadStatus::NOT_READY, {}};
     }
   }
 
-  // Legacy read interface — returns std::optional<Msg>.
+  // Batch read: copy up to out.size() messages from consecutive ring
+  // sequence numbers starting at from_seq, stopping at the first slot that
+  // is not OK. Each slot is read with readEx(). A message's seq_num is
+  // whatever was pushed: the ring sequence after pushBatch(), the feed's own
+  // seq_num after pushBatchKeepSeq(). Returns the number copied; the caller
+  // inspects the stopping slot with readEx().
+  size_t readBatch(SeqNum from_seq, std::span<T> out) const {
+    size_t count = 0;
+    for (; count < out.size(); ++count) {
+      auto result = readEx(from_seq + static_cast<SeqNum>(count));
+      if (result.status != ReadStatus::OK) {
+        break;
+      }
+      out[count] = result.msg;
+    }
+    return count;
+  }
+
+  // Legacy read interface — returns std::optional<T>.
   // Cannot distinguish NOT_READY from OVERWRITTEN; prefer readEx() for new code.
-  std::optional<Msg> read(SeqNum expected_seq) const {
+  std::optional<T> read(SeqNum expected_seq) const {
     auto result = readEx(expected_seq);
     if (result.status == ReadStatus::OK) {
       return result.msg;
@@ -173,7 +198,7 @@ class RingBuffer {
 
   // Try to read message, returns empty if message at current sequence number is
   // unavailable
-  std::optional<Msg> tryRead(SeqNum expected_seq) const {
+  std::optional<T> tryRead(SeqNum expected_seq) const {
     return read(expected_seq);
   }
 
@@ -187,6 +212,14 @@ class RingBuffer {
     return write_seq_.load(std::memory_order_acquire);
   }
 
+  // Get oldest sequence number still resident in the buffer (the lower edge
+  // of the window [latest - Capacity + 1, latest]). Returns 0 when nothing has
+  // wrapped yet. Point-in-time snapshot: the window keeps moving forward.
+  SeqNum getOldestSeq() const {
+    return std::max(SeqNum(0),
+                    getLatestSeq() - static_cast<SeqNum>(Capacity) + 1);
+  }
+
   // Check if message at specified sequence number is available.
   // Note: this is a point-in-time snapshot; the slot may be overwritten
   // immediately after this returns true.
@@ -199,6 +232,22 @@ class RingBuffer {
   // Get buffer capacity
   static constexpr size_t capacity() { return Capacity; }
 
+  // Bytes per slot (record and published sequence, whole cache lines)
+  static constexpr size_t slotSize() { return sizeof(Slot); }
+
+  // Second tier for messages overwritten in the ring (nullptr detaches).
+  // Attach before consumers start; the log must outlive the ring's readers.
+  // The log holds Msg records, so only a Msg ring can have one.
+  void attachOverflow(const OverflowLog* log)
+    requires std::is_same_v<T, Msg>
+  {
+    overflow_.store(log, std::memory_order_release);
+  }
+
+  const OverflowLog* getOverflow() const {
+    return overflow_.load(std::memory_order_acquire);
+  }
+
   // Get approximate number of messages in buffer
   size_t size() const {
     SeqNum latest = getLatestSeq();
@@ -207,27 +256,94 @@ class RingBuffer {
   }
 
   // Get total number of slot overwrites since creation.
-  // After the first Capacity messages, every push increments this counter.
-  // Useful as a system-level indicator of buffer pressure.
+  // After the first Capacity messages, every push increments this counter,
+  // whether or not anyone still needed the message (see getLappedCount()).
   int64_t getOverwriteCount() const {
     return overwrite_count_.load(std::memory_order_relaxed);
   }
 
+  // Messages overwritten before a live registered consumer read them
+  // (approximate, see LapTracker). 0 while every consumer keeps up.
+  int64_t getLappedCount() const { return lap_tracker_.getLappedCount(); }
+
+  // Registered consumers: cursors, heartbeats, per-consumer lapped counts
+  ConsumerTable& consumers() { return consumers_; }
+  const ConsumerTable& consumers() const { return consumers_; }
+
+  // Messages the consumer with this cursor has yet to read
+  int64_t lagOf(SeqNum cursor) const { return getNextWriteSeq() - cursor; }
+
  private:
   // Cache line size (64 bytes on most x86 CPUs)
   static constexpr size_t CACHE_LINE_SIZE = 64;
 
-  // Slot structure, contains message and sequence number
+  // pushBatch() (KeepSeq false) and pushBatchKeepSeq()
+  template <bool KeepSeq>
+  SeqNum pushBatchImpl(std::span<const T> messages) {
+    if (messages.empty()) {
+      return INVALID_SEQ;
+    }
+
+    // Reserve sequence numbers atomically for the entire batch
+    SeqNum first_seq = write_seq_.fetch_add(
+        static_cast<SeqNum>(messages.size()), std::memory_order_relaxed);
+
+    // Write all messages to their slots. Overwrites are counted locally and
+    // added once, keeping the shared counter's cache line out of the loop.
+    int64_t overwrites = 0;
+    SeqNum last_overwritten = INVALID_SEQ;
+    for (size_t i = 0; i < messages.size(); ++i) {
+      SeqNum seq = first_seq + static_cast<SeqNum>(i);
+      size_t index = seq & (Capacity - 1);
+      Slot& slot = buffer_[index];
+
+      SeqNum old_seq = slot.seq.load(std::memory_order_acquire);
+      overwrites += (old_seq != INVALID_SEQ);
+      last_overwritten = std::max(last_overwritten, old_seq);
+
+      // Write message data
+      slot.msg = messages[i];
+      if constexpr (!KeepSeq) {
+        slot.msg.seq_num = seq;
+      }
+
+      // Publish message
+      slot.seq.store(seq, std::memory_order_release);
+    }
+    if (overwrites > 0) {
+      overwrite_count_.fetch_add(overwrites, std::memory_order_relaxed);
+      lap_tracker_.onOverwrite(consumers_, last_overwritten);
+    }
+
+    return first_seq;
+  }
+
+  // Overwritten in the ring: the overflow log's copy, if it has one
+  ReadResultType readOverflow(SeqNum expected_seq) const {
+    if constexpr (std::is_same_v<T, Msg>) {
+      const OverflowLog* log = overflow_.load(std::memory_order_acquire);
+      Msg msg;
+      if (log != nullptr && log->read(expected_seq, msg)) {
+        return {ReadStatus::OK, msg};
+      }
+    }
+    return {ReadStatus::OVERWRITTEN, {}};
+  }
+
+  // Slot structure, contains message and sequence number. The alignment
+  // pads it to whole cache lines to avoid false sharing.
   struct alignas(CACHE_LINE_SIZE) Slot {
-    Msg msg;
+    T msg;
     std::atomic<SeqNum> seq;
-    // Pad to fill exactly one cache line to avoid false sharing
-    char padding[CACHE_LINE_SIZE - sizeof(Msg) - sizeof(std::atomic<SeqNum>)];
 
     Slot() : seq(INVALID_SEQ) {}
   };
-  static_assert(sizeof(Slot) == CACHE_LINE_SIZE,
-                "Slot must be exactly one cache line to avoid false sharing");
+  static_assert(alignof(T) <= CACHE_LINE_SIZE,
+                "Record alignment must not exceed a cache line");
+  static_assert(sizeof(Slot) % CACHE_LINE_SIZE == 0,
+                "Slot must fill whole cache lines to avoid false sharing");
+  static_assert(!std::is_same_v<T, Msg> || sizeof(Slot) == CACHE_LINE_SIZE,
+                "Msg slots must be exactly one cache line");
 
   // Buffer array
   std::array<Slot, Capacity> buffer_;
@@ -237,6 +353,15 @@ class RingBuffer {
 
   // Count of slot overwrites (producer-side metric)
   alignas(CACHE_LINE_SIZE) std::atomic<int64_t> overwrite_count_;
+
+  // Lapped-message detection (producer only, same cache line as the metric)
+  LapTracker lap_tracker_;
+
+  // Consumer cursors and heartbeats (one cache line per consumer)
+  ConsumerTable consumers_;
+
+  // Optional second tier, read only on the overwritten path
+  std::atomic<const OverflowLog*> overflow_{nullptr};
 };
 
 // Consumer cursor, each consumer maintains independent read position
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define REPLAY_TSC_X86 1
+#endif
+
+#include "Types.hpp"
+
+namespace replay {
+
+// Length of the initial calibration (TSC ticks vs system clock)
+constexpr int64_t TSC_CALIBRATION_WINDOW_NS = 5000000;  // 5 ms
+
+// Period of the background recalibration
+constexpr int64_t TSC_RECALIBRATION_INTERVAL_NS = 1000000000;  // 1 s
+
+// Largest rate correction applied per recalibration interval; larger errors
+// are slewed out over several intervals so the clock never jumps back
+constexpr double TSC_MAX_SLEW = 500e-6;  // 500 ppm
+
+// An error beyond this means the system clock was stepped (settimeofday,
+// NTP step): the TSC clock is re-anchored instead of slewed
+constexpr int64_t TSC_STEP_THRESHOLD_NS = 1000000;  // 1 ms
+
+// Conversion from TSC ticks to epoch nanoseconds:
+//   ns = base_ns + ((tsc - base_tsc) * mult) >> TSC_MULT_SHIFT
+// mult == 0 means "not calibrated": readers use the system clock.
+constexpr int TSC_MULT_SHIFT = 32;
+
+namespace detail {
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef __int128 TscInt128;
+__extension__ typedef unsigned __int128 TscUint128;
+#endif
+
+// floor(delta * mult / 2^TSC_MULT_SHIFT) without 128-bit integers: the
+// full 128-bit product |delta| * mult is built from 32-bit halves with every
+// carry kept, so it is exact for any delta and mult whose result fits in
+// int64_t (the same range as the __int128 version)
+inline int64_t tscMulShiftSplit(int64_t delta, uint64_t mult) {
+  uint64_t a = delta < 0 ? 0 - static_cast<uint64_t>(delta)
+                         : static_cast<uint64_t>(delta);
+  uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+  uint64_t m_lo = mult & 0xFFFFFFFF, m_hi = mult >> 32;
+  uint64_t p0 = a_lo * m_lo;
+  uint64_t p1 = a_lo * m_hi;
+  uint64_t p2 = a_hi * m_lo;
+  uint64_t p3 = a_hi * m_hi;
+  // Bits 32..63 of the product plus carries; at most 3 * (2^32 - 1)
+  uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFF) + (p2 & 0xFFFFFFFF);
+  uint64_t high = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+  uint64_t shifted = (high << 32) | (mid & 0xFFFFFFFF);
+  auto result = static_cast<int64_t>(shifted);
+  // Round towards minus infinity like the arithmetic shift
+  return delta < 0 ? -result - ((p0 & 0xFFFFFFFF) != 0) : result;
+}
+
+// floor(delta * mult / 2^TSC_MULT_SHIFT)
+inline int64_t tscMulShift(int64_t delta, uint64_t mult) {
+#if defined(__SIZEOF_INT128__)
+  return static_cast<int64_t>(
+      (static_cast<TscInt128>(delta) * static_cast<TscInt128>(mult)) >>
+      TSC_MULT_SHIFT);
+#else
+  return tscMulShiftSplit(delta, mult);
+#endif
+}
+
+// (ns << TSC_MULT_SHIFT) / ticks, for ns >= 0 and ticks > 0
+inline uint64_t tscShiftDiv(uint64_t ns, uint64_t ticks) {
+#if defined(__SIZEOF_INT128__)
+  return static_cast<uint64_t>((static_cast<TscUint128>(ns) << TSC_MULT_SHIFT) /
+                               ticks);
+#else
+  // Long division, one quotient bit per shifted-in zero
+  uint64_t q = ns / ticks;
+  uint64_t r = ns % ticks;
+  for (int i = 0; i < TSC_MULT_SHIFT; ++i) {
+    q <<= 1;
+    if (r >= ticks - r) {
+      r -= ticks - r;
+      q |= 1;
+    } else {
+      r <<= 1;
+    }
+  }
+  return q;
+#endif
+}
+
+}  // namespace detail
+
+struct TscParams {
+  uint64_t base_tsc = 0;
+  int64_t base_ns = 0;
+  uint64_t mult = 0;
+
+  [[nodiscard]] int64_t toNs(uint64_t tsc) const {
+    return base_ns +
+           detail::tscMulShift(static_cast<int64_t>(tsc - base_tsc), mult);
+  }
+};
+
+// Published calibration, read by any number of threads or processes.
+//
+// Seqlock: the single writer makes version odd while it updates the fields,
+// readers retry until they see the same even version before and after. All
+// fields are lock-free atomics and the all-zero state means "not
+// calibrated", so the struct can live in zero-filled shared memory without
+// construction.
+struct alignas(64) TscCalibration {
+  std::atomic<uint64_t> version{0};
+  std::atomic<uint64_t> base_tsc{0};
+  std::atomic<int64_t> base_ns{0};
+  std::atomic<uint64_t> mult{0};
+
+  TscParams load() const {
+    for (;;) {
+      uint64_t v0 = version.load(std::memory_order_acquire);
+      if ((v0 & 1) == 0) {
+        TscParams params;
+        params.base_tsc = base_tsc.load(std::memory_order_relaxed);
+        params.base_ns = base_ns.load(std::memory_order_relaxed);
+        params.mult = mult.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version.load(std::memory_order_relaxed) == v0) {
+          return params;
+        }
+      }
+    }
+  }
+
+  // Single writer only
+  void store(const TscParams& params) {
+    uint64_t v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    base_tsc.store(params.base_tsc, std::memory_order_relaxed);
+    base_ns.store(params.base_ns, std::memory_order_relaxed);
+    mult.store(params.mult, std::memory_order_relaxed);
+    version.store(v + 2, std::memory_order_release);
+  }
+};
+
+// Low-overhead epoch-nanosecond clock from the invariant TSC.
+//
+// A read is one rdtsc plus a multiply-shift (a few ns) instead of a vDSO
+// clock_gettime (~20 ns). The OWNER calibrates the tick rate against the
+// system clock, publishes the parameters into a TscCalibration and keeps
+// them in line from a background thread. A recalibration corrects drift by
+// adjusting the rate for the next interval (bounded by TSC_MAX_SLEW) and
+// keeps the clock continuous, so slewing never moves readings backwards. An
+// error above TSC_STEP_THRESHOLD_NS (the system clock was stepped) re-anchors
+// the clock on the system time instead, and readings taken across that
+// update can go backwards by up to the step. A READER only converts with
+// the published parameters, which lets several processes share one
+// calibration through shared memory and stamp messages on the same time
+// base.
+//
+// Without an invariant TSC (or off x86-64) the clock is never calibrated and
+// nowNs() falls back to getCurrentTimestampNs().
+class TscClock {
+ public:
+  enum class Role {
+    OWNER,  // Calibrates and runs the recalibration thread
+    READER  // Uses whatever the owner publishes
+  };
+
+  TscClock(TscCalibration& calibration, Role role)
+      : calibration_(calibration), stop_requested_(false) {
+    if (role == Role::OWNER && isInvariantTscSupported()) {
+      calibrate();
+      thread_ = std::thread(&TscClock::recalibrationLoop, this);
+    }
+  }
+
+  ~TscClock() { stopRecalibration(); }
+
+  TscClock(const TscClock&) = delete;
+  TscClock& operator=(const TscClock&) = delete;
+
+  // Process-wide calibration, read by tscTimestampNs(). Constant-initialized
+  // to "not calibrated" (system clock) until global() is first called.
+  static TscCalibration& globalCalibration() {
+    static constinit TscCalibration calibration;
+    return calibration;
+  }
+
+  // Process-wide clock, the owner of globalCalibration(). The first call
+  // calibrates (a TSC_CALIBRATION_WINDOW_NS sleep), so processes make it at
+  // startup; tscTimestampNs() itself never calibrates.
+  static TscClock& global() {
+    static TscClock clock(globalCalibration(), Role::OWNER);
+    return clock;
+  }
+
+  // Whether the CPU advertises a constant-rate TSC that keeps counting in
+  // deep C-states (CPUID 0x80000007 EDX bit 8)
+  static bool isInvariantTscSupported() {
+#ifdef REPLAY_TSC_X86
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+      return (edx & (1u << 8)) != 0;
+    }
+#endif
+    return false;
+  }
+
+  static uint64_t readTsc() {
+#ifdef REPLAY_TSC_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  // Current time in epoch nanoseconds
+  int64_t nowNs() const { return nowNs(calibration_); }
+
+  // Current time in epoch nanoseconds from calibration, without a clock
+  static int64_t nowNs(const TscCalibration& calibration) {
+#ifdef REPLAY_TSC_X86
+    TscParams params = calibration.load();
+    if (params.mult != 0) {
+      return params.toNs(readTsc());
+    }
+#endif
+    return getCurrentTimestampNs();
+  }
+
+  // Whether readings come from the TSC (false = system clock fallback)
+  bool usesTsc() const { return calibration_.load().mult != 0; }
+
+  TscParams getParams() const { return calibration_.load(); }
+
+  // Stop the background thread (owner only; parameters stay valid). Must be
+  // called before unmapping shared memory that holds the calibration.
+  void stopRecalibration() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_requested_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+ private:
+  struct Sample {
+    uint64_t tsc;
+    int64_t ns;
+  };
+
+  // Simultaneous (TSC, system clock) reading. The pair with the tightest
+  // bracketing rdtsc/rdtscp of a few attempts is kept; its midpoint is the
+  // best estimate of when the system clock was read.
+  static Sample sample() {
+    Sample best{0, 0};
+#ifdef REPLAY_TSC_X86
+    uint64_t best_width = ~0ull;
+    for (int i = 0; i < 8; ++i) {
+      unsigned int aux;
+      uint64_t t0 = __rdtsc();
+      int64_t ns = getCurrentTimestampNs();
+      uint64_t t1 = __rdtscp(&aux);
+      if (t1 - t0 < best_width) {
+        best_width = t1 - t0;
+        best = {t0 + (t1 - t0) / 2, ns};
+      }
+    }
+#endif
+    return best;
+  }
+
+  // mult for the ticks -> ns rate between two samples
+  static uint64_t rateMult(const Sample& from, const Sample& to) {
+    uint64_t ticks = to.tsc - from.tsc;
+    int64_t ns = to.ns - from.ns;
+    if (ticks == 0 || ns <= 0) {
+      return 0;
+    }
+    return detail::tscShiftDiv(static_cast<uint64_t>(ns), ticks);
+  }
+
+  void calibrate() {
+    Sample start = sample();
+    std::this_thread::sleep_for(Nanoseconds(TSC_CALIBRATION_WINDOW_NS));
+    last_sample_ = sample();
+    uint64_t mult = rateMult(start, last_sample_);
+    if (mult != 0) {
+      calibration_.store({last_sample_.tsc, last_sample_.ns, mult});
+    }
+  }
+
+  // Re-measure the tick rate over the last interval and aim the clock at
+  // the system clock one interval ahead, starting from where the current
+  // parameters put it now. The rate is taken from the previous sample rather
+  // than the first one so that NTP slewing of the system clock is followed
+  // within one interval.
+  void recalibrate() {
+    TscParams current = calibration_.load();
+    Sample now = sample();
+    uint64_t rate = rateMult(last_sample_, now);
+    if (current.mult == 0 || rate == 0) {
+      return;
+    }
+    last_sample_ = now;
+
+    int64_t clock_ns = current.toNs(now.tsc);
+    int64_t error_ns = now.ns - clock_ns;
+    if (error_ns > TSC_STEP_THRESHOLD_NS || error_ns < -TSC_STEP_THRESHOLD_NS) {
+      calibration_.store({now.tsc, now.ns, rate});
+      return;
+    }
+
+    double correction =
+        std::clamp(static_cast<double>(error_ns) /
+                       static_cast<double>(TSC_RECALIBRATION_INTERVAL_NS),
+                   -TSC_MAX_SLEW, TSC_MAX_SLEW);
+    auto mult =
+        static_cast<uint64_t>(static_cast<double>(rate) * (1.0 + correction));
+    calibration_.store({now.tsc, clock_ns, mult});
+  }
+
+  void recalibrationLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, Nanoseconds(TSC_RECALIBRATION_INTERVAL_NS),
+                         [this] { return stop_requested_; })) {
+      recalibrate();
+    }
+  }
+
+  TscCalibration& calibration_;
+  Sample last_sample_{0, 0};  // Previous calibration sample (rate base)
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_requested_;
+};
+
+// Current time in epoch nanoseconds from the process-wide calibration: the
+// system clock until TscClock::global() has been called
+inline int64_t tscTimestampNs() {
+  return TscClock::nowNs(TscClock::globalCalibration());
+}
+
+}  // namespace replay
@@ -24,17 +24,47 @@ constexpr int64_t CATCHUP_THRESHOLD = 100;
 // Default ring buffer size
 constexpr size_t DEFAULT_RING_BUFFER_SIZE = 1024 * 1024;  // 1M entries
 
+// Default variable-length ring size: the same memory as the default ring
+constexpr size_t DEFAULT_VAR_RING_BYTES = DEFAULT_RING_BUFFER_SIZE * 64;
+
 // Disk write batch size
 constexpr size_t DISK_BATCH_SIZE = 1024;
 
+// Maximum messages a consumer drains from the ring per loop iteration
+constexpr size_t CONSUME_BATCH_SIZE = 256;
+
+// Cache line size, for keeping data written by different threads apart
+constexpr size_t CACHE_LINE_SIZE = 64;
+
 // File magic number
 constexpr uint32_t FILE_MAGIC = 0x4D4B5444;  // "MKTD"
 
 // File version (bumped to 2 for extended header with integrity fields)
 constexpr uint16_t FILE_VERSION = 2;
 
+// Block-columnar file version (delta-encoded seq and timestamps)
+constexpr uint16_t FILE_VERSION_COLUMNAR = 3;
+
+// Variable-length frame file version (see common/Frame.hpp)
+constexpr uint16_t FILE_VERSION_FRAMES = 4;
+
+// Record schema ids (FileHeader::schema_id, see common/Record.hpp); files
+// written before the field existed have SCHEMA_LEGACY and hold Msg records
+constexpr uint32_t SCHEMA_LEGACY = 0;
+constexpr uint32_t SCHEMA_MSG = 1;
+constexpr uint32_t SCHEMA_TICK = 2;
+constexpr uint32_t SCHEMA_FRAMES = 3;  // v4 frames, record_size 0
+
+// Body layout written by FileWriteChannel
+enum class FileFormat {
+  RAW,      // v2: array of 24-byte Msg records
+  COLUMNAR  // v3: column blocks
+};
+
 // File flags (stored in FileHeader.flags)
 constexpr uint16_t FILE_FLAG_COMPLETE = 0x0001;  // File was properly closed
+constexpr uint16_t FILE_FLAG_INSTRUMENT_INDEX =
+    0x0002;  // v2 records followed by an instrument index at data_end
 
 // RingBuffer read status — distinguishes "not yet published" from "overwritten"
 enum class ReadStatus {
@@ -58,6 +88,29 @@ enum class ClientState {
   CATCHING_UP  // Catching up
 };
 
+// Where a consumer with no state of its own (a late start, or after a crash
+// reset) joins the stream
+enum class JoinPolicy {
+  HEAD,                 // Next message published (skip the history)
+  OLDEST_RESIDENT,      // Oldest message safely in the ring (skip the rest)
+  DISK_THEN_RING,       // Full history: disk prefix, then the ring
+  CHECKPOINT_THEN_RING  // Restore a checkpoint, catch up from there
+};
+
+inline const char* toString(JoinPolicy policy) {
+  switch (policy) {
+    case JoinPolicy::HEAD:
+      return "head";
+    case JoinPolicy::OLDEST_RESIDENT:
+      return "oldest";
+    case JoinPolicy::DISK_THEN_RING:
+      return "disk";
+    case JoinPolicy::CHECKPOINT_THEN_RING:
+      return "checkpoint";
+  }
+  return "unknown";
+}
+
 // Get current nanosecond timestamp
 inline int64_t getCurrentTimestampNs() {
   return std::chrono::duration_cast<Nanoseconds>(
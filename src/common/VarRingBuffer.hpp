@@ -0,0 +1,388 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <span>
+
+#include "Frame.hpp"
+#include "Types.hpp"
+
+namespace replay {
+
+// Position of a consumer in a VarRingBuffer: the byte position of a frame
+// and that frame's sequence number (INVALID_SEQ: accept the frame's own, as
+// after oldest() or latest()). {0, 0} is the first frame ever pushed.
+struct FrameCursor {
+  uint64_t pos = 0;
+  SeqNum seq = 0;
+};
+
+// Result of VarRingBuffer::readEx()
+struct FrameReadResult {
+  ReadStatus status;
+  FrameHeader header;  // Only valid when status == ReadStatus::OK
+};
+
+// Result of VarRingBuffer::readBatch()
+struct FrameBatch {
+  ReadStatus status;  // OK when frames > 0
+  size_t frames;
+  size_t bytes;  // Frame bytes copied, headers included
+};
+
+// Lock-free SPMC ring of variable-length frames
+// The byte-oriented counterpart of RingBuffer: each push appends a
+// length-prefixed frame (see common/Frame.hpp) with the next frame sequence
+// number, so events of different sizes take only the bytes they need instead
+// of a slot sized for the largest. A frame that does not fit before the end
+// of the buffer is preceded by a padding frame up to the wrap (or by nothing
+// when less than a header is left), so frames are always contiguous.
+//
+// Like RingBuffer, the producer never waits for consumers: it overwrites the
+// oldest frames. Consumers read with the same statuses:
+//   - NOT_READY: the cursor is at the published end (tail)
+//   - OVERWRITTEN: the producer has reused the bytes at the cursor
+//   - OK: the frame was copied out intact
+//
+// Correctness invariants:
+//   INV-V1: tail_intent_ is raised to the end of a batch before any of its
+//           bytes are written (release fence); tail_ is raised to the same
+//           position after they are (release).
+//   INV-V2: A consumer reads frames below tail_ (acquire), then checks with
+//           an acquire fence that tail_intent_ has not moved more than the
+//           capacity past the first byte it read. Otherwise the copy may be
+//           torn and the read reports OVERWRITTEN. Frame headers are also
+//           validated (length, fit before the wrap, expected seq_num), so a
+//           cursor is never walked off a frame boundary.
+//   INV-V3: head_ is the position of the oldest frame still whole in the
+//           buffer; the producer advances it over the frames a batch is
+//           about to overwrite before raising tail_intent_.
+//
+// A lapped consumer resumes from oldest() (or latest()); the jump shows up
+// as a gap in the frame sequence numbers.
+template <size_t CapacityBytes = DEFAULT_VAR_RING_BYTES>
+class VarRingBuffer {
+  static_assert((CapacityBytes & (CapacityBytes - 1)) == 0,
+                "Capacity must be a power of 2 for bitmask indexing");
+  static_assert(CapacityBytes >= 4096, "Capacity must be at least 4 KiB");
+
+ public:
+  // Largest payload of a frame: a quarter of the ring, header included
+  static constexpr size_t MAX_PAYLOAD = CapacityBytes / 4 - sizeof(FrameHeader);
+
+  VarRingBuffer()
+      : tail_(0),
+        tail_intent_(0),
+        head_(0),
+        write_seq_(0),
+        overwrite_count_(0),
+        padding_bytes_(0),
+        write_pos_(0),
+        head_pos_(0) {}
+
+  // Append a frame. Returns its sequence number, or INVALID_SEQ if the
+  // payload is longer than MAX_PAYLOAD.
+  SeqNum push(const FrameRef& frame) {
+    return pushBatch(std::span<const FrameRef>(&frame, 1));
+  }
+
+  // Append an event struct as the payload of a frame of this type
+  template <typename E>
+    requires std::is_trivially_copyable_v<E>
+  SeqNum pushEvent(uint16_t type, int64_t timestamp_ns, const E& event) {
+    return push(FrameRef{type, timestamp_ns, eventBytes(event)});
+  }
+
+  // Append frames with consecutive sequence numbers, published together (in
+  // chunks of up to half the ring). Returns the first sequence number, or
+  // INVALID_SEQ, writing nothing, if the batch is empty or a payload is
+  // longer than MAX_PAYLOAD.
+  SeqNum pushBatch(std::span<const FrameRef> frames) {
+    if (frames.empty()) {
+      return INVALID_SEQ;
+    }
+    for (const FrameRef& frame : frames) {
+      if (frame.payload.size() > MAX_PAYLOAD) {
+        return INVALID_SEQ;
+      }
+    }
+
+    const SeqNum first_seq = write_seq_.load(std::memory_order_relaxed);
+    size_t begin = 0;
+    while (begin < frames.size()) {
+      // Lay out a chunk: frames that do not fit before the wrap move past it
+      uint64_t end = write_pos_;
+      size_t count = 0;
+      while (begin + count < frames.size()) {
+        uint64_t next = place(end, frames[begin + count].payload.size());
+        if (count > 0 && next - write_pos_ > CapacityBytes / 2) {
+          break;
+        }
+        end = next;
+        ++count;
+      }
+      publish(frames.subspan(begin, count), end);
+      begin += count;
+    }
+    return first_seq;
+  }
+
+  // Copy the frame at cursor: its payload into out (truncated to out.size();
+  // header.length is the full size) and, on OK, move the cursor past it.
+  FrameReadResult readEx(FrameCursor& cursor,
+                         std::span<std::byte> out) const {
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    uint64_t pos = cursor.pos;
+    while (pos < tail) {
+      const size_t offset = pos & MASK;
+      const size_t left = CapacityBytes - offset;
+      if (left < sizeof(FrameHeader)) {
+        pos += left;  // Too short for a padding frame
+        continue;
+      }
+
+      FrameHeader header;
+      std::memcpy(&header, &buffer_[offset], sizeof(FrameHeader));
+      const bool valid = isValidFrame(header, left, cursor.seq);
+      if (valid && !header.isPadding() && !out.empty()) {
+        std::memcpy(out.data(), &buffer_[offset + sizeof(FrameHeader)],
+                    std::min<size_t>(header.length, out.size()));
+      }
+
+      // INV-V2: seqlock-style check after the copy
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!valid || lapped(pos)) {
+        return {ReadStatus::OVERWRITTEN, {}};
+      }
+      if (header.isPadding()) {
+        pos += left;
+        continue;
+      }
+      cursor.pos = pos + frameBytes(header.length);
+      cursor.seq = header.seq_num + 1;
+      return {ReadStatus::OK, header};
+    }
+    return {ReadStatus::NOT_READY, {}};
+  }
+
+  // Copy as many whole consecutive frames from cursor as fit in out, in
+  // their encoded form (header, payload, padding; ring padding frames are
+  // left out), and move the cursor past them. out must hold at least
+  // maxFrameBytes(). A batch that may have been torn by the producer is
+  // discarded and reported as OVERWRITTEN.
+  FrameBatch readBatch(FrameCursor& cursor, std::span<std::byte> out) const {
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    uint64_t pos = cursor.pos;
+    SeqNum seq = cursor.seq;
+    size_t frames = 0;
+    size_t bytes = 0;
+    bool valid = true;
+    while (pos < tail) {
+      const size_t offset = pos & MASK;
+      const size_t left = CapacityBytes - offset;
+      if (left < sizeof(FrameHeader)) {
+        pos += left;
+        continue;
+      }
+
+      FrameHeader header;
+      std::memcpy(&header, &buffer_[offset], sizeof(FrameHeader));
+      if (!isValidFrame(header, left, seq)) {
+        valid = false;
+        break;
+      }
+      if (header.isPadding()) {
+        pos += left;
+        continue;
+      }
+      const size_t size = frameBytes(header.length);
+      if (bytes + size > out.size()) {
+        break;
+      }
+      std::memcpy(&out[bytes], &buffer_[offset], size);
+      bytes += size;
+      ++frames;
+      seq = header.seq_num + 1;
+      pos += size;
+    }
+
+    // INV-V2: everything read lies at or after cursor.pos
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (lapped(cursor.pos) || (!valid && frames == 0)) {
+      return {ReadStatus::OVERWRITTEN, 0, 0};
+    }
+    if (frames == 0) {
+      return {ReadStatus::NOT_READY, 0, 0};
+    }
+    cursor.pos = pos;
+    cursor.seq = seq;
+    return {ReadStatus::OK, frames, bytes};
+  }
+
+  // Cursor at the oldest frame still in the ring (a lapped consumer's
+  // restart point)
+  FrameCursor oldest() const {
+    return {head_.load(std::memory_order_acquire), INVALID_SEQ};
+  }
+
+  // Cursor at the next frame to be published
+  FrameCursor latest() const {
+    return {tail_.load(std::memory_order_acquire), INVALID_SEQ};
+  }
+
+  // Get latest published sequence number
+  SeqNum getLatestSeq() const {
+    SeqNum next = write_seq_.load(std::memory_order_acquire);
+    return next > 0 ? next - 1 : INVALID_SEQ;
+  }
+
+  // Next sequence number to be assigned
+  SeqNum getNextWriteSeq() const {
+    return write_seq_.load(std::memory_order_acquire);
+  }
+
+  // Bytes published since creation, padding included
+  uint64_t getBytesWritten() const {
+    return tail_.load(std::memory_order_acquire);
+  }
+
+  // Bytes the consumer at cursor has yet to read
+  uint64_t lagOf(const FrameCursor& cursor) const {
+    return getBytesWritten() - cursor.pos;
+  }
+
+  // Frames overwritten since creation
+  int64_t getOverwriteCount() const {
+    return overwrite_count_.load(std::memory_order_relaxed);
+  }
+
+  // Bytes spent on padding up to the wrap
+  uint64_t getPaddingBytes() const {
+    return padding_bytes_.load(std::memory_order_relaxed);
+  }
+
+  static constexpr size_t capacity() { return CapacityBytes; }
+
+  static constexpr size_t maxPayloadSize() { return MAX_PAYLOAD; }
+
+  // Bytes of the largest frame, header and padding included
+  static constexpr size_t maxFrameBytes() { return frameBytes(MAX_PAYLOAD); }
+
+ private:
+  static constexpr size_t MASK = CapacityBytes - 1;
+
+  // End of a frame with this payload written at pos, moved past the wrap if
+  // it does not fit before it
+  static uint64_t place(uint64_t pos, size_t length) {
+    const size_t size = frameBytes(length);
+    const size_t left = CapacityBytes - (pos & MASK);
+    return (left < size ? pos + left : pos) + size;
+  }
+
+  // Header checks that keep a cursor on frame boundaries
+  static bool isValidFrame(const FrameHeader& header, size_t left,
+                           SeqNum expected_seq) {
+    if (header.isPadding()) {
+      return header.length == left - sizeof(FrameHeader);
+    }
+    return header.length <= MAX_PAYLOAD &&
+           frameBytes(header.length) <= left &&
+           (expected_seq == INVALID_SEQ || header.seq_num == expected_seq);
+  }
+
+  // Whether the producer may have written over the byte at pos
+  bool lapped(uint64_t pos) const {
+    return tail_intent_.load(std::memory_order_relaxed) > pos + CapacityBytes;
+  }
+
+  // Write frames laid out up to end and publish them (INV-V1, INV-V3)
+  void publish(std::span<const FrameRef> frames, uint64_t end) {
+    retire(end);
+    tail_intent_.store(end, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    SeqNum seq = write_seq_.load(std::memory_order_relaxed);
+    uint64_t pos = write_pos_;
+    uint64_t padding = 0;
+    for (const FrameRef& frame : frames) {
+      const size_t length = frame.payload.size();
+      const size_t size = frameBytes(length);
+      size_t offset = pos & MASK;
+      const size_t left = CapacityBytes - offset;
+      if (left < size) {
+        if (left >= sizeof(FrameHeader)) {
+          FrameHeader pad{seq, 0,
+                          static_cast<uint32_t>(left - sizeof(FrameHeader)), 0,
+                          FRAME_FLAG_PADDING};
+          std::memcpy(&buffer_[offset], &pad, sizeof(FrameHeader));
+        }
+        pos += left;
+        padding += left;
+        offset = 0;
+      }
+
+      FrameHeader header{seq, frame.timestamp_ns,
+                         static_cast<uint32_t>(length), frame.type, 0};
+      std::byte* dst = &buffer_[offset];
+      std::memcpy(dst, &header, sizeof(FrameHeader));
+      if (length > 0) {
+        std::memcpy(dst + sizeof(FrameHeader), frame.payload.data(), length);
+      }
+      std::memset(dst + sizeof(FrameHeader) + length, 0,
+                  size - sizeof(FrameHeader) - length);
+      pos += size;
+      ++seq;
+    }
+
+    write_pos_ = end;
+    tail_.store(end, std::memory_order_release);
+    write_seq_.store(seq, std::memory_order_release);
+    if (padding > 0) {
+      padding_bytes_.fetch_add(padding, std::memory_order_relaxed);
+    }
+  }
+
+  // Move head_ past the frames that writing up to end overwrites
+  void retire(uint64_t end) {
+    const uint64_t head = head_pos_;
+    int64_t overwritten = 0;
+    while (head_pos_ + CapacityBytes < end) {
+      const size_t offset = head_pos_ & MASK;
+      const size_t left = CapacityBytes - offset;
+      if (left < sizeof(FrameHeader)) {
+        head_pos_ += left;
+        continue;
+      }
+      FrameHeader header;
+      std::memcpy(&header, &buffer_[offset], sizeof(FrameHeader));
+      head_pos_ += frameBytes(header.length);
+      overwritten += header.isPadding() ? 0 : 1;
+    }
+    if (head_pos_ != head) {
+      head_.store(head_pos_, std::memory_order_release);
+      overwrite_count_.fetch_add(overwritten, std::memory_order_relaxed);
+    }
+  }
+
+  // Frame bytes
+  alignas(CACHE_LINE_SIZE) std::array<std::byte, CapacityBytes> buffer_;
+
+  // Positions and sequence published by the producer
+  alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail_;
+  std::atomic<uint64_t> tail_intent_;
+  std::atomic<uint64_t> head_;
+  std::atomic<SeqNum> write_seq_;
+
+  // Producer metrics
+  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> overwrite_count_;
+  std::atomic<uint64_t> padding_bytes_;
+
+  // Producer-only state
+  alignas(CACHE_LINE_SIZE) uint64_t write_pos_;
+  uint64_t head_pos_;
+};
+
+}  // namespace replay
@@ -1,19 +1,32 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstring>
 #include <ctime>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <span>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "client/MktDataClient.hpp"
 #include "common/CpuAffinity.hpp"
 #include "common/Logging.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/OverflowLog.hpp"
+#include "common/PayloadSum.hpp"
 #include "common/RingBuffer.hpp"
+#include "common/TscClock.hpp"
 #include "recorder/MktDataRecorder.hpp"
+#include "relay/OverflowRelay.hpp"
+#include "replay/MergedReplayEngine.hpp"
+#include "replay/ReplayEngine.hpp"
 #include "server/MktDataServer.hpp"
 
 namespace {
@@ -34,14 +47,62 @@ void printUsage(std::string_view program) {
   std::cout
       << "Usage: " << program << " [options]\n"
       << "\nOptions:\n"
-      << "  --mode=<mode>        Run mode: test, recovery_test, stress\n"
+      << "  --mode=<mode>        Run mode: test, recovery_test, stress, "
+         "verify, replay, merge\n"
       << "  --messages=<count>   Message count (default: 10000)\n"
       << "  --rate=<rate>        Messages per second (default: 1000)\n"
+      << "  --shape=<shape>      Generator traffic shape: uniform, bucket, "
+         "poisson, onoff (default: uniform)\n"
+      << "  --burst=<n>          Token bucket depth for --shape=bucket "
+         "(default: 1)\n"
+      << "  --on-us=<us>         On window for --shape=onoff (default: 1000)\n"
+      << "  --off-us=<us>        Off window for --shape=onoff (default: 9000)\n"
       << "  --fault-at=<seq>     Trigger fault at specified sequence number "
          "(recovery_test mode)\n"
       << "  --data-dir=<dir>     Data directory, output files written to this "
          "directory (default: data)\n"
       << "  --output=<file>      Output file path (overrides --data-dir)\n"
+      << "  --threads=<n>        Reader and checksum threads for verify mode "
+         "(default: hardware concurrency)\n"
+      << "  --source=<file>      Server republishes this recording instead of "
+         "generating (test/stress modes)\n"
+      << "  --loop               Loop the --source recording until --messages "
+         "are sent\n"
+      << "  --speed=<x>          Speed multiplier for replay mode and --source, "
+         "0 = max speed (default: 1)\n"
+      << "  --max-gap-us=<us>    Recorded gaps longer than this are idle gaps "
+         "(replay mode and --source; default: none)\n"
+      << "  --idle-gaps=<mode>   compress idle gaps to --max-gap-us, or drop "
+         "them (default: compress)\n"
+      << "  --latency-report-ms=<ms>  Print per-stage latency percentiles "
+         "every <ms> during test/stress runs (default: off)\n"
+      << "  --metrics-shm=<name> Shared-memory metrics page for replay_top, "
+         "none = off (default: /replay_metrics)\n"
+      << "  --overflow-log=<file>  Relay every message into an mmap-backed "
+         "second-tier ring that lapped consumers read on from (test/stress "
+         "modes; default: off)\n"
+      << "  --overflow-capacity=<n>  Messages in the overflow log, a power of "
+         "two (default: 67108864)\n"
+      << "  --join=<policy>      Client join policy: head, oldest, disk, "
+         "checkpoint (default: disk)\n"
+      << "  --join-at=<seq>      Start the client once the server has "
+         "published this seq (test mode; default: with the server)\n"
+      << "  --checkpoint=<file>  Client checkpoint file, written periodically "
+         "and read by --join=checkpoint (default: off)\n"
+      << "  --format=v2|v3       Recording layout: raw records or column "
+         "blocks (default: v3)\n"
+      << "  --codec=<name>       Compress v3 blocks: none, lz, lz4, zstd "
+         "(lz4/zstd if built in; default: none)\n"
+      << "  --decode-threads=<n> Threads decoding v3 blocks ahead of replay "
+         "mode (default: 0, decode inline)\n"
+      << "  --seq-range=<lo:hi>  Replay mode: only messages with seq_num in "
+         "[lo, hi] (either side may be empty)\n"
+      << "  --time-range=<lo:hi> Replay mode: only messages with timestamp_ns "
+         "in [lo, hi]\n"
+      << "  --payload-range=<lo:hi>  Replay mode: only messages with payload "
+         "in [lo, hi]\n"
+      << "  --inputs=<f1,f2,...> Merge mode: recordings merged by timestamp, "
+         "one feed each\n"
       << "  --cpu=<c0,c1,...>    Pin threads to CPU cores (comma-separated)\n"
       << "                       Order: main, server, client, recorder\n"
       << "                       Unspecified threads are not pinned\n"
@@ -49,6 +110,42 @@ void printUsage(std::string_view program) {
       << std::endl;
 }
 
+// Parse "lo:hi" (or a single value) into the bounds of a filter range; an
+// empty side leaves that bound open
+template <typename T>
+void parseRange(std::string_view str, T& lo, T& hi) {
+  auto parse = [](std::string_view text) -> T {
+    if constexpr (std::is_floating_point_v<T>) {
+      return std::stod(std::string(text));
+    } else {
+      return static_cast<T>(std::stoll(std::string(text)));
+    }
+  };
+  auto colon = str.find(':');
+  std::string_view low = str.substr(0, colon);
+  std::string_view high =
+      colon == std::string_view::npos ? low : str.substr(colon + 1);
+  if (!low.empty()) {
+    lo = parse(low);
+  }
+  if (!high.empty()) {
+    hi = parse(high);
+  }
+}
+
+// Parse a comma-separated list of file paths
+std::vector<std::string> parseFileList(std::string_view str) {
+  std::vector<std::string> files;
+  std::string token;
+  std::istringstream ss{std::string(str)};
+  while (std::getline(ss, token, ',')) {
+    if (!token.empty()) {
+      files.push_back(token);
+    }
+  }
+  return files;
+}
+
 // Parse comma-separated CPU core IDs, e.g. "0,1,2,3"
 std::vector<int> parseCpuCores(std::string_view str) {
   std::vector<int> cores;
@@ -76,7 +173,30 @@ struct Config {
   std::string mode = "test";
   int64_t message_count = 10000;
   int64_t message_rate = 1000;
+  std::string shape = "uniform";
+  int64_t burst_size = 1;
+  int64_t on_us = 1000;
+  int64_t off_us = 9000;
   int64_t fault_at = -1;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  double speed = 1.0;
+  int64_t max_gap_us = -1;
+  std::string idle_gaps = "compress";  // What happens to gaps > max_gap_us
+  std::string source_file;  // Recording republished by the server
+  bool loop_source = false;
+  int64_t latency_report_ms = 0;  // 0 = no periodic latency report
+  std::string metrics_shm = replay::METRICS_SHM_NAME;  // "none" = off
+  std::string overflow_log;  // Second-tier ring file, empty = off
+  size_t overflow_capacity = replay::DEFAULT_OVERFLOW_CAPACITY;
+  std::string join = "disk";  // Client join policy
+  int64_t join_at = -1;       // Late client start, -1 = with the server
+  std::string checkpoint_file;
+  std::string format = "v3";  // Recording layout
+  std::string codec = "none";  // v3 block compression
+  size_t decode_threads = 0;   // Replay-side block decoders
+  replay::MessageFilter filter;  // Replay mode message filter
+  bool filtered = false;         // filter set on the command line
+  std::vector<std::string> merge_inputs;  // Merge mode feeds
   std::string output_file;
 
   // CPU affinity: core IDs for each thread (-1 = unset, no pinning)
@@ -98,6 +218,80 @@ struct Config {
   }
 };
 
+// Pacing settings shared by replay mode and the server's replay source
+replay::PacingConfig pacingFromConfig(const Config& config) {
+  replay::PacingConfig pacing;
+  pacing.speed = config.speed;
+  pacing.idle_gap_ns = config.max_gap_us < 0 ? -1 : config.max_gap_us * 1000;
+  if (config.idle_gaps == "drop") {
+    pacing.idle_gap_policy = replay::IdleGapPolicy::DROP;
+  } else if (config.idle_gaps != "compress") {
+    LOG_WARNING(replay::logger(), "Unknown --idle-gaps={}, using compress",
+                config.idle_gaps);
+  }
+  return pacing;
+}
+
+// Generator traffic shape from the command line
+replay::TrafficConfig trafficFromConfig(const Config& config) {
+  replay::TrafficConfig traffic;
+  traffic.rate = static_cast<double>(config.message_rate);
+  traffic.burst_size = config.burst_size;
+  traffic.on_ns = config.on_us * 1000;
+  traffic.off_ns = config.off_us * 1000;
+  if (config.shape == "bucket") {
+    traffic.shape = replay::TrafficShape::TOKEN_BUCKET;
+  } else if (config.shape == "poisson") {
+    traffic.shape = replay::TrafficShape::POISSON;
+  } else if (config.shape == "onoff") {
+    traffic.shape = replay::TrafficShape::ON_OFF;
+  } else if (config.shape != "uniform") {
+    LOG_WARNING(replay::logger(), "Unknown --shape={}, using uniform",
+                config.shape);
+  }
+  return traffic;
+}
+
+// Client join policy from the command line
+replay::JoinPolicy joinPolicyFromConfig(const Config& config) {
+  if (config.join == "head") {
+    return replay::JoinPolicy::HEAD;
+  } else if (config.join == "oldest") {
+    return replay::JoinPolicy::OLDEST_RESIDENT;
+  } else if (config.join == "checkpoint") {
+    return replay::JoinPolicy::CHECKPOINT_THEN_RING;
+  } else if (config.join != "disk") {
+    LOG_WARNING(replay::logger(), "Unknown --join={}, using disk",
+                config.join);
+  }
+  return replay::JoinPolicy::DISK_THEN_RING;
+}
+
+// Recording layout from the command line
+replay::FileFormat fileFormatFromConfig(const Config& config) {
+  if (config.format == "v2") {
+    return replay::FileFormat::RAW;
+  } else if (config.format != "v3") {
+    LOG_WARNING(replay::logger(), "Unknown --format={}, using v3",
+                config.format);
+  }
+  return replay::FileFormat::COLUMNAR;
+}
+
+// Recording layout and block codec from the command line
+void configureRecording(replay::MktDataRecorder& recorder,
+                        const Config& config) {
+  recorder.setFileFormat(fileFormatFromConfig(config));
+  auto codec = replay::codecFromName(config.codec);
+  if (!codec) {
+    LOG_WARNING(replay::logger(), "Unknown --codec={}, using none",
+                config.codec);
+  } else if (!recorder.setCodec(*codec)) {
+    LOG_WARNING(replay::logger(), "--codec={} is not built in, using none",
+                config.codec);
+  }
+}
+
 Config parseArgs(int argc, char* argv[]) {
   Config config;
 
@@ -113,6 +307,14 @@ Config parseArgs(int argc, char* argv[]) {
       config.message_count = std::stoll(std::string(arg.substr(11)));
     } else if (arg.starts_with("--rate=")) {
       config.message_rate = std::stoll(std::string(arg.substr(7)));
+    } else if (arg.starts_with("--shape=")) {
+      config.shape = std::string(arg.substr(8));
+    } else if (arg.starts_with("--burst=")) {
+      config.burst_size = std::stoll(std::string(arg.substr(8)));
+    } else if (arg.starts_with("--on-us=")) {
+      config.on_us = std::stoll(std::string(arg.substr(8)));
+    } else if (arg.starts_with("--off-us=")) {
+      config.off_us = std::stoll(std::string(arg.substr(9)));
     } else if (arg.starts_with("--fault-at=")) {
       config.fault_at = std::stoll(std::string(arg.substr(11)));
     } else if (arg.starts_with("--data-dir=")) {
@@ -123,6 +325,52 @@ Config parseArgs(int argc, char* argv[]) {
       config.output_file = dir + "/mktdata_" + getDateString() + ".bin";
     } else if (arg.starts_with("--output=")) {
       config.output_file = std::string(arg.substr(9));
+    } else if (arg.starts_with("--threads=")) {
+      config.threads = std::max(1ll, std::stoll(std::string(arg.substr(10))));
+    } else if (arg.starts_with("--source=")) {
+      config.source_file = std::string(arg.substr(9));
+    } else if (arg == "--loop") {
+      config.loop_source = true;
+    } else if (arg.starts_with("--speed=")) {
+      config.speed = std::stod(std::string(arg.substr(8)));
+    } else if (arg.starts_with("--max-gap-us=")) {
+      config.max_gap_us = std::stoll(std::string(arg.substr(13)));
+    } else if (arg.starts_with("--idle-gaps=")) {
+      config.idle_gaps = std::string(arg.substr(12));
+    } else if (arg.starts_with("--latency-report-ms=")) {
+      config.latency_report_ms = std::stoll(std::string(arg.substr(20)));
+    } else if (arg.starts_with("--metrics-shm=")) {
+      config.metrics_shm = std::string(arg.substr(14));
+    } else if (arg.starts_with("--overflow-log=")) {
+      config.overflow_log = std::string(arg.substr(15));
+    } else if (arg.starts_with("--overflow-capacity=")) {
+      config.overflow_capacity = std::stoull(std::string(arg.substr(20)));
+    } else if (arg.starts_with("--join=")) {
+      config.join = std::string(arg.substr(7));
+    } else if (arg.starts_with("--join-at=")) {
+      config.join_at = std::stoll(std::string(arg.substr(10)));
+    } else if (arg.starts_with("--checkpoint=")) {
+      config.checkpoint_file = std::string(arg.substr(13));
+    } else if (arg.starts_with("--format=")) {
+      config.format = std::string(arg.substr(9));
+    } else if (arg.starts_with("--codec=")) {
+      config.codec = std::string(arg.substr(8));
+    } else if (arg.starts_with("--decode-threads=")) {
+      config.decode_threads = std::stoull(std::string(arg.substr(17)));
+    } else if (arg.starts_with("--inputs=")) {
+      config.merge_inputs = parseFileList(arg.substr(9));
+    } else if (arg.starts_with("--seq-range=")) {
+      parseRange(arg.substr(12), config.filter.min_seq,
+                 config.filter.max_seq);
+      config.filtered = true;
+    } else if (arg.starts_with("--time-range=")) {
+      parseRange(arg.substr(13), config.filter.min_timestamp_ns,
+                 config.filter.max_timestamp_ns);
+      config.filtered = true;
+    } else if (arg.starts_with("--payload-range=")) {
+      parseRange(arg.substr(16), config.filter.min_payload,
+                 config.filter.max_payload);
+      config.filtered = true;
     } else if (arg.starts_with("--cpu=")) {
       config.assignCpuCores(parseCpuCores(arg.substr(6)));
     }
@@ -131,6 +379,53 @@ Config parseArgs(int argc, char* argv[]) {
   return config;
 }
 
+// Shared-memory metrics page the components publish into (for replay_top).
+// nullptr when disabled or unavailable; the run goes on without it.
+std::unique_ptr<replay::MetricsRegistry> openMetrics(const Config& config) {
+  if (config.metrics_shm.empty() || config.metrics_shm == "none") {
+    return nullptr;
+  }
+  auto metrics = replay::MetricsRegistry::openShared(
+      config.metrics_shm, replay::MetricsRegistry::Access::PUBLISH);
+  if (metrics) {
+    std::cout << "Metrics page: " << config.metrics_shm << std::endl;
+  }
+  return metrics;
+}
+
+// Remove the metrics page name once the run is over
+void closeMetrics(const std::unique_ptr<replay::MetricsRegistry>& metrics) {
+  if (metrics) {
+    replay::MetricsRegistry::unlinkShared(metrics->getShmName());
+  }
+}
+
+// Print the latency of each pipeline stage over every interval until done
+void reportLatencyLoop(const replay::MktDataClient& client,
+                       const replay::MktDataRecorder& recorder,
+                       int64_t interval_ms, const std::atomic<bool>& done) {
+  replay::HistogramSnapshot prev_consume;
+  replay::HistogramSnapshot prev_read;
+  replay::HistogramSnapshot prev_write;
+
+  while (!done.load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+
+    auto consume = client.getMetrics().consume_latency_ns.snapshot();
+    auto read = recorder.getMetrics().read_latency_ns.snapshot();
+    auto write = recorder.getMetrics().write_latency_ns.snapshot();
+    std::cout << "[latency ns] produce->consume: "
+              << consume.since(prev_consume).summary()
+              << "\n             produce->record: "
+              << read.since(prev_read).summary()
+              << "\n             record->disk:    "
+              << write.since(prev_write).summary() << std::endl;
+    prev_consume = consume;
+    prev_read = read;
+    prev_write = write;
+  }
+}
+
 // Basic functionality test
 int runTest(const Config& config) {
   auto* logger = replay::logger();
@@ -147,27 +442,95 @@ int runTest(const Config& config) {
   auto buffer =
       std::make_unique<replay::RingBuffer<replay::DEFAULT_RING_BUFFER_SIZE>>();
 
+  // Metrics page (declared first: it must outlive the components that
+  // publish into it)
+  auto metrics = openMetrics(config);
+
+  // Optional overflow tier and its relay (declared before the components
+  // that read through it)
+  std::unique_ptr<replay::OverflowLog> overflow;
+  std::unique_ptr<replay::OverflowRelay> relay;
+  if (!config.overflow_log.empty()) {
+    overflow = replay::OverflowLog::create(config.overflow_log,
+                                           config.overflow_capacity);
+    if (!overflow) {
+      std::cerr << "Cannot create overflow log: " << config.overflow_log
+                << std::endl;
+      return 1;
+    }
+    relay = std::make_unique<replay::OverflowRelay>(*buffer, *overflow);
+    if (metrics) {
+      relay->attachMetrics(*metrics);
+    }
+    std::cout << "Overflow log: " << config.overflow_log << " ("
+              << config.overflow_capacity << " messages)" << std::endl;
+  }
+
   // Create components
   replay::MktDataServer server(*buffer);
-  replay::MktDataClient client(*buffer, config.output_file);
+  replay::JoinPolicy join_policy = joinPolicyFromConfig(config);
+  replay::MktDataClient client(*buffer, config.output_file, join_policy);
   replay::MktDataRecorder recorder(*buffer, config.output_file);
+  if (metrics) {
+    server.attachMetrics(*metrics);
+    client.attachMetrics(*metrics);
+    recorder.attachMetrics(*metrics);
+  }
 
   // Configure server
   server.setMessageCount(config.message_count);
-  server.setMessageRate(config.message_rate);
+  server.setTrafficShape(trafficFromConfig(config));
+  if (!config.source_file.empty()) {
+    replay::ReplaySourceConfig source;
+    source.filepath = config.source_file;
+    source.pacing = pacingFromConfig(config);
+    source.loop = config.loop_source;
+    source.max_messages = config.loop_source ? config.message_count : -1;
+    server.setReplaySource(source);
+    std::cout << "Replay source: " << config.source_file
+              << (config.loop_source ? " (looped)" : "") << std::endl;
+  }
 
   // Set CPU affinity
   server.setCpuCore(config.cpu_server);
   client.setCpuCore(config.cpu_client);
+  if (!config.checkpoint_file.empty()) {
+    client.setCheckpoint(config.checkpoint_file);
+  }
   recorder.setCpuCore(config.cpu_recorder);
+  configureRecording(recorder, config);
 
   // Start threads
   auto start_time = std::chrono::high_resolution_clock::now();
 
+  if (relay) {
+    relay->start();
+  }
   recorder.start();
-  client.start();
+  if (config.join_at < 0) {
+    client.start();
+  }
   server.start();
 
+  // Late join: the client starts on a stream that is already running
+  if (config.join_at >= 0) {
+    while (buffer->getLatestSeq() < config.join_at && server.isRunning()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    std::cout << "Client joining at seq " << buffer->getLatestSeq()
+              << " (join=" << replay::toString(join_policy) << ")"
+              << std::endl;
+    client.start();
+  }
+
+  std::atomic<bool> report_done{false};
+  std::thread reporter;
+  if (config.latency_report_ms > 0) {
+    reporter = std::thread(reportLatencyLoop, std::cref(client),
+                           std::cref(recorder), config.latency_report_ms,
+                           std::cref(report_done));
+  }
+
   // Wait for server to complete
   server.waitForComplete();
 
@@ -177,6 +540,14 @@ int runTest(const Config& config) {
   // Stop components
   client.stop();
   recorder.stop();
+  if (relay) {
+    relay->stop();
+  }
+
+  report_done.store(true, std::memory_order_release);
+  if (reporter.joinable()) {
+    reporter.join();
+  }
 
   auto end_time = std::chrono::high_resolution_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -191,16 +562,47 @@ int runTest(const Config& config) {
             << std::endl;
   std::cout << "Recorder recorded: " << recorder.getRecordedCount()
             << " messages" << std::endl;
+  if (config.source_file.empty()) {
+    auto rate = server.getRateStats();
+    std::cout << "Achieved rate: " << std::fixed << std::setprecision(0)
+              << rate.achieved_rate << "/s (requested " << rate.requested_rate
+              << "/s, mean jitter " << rate.mean_jitter_ns << " ns)"
+              << std::endl;
+  }
+  if (relay) {
+    std::cout << "Overflow relay: relayed " << relay->getRelayedCount()
+              << ", lost " << relay->getLostCount() << std::endl;
+  }
+  std::cout << "Latency produce->consume (ns): "
+            << client.getMetrics().consume_latency_ns.snapshot().summary()
+            << std::endl;
+  std::cout << "Latency produce->record (ns):  "
+            << recorder.getMetrics().read_latency_ns.snapshot().summary()
+            << std::endl;
+  std::cout << "Latency record->disk (ns):     "
+            << recorder.getMetrics().write_latency_ns.snapshot().summary()
+            << std::endl;
   std::cout << "Client sum: " << std::fixed << std::setprecision(6)
             << client.getSum() << std::endl;
   std::cout << "Recorder expected sum: " << std::fixed << std::setprecision(6)
             << recorder.getExpectedSum() << std::endl;
 
-  // Verify results
+  int64_t time_to_live_ns = client.getMetrics().time_to_live_ns.load();
+  if (time_to_live_ns >= 0) {
+    std::cout << "Client time to live: " << time_to_live_ns / 1000
+              << " us (join=" << replay::toString(join_policy) << ")"
+              << std::endl;
+  }
+
+  // Verify results; head and oldest joins skip part of the history by design
+  bool full_history = join_policy == replay::JoinPolicy::DISK_THEN_RING ||
+                      join_policy == replay::JoinPolicy::CHECKPOINT_THEN_RING;
   double diff = std::abs(client.getSum() - recorder.getExpectedSum());
-  bool passed = diff < 1e-9;
+  bool passed = !full_history || diff < 1e-9;
 
-  std::cout << "\nVerification result: " << (passed ? "PASSED" : "FAILED")
+  std::cout << "\nVerification result: "
+            << (!full_history ? "SKIPPED (partial join)"
+                              : (passed ? "PASSED" : "FAILED"))
             << std::endl;
 
   LOG_INFO(logger,
@@ -209,6 +611,8 @@ int runTest(const Config& config) {
            server.getSentCount(), client.getProcessedCount(),
            recorder.getRecordedCount(), duration.count(), passed);
 
+  closeMetrics(metrics);
+
   return passed ? 0 : 1;
 }
 
@@ -230,10 +634,19 @@ int runRecoveryTest(const Config& config) {
   auto buffer =
       std::make_unique<replay::RingBuffer<replay::DEFAULT_RING_BUFFER_SIZE>>();
 
+  // Metrics page (declared first: it must outlive the components that
+  // publish into it)
+  auto metrics = openMetrics(config);
+
   // Create components
   replay::MktDataServer server(*buffer);
   replay::MktDataClient client(*buffer, config.output_file);
   replay::MktDataRecorder recorder(*buffer, config.output_file);
+  if (metrics) {
+    server.attachMetrics(*metrics);
+    client.attachMetrics(*metrics);
+    recorder.attachMetrics(*metrics);
+  }
 
   // Configure server
   server.setMessageCount(config.message_count);
@@ -243,6 +656,7 @@ int runRecoveryTest(const Config& config) {
   server.setCpuCore(config.cpu_server);
   client.setCpuCore(config.cpu_client);
   recorder.setCpuCore(config.cpu_recorder);
+  configureRecording(recorder, config);
 
   // Start threads
   recorder.start();
@@ -291,6 +705,8 @@ int runRecoveryTest(const Config& config) {
       "runRecoveryTest complete: client_sum={}, recorder_sum={}, passed={}",
       client.getSum(), recorder.getExpectedSum(), passed);
 
+  closeMetrics(metrics);
+
   return passed ? 0 : 1;
 }
 
@@ -309,6 +725,180 @@ int runStressTest(const Config& config) {
                            // parameters differ
 }
 
+// Reduce a recorded file on several threads and report its exact checksum
+int runVerify(const Config& config) {
+  auto* logger = replay::logger();
+  std::cout << "=== Verify Recorded File ===" << std::endl;
+  std::cout << "Input file: " << config.output_file << std::endl;
+  std::cout << "Threads: " << config.threads << std::endl;
+  std::cout << std::endl;
+
+  // Block checksums first (v3); a corrupt block ends the readable data
+  bool corrupt = false;
+  replay::FileChannel checked(config.output_file);
+  checked.setVerifyThreads(config.threads);
+  if (checked.open() && checked.isColumnar()) {
+    const auto& verify = checked.getVerifyStats();
+    std::cout << "Checksums: " << verify.verified_blocks << " blocks OK, "
+              << verify.unchecked_blocks << " without checksum ("
+              << std::fixed << std::setprecision(2)
+              << (verify.seconds > 0 ? verify.bytes / verify.seconds / 1e9
+                                     : 0.0)
+              << " GB/s)" << std::defaultfloat << std::endl;
+    if (verify.corrupt) {
+      corrupt = true;
+      std::cout << "CORRUPT block after message " << checked.getMessageCount()
+                << ": " << verify.dropped_messages << " messages unreadable"
+                << std::endl;
+      LOG_ERROR(logger, "runVerify: corrupt block in {} after message {}",
+                config.output_file, checked.getMessageCount());
+    }
+  }
+  checked.close();
+
+  auto start = std::chrono::steady_clock::now();
+  auto result =
+      replay::ReplayEngine::parallelReduce(config.output_file, config.threads);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  if (!result) {
+    LOG_ERROR(logger, "runVerify: failed to read {}", config.output_file);
+    std::cerr << "Failed to read " << config.output_file << std::endl;
+    return 1;
+  }
+
+  double elapsed_ms =
+      std::chrono::duration<double, std::milli>(elapsed).count();
+  std::cout << "Messages: " << result->msg_count << std::endl;
+  std::cout << "Seq range: [" << result->first_seq << ", " << result->last_seq
+            << "]" << std::endl;
+  std::cout << "Seq violations: " << result->seq_violation_count << std::endl;
+  std::cout << "Seq gaps: " << result->seq_gap_count << std::endl;
+  std::cout << "Exact sum: " << std::setprecision(17) << result->sum.value()
+            << std::endl;
+  std::cout << "Elapsed: " << std::setprecision(3) << elapsed_ms << " ms"
+            << std::endl;
+
+  LOG_INFO(logger,
+           "runVerify: msgs={}, seq=[{}, {}], violations={}, gaps={}, sum={}",
+           result->msg_count, result->first_seq, result->last_seq,
+           result->seq_violation_count, result->seq_gap_count,
+           result->sum.value());
+
+  return result->seq_violation_count == 0 && !corrupt ? 0 : 1;
+}
+
+// Replay a recorded file with its original timing and report pacing accuracy
+int runReplay(const Config& config) {
+  auto* logger = replay::logger();
+  std::cout << "=== Paced Replay ===" << std::endl;
+  std::cout << "Input file: " << config.output_file << std::endl;
+  std::cout << "Speed: " << config.speed << "x" << std::endl;
+  std::cout << std::endl;
+
+  replay::ReplayEngine engine(config.output_file);
+  engine.setDecodeThreads(config.decode_threads);
+  if (!engine.open()) {
+    LOG_ERROR(logger, "runReplay: failed to open {}", config.output_file);
+    std::cerr << "Failed to open " << config.output_file << std::endl;
+    return 1;
+  }
+
+  engine.setPacing(pacingFromConfig(config));
+  if (config.filtered) {
+    engine.setFilter(config.filter);
+  }
+
+  replay::ExactSum sum;
+  auto start = std::chrono::steady_clock::now();
+  while (auto msg = engine.nextPacedMessage()) {
+    sum.add(msg->payload);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto& stats = engine.getPacingStats();
+  double elapsed_ms =
+      std::chrono::duration<double, std::milli>(elapsed).count();
+  std::cout << "Messages: " << stats.emitted_count << std::endl;
+  std::cout << "Elapsed: " << std::fixed << std::setprecision(3) << elapsed_ms
+            << " ms" << std::endl;
+  std::cout << "Lateness mean/max: " << std::setprecision(1)
+            << stats.meanLatenessNs() << " / " << stats.max_lateness_ns
+            << " ns" << std::endl;
+  std::cout << "Late (> " << replay::PACING_LATE_THRESHOLD_NS
+            << " ns): " << stats.late_count << std::endl;
+  std::cout << "Compressed gaps: " << stats.compressed_gap_count << " ("
+            << stats.compressed_ns / 1000000 << " ms removed)" << std::endl;
+  std::cout << "Sum: " << std::setprecision(6) << sum.value() << std::endl;
+  if (config.filtered) {
+    const auto& filter_stats = engine.getFilterStats();
+    std::cout << "Filter: " << filter_stats.blocks_skipped
+              << " blocks skipped, " << filter_stats.blocks_whole
+              << " taken whole, " << filter_stats.blocks_selected
+              << " selected (" << replay::selectKernelName(
+                                      replay::activeSelectKernel())
+              << "); " << std::setprecision(2)
+              << filter_stats.bytes_read / 1e6 << " MB read" << std::endl;
+  }
+
+  LOG_INFO(logger,
+           "runReplay: msgs={}, speed={}, mean_lateness_ns={}, "
+           "max_lateness_ns={}, late={}",
+           stats.emitted_count, config.speed, stats.meanLatenessNs(),
+           stats.max_lateness_ns, stats.late_count);
+
+  return 0;
+}
+
+// Merge mode: replay several recordings as one stream ordered by timestamp
+int runMerge(const Config& config) {
+  auto* logger = replay::logger();
+  std::cout << "=== Merged Replay ===" << std::endl;
+  std::cout << "Feeds: " << config.merge_inputs.size() << std::endl;
+  std::cout << std::endl;
+
+  replay::MergedReplayEngine engine(config.merge_inputs);
+  engine.setDecodeThreads(config.decode_threads);
+  if (config.filtered) {
+    engine.setFilter(config.filter);
+  }
+  if (config.merge_inputs.empty() || !engine.open()) {
+    LOG_ERROR(logger, "runMerge: failed to open the --inputs");
+    std::cerr << "Failed to open the --inputs" << std::endl;
+    return 1;
+  }
+
+  // One compensated-sum kernel call per merged batch
+  replay::NeumaierSum sum;
+  std::vector<replay::Msg> batch(replay::MERGE_BATCH_SIZE);
+  auto start = std::chrono::steady_clock::now();
+  while (size_t n = engine.readBatch(batch)) {
+    sum.add(replay::sumPayloads(std::span<const replay::Msg>(batch.data(), n)));
+  }
+  double elapsed_s = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+  for (size_t feed = 0; feed < engine.getFeedCount(); ++feed) {
+    std::cout << "  feed " << feed << ": " << engine.getMergedCount(feed)
+              << " messages  " << engine.getFilePath(feed) << std::endl;
+  }
+  std::cout << "Messages: " << engine.getMergedCount() << std::endl;
+  std::cout << "Elapsed: " << std::fixed << std::setprecision(3)
+            << elapsed_s * 1e3 << " ms ("
+            << std::setprecision(1)
+            << engine.getMergedCount() / elapsed_s / 1e6 << "M msg/s)"
+            << std::endl;
+  std::cout << "Timestamp order violations: "
+            << engine.getOrderViolationCount() << std::endl;
+  std::cout << "Sum: " << std::setprecision(6) << sum.value() << std::endl;
+
+  LOG_INFO(logger, "runMerge: feeds={}, msgs={}, order_violations={}",
+           engine.getFeedCount(), engine.getMergedCount(),
+           engine.getOrderViolationCount());
+  return 0;
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -324,6 +914,9 @@ int main(int argc, char* argv[]) {
   // Set main thread CPU affinity
   replay::setCpuAffinity(config.cpu_main, "main");
 
+  // Calibrate the timestamp clock now rather than on the first stamp
+  replay::TscClock::global();
+
   std::cout << "Real-time Data Replay System" << std::endl;
   std::cout << "=================" << std::endl;
   std::cout << std::endl;
@@ -338,6 +931,12 @@ int main(int argc, char* argv[]) {
     return runRecoveryTest(config);
   } else if (config.mode == "stress") {
     return runStressTest(config);
+  } else if (config.mode == "verify") {
+    return runVerify(config);
+  } else if (config.mode == "replay") {
+    return runReplay(config);
+  } else if (config.mode == "merge") {
+    return runMerge(config);
   } else {
     LOG_ERROR(logger, "Unknown mode: {}", config.mode);
     std::cerr << "Unknown mode: " << config.mode << std::endl;
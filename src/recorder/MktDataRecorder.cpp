@@ -1,11 +1,17 @@
 #include "MktDataRecorder.hpp"
 
+#include <algorithm>
+#include <cstddef>
+
 #include "common/Logging.hpp"
+#include "common/PayloadSum.hpp"
+#include "common/TscClock.hpp"
 
 namespace replay {
 
-MktDataRecorder::MktDataRecorder(RingBufferType& buffer,
-                                 const std::string& output_file)
+template <Record T>
+BasicMktDataRecorder<T>::BasicMktDataRecorder(RingBufferType& buffer,
+                                              const std::string& output_file)
     : buffer_(buffer),
       output_file_(output_file),
       channel_(output_file),
@@ -17,12 +23,18 @@ MktDataRecorder::MktDataRecorder(RingBufferType& buffer,
       kahan_c_(0.0),
       batch_size_(DISK_BATCH_SIZE),
       metrics_() {
+  if constexpr (std::is_same_v<T, Msg>) {
+    channel_.setFormat(FileFormat::COLUMNAR);
+  }
   batch_buffer_.reserve(batch_size_);
+  read_marks_.reserve(batch_size_);
 }
 
-MktDataRecorder::~MktDataRecorder() { stop(); }
+template <Record T>
+BasicMktDataRecorder<T>::~BasicMktDataRecorder() { stop(); }
 
-void MktDataRecorder::start() {
+template <Record T>
+void BasicMktDataRecorder<T>::start() {
   if (running_) {
     LOG_WARNING(replay::logger(),
                 "MktDataRecorder already running, ignoring start {}", "");
@@ -39,15 +51,18 @@ void MktDataRecorder::start() {
   last_seq_ = INVALID_SEQ;
   expected_sum_ = 0.0;
   kahan_c_ = 0.0;
+  read_marks_.clear();
+  stamped_count_ = channel_.getPersistedCount();
   running_ = true;
 
   LOG_INFO(replay::logger(), "MktDataRecorder start: output={}, batch_size={}",
            output_file_, batch_size_);
 
-  thread_ = std::thread(&MktDataRecorder::run, this);
+  thread_ = std::thread(&BasicMktDataRecorder::run, this);
 }
 
-void MktDataRecorder::stop() {
+template <Record T>
+void BasicMktDataRecorder<T>::stop() {
   stop_requested_ = true;
 
   if (thread_.joinable()) {
@@ -57,6 +72,7 @@ void MktDataRecorder::stop() {
   // Write remaining data
   writeBatch();
   channel_.close();  // Sets FILE_FLAG_COMPLETE
+  stampWritten();
 
   running_ = false;
   LOG_INFO(replay::logger(),
@@ -64,41 +80,86 @@ void MktDataRecorder::stop() {
            getRecordedCount(),
            metrics_.seq_gap_count.load(std::memory_order_relaxed),
            metrics_.overwrite_count.load(std::memory_order_relaxed));
+  LOG_INFO(replay::logger(),
+           "MktDataRecorder latency ns: read [{}], write [{}]",
+           metrics_.read_latency_ns.snapshot().summary(),
+           metrics_.write_latency_ns.snapshot().summary());
 }
 
-void MktDataRecorder::waitForComplete() {
+template <Record T>
+void BasicMktDataRecorder<T>::waitForComplete() {
   if (thread_.joinable()) {
     thread_.join();
   }
 }
 
-bool MktDataRecorder::isRunning() const { return running_; }
+template <Record T>
+bool BasicMktDataRecorder<T>::isRunning() const { return running_; }
 
-int64_t MktDataRecorder::getRecordedCount() const {
+template <Record T>
+int64_t BasicMktDataRecorder<T>::getRecordedCount() const {
   return recorded_count_.load(std::memory_order_acquire);
 }
 
-SeqNum MktDataRecorder::getLastSeq() const {
+template <Record T>
+SeqNum BasicMktDataRecorder<T>::getLastSeq() const {
   return last_seq_.load(std::memory_order_acquire);
 }
 
-double MktDataRecorder::getExpectedSum() const {
+template <Record T>
+double BasicMktDataRecorder<T>::getExpectedSum() const {
   return expected_sum_.load(std::memory_order_acquire);
 }
 
-void MktDataRecorder::flush() {
+template <Record T>
+void BasicMktDataRecorder<T>::flush() {
   writeBatch();
   channel_.flush();
+  stampWritten();
 }
 
-void MktDataRecorder::setBatchSize(size_t size) {
+template <Record T>
+void BasicMktDataRecorder<T>::setBatchSize(size_t size) {
   batch_size_ = size;
   batch_buffer_.reserve(size);
+  read_marks_.reserve(size);
+}
+
+template <Record T>
+void BasicMktDataRecorder<T>::setFileFormat(FileFormat format)
+  requires std::is_same_v<T, Msg>
+{
+  channel_.setFormat(format);
+}
+
+template <Record T>
+bool BasicMktDataRecorder<T>::setCodec(CodecId codec)
+  requires std::is_same_v<T, Msg>
+{
+  return channel_.setCodec(codec);
 }
 
-const RecorderMetrics& MktDataRecorder::getMetrics() const { return metrics_; }
+template <Record T>
+const RecorderMetrics& BasicMktDataRecorder<T>::getMetrics() const {
+  return metrics_;
+}
+
+template <Record T>
+void BasicMktDataRecorder<T>::setCpuCore(int core_id) {
+  cpu_core_ = core_id;
+}
 
-void MktDataRecorder::setCpuCore(int core_id) { cpu_core_ = core_id; }
+template <Record T>
+void BasicMktDataRecorder<T>::attachMetrics(MetricsRegistry& registry,
+                                            std::string_view prefix) {
+  std::string name(prefix);
+  registry.bind(recorded_metric_, name + ".recorded");
+  registry.bind(seq_metric_, name + ".seq");
+  registry.bind(written_metric_, name + ".written");
+  registry.bind(batch_metric_, name + ".batch");
+  registry.bind(gap_metric_, name + ".gaps");
+  registry.bind(overwrite_metric_, name + ".overwrites");
+}
 
 // ---------------------------------------------------------------------------
 // Main recorder loop.
@@ -108,49 +169,49 @@ void MktDataRecorder::setCpuCore(int core_id) { cpu_core_ = core_id; }
 // the ring buffer should be sized and the recorder prioritized so that this
 // never happens. When it does, we log an error, count the gap, and skip
 // ahead to the next available message.
+//
+// Published messages are drained with readBatch() and recorded a batch at a
+// time; readEx() is only consulted once nothing more is ready.
 // ---------------------------------------------------------------------------
-void MktDataRecorder::run() {
+template <Record T>
+void BasicMktDataRecorder<T>::run() {
   setCpuAffinity(cpu_core_, "MktDataRecorder");
 
   cursor_.reset(0);
 
+  ConsumerTable& consumers = buffer_.consumers();
+  consumer_id_ = consumers.registerConsumer("recorder", 0, tscTimestampNs());
+  if (consumer_id_ < 0) {
+    LOG_WARNING(replay::logger(),
+                "MktDataRecorder: consumer table full, lag not tracked {}",
+                "");
+  }
+
   while (!stop_requested_) {
     SeqNum seq = cursor_.getReadSeq();
+    size_t count = buffer_.readBatch(seq, read_batch_);
+    if (count > 0) {
+      recordBatch(std::span<const T>(read_batch_.data(), count));
+      cursor_.setReadSeq(seq + static_cast<SeqNum>(count));
+      consumers.publish(consumer_id_, seq + static_cast<SeqNum>(count),
+                        tscTimestampNs());
+
+      // Batch write
+      if (batch_buffer_.size() >= batch_size_) {
+        writeBatch();
+      }
+      continue;
+    }
+
     auto result = buffer_.readEx(seq);
 
     switch (result.status) {
       case ReadStatus::OK: {
-        // INV-R1: Verify monotonic sequence
-        SeqNum prev = last_seq_.load(std::memory_order_relaxed);
-        if (prev != INVALID_SEQ && result.msg.seq_num <= prev) {
-          LOG_WARNING(replay::logger(),
-                      "Recorder: duplicate/out-of-order seq={}, prev={}",
-                      result.msg.seq_num, prev);
-          cursor_.advance();
-          break;
-        }
-        if (prev != INVALID_SEQ && result.msg.seq_num != prev + 1) {
-          int64_t gap = result.msg.seq_num - prev - 1;
-          metrics_.seq_gap_count.fetch_add(gap, std::memory_order_relaxed);
-          LOG_WARNING(replay::logger(),
-                      "Recorder: seq gap detected, expected={}, got={}, gap={}",
-                      prev + 1, result.msg.seq_num, gap);
-        }
-
-        batch_buffer_.push_back(result.msg);
-
-        // Kahan summation
-        double y = result.msg.payload - kahan_c_;
-        double current_sum = expected_sum_.load(std::memory_order_relaxed);
-        double t = current_sum + y;
-        kahan_c_ = (t - current_sum) - y;
-        expected_sum_.store(t, std::memory_order_release);
-
-        last_seq_.store(result.msg.seq_num, std::memory_order_release);
-        recorded_count_.fetch_add(1, std::memory_order_release);
+        // Published between readBatch() and readEx()
+        recordBatch(std::span<const T>(&result.msg, 1));
         cursor_.advance();
+        consumers.publish(consumer_id_, seq + 1, tscTimestampNs());
 
-        // Batch write
         if (batch_buffer_.size() >= batch_size_) {
           writeBatch();
         }
@@ -160,6 +221,8 @@ void MktDataRecorder::run() {
       case ReadStatus::OVERWRITTEN: {
         // Critical: recorder was lapped. Log error, skip ahead.
         metrics_.overwrite_count.fetch_add(1, std::memory_order_relaxed);
+        overwrite_metric_.add();
+        consumers.recordLapped(consumer_id_);
         LOG_ERROR(replay::logger(),
                   "CRITICAL: Recorder lapped by producer at seq={}. "
                   "Data loss is permanent. Consider increasing buffer size.",
@@ -190,22 +253,122 @@ void MktDataRecorder::run() {
           // Has data to write, write to disk
           writeBatch();
         }
+        consumers.heartbeat(consumer_id_, tscTimestampNs());
         std::this_thread::yield();
         break;
     }
   }
 
+  consumers.unregisterConsumer(consumer_id_);
+  consumer_id_ = -1;
   running_ = false;
   LOG_INFO(replay::logger(), "MktDataRecorder completed: recorded={}",
            getRecordedCount());
 }
 
-void MktDataRecorder::writeBatch() {
+// ---------------------------------------------------------------------------
+// Record a readBatch() run. Within a run of consecutive seq_nums INV-R1 only
+// needs checking at the run boundary; a ring fed by pushBatchKeepSeq() may
+// skip or repeat seq_nums, so such a batch is recorded one consecutive run at
+// a time. The expected sum and shared counters are updated once per run, and
+// so is the clock read that both latency stages are measured from.
+// ---------------------------------------------------------------------------
+template <Record T>
+void BasicMktDataRecorder<T>::recordBatch(std::span<const T> batch) {
+  size_t run = consecutiveRun(batch);
+  if (run < batch.size()) {
+    for (; !batch.empty(); batch = batch.subspan(run)) {
+      run = consecutiveRun(batch);
+      recordBatch(batch.first(run));
+    }
+    return;
+  }
+
+  // INV-R1: Verify monotonic sequence
+  SeqNum prev = last_seq_.load(std::memory_order_relaxed);
+  while (!batch.empty() && prev != INVALID_SEQ &&
+         batch.front().seq_num <= prev) {
+    LOG_WARNING(replay::logger(),
+                "Recorder: duplicate/out-of-order seq={}, prev={}",
+                batch.front().seq_num, prev);
+    batch = batch.subspan(1);
+  }
+  if (batch.empty()) {
+    return;
+  }
+
+  if (prev != INVALID_SEQ && batch.front().seq_num != prev + 1) {
+    int64_t gap = batch.front().seq_num - prev - 1;
+    metrics_.seq_gap_count.fetch_add(gap, std::memory_order_relaxed);
+    gap_metric_.add(gap);
+    LOG_WARNING(replay::logger(),
+                "Recorder: seq gap detected, expected={}, got={}, gap={}",
+                prev + 1, batch.front().seq_num, gap);
+  }
+
+  int64_t now = tscTimestampNs();
+  for (const T& msg : batch) {
+    metrics_.read_latency_ns.record(now - msg.timestamp_ns);
+  }
+  read_marks_.push_back({now, batch.size()});
+
+  batch_buffer_.insert(batch_buffer_.end(), batch.begin(), batch.end());
+
+  // Kahan summation, one step per batch
+  if constexpr (std::is_same_v<T, Msg>) {
+    double y = sumPayloads(batch) - kahan_c_;
+    double current_sum = expected_sum_.load(std::memory_order_relaxed);
+    double t = current_sum + y;
+    kahan_c_ = (t - current_sum) - y;
+    expected_sum_.store(t, std::memory_order_release);
+  }
+
+  last_seq_.store(batch.back().seq_num, std::memory_order_release);
+  recorded_count_.fetch_add(static_cast<int64_t>(batch.size()),
+                            std::memory_order_release);
+  recorded_metric_.add(static_cast<int64_t>(batch.size()));
+  seq_metric_.set(batch.back().seq_num);
+  batch_metric_.set(static_cast<int64_t>(batch.size()));
+}
+
+template <Record T>
+void BasicMktDataRecorder<T>::writeBatch() {
   for (const auto& msg : batch_buffer_) {
     channel_.write(msg);
   }
+  written_metric_.add(static_cast<int64_t>(batch_buffer_.size()));
   batch_buffer_.clear();
-  channel_.flush();
+  channel_.periodicFlush();
+  stampWritten();
 }
 
+// Charge write latency to the messages the channel has persisted since the
+// last call, oldest read first. In v2 that is everything written; in v3 a
+// message is persisted when its block is sealed, so the latency includes the
+// wait for the block to fill.
+template <Record T>
+void BasicMktDataRecorder<T>::stampWritten() {
+  int64_t persisted = channel_.getPersistedCount();
+  if (persisted <= stamped_count_ || read_marks_.empty()) {
+    return;
+  }
+
+  int64_t written = tscTimestampNs();
+  size_t done = 0;
+  while (done < read_marks_.size() && stamped_count_ < persisted) {
+    ReadMark& mark = read_marks_[done];
+    auto count = std::min<uint64_t>(
+        mark.count, static_cast<uint64_t>(persisted - stamped_count_));
+    metrics_.write_latency_ns.record(written - mark.read_ns, count);
+    stamped_count_ += static_cast<int64_t>(count);
+    mark.count -= count;
+    done += mark.count == 0;
+  }
+  read_marks_.erase(read_marks_.begin(),
+                    read_marks_.begin() + static_cast<ptrdiff_t>(done));
+}
+
+template class BasicMktDataRecorder<Msg>;
+template class BasicMktDataRecorder<TickRecord>;
+
 }  // namespace replay
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "channel/FileChannel.hpp"
+#include "channel/RecordFileChannel.hpp"
 #include "common/CpuAffinity.hpp"
+#include "common/LatencyHistogram.hpp"
 #include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/Record.hpp"
 #include "common/RingBuffer.hpp"
 
 namespace replay {
@@ -16,29 +24,46 @@ namespace replay {
 struct RecorderMetrics {
   std::atomic<int64_t> seq_gap_count{0};    // Sequence gaps detected
   std::atomic<int64_t> overwrite_count{0};  // Ring buffer overwrites detected
+
+  // Written by the recorder thread only; snapshot() from anywhere
+  LatencyHistogram read_latency_ns;   // Producer timestamp -> read from ring
+  LatencyHistogram write_latency_ns;  // Read from ring -> written to the file
+                                      // (flushed in v2, block sealed in v3)
 };
 
 // Market data recorder
 // Independent thread consumes messages and persists to disk files
 //
+// Files are written in the v3 columnar layout by default: the header is then
+// updated once per sealed block rather than once per batch, and flush()
+// seals the partial block.
+//
 // Correctness invariant:
 //   INV-R1: Messages are written to disk in strictly increasing seq_num order
 //           with no gaps. If a gap is detected (ring buffer overwrite), it is
 //           logged and counted but recording continues — the gap will be
 //           visible in the file's seq_num stream and the header's first_seq /
 //           last_seq will reflect the actual range.
-class MktDataRecorder {
+//
+// T is the record recorded (see common/Record.hpp). MktDataRecorder records
+// Msg; other records are written with RecordFileWriteChannel in the v2
+// layout, so the file format and codec settings apply to Msg only. Instances
+// for Msg and TickRecord are compiled in MktDataRecorder.cpp.
+template <Record T>
+class BasicMktDataRecorder {
  public:
-  using RingBufferType = RingBuffer<DEFAULT_RING_BUFFER_SIZE>;
+  using RecordType = T;
+  using RingBufferType = RingBuffer<DEFAULT_RING_BUFFER_SIZE, T>;
+  using ChannelType = FileWriteChannelFor<T>;
 
-  MktDataRecorder(RingBufferType& buffer, const std::string& output_file);
-  ~MktDataRecorder();
+  BasicMktDataRecorder(RingBufferType& buffer, const std::string& output_file);
+  ~BasicMktDataRecorder();
 
   // Disable copy and move
-  MktDataRecorder(const MktDataRecorder&) = delete;
-  MktDataRecorder& operator=(const MktDataRecorder&) = delete;
-  MktDataRecorder(MktDataRecorder&&) = delete;
-  MktDataRecorder& operator=(MktDataRecorder&&) = delete;
+  BasicMktDataRecorder(const BasicMktDataRecorder&) = delete;
+  BasicMktDataRecorder& operator=(const BasicMktDataRecorder&) = delete;
+  BasicMktDataRecorder(BasicMktDataRecorder&&) = delete;
+  BasicMktDataRecorder& operator=(BasicMktDataRecorder&&) = delete;
 
   // Start recorder
   void start();
@@ -58,7 +83,7 @@ class MktDataRecorder {
   // Get last recorded sequence number
   SeqNum getLastSeq() const;
 
-  // Get expected sum (for verification)
+  // Get expected sum (for verification); Msg payloads, 0 for other records
   double getExpectedSum() const;
 
   // Flush buffer to disk
@@ -67,38 +92,81 @@ class MktDataRecorder {
   // Set batch write size
   void setBatchSize(size_t size);
 
+  // Set the file layout (call before start()); v3 columnar by default
+  void setFileFormat(FileFormat format)
+    requires std::is_same_v<T, Msg>;
+
+  // Compress v3 blocks with codec, on the recorder thread as blocks are
+  // sealed (call before start()). Returns false if this build lacks it.
+  bool setCodec(CodecId codec)
+    requires std::is_same_v<T, Msg>;
+
   // Set CPU core for this thread (call before start())
   void setCpuCore(int core_id);
 
   // Access observability metrics (thread-safe reads)
   const RecorderMetrics& getMetrics() const;
 
+  // Publish <prefix>.recorded, .seq (last read), .written (messages flushed
+  // to the file), .batch, .gaps and .overwrites into a metrics registry
+  // (call before start())
+  void attachMetrics(MetricsRegistry& registry,
+                     std::string_view prefix = "recorder");
+
  private:
   void run();
+  void recordBatch(std::span<const T> batch);
   void writeBatch();
+  void stampWritten();
 
   RingBufferType& buffer_;
   std::string output_file_;
-  FileWriteChannel channel_;
+  ChannelType channel_;
 
   std::thread thread_;
   std::atomic<bool> running_;
   std::atomic<bool> stop_requested_;
 
-  std::atomic<int64_t> recorded_count_;
+  // Recorder state written per batch, on a cache line of its own (the flags
+  // above are written by other threads and polled by the recorder)
+  alignas(CACHE_LINE_SIZE) std::atomic<int64_t> recorded_count_;
   std::atomic<SeqNum> last_seq_;
   std::atomic<double> expected_sum_;
   double kahan_c_;
 
-  std::vector<Msg> batch_buffer_;
+  alignas(CACHE_LINE_SIZE) std::vector<T> batch_buffer_;
   size_t batch_size_;
 
+  // Read time of each run of messages not yet persisted by channel_ (in
+  // batch_buffer_ or an open v3 block), for write latency
+  struct ReadMark {
+    int64_t read_ns;
+    uint64_t count;
+  };
+  std::vector<ReadMark> read_marks_;
+  int64_t stamped_count_ = 0;  // channel_ persisted count the marks start at
+
   ConsumerCursor cursor_;
+  int consumer_id_ = -1;  // Slot in buffer_.consumers() while running
+  std::array<T, CONSUME_BATCH_SIZE> read_batch_;
 
   // Observability
   RecorderMetrics metrics_;
 
+  // Published metrics (see attachMetrics()), written by the recorder thread
+  Counter recorded_metric_;
+  Gauge seq_metric_;
+  Counter written_metric_;
+  Gauge batch_metric_;
+  Counter gap_metric_;
+  Counter overwrite_metric_;
+
   int cpu_core_ = CPU_CORE_UNSET;
 };
 
+extern template class BasicMktDataRecorder<Msg>;
+extern template class BasicMktDataRecorder<TickRecord>;
+
+using MktDataRecorder = BasicMktDataRecorder<Msg>;
+
 }  // namespace replay
@@ -0,0 +1,125 @@
+#include "OverflowRelay.hpp"
+
+#include <algorithm>
+#include <span>
+#include <string>
+
+#include "common/Logging.hpp"
+#include "common/TscClock.hpp"
+
+namespace replay {
+
+OverflowRelay::OverflowRelay(RingBufferType& buffer, OverflowLog& log)
+    : buffer_(buffer),
+      log_(log),
+      running_(false),
+      stop_requested_(false),
+      relayed_count_(0),
+      lost_count_(0) {}
+
+OverflowRelay::~OverflowRelay() {
+  stop();
+  if (buffer_.getOverflow() == &log_) {
+    buffer_.attachOverflow(nullptr);
+  }
+}
+
+void OverflowRelay::start() {
+  if (running_) {
+    LOG_WARNING(replay::logger(),
+                "OverflowRelay already running, ignoring start {}", "");
+    return;
+  }
+
+  stop_requested_ = false;
+  relayed_count_ = 0;
+  lost_count_ = 0;
+  running_ = true;
+  buffer_.attachOverflow(&log_);
+
+  LOG_INFO(replay::logger(), "OverflowRelay start: log={}, capacity={}",
+           log_.getPath(), log_.capacity());
+  thread_ = std::thread(&OverflowRelay::run, this);
+}
+
+void OverflowRelay::stop() {
+  stop_requested_ = true;
+
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+
+  if (running_) {
+    running_ = false;
+    LOG_INFO(replay::logger(), "OverflowRelay stopped: relayed={}, lost={}",
+             getRelayedCount(), getLostCount());
+  }
+}
+
+bool OverflowRelay::isRunning() const { return running_; }
+
+int64_t OverflowRelay::getRelayedCount() const {
+  return relayed_count_.load(std::memory_order_acquire);
+}
+
+int64_t OverflowRelay::getLostCount() const {
+  return lost_count_.load(std::memory_order_acquire);
+}
+
+void OverflowRelay::setCpuCore(int core_id) { cpu_core_ = core_id; }
+
+void OverflowRelay::attachMetrics(MetricsRegistry& registry,
+                                  std::string_view prefix) {
+  std::string name(prefix);
+  registry.bind(relayed_metric_, name + ".relayed");
+  registry.bind(seq_metric_, name + ".seq");
+  registry.bind(lost_metric_, name + ".lost");
+}
+
+// ---------------------------------------------------------------------------
+// Relay loop: drain the ring a batch at a time into the log. The cursor is
+// published once per batch like any consumer's, so the ring's lapped count
+// covers the relay too.
+// ---------------------------------------------------------------------------
+void OverflowRelay::run() {
+  setCpuAffinity(cpu_core_, "OverflowRelay");
+  setThreadNice(RELAY_NICE, "OverflowRelay");
+
+  ConsumerTable& consumers = buffer_.consumers();
+  int consumer_id = consumers.registerConsumer("relay", 0, tscTimestampNs());
+  SeqNum seq = 0;
+
+  while (!stop_requested_) {
+    size_t count = buffer_.readBatch(seq, read_batch_);
+    if (count > 0) {
+      log_.append(std::span<const Msg>(read_batch_.data(), count));
+      seq += static_cast<SeqNum>(count);
+      consumers.publish(consumer_id, seq, tscTimestampNs());
+      relayed_count_.fetch_add(static_cast<int64_t>(count),
+                               std::memory_order_release);
+      relayed_metric_.add(static_cast<int64_t>(count));
+      seq_metric_.set(seq - 1);
+      continue;
+    }
+
+    if (buffer_.readEx(seq).status == ReadStatus::OVERWRITTEN) {
+      // Lapped: those messages are in neither tier now
+      SeqNum resume = std::max(seq + 1, buffer_.getOldestSeq());
+      lost_count_.fetch_add(resume - seq, std::memory_order_release);
+      lost_metric_.add(resume - seq);
+      consumers.recordLapped(consumer_id);
+      LOG_WARNING(replay::logger(),
+                  "OverflowRelay lapped at seq={}, resuming at {}", seq,
+                  resume);
+      seq = resume;
+      continue;
+    }
+
+    consumers.heartbeat(consumer_id, tscTimestampNs());
+    std::this_thread::sleep_for(IDLE_SLEEP);
+  }
+
+  consumers.unregisterConsumer(consumer_id);
+}
+
+}  // namespace replay
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string_view>
+#include <thread>
+
+#include "common/CpuAffinity.hpp"
+#include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/OverflowLog.hpp"
+#include "common/RingBuffer.hpp"
+#include "common/Types.hpp"
+
+namespace replay {
+
+// Overflow relay
+// Low-priority thread that copies every message from the ring into an
+// OverflowLog, giving lagging consumers a second, much larger tier: while the
+// relay keeps up, a consumer lapped in the ring reads on from the log
+// (RingBuffer::readEx() falls through to it) instead of recovering from disk.
+//
+// The relay is an ordinary registered consumer: it is never on the
+// producer's or the recorder's path, and it only has to stay within one ring
+// capacity of the producer. It runs at a low priority and sleeps when idle.
+// If it is lapped itself, the lost messages are counted and it resumes at
+// the oldest message still in the ring.
+class OverflowRelay {
+ public:
+  using RingBufferType = RingBuffer<DEFAULT_RING_BUFFER_SIZE>;
+
+  // Nice value of the relay thread
+  static constexpr int RELAY_NICE = 10;
+
+  // Sleep when the relay has caught up with the producer
+  static constexpr auto IDLE_SLEEP = std::chrono::microseconds(100);
+
+  // Attaches log to buffer on start(); the log must outlive the relay
+  OverflowRelay(RingBufferType& buffer, OverflowLog& log);
+  ~OverflowRelay();
+
+  // Disable copy and move
+  OverflowRelay(const OverflowRelay&) = delete;
+  OverflowRelay& operator=(const OverflowRelay&) = delete;
+  OverflowRelay(OverflowRelay&&) = delete;
+  OverflowRelay& operator=(OverflowRelay&&) = delete;
+
+  // Attach the log to the ring and start relaying from seq 0
+  void start();
+
+  // Stop relaying (the log stays attached until the relay is destroyed)
+  void stop();
+
+  bool isRunning() const;
+
+  // Messages copied into the log
+  int64_t getRelayedCount() const;
+
+  // Messages overwritten in the ring before the relay copied them
+  int64_t getLostCount() const;
+
+  // Set CPU core for this thread (call before start())
+  void setCpuCore(int core_id);
+
+  // Publish <prefix>.relayed, .seq (last relayed) and .lost into a metrics
+  // registry (call before start())
+  void attachMetrics(MetricsRegistry& registry,
+                     std::string_view prefix = "relay");
+
+ private:
+  void run();
+
+  RingBufferType& buffer_;
+  OverflowLog& log_;
+
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<bool> stop_requested_;
+
+  std::atomic<int64_t> relayed_count_;
+  std::atomic<int64_t> lost_count_;
+
+  // Published metrics, written by the relay thread once per batch
+  Counter relayed_metric_;
+  Gauge seq_metric_;
+  Counter lost_metric_;
+
+  std::array<Msg, CONSUME_BATCH_SIZE> read_batch_;
+
+  int cpu_core_ = CPU_CORE_UNSET;
+};
+
+}  // namespace replay
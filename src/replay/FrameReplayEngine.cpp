@@ -0,0 +1,158 @@
+#include "FrameReplayEngine.hpp"
+
+#include "common/Logging.hpp"
+
+namespace replay {
+
+namespace {
+
+constexpr uint64_t ALL_TYPES = ~uint64_t{0};
+
+}  // namespace
+
+FrameReplayEngine::FrameReplayEngine(const std::string& filepath)
+    : channel_(filepath),
+      type_mask_(ALL_TYPES),
+      last_read_seq_(INVALID_SEQ),
+      seq_violation_count_(0),
+      filtered_count_(0),
+      pacing_() {}
+
+FrameReplayEngine::~FrameReplayEngine() { close(); }
+
+bool FrameReplayEngine::open() {
+  bool ok = channel_.open();
+  if (ok) {
+    last_read_seq_ = INVALID_SEQ;
+    seq_violation_count_ = 0;
+    filtered_count_ = 0;
+    pacing_.reanchor();
+
+    if (!channel_.wasCleanlyClose()) {
+      LOG_WARNING(replay::logger(),
+                  "Frame replay file was NOT cleanly closed (possible "
+                  "crash): {} frames recovered past the header in {}",
+                  channel_.getRecoveredCount(), channel_.getFilePath());
+    }
+  }
+  return ok;
+}
+
+void FrameReplayEngine::close() { channel_.close(); }
+
+bool FrameReplayEngine::isOpen() const { return channel_.isOpen(); }
+
+void FrameReplayEngine::setTypeFilter(uint64_t type_mask) {
+  type_mask_ = type_mask;
+}
+
+void FrameReplayEngine::clearTypeFilter() { type_mask_ = ALL_TYPES; }
+
+void FrameReplayEngine::skipFiltered() {
+  if (type_mask_ == ALL_TYPES) {
+    return;
+  }
+  while (auto frame = channel_.peek()) {
+    uint16_t type = frame->header.type;
+    if (type < 64 && (type_mask_ >> type & 1) != 0) {
+      return;
+    }
+    channel_.readNext();
+    filtered_count_++;
+  }
+}
+
+std::optional<FrameView> FrameReplayEngine::nextFrame() {
+  skipFiltered();
+  auto frame = channel_.readNext();
+  if (frame) {
+    SeqNum seq = frame->header.seq_num;
+    if (last_read_seq_ != INVALID_SEQ && seq <= last_read_seq_) {
+      seq_violation_count_++;
+      LOG_WARNING(replay::logger(),
+                  "Frame replay sequence violation: prev={}, got={} in file "
+                  "{}",
+                  last_read_seq_, seq, channel_.getFilePath());
+    }
+    last_read_seq_ = seq;
+  }
+  return frame;
+}
+
+std::optional<FrameView> FrameReplayEngine::peekFrame() {
+  skipFiltered();
+  return channel_.peek();
+}
+
+// The frame is only consumed once its wait is over, so a cancelled wait
+// leaves it to the next read.
+std::optional<FrameView> FrameReplayEngine::nextPacedFrame(
+    const std::atomic<bool>* cancel) {
+  auto next = peekFrame();
+  if (!next || !pacing_.wait(next->header.timestamp_ns, cancel)) {
+    return std::nullopt;
+  }
+  return nextFrame();
+}
+
+bool FrameReplayEngine::seek(int64_t index) {
+  bool ok = channel_.seek(index);
+  if (ok) {
+    // No continuity check across a seek boundary
+    last_read_seq_ = INVALID_SEQ;
+    pacing_.reanchor();
+  }
+  return ok;
+}
+
+void FrameReplayEngine::reset() {
+  channel_.seek(0);
+  last_read_seq_ = INVALID_SEQ;
+  pacing_.reanchor();
+}
+
+void FrameReplayEngine::setPacing(const PacingConfig& config) {
+  pacing_.configure(config);
+}
+
+const PacingConfig& FrameReplayEngine::getPacing() const {
+  return pacing_.config();
+}
+
+const PacingStats& FrameReplayEngine::getPacingStats() const {
+  return pacing_.stats();
+}
+
+int64_t FrameReplayEngine::getFrameCount() const {
+  return channel_.getFrameCount();
+}
+
+int64_t FrameReplayEngine::getCurrentIndex() const {
+  return channel_.getCurrentIndex();
+}
+
+SeqNum FrameReplayEngine::getFileFirstSeq() const {
+  return channel_.getFirstSeq();
+}
+
+SeqNum FrameReplayEngine::getLastSeq() const {
+  return channel_.getFileLastSeq();
+}
+
+const std::string& FrameReplayEngine::getFilePath() const {
+  return channel_.getFilePath();
+}
+
+bool FrameReplayEngine::wasFileCleanlyClose() const {
+  return channel_.wasCleanlyClose();
+}
+
+int64_t FrameReplayEngine::getFilteredCount() const {
+  return filtered_count_;
+}
+
+int64_t FrameReplayEngine::getSeqViolationCount() const {
+  return seq_violation_count_;
+}
+
+}  // namespace replay
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "channel/FrameFileChannel.hpp"
+#include "common/Frame.hpp"
+#include "common/Pacing.hpp"
+#include "common/Types.hpp"
+
+namespace replay {
+
+// Replay of v4 (variable-length frame) recordings
+// The ReplayEngine of heterogeneous event streams: frames come back in file
+// order with their type and payload, seq_num continuity is checked the same
+// way (violations are counted and logged, the frame is still returned), and
+// nextPacedFrame() releases each frame on the PacingSchedule of its
+// timestamp_ns.
+//
+// setTypeFilter() restricts replay to some event types (those below 64, one
+// bit each); the other frames are skipped without being returned.
+class FrameReplayEngine {
+ public:
+  explicit FrameReplayEngine(const std::string& filepath);
+  ~FrameReplayEngine();
+
+  // Disable copy and move
+  FrameReplayEngine(const FrameReplayEngine&) = delete;
+  FrameReplayEngine& operator=(const FrameReplayEngine&) = delete;
+  FrameReplayEngine(FrameReplayEngine&&) = delete;
+  FrameReplayEngine& operator=(FrameReplayEngine&&) = delete;
+
+  bool open();
+
+  void close();
+
+  bool isOpen() const;
+
+  // Replay only frames whose type t has bit t set in type_mask
+  void setTypeFilter(uint64_t type_mask);
+
+  // Replay every frame again
+  void clearTypeFilter();
+
+  // Next frame (validates sequence continuity); the payload is valid until
+  // the next read
+  std::optional<FrameView> nextFrame();
+
+  // Peek at the next frame without consuming it
+  std::optional<FrameView> peekFrame();
+
+  // Read the next frame, blocking until its scheduled emission time.
+  // Returns std::nullopt at end of file, or if cancel is raised while
+  // waiting (the frame is then returned by the next read).
+  std::optional<FrameView> nextPacedFrame(
+      const std::atomic<bool>* cancel = nullptr);
+
+  // Move to frame index (not sequence number)
+  bool seek(int64_t index);
+
+  // Reset to beginning
+  void reset();
+
+  // Configure paced replay; re-anchors the schedule and clears PacingStats
+  void setPacing(const PacingConfig& config);
+
+  const PacingConfig& getPacing() const;
+
+  const PacingStats& getPacingStats() const;
+
+  // Frames in the file, and the index of the next one to read
+  int64_t getFrameCount() const;
+  int64_t getCurrentIndex() const;
+
+  SeqNum getFileFirstSeq() const;
+  SeqNum getLastSeq() const;
+
+  const std::string& getFilePath() const;
+
+  // Whether the file was cleanly closed by its writer
+  bool wasFileCleanlyClose() const;
+
+  // Frames skipped by the type filter since open()
+  int64_t getFilteredCount() const;
+
+  // Get number of sequence violations detected during replay
+  int64_t getSeqViolationCount() const;
+
+ private:
+  // Consume frames the type filter rules out
+  void skipFiltered();
+
+  FrameFileChannel channel_;
+  uint64_t type_mask_;  // All bits set: no filter
+
+  // Validation state
+  SeqNum last_read_seq_;
+  int64_t seq_violation_count_;
+  int64_t filtered_count_;
+
+  PacingSchedule pacing_;
+};
+
+}  // namespace replay
@@ -0,0 +1,196 @@
+#include "MergedReplayEngine.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <utility>
+
+#include "common/Logging.hpp"
+
+namespace replay {
+
+MergedReplayEngine::MergedReplayEngine(std::vector<std::string> filepaths)
+    : filepaths_(std::move(filepaths)),
+      decode_threads_(0),
+      is_open_(false),
+      leaves_(1),
+      last_feed_(0),
+      merged_count_(0),
+      last_timestamp_ns_(std::numeric_limits<int64_t>::min()),
+      order_violation_count_(0) {}
+
+MergedReplayEngine::~MergedReplayEngine() { close(); }
+
+void MergedReplayEngine::setDecodeThreads(size_t threads) {
+  decode_threads_ = threads;
+}
+
+void MergedReplayEngine::setFilter(const MessageFilter& filter) {
+  filter_ = filter;
+}
+
+bool MergedReplayEngine::open() {
+  if (is_open_) {
+    return true;
+  }
+
+  feeds_.clear();
+  feeds_.resize(filepaths_.size());
+  for (size_t i = 0; i < filepaths_.size(); ++i) {
+    Feed& feed = feeds_[i];
+    feed.channel = std::make_unique<FileChannel>(filepaths_[i]);
+    feed.channel->setDecodeThreads(decode_threads_);
+    if (!feed.channel->open()) {
+      LOG_ERROR(replay::logger(), "MergedReplayEngine: failed to open {}",
+                filepaths_[i]);
+      feeds_.clear();
+      return false;
+    }
+    if (!feed.channel->wasCleanlyClose()) {
+      LOG_WARNING(replay::logger(),
+                  "Merged feed {} was NOT cleanly closed (possible crash). "
+                  "Data may be truncated: {}",
+                  i, filepaths_[i]);
+    }
+    if (filter_) {
+      feed.channel->setFilter(*filter_);
+    }
+    feed.buffer.resize(MERGE_BATCH_SIZE);
+  }
+
+  merged_count_ = 0;
+  last_timestamp_ns_ = std::numeric_limits<int64_t>::min();
+  order_violation_count_ = 0;
+  build();
+  is_open_ = true;
+
+  LOG_INFO(replay::logger(), "MergedReplayEngine: {} feeds, {} messages",
+           feeds_.size(), getMessageCount());
+  return true;
+}
+
+void MergedReplayEngine::close() {
+  feeds_.clear();
+  tree_.clear();
+  is_open_ = false;
+}
+
+bool MergedReplayEngine::isOpen() const { return is_open_; }
+
+MergedReplayEngine::Key MergedReplayEngine::head(uint32_t feed) {
+  const Key done = makeKey(std::numeric_limits<int64_t>::max(), feed + leaves_);
+  if (feed >= feeds_.size()) {
+    return done;  // Padding
+  }
+  Feed& in = feeds_[feed];
+  if (in.cursor == in.size) {
+    in.size = in.channel->readBatch(in.buffer);
+    in.cursor = 0;
+    if (in.size == 0) {
+      return done;
+    }
+  }
+  return makeKey(in.buffer[in.cursor].timestamp_ns, feed);
+}
+
+// Bottom-up: each internal node keeps its match's loser and passes the
+// winner up; the root's winner is tree_[0]
+void MergedReplayEngine::build() {
+  leaves_ = std::bit_ceil(std::max<uint32_t>(
+      1, static_cast<uint32_t>(feeds_.size())));
+  std::vector<Key> winners(2 * leaves_);
+  for (uint32_t i = 0; i < leaves_; ++i) {
+    winners[leaves_ + i] = head(i);
+  }
+  tree_.assign(leaves_, Key{});
+  for (uint32_t node = leaves_ - 1; node > 0; --node) {
+    const Key left = winners[2 * node];
+    const Key right = winners[2 * node + 1];
+    winners[node] = std::min(left, right);
+    tree_[node] = std::max(left, right);
+  }
+  tree_[0] = winners[1];
+}
+
+std::optional<Msg> MergedReplayEngine::nextMessage() {
+  Msg msg;
+  if (readBatch({&msg, 1}) == 0) {
+    return std::nullopt;
+  }
+  return msg;
+}
+
+size_t MergedReplayEngine::readBatch(std::span<Msg> out,
+                                     std::span<uint32_t> feeds) {
+  if (!is_open_) {
+    return 0;
+  }
+  // Merge state lives in locals for the loop: out[] stores would otherwise
+  // force the int64 members to be reloaded after every message
+  Key* tree = tree_.data();
+  const uint32_t leaves = leaves_;
+  int64_t last_timestamp_ns = last_timestamp_ns_;
+  int64_t violations = 0;
+  uint32_t feed = last_feed_;
+  size_t count = 0;
+  for (; count < out.size(); ++count) {
+    const uint32_t winner = rankOf(tree[0]);
+    if (winner >= leaves) {
+      break;  // Every feed is done
+    }
+    Feed& in = feeds_[winner];
+    const Msg& msg = in.buffer[in.cursor++];
+    out[count] = msg;
+    ++in.merged;
+    violations += msg.timestamp_ns < last_timestamp_ns;
+    last_timestamp_ns = msg.timestamp_ns;
+    feed = winner;
+    if (!feeds.empty()) {
+      feeds[count] = winner;
+    }
+
+    // Replay: the feed's next key plays the losers on its path to the root
+    Key next = in.cursor < in.size
+                   ? makeKey(in.buffer[in.cursor].timestamp_ns, winner)
+                   : head(winner);
+    for (uint32_t node = (winner + leaves) >> 1; node > 0; node >>= 1) {
+      const Key stored = tree[node];
+      tree[node] = std::max(stored, next);
+      next = std::min(stored, next);
+    }
+    tree[0] = next;
+  }
+  last_timestamp_ns_ = last_timestamp_ns;
+  order_violation_count_ += violations;
+  merged_count_ += static_cast<int64_t>(count);
+  last_feed_ = feed;
+  return count;
+}
+
+uint32_t MergedReplayEngine::getLastFeed() const { return last_feed_; }
+
+size_t MergedReplayEngine::getFeedCount() const { return filepaths_.size(); }
+
+const std::string& MergedReplayEngine::getFilePath(size_t feed) const {
+  return filepaths_[feed];
+}
+
+int64_t MergedReplayEngine::getMessageCount() const {
+  int64_t total = 0;
+  for (const Feed& feed : feeds_) {
+    total += feed.channel->getMessageCount();
+  }
+  return total;
+}
+
+int64_t MergedReplayEngine::getMergedCount() const { return merged_count_; }
+
+int64_t MergedReplayEngine::getMergedCount(size_t feed) const {
+  return feed < feeds_.size() ? feeds_[feed].merged : 0;
+}
+
+int64_t MergedReplayEngine::getOrderViolationCount() const {
+  return order_violation_count_;
+}
+
+}  // namespace replay
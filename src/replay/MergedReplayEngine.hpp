@@ -0,0 +1,131 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "channel/FileChannel.hpp"
+#include "common/Message.hpp"
+#include "common/MessageFilter.hpp"
+#include "common/Types.hpp"
+
+namespace replay {
+
+// Messages read from a recording per refill of its merge buffer
+constexpr size_t MERGE_BATCH_SIZE = 256;
+
+// K-way merge of several recordings (one per feed) into one stream ordered
+// by timestamp_ns.
+//
+// Feed i is the i-th file passed to the constructor. Each feed is read in
+// batches of MERGE_BATCH_SIZE into its own buffer, and a loser tree picks the
+// next message: the tree keeps the key of each match's loser (timestamp and
+// feed) in a flat array, so advancing the winning feed costs log2(N)
+// comparisons against keys already in cache and touches no other buffer.
+// Equal timestamps come out in feed order, and a feed's own messages in
+// their recorded (seq_num) order, so the output is the stable sort of all
+// messages by (timestamp_ns, feed, position in the feed).
+//
+// A feed whose timestamps go backwards cannot be merged in global order:
+// its messages still come out in file order, and each step back in the
+// output is counted (getOrderViolationCount()).
+class MergedReplayEngine {
+ public:
+  explicit MergedReplayEngine(std::vector<std::string> filepaths);
+  ~MergedReplayEngine();
+
+  MergedReplayEngine(const MergedReplayEngine&) = delete;
+  MergedReplayEngine& operator=(const MergedReplayEngine&) = delete;
+
+  // Decode v3 blocks of each feed on this many threads ahead of the merge
+  // (0, the default, decodes inline); takes effect on the next open()
+  void setDecodeThreads(size_t threads);
+
+  // Merge only messages matching filter (FileChannel::setFilter() on every
+  // feed); takes effect on the next open()
+  void setFilter(const MessageFilter& filter);
+
+  // Open every feed; false (nothing left open) if any cannot be opened
+  bool open();
+
+  void close();
+
+  bool isOpen() const;
+
+  // Next message in timestamp order (std::nullopt once every feed is done)
+  std::optional<Msg> nextMessage();
+
+  // Up to out.size() next messages; their feeds go to feeds (if not empty,
+  // at least out.size() long). Returns the number read (0 at the end).
+  size_t readBatch(std::span<Msg> out, std::span<uint32_t> feeds = {});
+
+  // Feed of the message last returned by nextMessage() or readBatch()
+  uint32_t getLastFeed() const;
+
+  size_t getFeedCount() const;
+
+  const std::string& getFilePath(size_t feed) const;
+
+  // Messages in all feeds (as indexed on open)
+  int64_t getMessageCount() const;
+
+  // Messages merged so far, in total and per feed
+  int64_t getMergedCount() const;
+  int64_t getMergedCount(size_t feed) const;
+
+  // Output messages whose timestamp_ns is below their predecessor's
+  int64_t getOrderViolationCount() const;
+
+ private:
+  // Merge key of a feed's head, ordered by timestamp and then by rank (the
+  // feed index; feed + leaves once the feed is exhausted, so done feeds lose
+  // every match)
+  struct Key {
+    int64_t timestamp_ns;
+    uint32_t rank;
+
+    friend auto operator<=>(const Key&, const Key&) = default;
+  };
+
+  static Key makeKey(int64_t timestamp_ns, uint32_t rank) {
+    return {timestamp_ns, rank};
+  }
+
+  static uint32_t rankOf(const Key& key) { return key.rank; }
+
+  struct Feed {
+    std::unique_ptr<FileChannel> channel;
+    std::vector<Msg> buffer;
+    size_t cursor = 0;
+    size_t size = 0;
+    int64_t merged = 0;
+  };
+
+  // Key of feed's next message, refilling its buffer when drained
+  Key head(uint32_t feed);
+
+  void build();
+
+  std::vector<std::string> filepaths_;
+  std::vector<Feed> feeds_;
+  size_t decode_threads_;
+  std::optional<MessageFilter> filter_;
+  bool is_open_;
+
+  // Loser tree over leaves_ (a power of two >= feed count) leaves: tree_[0]
+  // is the winner, tree_[n] the loser of the match at internal node n
+  uint32_t leaves_;
+  std::vector<Key> tree_;
+
+  uint32_t last_feed_;
+  int64_t merged_count_;
+  int64_t last_timestamp_ns_;
+  int64_t order_violation_count_;
+};
+
+}  // namespace replay
@@ -1,23 +1,81 @@
 #include "ReplayEngine.hpp"
 
+#include <algorithm>
+#include <thread>
+
 #include "common/Logging.hpp"
 
 namespace replay {
 
+namespace {
+
+// Messages per stream read when reducing a range
+constexpr size_t REDUCE_CHUNK_SIZE = 4096;
+
+}  // namespace
+
+void ReplayReduction::append(const ReplayReduction& next) {
+  if (next.msg_count == 0) {
+    return;
+  }
+  if (msg_count == 0) {
+    *this = next;
+    return;
+  }
+
+  // Boundary check, exactly as nextMessage() would see it
+  if (next.first_seq <= last_seq) {
+    seq_violation_count++;
+  } else if (next.first_seq > last_seq + 1) {
+    seq_gap_count += next.first_seq - last_seq - 1;
+  }
+
+  msg_count += next.msg_count;
+  last_seq = next.last_seq;
+  seq_violation_count += next.seq_violation_count;
+  seq_gap_count += next.seq_gap_count;
+  sum.merge(next.sum);
+}
+
 ReplayEngine::ReplayEngine(const std::string& filepath)
     : channel_(filepath),
       catchup_threshold_(CATCHUP_THRESHOLD),
       catchup_callback_(nullptr),
       last_read_seq_(INVALID_SEQ),
-      seq_violation_count_(0) {}
+      seq_violation_count_(0),
+      pacing_() {}
 
 ReplayEngine::~ReplayEngine() { close(); }
 
+void ReplayEngine::setDecodeThreads(size_t threads) {
+  channel_.setDecodeThreads(threads);
+}
+
+void ReplayEngine::setVerifyThreads(size_t threads) {
+  channel_.setVerifyThreads(threads);
+}
+
+const BlockVerifyStats& ReplayEngine::getVerifyStats() const {
+  return channel_.getVerifyStats();
+}
+
+void ReplayEngine::setFilter(const MessageFilter& filter) {
+  channel_.setFilter(filter);
+}
+
+void ReplayEngine::clearFilter() { channel_.clearFilter(); }
+
+const FilterStats& ReplayEngine::getFilterStats() const {
+  return channel_.getFilterStats();
+}
+
 bool ReplayEngine::open() {
   bool ok = channel_.open();
   if (ok) {
     last_read_seq_ = INVALID_SEQ;
     seq_violation_count_ = 0;
+    pending_msg_.reset();
+    pacing_.reanchor();
 
     if (!channel_.wasCleanlyClose()) {
       LOG_WARNING(replay::logger(),
@@ -25,6 +83,14 @@ bool ReplayEngine::open() {
                   "Data may be truncated: {}",
                   channel_.getFilePath());
     }
+    const BlockVerifyStats& verify = channel_.getVerifyStats();
+    if (verify.corrupt) {
+      LOG_WARNING(replay::logger(),
+                  "Corrupt block in {}: replay ends at position {}, {} "
+                  "messages dropped",
+                  channel_.getFilePath(), channel_.getMessageCount(),
+                  verify.dropped_messages);
+    }
   }
   return ok;
 }
@@ -38,6 +104,13 @@ bool ReplayEngine::isOpen() const { return channel_.isOpen(); }
 // and count violations but still return the message — the consumer decides
 // whether to skip or process.
 std::optional<Msg> ReplayEngine::nextMessage() {
+  if (pending_msg_) {
+    // Already validated when it was first read
+    auto msg = pending_msg_;
+    pending_msg_.reset();
+    return msg;
+  }
+
   auto msg = channel_.readNext();
   if (msg) {
     if (last_read_seq_ != INVALID_SEQ && msg->seq_num <= last_read_seq_) {
@@ -51,7 +124,12 @@ std::optional<Msg> ReplayEngine::nextMessage() {
   return msg;
 }
 
-std::optional<Msg> ReplayEngine::peekMessage() { return channel_.peek(); }
+std::optional<Msg> ReplayEngine::peekMessage() {
+  if (pending_msg_) {
+    return pending_msg_;
+  }
+  return channel_.peek();
+}
 
 bool ReplayEngine::seek(SeqNum seq) {
   bool ok = channel_.seek(seq);
@@ -59,20 +137,31 @@ bool ReplayEngine::seek(SeqNum seq) {
     // Reset validation state after seek — we can't verify continuity
     // across a seek boundary
     last_read_seq_ = INVALID_SEQ;
+    pending_msg_.reset();
+    pacing_.reanchor();
   }
   return ok;
 }
 
+int64_t ReplayEngine::positionOfSeq(SeqNum seq) {
+  return channel_.positionOfSeq(seq);
+}
+
 void ReplayEngine::reset() {
   channel_.seek(0);
   last_read_seq_ = INVALID_SEQ;
+  pending_msg_.reset();
+  pacing_.reanchor();
 }
 
 int64_t ReplayEngine::getMessageCount() const {
   return channel_.getMessageCount();
 }
 
-SeqNum ReplayEngine::getCurrentSeq() const { return channel_.getCurrentSeq(); }
+SeqNum ReplayEngine::getCurrentSeq() const {
+  // A parked message has been read from the channel but not returned yet
+  return channel_.getCurrentSeq() - (pending_msg_ ? 1 : 0);
+}
 
 SeqNum ReplayEngine::getLastSeq() const { return channel_.getLatestSeq(); }
 
@@ -114,6 +203,38 @@ std::vector<Msg> ReplayEngine::readBatch(size_t count) {
   return batch;
 }
 
+void ReplayEngine::setPacing(const PacingConfig& config) {
+  pacing_.configure(config);
+}
+
+const PacingConfig& ReplayEngine::getPacing() const {
+  return pacing_.config();
+}
+
+const PacingStats& ReplayEngine::getPacingStats() const {
+  return pacing_.stats();
+}
+
+// ---------------------------------------------------------------------------
+// Paced read: the message is released when the PacingSchedule says it is due.
+//
+// A message whose wait is cancelled is parked in pending_msg_ and returned
+// by the next read, so cancellation never drops data.
+// ---------------------------------------------------------------------------
+std::optional<Msg> ReplayEngine::nextPacedMessage(
+    const std::atomic<bool>* cancel) {
+  auto next = nextMessage();
+  if (!next) {
+    return std::nullopt;
+  }
+
+  if (!pacing_.wait(next->timestamp_ns, cancel)) {
+    pending_msg_ = next;
+    return std::nullopt;
+  }
+  return next;
+}
+
 const std::string& ReplayEngine::getFilePath() const {
   return channel_.getFilePath();
 }
@@ -130,4 +251,116 @@ int64_t ReplayEngine::getSeqViolationCount() const {
   return seq_violation_count_;
 }
 
+std::optional<ReplayReduction> ReplayEngine::reduce(const std::string& filepath,
+                                                    int64_t begin,
+                                                    int64_t end) {
+  FileChannel channel(filepath);
+  if (!channel.open()) {
+    return std::nullopt;
+  }
+
+  int64_t total = channel.getMessageCount();
+  if (end < 0 || end > total) {
+    end = total;
+  }
+
+  ReplayReduction result;
+  if (begin >= end) {
+    return result;
+  }
+  if (begin > 0 && !channel.seek(begin)) {
+    return std::nullopt;
+  }
+
+  std::vector<Msg> chunk(REDUCE_CHUNK_SIZE);
+  int64_t remaining = end - begin;
+  SeqNum prev = INVALID_SEQ;
+
+  while (remaining > 0) {
+    size_t want = static_cast<size_t>(
+        std::min<int64_t>(remaining, static_cast<int64_t>(chunk.size())));
+    size_t got = channel.readBatch(std::span<Msg>(chunk.data(), want));
+    if (got == 0) {
+      break;  // File shorter than its header claims
+    }
+
+    for (size_t i = 0; i < got; ++i) {
+      const Msg& msg = chunk[i];
+      if (prev != INVALID_SEQ) {
+        if (msg.seq_num <= prev) {
+          result.seq_violation_count++;
+        } else if (msg.seq_num > prev + 1) {
+          result.seq_gap_count += msg.seq_num - prev - 1;
+        }
+      }
+      prev = msg.seq_num;
+      // ExactSum rather than the sumPayloads() kernel: partial reductions
+      // must merge bit-identically however the range was split
+      result.sum.add(msg.payload);
+    }
+
+    if (result.msg_count == 0) {
+      result.first_seq = chunk[0].seq_num;
+    }
+    result.msg_count += static_cast<int64_t>(got);
+    remaining -= static_cast<int64_t>(got);
+  }
+
+  result.last_seq = prev;
+  return result;
+}
+
+std::optional<ReplayReduction> ReplayEngine::parallelReduce(
+    const std::string& filepath, size_t num_threads, int64_t begin,
+    int64_t end) {
+  int64_t total;
+  {
+    FileChannel channel(filepath);
+    if (!channel.open()) {
+      return std::nullopt;
+    }
+    total = channel.getMessageCount();
+  }
+  if (end < 0 || end > total) {
+    end = total;
+  }
+
+  int64_t length = std::max<int64_t>(0, end - begin);
+
+  // Keep slices large enough to amortize opening a stream per thread
+  auto max_threads = static_cast<size_t>(
+      std::max<int64_t>(1, length / static_cast<int64_t>(REDUCE_CHUNK_SIZE)));
+  num_threads = std::clamp<size_t>(num_threads, 1, max_threads);
+  if (num_threads == 1) {
+    return reduce(filepath, begin, end);
+  }
+
+  // Contiguous slices; each thread opens its own stream
+  int64_t slice = (length + static_cast<int64_t>(num_threads) - 1) /
+                  static_cast<int64_t>(num_threads);
+  std::vector<std::optional<ReplayReduction>> parts(num_threads);
+  std::vector<std::thread> workers;
+  workers.reserve(num_threads);
+
+  for (size_t t = 0; t < num_threads; ++t) {
+    int64_t lo = begin + static_cast<int64_t>(t) * slice;
+    int64_t hi = std::min(end, lo + slice);
+    workers.emplace_back([&parts, &filepath, t, lo, hi]() {
+      parts[t] = reduce(filepath, lo, hi);
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  ReplayReduction result;
+  for (auto& part : parts) {
+    if (!part) {
+      return std::nullopt;
+    }
+    result.append(*part);
+  }
+  return result;
+}
+
 }  // namespace replay
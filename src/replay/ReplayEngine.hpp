@@ -1,22 +1,53 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include "channel/FileChannel.hpp"
+#include "common/ExactSum.hpp"
 #include "common/Message.hpp"
+#include "common/MessageFilter.hpp"
+#include "common/Pacing.hpp"
 #include "common/Types.hpp"
 
 namespace replay {
 
+// Summary of a contiguous range of a recording (see ReplayEngine::reduce()).
+// The sum is exact, so reductions of adjacent ranges can be computed on
+// different threads and appended in file order with a bit-identical result to
+// one sequential pass.
+struct ReplayReduction {
+  int64_t msg_count = 0;
+  SeqNum first_seq = INVALID_SEQ;
+  SeqNum last_seq = INVALID_SEQ;
+  int64_t seq_violation_count = 0;  // Non-increasing seq_num (as nextMessage)
+  int64_t seq_gap_count = 0;        // Missing seq_nums between messages
+  ExactSum sum;                     // Exact sum of payloads
+
+  // Append the reduction of the range that immediately follows this one
+  void append(const ReplayReduction& next);
+};
+
 // Replay engine
 // Reads historical messages from disk files, supports catch-up detection and
 // switching.
 //
 // Validates message sequence continuity during replay: each message's seq_num
 // must be strictly greater than the previous. Violations are counted and logged.
+//
+// Paced mode: nextPacedMessage() releases each message at the wall-clock time
+// implied by its timestamp_ns relative to the first paced message, scaled by
+// PacingConfig::speed (see PacingSchedule). The schedule is anchored at the
+// first paced message after open(), seek(), reset() or setPacing(), and how
+// late each message was released is tracked in PacingStats.
+//
+// Filtered replay: setFilter() restricts every read to the messages matching
+// seq_num, timestamp and payload ranges. In v3 files the blocks whose zone
+// maps rule the filter out are skipped without being read, so a narrow
+// window of a long recording only touches the blocks around it.
 class ReplayEngine {
  public:
   using CatchUpCallback =
@@ -31,6 +62,28 @@ class ReplayEngine {
   ReplayEngine(ReplayEngine&&) = delete;
   ReplayEngine& operator=(ReplayEngine&&) = delete;
 
+  // Decode v3 blocks on this many threads ahead of the reader (0, the
+  // default, decodes inline); takes effect on the next open()
+  void setDecodeThreads(size_t threads);
+
+  // Check every v3 block checksum on open on this many threads (0, the
+  // default, checks blocks as they are read); a corrupt block ends the file
+  // there. Takes effect on the next open().
+  void setVerifyThreads(size_t threads);
+
+  // Result of the checks on the last open() with setVerifyThreads()
+  const BlockVerifyStats& getVerifyStats() const;
+
+  // Replay only messages matching filter, from the current position on
+  // (also across seek() and reset()); resets the FilterStats
+  void setFilter(const MessageFilter& filter);
+
+  // Replay every message again
+  void clearFilter();
+
+  // Blocks skipped, selected and bytes read since open() or setFilter()
+  const FilterStats& getFilterStats() const;
+
   // Open replay file
   bool open();
 
@@ -49,6 +102,10 @@ class ReplayEngine {
   // Seek to specified sequence number
   bool seek(SeqNum seq);
 
+  // Position (for seek()) of the first message whose seq_num is >= seq;
+  // getMessageCount() if there is none. Recordings may skip seq_nums.
+  int64_t positionOfSeq(SeqNum seq);
+
   // Reset to beginning
   void reset();
 
@@ -73,6 +130,21 @@ class ReplayEngine {
   // Batch read messages
   std::vector<Msg> readBatch(size_t count);
 
+  // Configure paced replay; re-anchors the schedule and clears PacingStats
+  void setPacing(const PacingConfig& config);
+
+  // Current pacing configuration
+  const PacingConfig& getPacing() const;
+
+  // Read the next message, blocking until its scheduled emission time.
+  // Returns std::nullopt at end of file, or if cancel is raised while
+  // waiting (the message is then kept and returned by the next read).
+  std::optional<Msg> nextPacedMessage(
+      const std::atomic<bool>* cancel = nullptr);
+
+  // Schedule adherence of paced replay so far
+  const PacingStats& getPacingStats() const;
+
   // Get file path
   const std::string& getFilePath() const;
 
@@ -85,6 +157,18 @@ class ReplayEngine {
   // Get number of sequence violations detected during replay
   int64_t getSeqViolationCount() const;
 
+  // Reduce file positions [begin, end) on the calling thread (end < 0 means
+  // end of file). Returns std::nullopt if the file cannot be opened.
+  static std::optional<ReplayReduction> reduce(const std::string& filepath,
+                                               int64_t begin = 0,
+                                               int64_t end = -1);
+
+  // Same result as reduce(), with the range split across num_threads threads,
+  // each reading its own slice of the file.
+  static std::optional<ReplayReduction> parallelReduce(
+      const std::string& filepath, size_t num_threads, int64_t begin = 0,
+      int64_t end = -1);
+
  private:
   FileChannel channel_;
   int64_t catchup_threshold_;
@@ -93,6 +177,12 @@ class ReplayEngine {
   // Validation state
   SeqNum last_read_seq_;       // Last seq_num returned by nextMessage()
   int64_t seq_violation_count_; // Count of sequence order violations
+
+  // Message read by a cancelled nextPacedMessage(), returned by the next read
+  std::optional<Msg> pending_msg_;
+
+  // Paced replay schedule
+  PacingSchedule pacing_;
 };
 
 }  // namespace replay
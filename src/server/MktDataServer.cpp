@@ -1,21 +1,38 @@
 #include "MktDataServer.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <random>
 
 #include "common/Logging.hpp"
+#include "common/TscClock.hpp"
 
 namespace replay {
 
+namespace {
+
+// Range of generated payloads
+constexpr double PAYLOAD_MIN = 0.0;
+constexpr double PAYLOAD_MAX = 100.0;
+
+}  // namespace
+
 MktDataServer::MktDataServer(RingBufferType& buffer)
     : buffer_(buffer),
       running_(false),
       stop_requested_(false),
       message_count_(10000),
-      message_rate_(1000),
+      traffic_(),
+      rate_stats_(),
       sent_count_(0),
-      generator_(nullptr),
-      rng_(std::random_device{}()),
-      dist_(0.0, 100.0) {}
+      payload_fill_(nullptr),
+      rng_((static_cast<uint64_t>(std::random_device{}()) << 32) |
+           std::random_device{}()),
+      payloads_(),
+      batch_(),
+      replay_source_(),
+      replay_loop_count_(0),
+      replay_pacing_stats_() {}
 
 MktDataServer::~MktDataServer() { stop(); }
 
@@ -28,10 +45,19 @@ void MktDataServer::start() {
 
   stop_requested_ = false;
   sent_count_ = 0;
+  replay_loop_count_ = 0;
   running_ = true;
 
-  LOG_INFO(replay::logger(), "MktDataServer start: messages={}, rate={}",
-           message_count_, message_rate_);
+  if (replay_source_.filepath.empty()) {
+    LOG_INFO(replay::logger(),
+             "MktDataServer start: messages={}, rate={}, shape={}",
+             message_count_, traffic_.rate, static_cast<int>(traffic_.shape));
+  } else {
+    LOG_INFO(replay::logger(),
+             "MktDataServer start: replay={}, speed={}, loop={}, max={}",
+             replay_source_.filepath, replay_source_.pacing.speed,
+             replay_source_.loop, replay_source_.max_messages);
+  }
 
   thread_ = std::thread(&MktDataServer::run, this);
 }
@@ -58,15 +84,42 @@ bool MktDataServer::isRunning() const { return running_; }
 void MktDataServer::setMessageCount(int64_t count) { message_count_ = count; }
 
 void MktDataServer::setMessageRate(int64_t rate_per_second) {
-  message_rate_ = rate_per_second;
+  traffic_ = TrafficConfig{};
+  traffic_.rate = static_cast<double>(rate_per_second);
+}
+
+void MktDataServer::setTrafficShape(const TrafficConfig& traffic) {
+  traffic_ = traffic;
+}
+
+RatePacerStats MktDataServer::getRateStats() const { return rate_stats_; }
+
+void MktDataServer::setPayloadFill(PayloadFill fill) {
+  payload_fill_ = std::move(fill);
+}
+
+void MktDataServer::setReplaySource(const ReplaySourceConfig& config) {
+  replay_source_ = config;
 }
 
-void MktDataServer::setMessageGenerator(MessageGenerator generator) {
-  generator_ = std::move(generator);
+int64_t MktDataServer::getReplayLoopCount() const {
+  return replay_loop_count_.load(std::memory_order_acquire);
+}
+
+PacingStats MktDataServer::getReplayPacingStats() const {
+  return replay_pacing_stats_;
 }
 
 void MktDataServer::setCpuCore(int core_id) { cpu_core_ = core_id; }
 
+void MktDataServer::attachMetrics(MetricsRegistry& registry,
+                                  std::string_view prefix) {
+  std::string name(prefix);
+  registry.bind(sent_metric_, name + ".sent");
+  registry.bind(seq_metric_, name + ".seq");
+  registry.bind(batch_metric_, name + ".batch");
+}
+
 int64_t MktDataServer::getSentCount() const {
   return sent_count_.load(std::memory_order_acquire);
 }
@@ -76,45 +129,136 @@ SeqNum MktDataServer::getLatestSeq() const { return buffer_.getLatestSeq(); }
 void MktDataServer::run() {
   setCpuAffinity(cpu_core_, "MktDataServer");
 
-  using namespace std::chrono;
-
-  // Calculate interval time for each message
-  auto interval_ns = nanoseconds(1000000000 / message_rate_);
-  auto start_time = high_resolution_clock::now();
+  if (replay_source_.filepath.empty()) {
+    runGenerator();
+  } else {
+    runReplaySource();
+  }
 
-  for (int64_t i = 0; i < message_count_ && !stop_requested_; ++i) {
-    // Generate message
-    double payload = generatePayload();
-    int64_t timestamp = getCurrentTimestampNs();
+  running_ = false;
+  LOG_INFO(replay::logger(), "MktDataServer completed: sent={}",
+           getSentCount());
+}
 
-    Msg msg(INVALID_SEQ, timestamp,
-            payload);  // Sequence number assigned by RingBuffer
+// ---------------------------------------------------------------------------
+// Generator loop.
+//
+// The pacer hands out every message that is due (up to GENERATE_BATCH_SIZE),
+// so at rates beyond one clock read per message the producer publishes bursts
+// instead of waiting per message, and falls back to exact per-message waits
+// at lower rates.
+//
+// Each batch costs one TSC clock read: stamps are spread evenly over the time
+// since the previous batch, ending at the current reading, so they stay
+// non-decreasing and approximate when each message became due.
+// ---------------------------------------------------------------------------
+template <typename Fill>
+void MktDataServer::runGeneratorLoop(Fill&& fill) {
+  RatePacer pacer(traffic_);
+  int64_t sent = 0;
+  int64_t last_stamp_ns = tscTimestampNs();
 
-    // Write to buffer
-    buffer_.push(msg);
-    sent_count_.fetch_add(1, std::memory_order_release);
+  while (sent < message_count_ && !stop_requested_) {
+    auto remaining = static_cast<size_t>(message_count_ - sent);
+    size_t due = pacer.acquire(std::min(remaining, GENERATE_BATCH_SIZE),
+                               &stop_requested_);
+    if (due == 0) {
+      continue;  // Cancelled while waiting
+    }
 
-    // Rate control
-    if (message_rate_ > 0) {
-      auto expected_time = start_time + interval_ns * (i + 1);
-      auto now = high_resolution_clock::now();
+    fill(std::span<double>(payloads_.data(), due));
 
-      if (now < expected_time) {
-        std::this_thread::sleep_until(expected_time);
-      }
+    int64_t now_ns = tscTimestampNs();
+    int64_t span_ns = std::max<int64_t>(0, now_ns - last_stamp_ns);
+    auto count = static_cast<int64_t>(due);
+    for (size_t i = 0; i < due; ++i) {
+      int64_t stamp =
+          last_stamp_ns + span_ns * (static_cast<int64_t>(i) + 1) / count;
+      // Sequence number assigned by RingBuffer
+      batch_[i] = Msg(INVALID_SEQ, stamp, payloads_[i]);
     }
+    last_stamp_ns = std::max(last_stamp_ns, now_ns);
+
+    SeqNum first_seq =
+        buffer_.pushBatch(std::span<const Msg>(batch_.data(), due));
+    sent_count_.fetch_add(count, std::memory_order_release);
+    sent += count;
+
+    sent_metric_.add(count);
+    seq_metric_.set(first_seq + count - 1);
+    batch_metric_.set(count);
   }
 
-  running_ = false;
-  LOG_INFO(replay::logger(), "MktDataServer completed: sent={}",
-           getSentCount());
+  rate_stats_ = pacer.getStats();
+  LOG_INFO(replay::logger(),
+           "MktDataServer generator done: requested_rate={}, "
+           "achieved_rate={}, mean_jitter_ns={}, max_jitter_ns={}",
+           rate_stats_.requested_rate, rate_stats_.achieved_rate,
+           rate_stats_.mean_jitter_ns, rate_stats_.max_jitter_ns);
 }
 
-double MktDataServer::generatePayload() {
-  if (generator_) {
-    return generator_();
+void MktDataServer::runGenerator() {
+  if (payload_fill_) {
+    runGeneratorLoop([this](std::span<double> out) { payload_fill_(out); });
+  } else {
+    runGeneratorLoop([this](std::span<double> out) {
+      rng_.fill(out, PAYLOAD_MIN, PAYLOAD_MAX);
+    });
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Replay source loop.
+//
+// Pacing is delegated to ReplayEngine::nextPacedMessage(), which waits on
+// stop_requested_ so stop() is honoured even inside a long recorded gap.
+// On wrap-around the engine is reset, which re-anchors the schedule: the
+// first message of the next pass goes out immediately after the last one.
+// ---------------------------------------------------------------------------
+void MktDataServer::runReplaySource() {
+  ReplayEngine engine(replay_source_.filepath);
+  if (!engine.open()) {
+    LOG_ERROR(replay::logger(), "MktDataServer: cannot open replay source {}",
+              replay_source_.filepath);
+    return;
   }
-  return dist_(rng_);
+  engine.setPacing(replay_source_.pacing);
+
+  const int64_t limit = replay_source_.max_messages;
+  int64_t sent = 0;
+
+  while (!stop_requested_ && (limit < 0 || sent < limit)) {
+    auto recorded = engine.nextPacedMessage(&stop_requested_);
+    if (!recorded) {
+      if (stop_requested_) {
+        break;
+      }
+      // End of file
+      if (!replay_source_.loop || engine.getMessageCount() == 0) {
+        break;
+      }
+      engine.reset();
+      replay_loop_count_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    // Sequence number assigned by RingBuffer, stamped as a live message
+    SeqNum seq =
+        buffer_.push(Msg(INVALID_SEQ, tscTimestampNs(), recorded->payload));
+    sent_count_.fetch_add(1, std::memory_order_release);
+    ++sent;
+
+    sent_metric_.add();
+    seq_metric_.set(seq);
+    batch_metric_.set(1);
+  }
+
+  replay_pacing_stats_ = engine.getPacingStats();
+  LOG_INFO(replay::logger(),
+           "MktDataServer replay source done: sent={}, loops={}, "
+           "mean_lateness_ns={}, max_lateness_ns={}",
+           sent, getReplayLoopCount(), replay_pacing_stats_.meanLatenessNs(),
+           replay_pacing_stats_.max_lateness_ns);
 }
 
 }  // namespace replay
@@ -1,21 +1,54 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <functional>
-#include <random>
+#include <span>
+#include <string>
+#include <string_view>
 #include <thread>
 
 #include "common/CpuAffinity.hpp"
+#include "common/FastRng.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/Pacing.hpp"
 #include "common/RingBuffer.hpp"
+#include "replay/ReplayEngine.hpp"
+#include "server/RatePacer.hpp"
 
 namespace replay {
 
+// Recorded-file source for MktDataServer (see setReplaySource())
+struct ReplaySourceConfig {
+  std::string filepath;  // Recording to republish
+  PacingConfig pacing;   // Speed multiplier, gap compression
+  bool loop = false;     // Restart from the beginning at end of file
+  int64_t max_messages = -1;  // Stop after this many; < 0 = end of file
+                              // (never, when looping)
+};
+
 // Market data server
 // Independent thread generates simulated market data and writes to RingBuffer
+//
+// Two sources:
+//   - Generated (default): message_count_ payloads from the generator, paced
+//     by a RatePacer (uniform message rate by default, or any TrafficShape).
+//     Messages are generated and published in batches of up to
+//     GENERATE_BATCH_SIZE: payloads are filled in bulk, stamped from one
+//     clock read and published with one pushBatch().
+//   - Replay: a recording read through ReplayEngine and republished with its
+//     original inter-message gaps (optionally time-scaled, gap-compressed or
+//     looped), giving reproducible production-shaped load. Republished
+//     messages get new sequence numbers from the ring and the current time
+//     as timestamp; payloads are unchanged.
 class MktDataServer {
  public:
   using RingBufferType = RingBuffer<DEFAULT_RING_BUFFER_SIZE>;
-  using MessageGenerator = std::function<double()>;
+  // Custom payload source: fills one payload per element, once per batch
+  using PayloadFill = std::function<void(std::span<double>)>;
+
+  // Largest batch generated and published at once
+  static constexpr size_t GENERATE_BATCH_SIZE = 256;
 
   explicit MktDataServer(RingBufferType& buffer);
   ~MktDataServer();
@@ -38,16 +71,54 @@ class MktDataServer {
   // Check if running
   bool isRunning() const;
 
-  // Set message generation parameters
+  // Set message generation parameters. setMessageRate() selects a uniform
+  // rate; rate <= 0 sends as fast as possible.
   void setMessageCount(int64_t count);
   void setMessageRate(int64_t rate_per_second);
 
-  // Set custom message generator
-  void setMessageGenerator(MessageGenerator generator);
+  // Set the arrival process for generated messages (replaces the rate set by
+  // setMessageRate())
+  void setTrafficShape(const TrafficConfig& traffic);
+
+  // Achieved-versus-requested rate and jitter of the generator (valid once
+  // the server has completed or been stopped)
+  RatePacerStats getRateStats() const;
+
+  // Set a custom payload source, called once per generated batch (the
+  // default fills whole batches with FastUniformRng)
+  void setPayloadFill(PayloadFill fill);
+
+  // Set a custom per-message generator (double generator()). It is inlined
+  // into a batch fill, so the only indirect call is the one per batch.
+  template <typename Generator>
+  void setMessageGenerator(Generator generator) {
+    setPayloadFill(
+        [generator = std::move(generator)](std::span<double> out) mutable {
+          for (double& payload : out) {
+            payload = generator();
+          }
+        });
+  }
+
+  // Republish a recording instead of generating messages (call before
+  // start()). An empty filepath switches back to the generator.
+  void setReplaySource(const ReplaySourceConfig& config);
+
+  // Times the replay source wrapped around to the start of the file
+  int64_t getReplayLoopCount() const;
+
+  // Schedule adherence of the replay source (valid once the server has
+  // completed or been stopped)
+  PacingStats getReplayPacingStats() const;
 
   // Set CPU core for this thread (call before start())
   void setCpuCore(int core_id);
 
+  // Publish <prefix>.sent, .seq (last published seq) and .batch into a
+  // metrics registry (call before start())
+  void attachMetrics(MetricsRegistry& registry,
+                     std::string_view prefix = "server");
+
   // Get count of sent messages
   int64_t getSentCount() const;
 
@@ -56,7 +127,13 @@ class MktDataServer {
 
  private:
   void run();
-  double generatePayload();
+  void runGenerator();
+  void runReplaySource();
+
+  // Generator loop, instantiated per payload source so the default bulk fill
+  // is inlined. fill(span<double>) writes one payload per element.
+  template <typename Fill>
+  void runGeneratorLoop(Fill&& fill);
 
   RingBufferType& buffer_;
   std::thread thread_;
@@ -64,12 +141,25 @@ class MktDataServer {
   std::atomic<bool> stop_requested_;
 
   int64_t message_count_;
-  int64_t message_rate_;
+  TrafficConfig traffic_;
+  RatePacerStats rate_stats_;  // Copied out when the generator finishes
   std::atomic<int64_t> sent_count_;
 
-  MessageGenerator generator_;
-  std::mt19937 rng_;
-  std::uniform_real_distribution<double> dist_;
+  PayloadFill payload_fill_;
+  FastUniformRng rng_;
+
+  // Published metrics, written by the server thread once per batch
+  Counter sent_metric_;
+  Gauge seq_metric_;
+  Gauge batch_metric_;
+
+  // Generator scratch space, reused for every batch
+  std::array<double, GENERATE_BATCH_SIZE> payloads_;
+  std::array<Msg, GENERATE_BATCH_SIZE> batch_;
+
+  ReplaySourceConfig replay_source_;
+  std::atomic<int64_t> replay_loop_count_;
+  PacingStats replay_pacing_stats_;  // Copied out when the replay finishes
 
   int cpu_core_ = CPU_CORE_UNSET;
 };
@@ -0,0 +1,258 @@
+#include "RatePacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "common/Logging.hpp"
+
+namespace replay {
+
+namespace {
+
+constexpr double NS_PER_SEC = 1e9;
+constexpr double NEVER = std::numeric_limits<double>::infinity();
+
+// Long-run mean rate of a shape (msg/s)
+double meanRate(const TrafficConfig& config) {
+  switch (config.shape) {
+    case TrafficShape::ON_OFF: {
+      double period = static_cast<double>(config.on_ns + config.off_ns);
+      return config.rate * static_cast<double>(config.on_ns) / period;
+    }
+    case TrafficShape::PROFILE: {
+      double messages = 0.0;
+      double duration = 0.0;
+      for (const auto& step : config.profile) {
+        messages += std::max(0.0, step.rate) *
+                    static_cast<double>(step.duration_ns) / NS_PER_SEC;
+        duration += static_cast<double>(step.duration_ns);
+      }
+      return duration > 0.0 ? messages * NS_PER_SEC / duration : 0.0;
+    }
+    default:
+      return config.rate;
+  }
+}
+
+}  // namespace
+
+RatePacer::RatePacer(const TrafficConfig& config)
+    : config_(config),
+      rng_(config.seed != 0 ? config.seed : std::random_device{}()),
+      exponential_(1.0),
+      started_(false),
+      next_due_ns_(0.0),
+      profile_step_(0),
+      profile_step_end_ns_(0.0),
+      tokens_(0.0),
+      tokens_at_ns_(0.0),
+      stats_(),
+      first_release_ns_(0.0),
+      last_release_ns_(0.0),
+      last_due_ns_(0.0),
+      total_jitter_ns_(0.0) {
+  // Reject configurations that could never release a message
+  if (config_.shape == TrafficShape::PROFILE) {
+    bool valid = !config_.profile.empty();
+    bool any_rate = false;
+    for (const auto& step : config_.profile) {
+      valid = valid && step.duration_ns > 0;
+      any_rate = any_rate || step.rate > 0.0;
+    }
+    if (!valid || !any_rate) {
+      LOG_WARNING(replay::logger(),
+                  "RatePacer: unusable rate profile ({} steps), falling back "
+                  "to uniform rate={}",
+                  config_.profile.size(), config_.rate);
+      config_.shape = TrafficShape::UNIFORM;
+    }
+  }
+  if (config_.shape == TrafficShape::ON_OFF &&
+      (config_.on_ns <= 0 || config_.off_ns < 0)) {
+    LOG_WARNING(replay::logger(),
+                "RatePacer: invalid on/off windows on={} off={}, falling back "
+                "to uniform rate={}",
+                config_.on_ns, config_.off_ns, config_.rate);
+    config_.shape = TrafficShape::UNIFORM;
+  }
+  config_.burst_size = std::max<int64_t>(1, config_.burst_size);
+
+  stats_.requested_rate = isUnthrottled() ? 0.0 : meanRate(config_);
+}
+
+const TrafficConfig& RatePacer::getConfig() const { return config_; }
+
+bool RatePacer::isUnthrottled() const {
+  return config_.shape != TrafficShape::PROFILE && config_.rate <= 0.0;
+}
+
+// ---------------------------------------------------------------------------
+// Due time of the message after the one due at due_ns.
+//
+// ON_OFF and PROFILE push a candidate that falls outside an active window to
+// the start of the next active window, so silent periods cost nothing.
+// ---------------------------------------------------------------------------
+double RatePacer::nextDueNs(double due_ns) {
+  switch (config_.shape) {
+    case TrafficShape::POISSON:
+      return due_ns + exponential_(rng_) * NS_PER_SEC / config_.rate;
+
+    case TrafficShape::ON_OFF: {
+      double period = static_cast<double>(config_.on_ns + config_.off_ns);
+      double next = due_ns + NS_PER_SEC / config_.rate;
+      double phase = std::fmod(next, period);
+      if (phase >= static_cast<double>(config_.on_ns)) {
+        next += period - phase;
+      }
+      return next;
+    }
+
+    case TrafficShape::PROFILE: {
+      double rate = config_.profile[profile_step_].rate;
+      double next = rate > 0.0 ? due_ns + NS_PER_SEC / rate : NEVER;
+      while (next >= profile_step_end_ns_) {
+        double boundary = profile_step_end_ns_;
+        profile_step_ = (profile_step_ + 1) % config_.profile.size();
+        const auto& step = config_.profile[profile_step_];
+        profile_step_end_ns_ += static_cast<double>(step.duration_ns);
+        next = step.rate > 0.0 ? boundary : NEVER;
+      }
+      return next;
+    }
+
+    default:
+      return due_ns + NS_PER_SEC / config_.rate;
+  }
+}
+
+size_t RatePacer::acquire(size_t max_count, const std::atomic<bool>* cancel) {
+  if (max_count == 0) {
+    return 0;
+  }
+
+  if (!started_) {
+    started_ = true;
+    anchor_ = PacingClock::now();
+    tokens_ = static_cast<double>(config_.burst_size);
+    if (config_.shape == TrafficShape::PROFILE) {
+      profile_step_ = 0;
+      profile_step_end_ns_ =
+          static_cast<double>(config_.profile[0].duration_ns);
+      if (config_.profile[0].rate <= 0.0) {
+        // Start at the first step that sends anything
+        profile_step_end_ns_ = 0.0;
+        profile_step_ = config_.profile.size() - 1;
+        next_due_ns_ = nextDueNs(0.0);
+      }
+    }
+  }
+
+  if (isUnthrottled()) {
+    double now_ns =
+        static_cast<double>((PacingClock::now() - anchor_).count());
+    for (size_t i = 0; i < max_count; ++i) {
+      recordRelease(now_ns, now_ns);
+    }
+    return max_count;
+  }
+
+  if (config_.shape == TrafficShape::TOKEN_BUCKET) {
+    return acquireTokens(max_count, cancel);
+  }
+
+  auto now = PacingClock::now();
+  auto deadline =
+      anchor_ + Nanoseconds(static_cast<int64_t>(std::ceil(next_due_ns_)));
+  if (now < deadline) {
+    auto woke =
+        waitUntil(deadline, Nanoseconds(config_.spin_threshold_ns), cancel);
+    if (!woke) {
+      return 0;
+    }
+    now = *woke;
+  }
+
+  // Release everything that is due by now
+  double now_ns = static_cast<double>((now - anchor_).count());
+  size_t count = 0;
+  while (count < max_count && next_due_ns_ <= now_ns) {
+    recordRelease(now_ns, next_due_ns_);
+    next_due_ns_ = nextDueNs(next_due_ns_);
+    ++count;
+  }
+  return count;
+}
+
+// ---------------------------------------------------------------------------
+// Token bucket: tokens accrue at rate up to burst_size. A producer that keeps
+// up gets one message per 1/rate; after idling (or a stall) it may release up
+// to burst_size at once, but never more — unlike the absolute schedule of the
+// other shapes, a long stall is not caught up in one unbounded burst.
+// ---------------------------------------------------------------------------
+size_t RatePacer::acquireTokens(size_t max_count,
+                                const std::atomic<bool>* cancel) {
+  const double capacity = static_cast<double>(config_.burst_size);
+  auto refill = [&](double now_ns) {
+    tokens_ = std::min(capacity, tokens_ + (now_ns - tokens_at_ns_) *
+                                               config_.rate / NS_PER_SEC);
+    tokens_at_ns_ = now_ns;
+  };
+
+  double now_ns = static_cast<double>((PacingClock::now() - anchor_).count());
+  refill(now_ns);
+
+  double due_ns = now_ns;
+  if (tokens_ < 1.0) {
+    due_ns = now_ns + (1.0 - tokens_) * NS_PER_SEC / config_.rate;
+    auto deadline =
+        anchor_ + Nanoseconds(static_cast<int64_t>(std::ceil(due_ns)));
+    auto woke =
+        waitUntil(deadline, Nanoseconds(config_.spin_threshold_ns), cancel);
+    if (!woke) {
+      return 0;
+    }
+    now_ns = static_cast<double>((*woke - anchor_).count());
+    refill(now_ns);
+    tokens_ = std::max(tokens_, 1.0);  // Rounding must not lose the token
+  }
+
+  size_t count = std::min(max_count, static_cast<size_t>(tokens_));
+  tokens_ -= static_cast<double>(count);
+  for (size_t i = 0; i < count; ++i) {
+    recordRelease(now_ns, due_ns);
+  }
+  return count;
+}
+
+void RatePacer::recordRelease(double release_ns, double due_ns) {
+  if (stats_.sent_count > 0) {
+    double jitter =
+        std::fabs((release_ns - last_release_ns_) - (due_ns - last_due_ns_));
+    total_jitter_ns_ += jitter;
+    stats_.max_jitter_ns = std::max(stats_.max_jitter_ns, jitter);
+  } else {
+    first_release_ns_ = release_ns;
+  }
+  stats_.sent_count++;
+  stats_.lateness.recordEmit(
+      static_cast<int64_t>(std::max(0.0, release_ns - due_ns)));
+  last_release_ns_ = release_ns;
+  last_due_ns_ = due_ns;
+}
+
+RatePacerStats RatePacer::getStats() const {
+  RatePacerStats stats = stats_;
+  if (stats.sent_count > 1) {
+    double span_ns = last_release_ns_ - first_release_ns_;
+    if (span_ns > 0.0) {
+      stats.achieved_rate =
+          static_cast<double>(stats.sent_count - 1) * NS_PER_SEC / span_ns;
+    }
+    stats.mean_jitter_ns =
+        total_jitter_ns_ / static_cast<double>(stats.sent_count - 1);
+  }
+  return stats;
+}
+
+}  // namespace replay
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "common/Pacing.hpp"
+
+namespace replay {
+
+// Arrival process used by RatePacer
+enum class TrafficShape {
+  UNIFORM,       // Evenly spaced at rate
+  TOKEN_BUCKET,  // Sustained rate, up to burst_size back-to-back after idling
+  POISSON,       // Exponential inter-arrival times with mean 1/rate
+  ON_OFF,        // rate during on_ns windows, silent for off_ns in between
+  PROFILE        // Piecewise-constant rate from profile, repeated
+};
+
+// One step of a replayed rate profile
+struct RateProfileStep {
+  int64_t duration_ns;  // Length of the step
+  double rate;          // msg/s during the step (<= 0 = silent)
+};
+
+struct TrafficConfig {
+  TrafficShape shape = TrafficShape::UNIFORM;
+
+  // Messages per second (for ON_OFF: the rate inside on windows).
+  // <= 0 disables pacing for every shape except PROFILE.
+  double rate = 1000.0;
+
+  // TOKEN_BUCKET: bucket depth, the largest burst released after idle time
+  int64_t burst_size = 1;
+
+  // ON_OFF: window lengths
+  int64_t on_ns = 1000000;
+  int64_t off_ns = 9000000;
+
+  // PROFILE: steps played in order and repeated
+  std::vector<RateProfileStep> profile;
+
+  // POISSON: RNG seed (0 = random)
+  uint64_t seed = 0;
+
+  // Final part of each wait that is spun rather than slept
+  int64_t spin_threshold_ns = DEFAULT_SPIN_THRESHOLD_NS;
+};
+
+// Achieved-versus-requested report of a RatePacer
+struct RatePacerStats {
+  int64_t sent_count = 0;
+  double requested_rate = 0.0;  // Long-run mean rate of the shape (msg/s)
+  double achieved_rate = 0.0;   // sent_count / time since the first release
+  double mean_jitter_ns = 0.0;  // Mean |actual - scheduled| inter-arrival gap
+  double max_jitter_ns = 0.0;
+  PacingStats lateness;         // Release time vs scheduled time
+};
+
+// High-precision message pacer.
+//
+// Keeps an absolute schedule in double-precision nanoseconds from the first
+// acquire(), so there is no per-message integer truncation and wait errors
+// do not accumulate. Waits use the hybrid sleep/spin waitUntil(). At high
+// rates (intervals shorter than one clock read) acquire() hands out every
+// message that is already due in one call, so the producer publishes them
+// as a batch instead of waiting per message; that is what sustains
+// 5-20M msg/s microbursts.
+//
+// Not thread-safe: one pacer per producer thread.
+class RatePacer {
+ public:
+  explicit RatePacer(const TrafficConfig& config);
+
+  // Block until at least one message is due, then return how many are due
+  // now (1..max_count). Returns 0 if cancel was raised while waiting.
+  size_t acquire(size_t max_count, const std::atomic<bool>* cancel = nullptr);
+
+  // Achieved-versus-requested report so far
+  RatePacerStats getStats() const;
+
+  const TrafficConfig& getConfig() const;
+
+ private:
+  bool isUnthrottled() const;
+  double nextDueNs(double due_ns);
+  size_t acquireTokens(size_t max_count, const std::atomic<bool>* cancel);
+  void recordRelease(double release_ns, double due_ns);
+
+  TrafficConfig config_;
+  std::mt19937_64 rng_;
+  std::exponential_distribution<double> exponential_;
+
+  bool started_;
+  PacingClock::time_point anchor_;  // Time of the first acquire()
+  double next_due_ns_;              // Due time of the next message
+  size_t profile_step_;             // PROFILE: current step
+  double profile_step_end_ns_;      // PROFILE: end of the current step
+  double tokens_;                   // TOKEN_BUCKET: available tokens
+  double tokens_at_ns_;             // TOKEN_BUCKET: time of last refill
+
+  // Statistics
+  RatePacerStats stats_;
+  double first_release_ns_;
+  double last_release_ns_;
+  double last_due_ns_;
+  double total_jitter_ns_;
+};
+
+}  // namespace replay
@@ -0,0 +1,241 @@
+/**
+ * replay_top - live view of a shared-memory metrics page
+ *
+ * Samples the page published by replay_system or the ipc processes at a high
+ * rate and refreshes a summary every interval: counter totals and rates,
+ * gauge ranges, and how far each consumer trails the server. Only the
+ * metrics page is read; the publishing processes are never touched.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "common/Logging.hpp"
+#include "common/MetricsRegistry.hpp"
+
+namespace {
+
+std::atomic<bool> g_stop_requested{false};
+
+void signalHandler(int /*sig*/) { g_stop_requested = true; }
+
+struct Options {
+  std::string shm_name = replay::METRICS_SHM_NAME;
+  int64_t interval_ms = 1000;  // Display refresh
+  int64_t sample_us = 1000;    // Sampling period
+  int64_t count = 0;           // Refreshes before exiting, 0 = until stopped
+  bool clear = true;           // Redraw in place instead of appending
+};
+
+// One metric over the current display interval
+struct MetricView {
+  replay::MetricKind kind = replay::MetricKind::GAUGE;
+  int64_t first = 0;  // Value at the first sample of the interval
+  int64_t last = 0;
+  int64_t min = std::numeric_limits<int64_t>::max();
+  int64_t max = std::numeric_limits<int64_t>::min();
+  bool seen = false;
+
+  void add(replay::MetricKind k, int64_t value) {
+    if (!seen) {
+      kind = k;
+      first = value;
+      seen = true;
+    }
+    last = value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+
+  void startInterval() {
+    if (seen) {
+      first = last;
+      min = max = last;
+    }
+  }
+};
+
+// Name of the stage a "<stage>.<metric>" name belongs to
+std::string_view stageOf(std::string_view name) {
+  return name.substr(0, name.find('.'));
+}
+
+bool endsWith(std::string_view name, std::string_view suffix) {
+  return name.size() >= suffix.size() &&
+         name.substr(name.size() - suffix.size()) == suffix;
+}
+
+void printUsage(const char* program) {
+  std::cout << "Usage: " << program << " [options]\n"
+            << "  --shm=<name>         Metrics page (default: "
+            << replay::METRICS_SHM_NAME << ")\n"
+            << "  --interval-ms=<ms>   Display refresh (default: 1000)\n"
+            << "  --sample-us=<us>     Sampling period (default: 1000)\n"
+            << "  --count=<n>          Exit after n refreshes (default: run "
+               "until interrupted or the page is removed)\n"
+            << "  --no-clear           Append each refresh instead of "
+               "redrawing\n"
+            << std::endl;
+}
+
+// Page name still exists (the publisher unlinks it when its run ends)
+bool pageExists(const std::string& shm_name) {
+  int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+void render(const Options& options,
+            const std::map<std::string, MetricView>& views, double interval_s,
+            int64_t samples) {
+  if (options.clear) {
+    std::cout << "\033[H\033[2J";
+  }
+  std::cout << "replay_top  " << options.shm_name << "  (" << samples
+            << " samples over " << std::fixed << std::setprecision(2)
+            << interval_s << " s)\n\n";
+
+  std::cout << std::left << std::setw(24) << "METRIC" << std::right
+            << std::setw(16) << "VALUE" << std::setw(16) << "RATE/s"
+            << std::setw(14) << "MIN" << std::setw(14) << "MAX" << "\n";
+  for (const auto& [name, view] : views) {
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::setw(16) << view.last;
+    if (view.kind == replay::MetricKind::COUNTER) {
+      double rate = static_cast<double>(view.last - view.first) / interval_s;
+      std::cout << std::setw(16) << std::setprecision(0) << rate;
+    } else {
+      std::cout << std::setw(16) << "-" << std::setw(14) << view.min
+                << std::setw(14) << view.max;
+    }
+    std::cout << "\n";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  replay::initLogger("replay_top");
+
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--shm=")) {
+      options.shm_name = std::string(arg.substr(6));
+    } else if (arg.starts_with("--interval-ms=")) {
+      options.interval_ms =
+          std::max(1ll, std::stoll(std::string(arg.substr(14))));
+    } else if (arg.starts_with("--sample-us=")) {
+      options.sample_us =
+          std::max(1ll, std::stoll(std::string(arg.substr(12))));
+    } else if (arg.starts_with("--count=")) {
+      options.count = std::stoll(std::string(arg.substr(8)));
+    } else if (arg == "--no-clear") {
+      options.clear = false;
+    } else if (arg == "--help") {
+      printUsage(argv[0]);
+      return 0;
+    }
+  }
+
+  std::signal(SIGINT, signalHandler);
+  std::signal(SIGTERM, signalHandler);
+
+  auto registry = replay::MetricsRegistry::openShared(
+      options.shm_name, replay::MetricsRegistry::Access::MONITOR);
+  if (!registry) {
+    std::cerr << "No metrics page " << options.shm_name
+              << " (is replay_system or ipc_server running?)" << std::endl;
+    return 1;
+  }
+
+  std::vector<replay::MetricSample> samples;
+  std::map<std::string, MetricView> views;
+  // Consumer lag: server.seq minus each other stage's .seq, per sample
+  std::map<std::string, MetricView> lags;
+
+  const auto interval = std::chrono::milliseconds(options.interval_ms);
+  const auto period = std::chrono::microseconds(options.sample_us);
+  int64_t refreshes = 0;
+
+  while (!g_stop_requested) {
+    auto interval_start = std::chrono::steady_clock::now();
+    auto next_sample = interval_start;
+    int64_t sample_count = 0;
+
+    for (auto& entry : views) {
+      entry.second.startInterval();
+    }
+    for (auto& entry : lags) {
+      entry.second.startInterval();
+    }
+
+    while (!g_stop_requested &&
+           std::chrono::steady_clock::now() - interval_start < interval) {
+      registry->sample(samples);
+      ++sample_count;
+
+      int64_t server_seq = replay::INVALID_SEQ;
+      for (const auto& sample : samples) {
+        views[sample.name].add(sample.kind, sample.value);
+        if (sample.name == "server.seq") {
+          server_seq = sample.value;
+        }
+      }
+      if (server_seq != replay::INVALID_SEQ) {
+        for (const auto& sample : samples) {
+          if (endsWith(sample.name, ".seq") && sample.name != "server.seq") {
+            lags[std::string(stageOf(sample.name)) + ".lag"].add(
+                replay::MetricKind::GAUGE, server_seq - sample.value);
+          }
+        }
+      }
+
+      next_sample += period;
+      std::this_thread::sleep_until(next_sample);
+    }
+
+    double interval_s = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - interval_start)
+                            .count();
+    render(options, views, interval_s, sample_count);
+    if (!lags.empty()) {
+      std::cout << "\nLag behind server.seq (messages)\n";
+      for (const auto& [name, view] : lags) {
+        std::cout << std::left << std::setw(24) << name << std::right
+                  << std::setw(16) << view.last << std::setw(16) << "-"
+                  << std::setw(14) << view.min << std::setw(14) << view.max
+                  << "\n";
+      }
+    }
+    std::cout << std::flush;
+
+    if (options.count > 0 && ++refreshes >= options.count) {
+      break;
+    }
+    if (!pageExists(options.shm_name)) {
+      std::cout << "\nMetrics page removed, publisher finished" << std::endl;
+      break;
+    }
+  }
+
+  return 0;
+}
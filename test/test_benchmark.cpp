@@ -1,22 +1,38 @@
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <numeric>
+#include <random>
+#include <sstream>
 #include <thread>
 #include <vector>
 
+#include "arbitrator/LineArbitrator.hpp"
 #include "channel/FileChannel.hpp"
+#include "channel/RecordFileChannel.hpp"
 #include "client/MktDataClient.hpp"
+#include "common/Crc32c.hpp"
+#include "common/LatencyHistogram.hpp"
+#include "common/MessageFilter.hpp"
 #include "common/Message.hpp"
+#include "common/PayloadCodec.hpp"
+#include "common/PayloadSum.hpp"
 #include "common/RingBuffer.hpp"
 #include "common/SpinLock.hpp"
+#include "common/TscClock.hpp"
+#include "common/VarRingBuffer.hpp"
 #include "recorder/MktDataRecorder.hpp"
+#include "replay/MergedReplayEngine.hpp"
 #include "replay/ReplayEngine.hpp"
 #include "server/MktDataServer.hpp"
+#include "server/RatePacer.hpp"
 #include "test_main.cpp"
 
 using namespace replay;
@@ -570,7 +586,7 @@ TEST(Benchmark, EndToEndLatency) {
     while (seq < MSG_COUNT) {
       auto result = buffer->readEx(seq);
       if (result.status == ReadStatus::OK) {
-        int64_t now = getCurrentTimestampNs();
+        int64_t now = tscTimestampNs();
         latencies[static_cast<size_t>(seq)] =
             static_cast<double>(now - result.msg.timestamp_ns);
         ++seq;
@@ -581,7 +597,7 @@ TEST(Benchmark, EndToEndLatency) {
 
   // Producer — push with current timestamp
   for (int64_t i = 0; i < MSG_COUNT; ++i) {
-    Msg msg(i, getCurrentTimestampNs(), static_cast<double>(i));
+    Msg msg(i, tscTimestampNs(), static_cast<double>(i));
     buffer->push(msg);
   }
 
@@ -730,12 +746,1115 @@ TEST(Benchmark, RecoveryLatency) {
   ASSERT_LT(recovery_ms, 5000.0);
 }
 
+// ===========================================================================
+// Benchmark 13: Compensated payload summation kernels
+//
+// Sums CONSUME_BATCH_SIZE-message batches the way the client and recorder
+// do, comparing the per-message scalar Kahan loop with each SIMD kernel
+// supported by this CPU. Reported as messages per second on one core.
+// ===========================================================================
+TEST(Benchmark, PayloadSumKernels) {
+  const size_t BATCH = CONSUME_BATCH_SIZE;
+  const size_t ROUNDS = 40000;
+
+  std::vector<Msg> msgs(BATCH);
+  for (size_t i = 0; i < BATCH; ++i) {
+    msgs[i] = Msg(static_cast<SeqNum>(i), 0, std::sin(static_cast<double>(i)));
+  }
+  std::span<const Msg> batch(msgs);
+
+  std::cout << "\n=== Benchmark: Payload Sum Kernels (batch=" << BATCH
+            << ", active=" << sumKernelName(activeSumKernel())
+            << ") ===" << std::endl;
+
+  auto report = [&](const char* label, double elapsed_s, double result) {
+    double msg_per_s = static_cast<double>(BATCH * ROUNDS) / elapsed_s;
+    std::cout << "  " << std::left << std::setw(14) << label << std::right
+              << std::fixed << std::setprecision(1) << msg_per_s / 1e6
+              << " M msg/s/core  (sum=" << std::setprecision(6) << result
+              << ")" << std::endl;
+  };
+
+  // Baseline: the per-message Kahan update the consumers used to do
+  {
+    double sum = 0.0, c = 0.0;
+    BenchTimer timer;
+    timer.start();
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (const Msg& msg : batch) {
+        double y = msg.payload - c;
+        double t = sum + y;
+        c = (t - sum) - y;
+        sum = t;
+      }
+    }
+    report("scalar-kahan", timer.elapsed_s(), sum);
+  }
+
+  for (SumKernel kernel :
+       {SumKernel::SCALAR, SumKernel::AVX2, SumKernel::AVX512}) {
+    if (!isSumKernelSupported(kernel)) {
+      continue;
+    }
+    double sum = 0.0, c = 0.0;
+    BenchTimer timer;
+    timer.start();
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      double y = sumPayloads(batch, kernel) - c;
+      double t = sum + y;
+      c = (t - sum) - y;
+      sum = t;
+    }
+    report(sumKernelName(kernel), timer.elapsed_s(), sum);
+  }
+
+  // Just pass — this is an informational benchmark
+  ASSERT_TRUE(true);
+}
+
+// ===========================================================================
+// Benchmark 14: Paced replay accuracy
+//
+// Replays a file recorded at 1 us spacing (1M msg/s) at 1x and 10x and
+// reports how late each message was released relative to its schedule.
+// Target: median lateness < 1 us.
+// ===========================================================================
+TEST(Benchmark, PacedReplayAccuracy) {
+  const int64_t MSG_COUNT = 200000;
+  const std::string TEST_FILE = "data/bench_paced_replay.bin";
+
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.open());
+    for (int64_t i = 0; i < MSG_COUNT; ++i) {
+      writer.write(Msg(i, i * 1000, 1.0));
+    }
+    writer.close();
+  }
+
+  std::cout << "\n=== Benchmark: Paced Replay Accuracy ===" << std::endl;
+
+  for (double speed : {1.0, 10.0}) {
+    ReplayEngine engine(TEST_FILE);
+    ASSERT_TRUE(engine.open());
+    PacingConfig pacing;
+    pacing.speed = speed;
+    engine.setPacing(pacing);
+
+    std::vector<double> lateness;
+    lateness.reserve(MSG_COUNT);
+    while (engine.nextPacedMessage()) {
+      lateness.push_back(
+          static_cast<double>(engine.getPacingStats().last_lateness_ns));
+    }
+    ASSERT_EQ(static_cast<int64_t>(lateness.size()), MSG_COUNT);
+
+    auto stats = computeStats(lateness);
+    std::ostringstream label;
+    label << "lateness@" << speed << "x";
+    printStats(label.str(), stats);
+    std::cout << "    late (> " << PACING_LATE_THRESHOLD_NS
+              << " ns): " << engine.getPacingStats().late_count << std::endl;
+
+    if (speed == 1.0) {
+      ASSERT_LT(stats.median_ns, 1000.0);
+    }
+  }
+}
+
+// ===========================================================================
+// Benchmark 15: Generator microbursts
+//
+// Runs the server's generator into a ring buffer at 5M, 10M and 20M msg/s
+// (no consumers) and reports achieved rate and inter-arrival jitter. At these
+// rates one message interval is shorter than a clock read, so the pacer
+// releases due messages in bursts. Target: achieved within 5% of 5M msg/s.
+// ===========================================================================
+TEST(Benchmark, GeneratorMicrobursts) {
+  const int64_t MSG_COUNT = 2000000;
+
+  std::cout << "\n=== Benchmark: Generator Microbursts ===" << std::endl;
+
+  for (double rate : {5e6, 10e6, 20e6}) {
+    auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+    MktDataServer server(*buffer);
+    TrafficConfig traffic;
+    traffic.rate = rate;
+    server.setMessageCount(MSG_COUNT);
+    server.setTrafficShape(traffic);
+    server.start();
+    server.waitForComplete();
+
+    auto stats = server.getRateStats();
+    ASSERT_EQ(stats.sent_count, MSG_COUNT);
+    std::cout << "  requested " << std::fixed << std::setprecision(1)
+              << rate / 1e6 << "M msg/s: achieved " << stats.achieved_rate / 1e6
+              << "M msg/s, jitter mean " << stats.mean_jitter_ns << " ns, max "
+              << stats.max_jitter_ns << " ns" << std::endl;
+
+    if (rate == 5e6) {
+      ASSERT_GT(stats.achieved_rate, rate * 0.95);
+    }
+  }
+}
+
+// ===========================================================================
+// Benchmark 16: Generator saturation
+//
+// Unthrottled server generator with no consumers: the default batched path
+// (bulk RNG fill, one clock read and one pushBatch per batch) versus a
+// custom per-message generator inlined into a batch fill. Target: > 20M
+// msg/s default, so benchmarks measure consumers rather than the producer.
+// ===========================================================================
+TEST(Benchmark, GeneratorSaturation) {
+  const int64_t MSG_COUNT = 10000000;
+
+  std::cout << "\n=== Benchmark: Generator Saturation ===" << std::endl;
+
+  for (bool custom : {false, true}) {
+    auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+    MktDataServer server(*buffer);
+    server.setMessageCount(MSG_COUNT);
+    server.setMessageRate(0);
+    if (custom) {
+      server.setMessageGenerator([]() { return 1.0; });
+    }
+
+    BenchTimer timer;
+    timer.start();
+    server.start();
+    server.waitForComplete();
+    double elapsed_ns = timer.elapsed_ns();
+    ASSERT_EQ(server.getSentCount(), MSG_COUNT);
+
+    double msg_per_sec = static_cast<double>(MSG_COUNT) / elapsed_ns * 1e9;
+    std::cout << "  " << (custom ? "per-message generator" : "batched RNG")
+              << ": " << std::fixed << std::setprecision(1)
+              << msg_per_sec / 1e6 << "M msg/s" << std::endl;
+
+    if (!custom) {
+      ASSERT_GT(msg_per_sec, 20e6);
+    }
+  }
+}
+
+// ===========================================================================
+// Benchmark 17: Timestamp clock cost
+//
+// Per-call cost of the system clock (getCurrentTimestampNs, vDSO
+// clock_gettime) versus the calibrated TSC clock, and how far the TSC clock
+// sits from the system clock. Target: TSC clock not slower than the system
+// clock.
+// ===========================================================================
+TEST(Benchmark, TimestampClockCost) {
+  const int ITERATIONS = 5000000;
+  auto& clock = TscClock::global();
+
+  std::cout << "\n=== Benchmark: Timestamp Clock Cost ===" << std::endl;
+  std::cout << "  TSC clock active: " << (clock.usesTsc() ? "yes" : "no")
+            << std::endl;
+
+  int64_t sink = 0;
+  BenchTimer timer;
+  timer.start();
+  for (int i = 0; i < ITERATIONS; ++i) {
+    sink += getCurrentTimestampNs();
+  }
+  double system_ns = timer.elapsed_ns() / ITERATIONS;
+
+  timer.start();
+  for (int i = 0; i < ITERATIONS; ++i) {
+    sink += clock.nowNs();
+  }
+  double tsc_ns = timer.elapsed_ns() / ITERATIONS;
+
+  std::vector<double> offsets;
+  offsets.reserve(10000);
+  for (int i = 0; i < 10000; ++i) {
+    int64_t system = getCurrentTimestampNs();
+    offsets.push_back(static_cast<double>(std::llabs(clock.nowNs() - system)));
+  }
+  auto stats = computeStats(offsets);
+
+  std::cout << "  system clock: " << std::fixed << std::setprecision(1)
+            << system_ns << " ns/call" << std::endl;
+  std::cout << "  TSC clock:    " << tsc_ns << " ns/call" << std::endl;
+  printStats("|tsc - system|", stats);
+  ASSERT_TRUE(sink != 0);
+
+  if (clock.usesTsc()) {
+    ASSERT_LT(tsc_ns, system_ns * 1.1);
+  }
+}
+
+// ===========================================================================
+// Benchmark 18: Latency histogram record cost
+//
+// Cost of LatencyHistogram::record() with values spread over five decades,
+// i.e. what each consumer pays per message for per-stage latency tracking.
+// Target: < 10 ns per sample.
+// ===========================================================================
+TEST(Benchmark, HistogramRecordCost) {
+  const int ITERATIONS = 20000000;
+  auto histogram = std::make_unique<LatencyHistogram>();
+
+  BenchTimer timer;
+  timer.start();
+  uint64_t x = 88172645463325252ull;
+  for (int i = 0; i < ITERATIONS; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    histogram->record(static_cast<int64_t>(x % 100000000));
+  }
+  double per_record_ns = timer.elapsed_ns() / ITERATIONS;
+
+  auto snap = histogram->snapshot();
+  std::cout << "\n=== Benchmark: Histogram Record Cost ===" << std::endl;
+  std::cout << "  record(): " << std::fixed << std::setprecision(2)
+            << per_record_ns << " ns/sample" << std::endl;
+  std::cout << "  " << snap.summary() << std::endl;
+
+  ASSERT_EQ(snap.total_count, ITERATIONS);
+  ASSERT_LT(per_record_ns, 10.0);
+}
+
+// ===========================================================================
+// Benchmark 19: Recording format v2 vs v3
+//
+// The same 2M messages (consecutive seq_nums, 100-1000 ns tick spacing)
+// written as raw 24-byte records (v2) and as column blocks (v3): disk bytes
+// per message, write throughput, and replay throughput through FileChannel
+// batches and ReplayEngine. Target: v3 < 12 bytes/msg.
+// ===========================================================================
+TEST(Benchmark, FileFormatComparison) {
+  const int64_t MSG_COUNT = 2000000;
+
+  std::cout << "\n=== Benchmark: File Format v2 vs v3 ===" << std::endl;
+
+  double bytes_per_msg[2] = {0.0, 0.0};
+  for (FileFormat format : {FileFormat::RAW, FileFormat::COLUMNAR}) {
+    bool columnar = format == FileFormat::COLUMNAR;
+    const std::string TEST_FILE =
+        columnar ? "data/bench_format_v3.bin" : "data/bench_format_v2.bin";
+
+    BenchTimer timer;
+    timer.start();
+    {
+      FileWriteChannel writer(TEST_FILE, format);
+      ASSERT_TRUE(writer.open());
+      uint64_t x = 88172645463325252ull;
+      int64_t ts = getCurrentTimestampNs();
+      for (int64_t i = 0; i < MSG_COUNT; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        ts += 100 + static_cast<int64_t>(x % 900);
+        writer.write(Msg(i, ts, static_cast<double>(x % 10000) * 0.01));
+      }
+    }
+    double write_s = timer.elapsed_s();
+
+    timer.start();
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    std::vector<Msg> chunk(4096);
+    int64_t batch_count = 0;
+    while (size_t got = reader.readBatch(chunk)) {
+      batch_count += static_cast<int64_t>(got);
+    }
+    double batch_s = timer.elapsed_s();
+
+    ReplayEngine engine(TEST_FILE);
+    ASSERT_TRUE(engine.open());
+    timer.start();
+    int64_t replay_count = 0;
+    while (auto msg = engine.nextMessage()) {
+      ++replay_count;
+    }
+    double replay_s = timer.elapsed_s();
+
+    auto file_size = std::filesystem::file_size(TEST_FILE);
+    bytes_per_msg[columnar] =
+        static_cast<double>(file_size - sizeof(FileHeader)) / MSG_COUNT;
+
+    std::cout << "  " << (columnar ? "v3 column blocks" : "v2 raw records")
+              << ": " << std::fixed << std::setprecision(2)
+              << bytes_per_msg[columnar] << " bytes/msg, write "
+              << MSG_COUNT / write_s / 1e6 << "M msg/s, readBatch "
+              << batch_count / batch_s / 1e6 << "M msg/s, replay "
+              << replay_count / replay_s / 1e6 << "M msg/s" << std::endl;
+
+    ASSERT_EQ(batch_count, MSG_COUNT);
+    ASSERT_EQ(replay_count, MSG_COUNT);
+    ASSERT_EQ(engine.getSeqViolationCount(), 0);
+  }
+
+  std::cout << "  size ratio v2/v3: " << std::fixed << std::setprecision(2)
+            << bytes_per_msg[0] / bytes_per_msg[1] << "x" << std::endl;
+  ASSERT_LT(bytes_per_msg[1], 12.0);
+}
+
+// ===========================================================================
+// Benchmark 20: XOR payload codec
+//
+// Bytes per payload and encode/decode speed of the Gorilla-style XOR codec
+// used for v3 payload columns, on 4096-value blocks of: a 0.01 price walk
+// unchanged three ticks in four, the same walk moving every tick, a constant,
+// and uniform random doubles (which blocks store raw). Target: < 4 bytes per
+// payload on the quiet walk, decode > 100M values/s.
+// ===========================================================================
+TEST(Benchmark, PayloadCodec) {
+  const size_t BLOCK = 4096;
+  const int ROUNDS = 500;
+
+  std::cout << "\n=== Benchmark: XOR Payload Codec ===" << std::endl;
+
+  std::mt19937_64 rng(7);
+  std::uniform_real_distribution<double> uniform(0.0, 1000.0);
+  for (int kind = 0; kind < 4; ++kind) {
+    std::vector<double> values(BLOCK);
+    int64_t cents = 10000;
+    for (size_t i = 0; i < BLOCK; ++i) {
+      if (kind == 0 && rng() % 4 == 0) {
+        cents += static_cast<int64_t>(rng() % 3) - 1;
+      } else if (kind == 1) {
+        cents += static_cast<int64_t>(rng() % 5) - 2;
+      }
+      values[i] = kind == 3 ? uniform(rng) : static_cast<double>(cents) / 100;
+    }
+
+    std::vector<uint8_t> encoded;
+    encoded.reserve(BLOCK * 10);
+    BenchTimer timer;
+    timer.start();
+    for (int r = 0; r < ROUNDS; ++r) {
+      encoded.clear();
+      xorEncode(BLOCK, [&](size_t i) { return values[i]; }, encoded);
+    }
+    double encode_ns = timer.elapsed_ns() / (ROUNDS * BLOCK);
+
+    std::vector<double> decoded(BLOCK);
+    bool ok = true;
+    timer.start();
+    for (int r = 0; r < ROUNDS; ++r) {
+      ok &= xorDecode(encoded.data(), encoded.size(), BLOCK,
+                      [&](size_t i, double v) { decoded[i] = v; });
+    }
+    double decode_ns = timer.elapsed_ns() / (ROUNDS * BLOCK);
+    ASSERT_TRUE(ok);
+    ASSERT_TRUE(decoded == values);
+
+    const char* names[] = {"quiet tick walk", "busy tick walk", "constant",
+                           "uniform random"};
+    double bytes = static_cast<double>(encoded.size()) / BLOCK;
+    std::cout << "  " << std::left << std::setw(16) << names[kind]
+              << std::right << std::fixed << std::setprecision(2) << bytes
+              << " bytes/value (" << std::setprecision(1)
+              << 100.0 * bytes / sizeof(double) << "% of raw), encode "
+              << 1e3 / encode_ns << "M/s, decode " << 1e3 / decode_ns
+              << "M/s" << std::endl;
+
+    if (kind == 0) {
+      ASSERT_LT(bytes, 4.0);
+      ASSERT_GT(1e3 / decode_ns, 100.0);
+    }
+  }
+}
+
+// ===========================================================================
+// Benchmark 21: Block compression and parallel decode
+//
+// 2M tick-like messages (quiet 0.01 price walk, inter-arrival times from a
+// few recurring gaps) recorded as v2, v3 and v3 with LZ-compressed blocks:
+// bytes per message, write throughput, and replay throughput from the page
+// cache with blocks decoded inline and on decode threads. The replay rate
+// from a disk of B MB/s is min(CPU rate, B / bytes per message), shown for
+// a few bandwidths. Target: LZ files smaller than plain v3, and v3+LZ replay
+// faster than both uncompressed layouts from a 50 MB/s disk.
+// ===========================================================================
+TEST(Benchmark, BlockCompression) {
+  const int64_t MSG_COUNT = 2000000;
+  const double DISK_MB_S[] = {50.0, 100.0, 200.0};
+  const size_t DECODE_THREADS =
+      std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 4);
+
+  std::cout << "\n=== Benchmark: Block Compression ===" << std::endl;
+
+  struct Variant {
+    const char* name;
+    FileFormat format;
+    CodecId codec;
+  };
+  const Variant variants[] = {
+      {"v2 raw records", FileFormat::RAW, CodecId::NONE},
+      {"v3 column blocks", FileFormat::COLUMNAR, CodecId::NONE},
+      {"v3 + lz", FileFormat::COLUMNAR, CodecId::LZ},
+  };
+  const int64_t GAPS_NS[] = {250, 250, 500, 1000, 1000, 1000, 4000, 50000};
+
+  double bytes_per_msg[3] = {};
+  double cpu_rate[3] = {};
+  for (size_t v = 0; v < 3; ++v) {
+    const std::string TEST_FILE =
+        "data/bench_codec_" + std::to_string(v) + ".bin";
+
+    BenchTimer timer;
+    timer.start();
+    {
+      FileWriteChannel writer(TEST_FILE, variants[v].format);
+      ASSERT_TRUE(writer.setCodec(variants[v].codec));
+      ASSERT_TRUE(writer.open());
+      std::mt19937_64 rng(11);
+      int64_t ts = 1'700'000'000'000'000'000;
+      int64_t cents = 10000;
+      for (int64_t i = 0; i < MSG_COUNT; ++i) {
+        uint64_t x = rng();
+        ts += GAPS_NS[x % 8];
+        if ((x >> 8) % 4 == 0) {
+          cents += static_cast<int64_t>((x >> 16) % 3) - 1;
+        }
+        writer.write(Msg(i, ts, static_cast<double>(cents) / 100.0));
+      }
+    }
+    double write_s = timer.elapsed_s();
+    bytes_per_msg[v] = static_cast<double>(
+                           std::filesystem::file_size(TEST_FILE) -
+                           sizeof(FileHeader)) /
+                       MSG_COUNT;
+
+    std::cout << "  " << std::left << std::setw(17) << variants[v].name
+              << std::right << std::fixed << std::setprecision(2)
+              << bytes_per_msg[v] << " bytes/msg, write "
+              << MSG_COUNT / write_s / 1e6 << "M msg/s" << std::endl;
+
+    double best_rate = 0.0;
+    for (size_t threads : {size_t(0), DECODE_THREADS}) {
+      if (threads > 0 && variants[v].format == FileFormat::RAW) {
+        continue;
+      }
+      ReplayEngine engine(TEST_FILE);
+      engine.setDecodeThreads(threads);
+      ASSERT_TRUE(engine.open());
+      timer.start();
+      int64_t replay_count = 0;
+      double sum = 0.0;
+      while (auto msg = engine.nextMessage()) {
+        sum += msg->payload;
+        ++replay_count;
+      }
+      double rate = replay_count / timer.elapsed_s();
+      ASSERT_EQ(replay_count, MSG_COUNT);
+      ASSERT_EQ(engine.getSeqViolationCount(), 0);
+      ASSERT_GT(sum, 0.0);
+      best_rate = std::max(best_rate, rate);
+
+      std::cout << "    replay, " << threads << " decode threads: "
+                << std::setprecision(1) << rate / 1e6 << "M msg/s ("
+                << rate * bytes_per_msg[v] / 1e6 << " MB/s of file)"
+                << std::endl;
+    }
+
+    cpu_rate[v] = best_rate;
+  }
+
+  auto diskBound = [&](size_t v, double mb_s) {
+    return std::min(cpu_rate[v], mb_s * 1e6 / bytes_per_msg[v]);
+  };
+  for (double mb_s : DISK_MB_S) {
+    std::cout << "  replay from a " << std::setprecision(0) << mb_s
+              << " MB/s disk:" << std::setprecision(1);
+    for (size_t v = 0; v < 3; ++v) {
+      std::cout << (v ? ", " : " ") << variants[v].name << " "
+                << diskBound(v, mb_s) / 1e6 << "M";
+    }
+    std::cout << " msg/s" << std::endl;
+  }
+
+  ASSERT_LT(bytes_per_msg[2], bytes_per_msg[1]);
+  ASSERT_GT(diskBound(2, DISK_MB_S[0]), diskBound(0, DISK_MB_S[0]));
+  ASSERT_GT(diskBound(2, DISK_MB_S[0]), diskBound(1, DISK_MB_S[0]));
+}
+
+// ===========================================================================
+// Benchmark 22: Block checksums
+//
+// CRC32C throughput of the table and hardware kernels over a 64 MB buffer,
+// against a plain read of the same buffer (the memory bandwidth bound), and
+// verify-on-open of a 4M-message v3 file from the page cache with 1 and N
+// threads. Target: the hardware kernel at > 50% of read bandwidth.
+// ===========================================================================
+TEST(Benchmark, BlockChecksum) {
+  const size_t BUFFER_BYTES = size_t(64) << 20;
+  const int ROUNDS = 5;
+  const int64_t MSG_COUNT = 4000000;
+  const std::string TEST_FILE = "data/bench_crc.bin";
+
+  std::cout << "\n=== Benchmark: Block Checksums ===" << std::endl;
+
+  std::vector<uint64_t> buffer(BUFFER_BYTES / sizeof(uint64_t));
+  std::mt19937_64 rng(3);
+  for (uint64_t& word : buffer) {
+    word = rng();
+  }
+
+  BenchTimer timer;
+  timer.start();
+  uint64_t folded = 0;
+  for (int r = 0; r < ROUNDS; ++r) {
+    folded += std::accumulate(buffer.begin(), buffer.end(), uint64_t(0));
+  }
+  double read_gb_s = ROUNDS * BUFFER_BYTES / timer.elapsed_s() / 1e9;
+  std::cout << "  read bandwidth     " << std::fixed << std::setprecision(2)
+            << read_gb_s << " GB/s (" << (folded & 1) << ")" << std::endl;
+
+  double gb_s[2] = {};
+  uint32_t crcs[2] = {};
+  for (CrcKernel kernel : {CrcKernel::TABLE, CrcKernel::HARDWARE}) {
+    auto k = static_cast<size_t>(kernel);
+    timer.start();
+    for (int r = 0; r < ROUNDS; ++r) {
+      crcs[k] = crc32c(buffer.data(), BUFFER_BYTES, crcs[k], kernel);
+    }
+    gb_s[k] = ROUNDS * BUFFER_BYTES / timer.elapsed_s() / 1e9;
+    std::cout << "  crc32c " << std::left << std::setw(12)
+              << crcKernelName(kernel) << std::right << gb_s[k] << " GB/s"
+              << (kernel == CrcKernel::HARDWARE &&
+                          activeCrcKernel() != CrcKernel::HARDWARE
+                      ? " (not supported, table used)"
+                      : "")
+              << std::endl;
+  }
+  ASSERT_EQ(crcs[0], crcs[1]);
+
+  {
+    FileWriteChannel writer(TEST_FILE, FileFormat::COLUMNAR);
+    ASSERT_TRUE(writer.open());
+    for (int64_t i = 0; i < MSG_COUNT; ++i) {
+      writer.write(Msg(i, 1000 * i, static_cast<double>(rng() % 100000)));
+    }
+  }
+  const size_t threads =
+      std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 8);
+  for (size_t n : {size_t(1), threads}) {
+    FileChannel reader(TEST_FILE);
+    reader.setVerifyThreads(n);
+    ASSERT_TRUE(reader.open());
+    const BlockVerifyStats& stats = reader.getVerifyStats();
+    ASSERT_FALSE(stats.corrupt);
+    ASSERT_EQ(stats.verified_blocks, reader.getBlockCount());
+    std::cout << "  verify on open, " << n << " threads: "
+              << stats.verified_blocks << " blocks, "
+              << std::setprecision(1) << stats.bytes / 1e6 << " MB in "
+              << stats.seconds * 1e3 << " ms ("
+              << std::setprecision(2) << stats.bytes / stats.seconds / 1e9
+              << " GB/s)" << std::endl;
+  }
+
+  if (activeCrcKernel() == CrcKernel::HARDWARE) {
+    ASSERT_GT(gb_s[1], 0.5 * read_gb_s);
+  }
+}
+
+// ===========================================================================
+// Benchmark 23: Filtered replay
+//
+// A trading day of 4M messages (one every 21.6 ms, a random-walk price) as
+// v3 blocks, queried with FileChannel filters: an hour's window with a
+// payload threshold, and a 10k seq window, against a full scan that filters
+// in the consumer. Reports matches, blocks skipped / whole / selected and
+// bytes read, and the selection kernels' rate on decoded blocks.
+// Target: the seq window reads < 1% and the hour < 10% of the file.
+// ===========================================================================
+TEST(Benchmark, FilteredReplay) {
+  const int64_t MSG_COUNT = 4000000;
+  const int64_t DAY_START_NS = 1'700'000'000'000'000'000;
+  const int64_t GAP_NS = 86'400'000'000'000 / MSG_COUNT;
+  const int64_t HOUR_NS = 3'600'000'000'000;
+  const std::string TEST_FILE = "data/bench_filter.bin";
+
+  std::cout << "\n=== Benchmark: Filtered Replay ===" << std::endl;
+
+  {
+    FileWriteChannel writer(TEST_FILE, FileFormat::COLUMNAR);
+    ASSERT_TRUE(writer.open());
+    std::mt19937_64 rng(23);
+    int64_t cents = 10000;
+    for (int64_t i = 0; i < MSG_COUNT; ++i) {
+      cents += static_cast<int64_t>(rng() % 3) - 1;
+      writer.write(Msg(i, DAY_START_NS + i * GAP_NS,
+                       static_cast<double>(cents) / 100.0));
+    }
+  }
+  const auto file_bytes =
+      static_cast<double>(std::filesystem::file_size(TEST_FILE));
+
+  MessageFilter hour;  // 10:00-11:00, payload above the opening price
+  hour.min_timestamp_ns = DAY_START_NS + 10 * HOUR_NS;
+  hour.max_timestamp_ns = DAY_START_NS + 11 * HOUR_NS - 1;
+  hour.min_payload = 100.0;
+  MessageFilter window;  // 10k messages
+  window.min_seq = MSG_COUNT / 2;
+  window.max_seq = MSG_COUNT / 2 + 9999;
+
+  std::vector<Msg> batch(4096);
+  double read_fraction[2] = {};
+  const MessageFilter* queries[] = {&hour, &window};
+  const char* names[] = {"hour + payload", "10k seq window"};
+  for (size_t q = 0; q < 2; ++q) {
+    const MessageFilter& filter = *queries[q];
+
+    // Baseline: every message read and checked by the consumer
+    BenchTimer timer;
+    timer.start();
+    int64_t scanned = 0;
+    {
+      FileChannel reader(TEST_FILE);
+      ASSERT_TRUE(reader.open());
+      while (size_t n = reader.readBatch(batch)) {
+        for (size_t i = 0; i < n; ++i) {
+          scanned += filter.matches(batch[i]) ? 1 : 0;
+        }
+      }
+    }
+    double scan_ms = timer.elapsed_ms();
+
+    timer.start();
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    reader.setFilter(filter);
+    int64_t matched = 0;
+    while (size_t n = reader.readBatch(batch)) {
+      matched += static_cast<int64_t>(n);
+    }
+    double filter_ms = timer.elapsed_ms();
+    ASSERT_EQ(matched, scanned);
+
+    const FilterStats& stats = reader.getFilterStats();
+    read_fraction[q] = static_cast<double>(stats.bytes_read) / file_bytes;
+    std::cout << "  " << std::left << std::setw(15) << names[q] << std::right
+              << ": " << matched << " msgs; blocks " << stats.blocks_skipped
+              << " skipped / " << stats.blocks_whole << " whole / "
+              << stats.blocks_selected << " selected; " << std::fixed
+              << std::setprecision(2) << read_fraction[q] * 100.0
+              << "% of bytes read; " << filter_ms << " ms vs " << scan_ms
+              << " ms full scan" << std::endl;
+  }
+
+  // Selection kernels on decoded blocks, about half of each matching
+  std::vector<Msg> msgs(DEFAULT_BLOCK_MESSAGES);
+  std::mt19937_64 rng(5);
+  for (size_t i = 0; i < msgs.size(); ++i) {
+    msgs[i] = Msg(static_cast<int64_t>(i), static_cast<int64_t>(i) * GAP_NS,
+                  static_cast<double>(rng() % 2000) / 10.0);
+  }
+  MessageFilter half;
+  half.min_payload = 100.0;
+  std::vector<uint32_t> selection(msgs.size());
+  const int ROUNDS = 2000;
+  for (SelectKernel kernel :
+       {SelectKernel::SCALAR, SelectKernel::AVX2, SelectKernel::AVX512}) {
+    if (!isSelectKernelSupported(kernel)) {
+      continue;
+    }
+    BenchTimer timer;
+    timer.start();
+    size_t selected = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+      selected += selectMessages(msgs, half, selection.data(), kernel);
+    }
+    double rate = ROUNDS * msgs.size() / timer.elapsed_s() / 1e6;
+    std::cout << "  select " << std::left << std::setw(8)
+              << selectKernelName(kernel) << std::right
+              << std::setprecision(0) << rate << " M msgs/s ("
+              << selected / ROUNDS << " of " << msgs.size() << " match)"
+              << std::endl;
+  }
+
+  ASSERT_LT(read_fraction[0], 0.10);
+  ASSERT_LT(read_fraction[1], 0.01);
+}
+
+// ===========================================================================
+// Benchmark 24: Merged replay
+//
+// 4M messages split over N v3 recordings (random 100-2000 ns gaps per feed)
+// merged by timestamp with MergedReplayEngine::readBatch(), against
+// FileChannel::readBatch() over one 4M-message file. Feeds interleave
+// message by message, the worst case for the merge (every pick is a coin
+// flip). Target: 2 inputs > 30% and 64 inputs > 10% of the single-file rate.
+// ===========================================================================
+TEST(Benchmark, MergedReplay) {
+  const int64_t MSG_COUNT = 4000000;
+  const size_t INPUTS[] = {1, 2, 8, 64};
+
+  std::cout << "\n=== Benchmark: Merged Replay ===" << std::endl;
+
+  double single_rate = 0.0;
+  double rate_2 = 0.0;
+  double rate_64 = 0.0;
+  for (size_t n : INPUTS) {
+    std::vector<std::string> files;
+    std::mt19937_64 rng(24);
+    for (size_t f = 0; f < n; ++f) {
+      files.push_back("data/bench_merge_" + std::to_string(f) + ".bin");
+      FileWriteChannel writer(files.back(), FileFormat::COLUMNAR);
+      ASSERT_TRUE(writer.open());
+      int64_t ts = 1'700'000'000'000'000'000;
+      const auto feed_count = MSG_COUNT / static_cast<int64_t>(n);
+      for (int64_t i = 0; i < feed_count; ++i) {
+        uint64_t x = rng();
+        ts += 100 + static_cast<int64_t>(x % 1901);
+        writer.write(Msg(i, ts, static_cast<double>((x >> 16) % 10000)));
+      }
+    }
+
+    BenchTimer timer;
+    int64_t count = 0;
+    double checksum = 0.0;
+    std::vector<Msg> batch(MERGE_BATCH_SIZE);
+    if (n == 1) {
+      FileChannel reader(files[0]);
+      ASSERT_TRUE(reader.open());
+      timer.start();
+      while (size_t got = reader.readBatch(batch)) {
+        for (size_t i = 0; i < got; ++i) {
+          checksum += batch[i].payload;
+        }
+        count += static_cast<int64_t>(got);
+      }
+    } else {
+      MergedReplayEngine engine(files);
+      ASSERT_TRUE(engine.open());
+      timer.start();
+      while (size_t got = engine.readBatch(batch)) {
+        for (size_t i = 0; i < got; ++i) {
+          checksum += batch[i].payload;
+        }
+        count += static_cast<int64_t>(got);
+      }
+      ASSERT_EQ(engine.getOrderViolationCount(), 0);
+    }
+    double rate = count / timer.elapsed_s();
+    ASSERT_EQ(count, MSG_COUNT / static_cast<int64_t>(n) *
+                         static_cast<int64_t>(n));
+    if (n == 1) {
+      single_rate = rate;
+    }
+    if (n == 2) {
+      rate_2 = rate;
+    }
+    if (n == 64) {
+      rate_64 = rate;
+    }
+    std::cout << "  " << std::setw(2) << n << (n == 1 ? " file   " : " inputs ")
+              << std::fixed << std::setprecision(1) << rate / 1e6
+              << "M msg/s (" << std::setprecision(0)
+              << rate / single_rate * 100.0 << "% of one file, sum "
+              << checksum << ")" << std::endl;
+  }
+
+  ASSERT_GT(rate_2, 0.3 * single_rate);
+  ASSERT_GT(rate_64, 0.1 * single_rate);
+}
+
+// ===========================================================================
+// Benchmark 25: A/B line arbitration
+//
+// 4M feed messages on two line rings, pushed in chunks of 64K, with no loss
+// and with 1% independent loss per line; only LineArbitrator::poll() is
+// timed (reading both lines, dropping duplicates, filling gaps and
+// publishing downstream). Target: < 100 ns per published message.
+// ===========================================================================
+TEST(Benchmark, LineArbitration) {
+  using Ring = LineArbitrator::RingBufferType;
+  const SeqNum CHUNK = 65536;
+  const SeqNum MSG_COUNT = 64 * CHUNK;
+
+  std::cout << "\n=== Benchmark: A/B Line Arbitration ===" << std::endl;
+
+  double worst_ns = 0.0;
+  for (int loss_pct : {0, 1}) {
+    auto line_a = std::make_unique<Ring>();
+    auto line_b = std::make_unique<Ring>();
+    auto downstream = std::make_unique<Ring>();
+    LineArbitrator arbitrator(*line_a, *line_b, *downstream);
+    std::mt19937_64 rng(25);
+    std::vector<Msg> a_msgs;
+    std::vector<Msg> b_msgs;
+    int64_t lost_both = 0;
+    double poll_ns = 0.0;
+
+    for (SeqNum begin = 0; begin < MSG_COUNT; begin += CHUNK) {
+      a_msgs.clear();
+      b_msgs.clear();
+      for (SeqNum seq = begin; seq < begin + CHUNK; ++seq) {
+        Msg msg(seq, seq * 1000, static_cast<double>(seq % 10000));
+        bool a_lost = loss_pct > 0 && rng() % 100 < 1;
+        bool b_lost = loss_pct > 0 && rng() % 100 < 1;
+        lost_both += a_lost && b_lost;
+        // The last message of the feed reaches both lines
+        bool last = seq == MSG_COUNT - 1;
+        if (!a_lost || last) {
+          a_msgs.push_back(msg);
+        }
+        if (!b_lost || last) {
+          b_msgs.push_back(msg);
+        }
+      }
+      line_a->pushBatchKeepSeq(a_msgs);
+      line_b->pushBatchKeepSeq(b_msgs);
+
+      BenchTimer timer;
+      timer.start();
+      while (arbitrator.poll() > 0) {
+      }
+      poll_ns += timer.elapsed_ns();
+    }
+
+    ArbitrationStats stats = arbitrator.getStats();
+    ASSERT_EQ(arbitrator.getNextSeq(), MSG_COUNT);
+    ASSERT_EQ(stats.published + stats.lost, MSG_COUNT);
+    ASSERT_EQ(stats.lost, lost_both);
+    double ns_per_msg = poll_ns / static_cast<double>(stats.published);
+    worst_ns = std::max(worst_ns, ns_per_msg);
+
+    const LineStats& a = stats.line(FeedLine::A);
+    const LineStats& b = stats.line(FeedLine::B);
+    std::cout << "  " << loss_pct << "% loss per line: " << std::fixed
+              << std::setprecision(1) << ns_per_msg << " ns/msg ("
+              << stats.published / (poll_ns / 1e9) / 1e6
+              << "M msg/s), win rate A " << stats.winRate(FeedLine::A) * 100.0
+              << "% / B " << stats.winRate(FeedLine::B) * 100.0
+              << "%, gaps A " << a.gaps << " / B " << b.gaps
+              << ", lost on both " << stats.lost << std::endl;
+  }
+
+  ASSERT_LT(worst_ns, 100.0);
+}
+
+// ===========================================================================
+// Benchmark 26: Variable-length event ring
+//
+// 4M mixed events (60% quotes, 30% trades, 10% book updates with 32, 16 and
+// 80 payload bytes) pushed in batches of 4096 and read back, through a
+// VarRingBuffer and through a fixed-slot RingBuffer of a record sized for the
+// largest event. Reports ring bytes per event (padding included) and
+// events/s for both. Target: the variable ring moves < 50% of the fixed
+// ring's bytes per event.
+// ===========================================================================
+
+// Fixed-slot carrier of any event: the largest payload inline
+struct MaxEventRecord {
+  static constexpr uint32_t SCHEMA_ID = 101;
+
+  SeqNum seq_num = INVALID_SEQ;
+  int64_t timestamp_ns = 0;
+  uint16_t type = 0;
+  uint16_t length = 0;
+  uint32_t reserved = 0;
+  std::byte payload[80] = {};
+};
+
+TEST(Benchmark, VarRingBytes) {
+  const size_t BATCH = 4096;
+  const size_t EVENT_COUNT = 1024 * BATCH;
+  const size_t PAYLOAD_BYTES[] = {32, 16, 80};  // Quote, trade, book
+
+  std::cout << "\n=== Benchmark: Variable-Length Event Ring ===" << std::endl;
+
+  std::mt19937_64 rng(26);
+  std::vector<uint16_t> types(EVENT_COUNT);
+  for (auto& type : types) {
+    auto pick = rng() % 10;
+    type = pick < 6 ? 0 : (pick < 9 ? 1 : 2);
+  }
+  std::array<std::byte, 80> payload;
+  for (size_t i = 0; i < payload.size(); ++i) {
+    payload[i] = static_cast<std::byte>(i);
+  }
+
+  // Variable-length frames
+  auto var_ring = std::make_unique<VarRingBuffer<4 << 20>>();
+  std::vector<FrameRef> frames(BATCH);
+  std::vector<std::byte> out(BATCH * var_ring->maxFrameBytes());
+  FrameCursor cursor;
+  size_t var_read = 0;
+  double var_ns = 0.0;
+  for (size_t begin = 0; begin < EVENT_COUNT; begin += BATCH) {
+    for (size_t i = 0; i < BATCH; ++i) {
+      uint16_t type = types[begin + i];
+      frames[i] = FrameRef{type, static_cast<int64_t>(begin + i),
+                           std::span(payload).first(PAYLOAD_BYTES[type])};
+    }
+    BenchTimer timer;
+    timer.start();
+    var_ring->pushBatch(frames);
+    FrameBatch batch;
+    while ((batch = var_ring->readBatch(cursor, out)).status ==
+           ReadStatus::OK) {
+      var_read += batch.frames;
+    }
+    var_ns += timer.elapsed_ns();
+  }
+  ASSERT_EQ(var_read, EVENT_COUNT);
+  double var_bytes = static_cast<double>(var_ring->getBytesWritten()) /
+                     static_cast<double>(EVENT_COUNT);
+
+  // Fixed slots
+  using FixedRing = RingBuffer<1 << 16, MaxEventRecord>;
+  auto fixed_ring = std::make_unique<FixedRing>();
+  std::vector<MaxEventRecord> records(BATCH);
+  std::vector<MaxEventRecord> read(BATCH);
+  size_t fixed_read = 0;
+  double fixed_ns = 0.0;
+  for (size_t begin = 0; begin < EVENT_COUNT; begin += BATCH) {
+    for (size_t i = 0; i < BATCH; ++i) {
+      uint16_t type = types[begin + i];
+      records[i].timestamp_ns = static_cast<int64_t>(begin + i);
+      records[i].type = type;
+      records[i].length = static_cast<uint16_t>(PAYLOAD_BYTES[type]);
+      std::memcpy(records[i].payload, payload.data(), PAYLOAD_BYTES[type]);
+    }
+    BenchTimer timer;
+    timer.start();
+    fixed_ring->pushBatch(records);
+    fixed_read += fixed_ring->readBatch(static_cast<SeqNum>(begin), read);
+    fixed_ns += timer.elapsed_ns();
+  }
+  ASSERT_EQ(fixed_read, EVENT_COUNT);
+  double fixed_bytes = static_cast<double>(FixedRing::slotSize());
+
+  auto report = [&](const char* name, double bytes, double ns) {
+    std::cout << "  " << name << std::fixed << std::setprecision(1) << bytes
+              << " B/event, "
+              << static_cast<double>(EVENT_COUNT) / (ns / 1e9) / 1e6
+              << "M events/s, "
+              << bytes * static_cast<double>(EVENT_COUNT) / ns
+              << " GB/s through the ring" << std::endl;
+  };
+  report("Variable frames: ", var_bytes, var_ns);
+  report("Fixed slots:     ", fixed_bytes, fixed_ns);
+  std::cout << "  Padding at the wrap: "
+            << 100.0 * static_cast<double>(var_ring->getPaddingBytes()) /
+                   static_cast<double>(var_ring->getBytesWritten())
+            << "% of the frame bytes" << std::endl;
+
+  ASSERT_LT(var_bytes, 0.5 * fixed_bytes);
+}
+
+// ===========================================================================
+// Benchmark 27: Instrument-filtered replay
+//
+// A full-universe day of 4M TickRecords over 10k instruments with Zipf
+// (s = 1) activity, written with RecordFileWriteChannel (which appends the
+// instrument index), then replayed for single names of activity rank 1, 100
+// and 5000 (the median name) with setInstrumentFilter(), against a full scan
+// that filters in the consumer. Reports the index size, blocks skipped /
+// selected, bytes read and time. Target: the median name reads < 1% of the
+// file (100x less than the scan).
+// ===========================================================================
+TEST(Benchmark, InstrumentReplay) {
+  const int64_t RECORD_COUNT = 4000000;
+  const uint32_t INSTRUMENTS = 10000;
+  const std::string TEST_FILE = "data/bench_instruments.bin";
+
+  std::cout << "\n=== Benchmark: Instrument-Filtered Replay ===" << std::endl;
+
+  // Instrument id r - 1 has activity rank r
+  std::vector<double> cdf(INSTRUMENTS);
+  double total = 0.0;
+  for (uint32_t r = 0; r < INSTRUMENTS; ++r) {
+    total += 1.0 / (r + 1);
+    cdf[r] = total;
+  }
+  std::vector<TickRecord> ticks(RECORD_COUNT);
+  std::mt19937_64 rng(27);
+  for (int64_t i = 0; i < RECORD_COUNT; ++i) {
+    double u = static_cast<double>(rng() >> 11) * 0x1.0p-53 * total;
+    auto rank = std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    TickRecord& tick = ticks[i];
+    tick.seq_num = i;
+    tick.timestamp_ns = i * 21600;
+    tick.price = 100.0 + static_cast<double>(i % 1000) * 0.01;
+    tick.size = 100;
+    tick.instrument_id =
+        static_cast<uint32_t>(std::min<int64_t>(rank, INSTRUMENTS - 1));
+  }
+
+  BenchTimer timer;
+  timer.start();
+  {
+    RecordFileWriteChannel<TickRecord> writer(TEST_FILE);
+    ASSERT_TRUE(writer.open());
+    for (int64_t begin = 0; begin < RECORD_COUNT; begin += 4096) {
+      writer.writeBatch(std::span<const TickRecord>(ticks).subspan(
+          begin, std::min<int64_t>(4096, RECORD_COUNT - begin)));
+    }
+  }
+  double write_s = timer.elapsed_s();
+  const auto file_bytes =
+      static_cast<double>(std::filesystem::file_size(TEST_FILE));
+  const double record_bytes = static_cast<double>(
+      sizeof(FileHeader) + RECORD_COUNT * sizeof(TickRecord));
+  std::cout << "  Write: " << std::fixed << std::setprecision(1)
+            << RECORD_COUNT / write_s / 1e6 << "M records/s; index "
+            << (file_bytes - record_bytes) / 1024.0 << " KB ("
+            << std::setprecision(2)
+            << (file_bytes - record_bytes) / record_bytes * 100.0
+            << "% of the records)" << std::endl;
+
+  std::vector<TickRecord> batch(4096);
+  double read_fraction = 0.0;
+  for (uint32_t rank : {1u, 100u, 5000u}) {
+    const uint32_t instrument = rank - 1;
+
+    // Baseline: every record read and checked by the consumer
+    timer.start();
+    int64_t scanned = 0;
+    {
+      RecordFileChannel<TickRecord> reader(TEST_FILE);
+      ASSERT_TRUE(reader.open());
+      while (size_t n = reader.readBatch(batch)) {
+        for (size_t i = 0; i < n; ++i) {
+          scanned += batch[i].instrument_id == instrument ? 1 : 0;
+        }
+      }
+    }
+    double scan_ms = timer.elapsed_ms();
+
+    timer.start();
+    RecordFileChannel<TickRecord> reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    reader.setInstrumentFilter(std::span<const uint32_t>(&instrument, 1));
+    ASSERT_TRUE(reader.usesInstrumentIndex());
+    int64_t matched = 0;
+    while (size_t n = reader.readBatch(batch)) {
+      matched += static_cast<int64_t>(n);
+    }
+    double filter_ms = timer.elapsed_ms();
+    ASSERT_EQ(matched, scanned);
+
+    const FilterStats& stats = reader.getFilterStats();
+    read_fraction = static_cast<double>(stats.bytes_read) / file_bytes;
+    std::cout << "  rank " << std::left << std::setw(5) << rank << std::right
+              << ": " << matched << " ticks; blocks " << stats.blocks_skipped
+              << " skipped / " << stats.blocks_selected << " selected; "
+              << std::setprecision(2) << read_fraction * 100.0
+              << "% of bytes read; " << filter_ms << " ms vs " << scan_ms
+              << " ms full scan" << std::endl;
+  }
+
+  ASSERT_LT(read_fraction, 0.01);
+}
+
 // ===========================================================================
 // Main — standalone runner (non-GTest fallback)
 // ===========================================================================
 #ifndef GTEST_FOUND
 
 int main() {
+  TscClock::global();  // Calibrate before anything is timed
   std::cout << "============================================" << std::endl;
   std::cout << "  ReplaySystem Performance Benchmark Suite" << std::endl;
   std::cout << "============================================" << std::endl;
@@ -760,6 +1879,23 @@ int main() {
   RUN_TEST(Benchmark, FullSystemThroughput);
   RUN_TEST(Benchmark, RecoveryLatency);
 
+  // Compute kernels
+  RUN_TEST(Benchmark, PayloadSumKernels);
+  RUN_TEST(Benchmark, PacedReplayAccuracy);
+  RUN_TEST(Benchmark, GeneratorMicrobursts);
+  RUN_TEST(Benchmark, GeneratorSaturation);
+  RUN_TEST(Benchmark, TimestampClockCost);
+  RUN_TEST(Benchmark, HistogramRecordCost);
+  RUN_TEST(Benchmark, FileFormatComparison);
+  RUN_TEST(Benchmark, PayloadCodec);
+  RUN_TEST(Benchmark, BlockCompression);
+  RUN_TEST(Benchmark, BlockChecksum);
+  RUN_TEST(Benchmark, FilteredReplay);
+  RUN_TEST(Benchmark, MergedReplay);
+  RUN_TEST(Benchmark, LineArbitration);
+  RUN_TEST(Benchmark, VarRingBytes);
+  RUN_TEST(Benchmark, InstrumentReplay);
+
   std::cout << "\n============================================" << std::endl;
   std::cout << "  All benchmarks completed!" << std::endl;
   std::cout << "============================================" << std::endl;
@@ -1,15 +1,47 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
 #include <memory>
+#include <random>
+#include <span>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "arbitrator/LineArbitrator.hpp"
 #include "channel/FileChannel.hpp"
+#include "channel/FrameFileChannel.hpp"
+#include "channel/InstrumentIndex.hpp"
+#include "channel/RecordFileChannel.hpp"
 #include "client/MktDataClient.hpp"
+#include "common/ConsumerTable.hpp"
+#include "common/Crc32c.hpp"
+#include "common/ExactSum.hpp"
+#include "common/FastRng.hpp"
+#include "common/Frame.hpp"
+#include "common/LatencyHistogram.hpp"
 #include "common/Message.hpp"
+#include "common/MessageFilter.hpp"
+#include "common/MetricsRegistry.hpp"
+#include "common/OverflowLog.hpp"
+#include "common/PayloadCodec.hpp"
+#include "common/PayloadSum.hpp"
+#include "common/Record.hpp"
 #include "common/RingBuffer.hpp"
 #include "common/SpinLock.hpp"
+#include "common/TscClock.hpp"
+#include "common/VarRingBuffer.hpp"
 #include "recorder/MktDataRecorder.hpp"
+#include "replay/FrameReplayEngine.hpp"
+#include "replay/MergedReplayEngine.hpp"
+#include "replay/ReplayEngine.hpp"
 #include "server/MktDataServer.hpp"
 #include "test_main.cpp"
 
@@ -145,6 +177,1569 @@ TEST(Consistency, FileIO) {
   }
 }
 
+// Test crash-restart append: the stale header is trusted up to its flushed
+// count, the tail is validated and trimmed, and appending continues gap-free
+TEST(Consistency, FileAppendResume) {
+  const std::string TEST_FILE = "data/test_append.bin";
+  const int MSG_COUNT = 100;
+  const int FLUSHED_COUNT = 60;
+
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(Msg(i, i, static_cast<double>(i))));
+    }
+  }
+
+  // Simulate a crash: header as of the last flush, an out-of-order record
+  // and a torn record at the tail
+  {
+    std::fstream file(TEST_FILE,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    FileHeader header;
+    header.msg_count = FLUSHED_COUNT;
+    header.first_seq = 0;
+    header.last_seq = FLUSHED_COUNT - 1;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.seekp(0, std::ios::end);
+    Msg stray(500, 0, 1.0);
+    file.write(reinterpret_cast<const char*>(&stray), sizeof(stray));
+    file.write("torn", 4);
+  }
+
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.openAppend());
+    ASSERT_EQ(writer.getMessageCount(), MSG_COUNT);
+    ASSERT_EQ(writer.getTrimmedCount(), 1);
+    ASSERT_EQ(writer.getFirstSeq(), 0);
+    ASSERT_EQ(writer.getLastSeq(), MSG_COUNT - 1);
+    for (int i = MSG_COUNT; i < 2 * MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(Msg(i, i, static_cast<double>(i))));
+    }
+  }
+
+  {
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_TRUE(reader.wasCleanlyClose());
+    ASSERT_EQ(reader.getMessageCount(), 2 * MSG_COUNT);
+    ASSERT_EQ(reader.getFileLastSeq(), 2 * MSG_COUNT - 1);
+    for (int i = 0; i < 2 * MSG_COUNT; ++i) {
+      auto msg = reader.readNext();
+      ASSERT_TRUE(msg.has_value());
+      ASSERT_EQ(msg->seq_num, i);
+    }
+  }
+
+  // A missing file is simply created
+  std::remove("data/test_append_new.bin");
+  FileWriteChannel fresh("data/test_append_new.bin");
+  ASSERT_TRUE(fresh.openAppend());
+  ASSERT_EQ(fresh.getMessageCount(), 0);
+  ASSERT_EQ(fresh.getLastSeq(), INVALID_SEQ);
+  fresh.close();
+
+  // One with a damaged header is refused and left as it is
+  {
+    std::fstream file(TEST_FILE,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.write("junk", 4);
+  }
+  const auto damaged_size = std::filesystem::file_size(TEST_FILE);
+  FileWriteChannel damaged(TEST_FILE);
+  ASSERT_FALSE(damaged.openAppend());
+  ASSERT_EQ(std::filesystem::file_size(TEST_FILE), damaged_size);
+}
+
+// Test the v3 columnar layout: round trip with seq gaps and irregular
+// timestamps, random access across blocks, and crash-restart append
+TEST(Consistency, ColumnarFile) {
+  const std::string TEST_FILE = "data/test_columnar.bin";
+  const uint32_t BLOCK = 64;
+  const int MSG_COUNT = 300;
+
+  // Mostly prev + 1 with a forward gap, a step back and a wide jump;
+  // timestamps with small, negative and large deltas
+  std::vector<Msg> expected;
+  SeqNum seq = 0;
+  int64_t ts = 1'000'000'000;
+  for (int i = 0; i < MSG_COUNT; ++i) {
+    seq += (i == 70) ? 5 : (i == 71) ? -2 : (i == 200) ? 1'000'000 : 1;
+    ts += (i % 50 == 0) ? 3'000'000'000LL : (i % 7 == 0) ? -40 : 90 + i;
+    expected.emplace_back(seq, ts, i * 0.25 - 10.0);
+  }
+
+  {
+    FileWriteChannel writer(TEST_FILE, FileFormat::COLUMNAR);
+    writer.setBlockMessages(BLOCK);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(expected[i]));
+      if (i == 99) {
+        writer.flush();  // Seals a short block
+      }
+    }
+  }
+
+  {
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_TRUE(reader.isColumnar());
+    ASSERT_EQ(reader.getMessageCount(), MSG_COUNT);
+    ASSERT_EQ(reader.getBlockCount(), 6u);  // 64 36 | 64 64 64 8
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      auto msg = reader.readNext();
+      ASSERT_TRUE(msg.has_value());
+      ASSERT_EQ(msg->seq_num, expected[i].seq_num);
+      ASSERT_EQ(msg->timestamp_ns, expected[i].timestamp_ns);
+      ASSERT_EQ(msg->payload, expected[i].payload);
+    }
+    ASSERT_FALSE(reader.readNext().has_value());
+
+    // Random access and batches spanning blocks
+    ASSERT_TRUE(reader.seek(250));
+    ASSERT_EQ(reader.peek()->seq_num, expected[250].seq_num);
+    ASSERT_TRUE(reader.seek(90));
+    std::vector<Msg> batch(100);
+    ASSERT_EQ(reader.readBatch(batch), 100u);
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_EQ(batch[i].seq_num, expected[90 + i].seq_num);
+    }
+    ASSERT_EQ(reader.getCurrentSeq(), 190);
+    ASSERT_FALSE(reader.seek(MSG_COUNT));
+  }
+
+  // Same data, consecutive seq_nums: v3 must be at least 2x smaller than v2
+  const std::string RAW_FILE = "data/test_columnar_v2.bin";
+  for (FileFormat format : {FileFormat::RAW, FileFormat::COLUMNAR}) {
+    FileWriteChannel writer(
+        format == FileFormat::RAW ? RAW_FILE : TEST_FILE, format);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(
+          Msg(i, expected[i].timestamp_ns, expected[i].payload)));
+    }
+  }
+  ASSERT_TRUE(std::filesystem::file_size(RAW_FILE) >
+              2 * std::filesystem::file_size(TEST_FILE));
+
+  // Crash restart: header as of the first block, a garbage tail after the
+  // last one; whole blocks are kept and appending continues in v3
+  {
+    FileWriteChannel writer(TEST_FILE, FileFormat::COLUMNAR);
+    writer.setBlockMessages(BLOCK);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(Msg(i, i, static_cast<double>(i))));
+    }
+    writer.flush();
+  }
+  {
+    std::fstream file(TEST_FILE,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    FileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.flags = 0;
+    header.msg_count = BLOCK;
+    header.last_seq = BLOCK - 1;
+    header.data_end = 0;  // Stale: scan from the first block
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.seekp(0, std::ios::end);
+    file.write("torn block", 10);
+  }
+  {
+    FileWriteChannel writer(TEST_FILE);  // Layout comes from the file
+    ASSERT_TRUE(writer.openAppend());
+    ASSERT_TRUE(writer.getFormat() == FileFormat::COLUMNAR);
+    ASSERT_EQ(writer.getBlockMessages(), BLOCK);
+    ASSERT_EQ(writer.getMessageCount(), MSG_COUNT);
+    ASSERT_EQ(writer.getLastSeq(), MSG_COUNT - 1);
+    for (int i = MSG_COUNT; i < 2 * MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(Msg(i, i, static_cast<double>(i))));
+    }
+  }
+  {
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_TRUE(reader.wasCleanlyClose());
+    ASSERT_EQ(reader.getMessageCount(), 2 * MSG_COUNT);
+    std::vector<Msg> all(2 * MSG_COUNT);
+    ASSERT_EQ(reader.readBatch(all), static_cast<size_t>(2 * MSG_COUNT));
+    for (int i = 0; i < 2 * MSG_COUNT; ++i) {
+      ASSERT_EQ(all[i].seq_num, i);
+      ASSERT_EQ(all[i].payload, static_cast<double>(i));
+    }
+  }
+}
+
+// Test the XOR payload codec: exact round trip of slowly moving, repeated,
+// random and special values, size on tick data, and rejection of bad input
+TEST(Consistency, PayloadCodec) {
+  auto roundTrip = [](const std::vector<double>& values) {
+    std::vector<uint8_t> encoded;
+    size_t bytes = xorEncode(
+        values.size(), [&](size_t i) { return values[i]; }, encoded);
+    ASSERT_EQ(bytes, encoded.size());
+    std::vector<double> decoded(values.size());
+    bool ok = xorDecode(encoded.data(), encoded.size(), values.size(),
+                        [&](size_t i, double v) { decoded[i] = v; });
+    ASSERT_TRUE(ok);
+    for (size_t i = 0; i < values.size(); ++i) {
+      ASSERT_EQ(std::bit_cast<uint64_t>(decoded[i]),
+                std::bit_cast<uint64_t>(values[i]));
+    }
+    return encoded;
+  };
+
+  // Price random walk in 0.01 ticks, unchanged three times in four
+  std::mt19937_64 rng(42);
+  std::vector<double> ticks;
+  int64_t cents = 10000;
+  for (int i = 0; i < 4096; ++i) {
+    if (rng() % 4 == 0) {
+      cents += static_cast<int64_t>(rng() % 3) - 1;
+    }
+    ticks.push_back(static_cast<double>(cents) / 100.0);
+  }
+  auto encoded = roundTrip(ticks);
+  ASSERT_LT(encoded.size(), ticks.size() * sizeof(double) / 2);
+
+  std::uniform_real_distribution<double> dist(-1e6, 1e6);
+  std::vector<double> random;
+  for (int i = 0; i < 1000; ++i) {
+    random.push_back(dist(rng));
+  }
+  roundTrip(random);
+  roundTrip(std::vector<double>(1000, 3.25));
+  roundTrip({1.0});
+  roundTrip({0.0, -0.0, std::numeric_limits<double>::infinity(),
+             std::numeric_limits<double>::quiet_NaN(),
+             std::numeric_limits<double>::denorm_min(), -1.5, -1.5,
+             std::numeric_limits<double>::max(), 1.0, 1.0 + 1e-15});
+
+  // Truncated data is rejected rather than read past
+  auto truncated = roundTrip(random);
+  truncated.resize(truncated.size() / 2);
+  std::vector<double> sink(random.size());
+  ASSERT_FALSE(xorDecode(truncated.data(), truncated.size(), random.size(),
+                         [&](size_t i, double v) { sink[i] = v; }));
+
+  // Column blocks pick the XOR payload column when it is smaller
+  std::vector<Msg> messages;
+  for (size_t i = 0; i < ticks.size(); ++i) {
+    messages.emplace_back(static_cast<SeqNum>(i), 1000 * i, ticks[i]);
+  }
+  BlockHeader header;
+  std::vector<uint8_t> body;
+  encodeBlock(messages, header, body);
+  ASSERT_TRUE((header.flags & BLOCK_FLAG_PAYLOAD_XOR) != 0);
+  ASSERT_LT(body.size(), ticks.size() * 4);
+  std::vector<Msg> decoded;
+  ASSERT_TRUE(decodeBlock(header, body.data(), decoded));
+  for (size_t i = 0; i < messages.size(); ++i) {
+    ASSERT_EQ(decoded[i].payload, messages[i].payload);
+  }
+  for (size_t i = 0; i < messages.size(); ++i) {
+    messages[i].payload = random[i % random.size()];
+  }
+  encodeBlock(messages, header, body);
+  ASSERT_TRUE((header.flags & BLOCK_FLAG_PAYLOAD_XOR) == 0);
+}
+
+// Test block compression: LZ round trip and rejection of bad input, then a
+// compressed v3 file read inline and through the decode threads, with
+// random access and crash-restart append
+TEST(Consistency, BlockCodec) {
+  ASSERT_TRUE(codecFromName("lz") == CodecId::LZ);
+  ASSERT_TRUE(codecFromName(toString(CodecId::ZSTD)) == CodecId::ZSTD);
+  ASSERT_FALSE(codecFromName("gzip").has_value());
+  ASSERT_TRUE(findCodec(CodecId::NONE) == nullptr);
+  const BlockCodec* lz = findCodec(CodecId::LZ);
+  ASSERT_TRUE(lz != nullptr);
+
+  auto roundTrip = [&](const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> packed(lz->compressBound(data.size()));
+    size_t size = lz->compress(data.data(), data.size(), packed.data());
+    ASSERT_TRUE(size > 0 && size <= packed.size());
+    packed.resize(size);
+    std::vector<uint8_t> unpacked(data.size());
+    ASSERT_TRUE(lz->decompress(packed.data(), packed.size(), unpacked.data(),
+                               unpacked.size()));
+    ASSERT_TRUE(unpacked == data);
+    return packed;
+  };
+
+  std::mt19937_64 rng(7);
+  std::vector<uint8_t> random(10000);
+  for (uint8_t& byte : random) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  roundTrip(random);
+  roundTrip({});
+  roundTrip({42});
+  std::vector<uint8_t> zeros(100000, 0);  // Long overlapping matches
+  ASSERT_LT(roundTrip(zeros).size(), zeros.size() / 100);
+  std::vector<uint8_t> mixed;  // Repeats at varying distances, and literals
+  for (int i = 0; i < 2000; ++i) {
+    mixed.insert(mixed.end(), random.begin() + (i % 37),
+                 random.begin() + (i % 37) + 20 + i % 300);
+  }
+  ASSERT_LT(roundTrip(mixed).size(), mixed.size() / 4);
+
+  // Truncated input, a wrong size and an offset before the start
+  auto packed = roundTrip(mixed);
+  std::vector<uint8_t> out(mixed.size());
+  ASSERT_FALSE(lz->decompress(packed.data(), packed.size() / 2, out.data(),
+                              out.size()));
+  ASSERT_FALSE(lz->decompress(packed.data(), packed.size(), out.data(),
+                              out.size() - 1));
+  const uint8_t bad_offset[] = {0x10, 'x', 0x05, 0x00, 0x00};
+  ASSERT_FALSE(lz->decompress(bad_offset, sizeof(bad_offset), out.data(), 5));
+
+  // Compressed v3 file: regular timestamps and a repeating price pattern
+  const std::string TEST_FILE = "data/test_block_codec.bin";
+  const std::string PLAIN_FILE = "data/test_block_codec_plain.bin";
+  const uint32_t BLOCK = 64;
+  const int MSG_COUNT = 1000;
+  auto message = [](int i) {
+    return Msg(i, 1'000'000 + i * 500, 100.0 + (i % 10) * 0.5);
+  };
+  for (bool compressed : {false, true}) {
+    FileWriteChannel writer(compressed ? TEST_FILE : PLAIN_FILE,
+                            FileFormat::COLUMNAR);
+    writer.setBlockMessages(BLOCK);
+    ASSERT_TRUE(writer.setCodec(compressed ? CodecId::LZ : CodecId::NONE));
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(message(i)));
+    }
+  }
+  ASSERT_LT(std::filesystem::file_size(TEST_FILE),
+            std::filesystem::file_size(PLAIN_FILE));
+
+  for (size_t threads : {0u, 3u}) {
+    FileChannel reader(TEST_FILE);
+    reader.setDecodeThreads(threads);
+    ASSERT_TRUE(reader.open());
+    ASSERT_EQ(reader.getBlockCount(), 16u);
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      auto msg = reader.readNext();
+      ASSERT_TRUE(msg.has_value());
+      ASSERT_EQ(msg->seq_num, i);
+      ASSERT_EQ(msg->timestamp_ns, message(i).timestamp_ns);
+      ASSERT_EQ(msg->payload, message(i).payload);
+    }
+    ASSERT_FALSE(reader.readNext().has_value());
+
+    // Backwards, forwards, and a batch over several blocks
+    ASSERT_TRUE(reader.seek(700));
+    ASSERT_EQ(reader.peek()->seq_num, 700);
+    ASSERT_TRUE(reader.seek(10));
+    ASSERT_EQ(reader.readNext()->seq_num, 10);
+    ASSERT_TRUE(reader.seek(130));
+    std::vector<Msg> batch(500);
+    ASSERT_EQ(reader.readBatch(batch), 500u);
+    for (int i = 0; i < 500; ++i) {
+      ASSERT_EQ(batch[i].seq_num, 130 + i);
+    }
+    reader.close();
+  }
+
+  // Crash restart validates the compressed tail and keeps compressing
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.setCodec(CodecId::LZ));
+    ASSERT_TRUE(writer.openAppend());
+    ASSERT_EQ(writer.getMessageCount(), MSG_COUNT);
+    for (int i = MSG_COUNT; i < 2 * MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(message(i)));
+    }
+  }
+  ReplayEngine engine(TEST_FILE);
+  engine.setDecodeThreads(2);
+  ASSERT_TRUE(engine.open());
+  ASSERT_EQ(engine.getMessageCount(), 2 * MSG_COUNT);
+  for (int i = 0; i < 2 * MSG_COUNT; ++i) {
+    ASSERT_EQ(engine.nextMessage()->payload, message(i).payload);
+  }
+  ASSERT_EQ(engine.getSeqViolationCount(), 0);
+}
+
+// Test block checksums: CRC32C kernels, a bit flip caught on open and on
+// read, recovery of blocks sealed after the last header update, and
+// crash-restart trimming at a corrupt block
+TEST(Consistency, BlockChecksum) {
+  for (CrcKernel kernel : {CrcKernel::TABLE, CrcKernel::HARDWARE}) {
+    ASSERT_EQ(crc32c("123456789", 9, 0, kernel), 0xE3069283u);
+  }
+  std::mt19937_64 rng(5);
+  std::vector<uint8_t> data(40000);
+  for (uint8_t& byte : data) {
+    byte = static_cast<uint8_t>(rng());
+  }
+  for (size_t n : {0u, 1u, 7u, 12287u, 12288u, 12289u, 40000u}) {
+    uint32_t table = crc32c(data.data(), n, 0, CrcKernel::TABLE);
+    ASSERT_EQ(crc32c(data.data(), n, 0, CrcKernel::HARDWARE), table);
+    ASSERT_EQ(crc32c(data.data() + n / 3, n - n / 3,
+                     crc32c(data.data(), n / 3)),
+              table);
+  }
+
+  const std::string TEST_FILE = "data/test_block_crc.bin";
+  const uint32_t BLOCK = 64;
+  const int BLOCKS = 10;
+  auto writeFile = [&]() {
+    FileWriteChannel writer(TEST_FILE, FileFormat::COLUMNAR);
+    writer.setBlockMessages(BLOCK);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < BLOCKS * static_cast<int>(BLOCK); ++i) {
+      ASSERT_TRUE(writer.write(Msg(i, 1000 + i, i * 0.5)));
+    }
+  };
+  // Offsets of the block headers
+  auto blockOffsets = [&]() {
+    std::vector<int64_t> offsets;
+    std::ifstream in(TEST_FILE, std::ios::binary);
+    BlockHeader block;
+    int64_t offset = sizeof(FileHeader);
+    in.seekg(offset);
+    while (in.read(reinterpret_cast<char*>(&block), sizeof(block))) {
+      offsets.push_back(offset);
+      offset += static_cast<int64_t>(sizeof(block) + block.body_bytes);
+      in.seekg(offset);
+    }
+    return offsets;
+  };
+  auto flipByte = [&](int64_t offset) {
+    std::fstream file(TEST_FILE,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    char byte;
+    file.seekg(offset);
+    file.read(&byte, 1);
+    byte ^= 0x10;
+    file.seekp(offset);
+    file.write(&byte, 1);
+  };
+  auto readAll = [&](FileChannel& reader) {
+    int64_t count = 0;
+    while (auto msg = reader.readNext()) {
+      ASSERT_EQ(msg->seq_num, count);
+      ++count;
+    }
+    return count;
+  };
+
+  // Bit flip in the body of block 6 of a cleanly closed file
+  writeFile();
+  auto offsets = blockOffsets();
+  ASSERT_EQ(offsets.size(), static_cast<size_t>(BLOCKS));
+  flipByte(offsets[6] + static_cast<int64_t>(sizeof(BlockHeader)) + 3);
+  {
+    FileChannel reader(TEST_FILE);
+    reader.setVerifyThreads(3);
+    ASSERT_TRUE(reader.open());
+    const BlockVerifyStats& stats = reader.getVerifyStats();
+    ASSERT_TRUE(stats.corrupt);
+    ASSERT_EQ(stats.verified_blocks, 6u);
+    ASSERT_EQ(stats.dropped_messages, 4 * BLOCK);
+    ASSERT_EQ(reader.getMessageCount(), 6 * BLOCK);
+    ASSERT_EQ(reader.getFileLastSeq(), 6 * BLOCK - 1);
+    ASSERT_EQ(readAll(reader), 6 * BLOCK);
+  }
+  {
+    // Without verification on open the block is rejected when loaded
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_EQ(reader.getMessageCount(), BLOCKS * BLOCK);
+    ASSERT_EQ(readAll(reader), 6 * BLOCK);
+  }
+
+  // Crash: header as of block 3, a torn block after the last one. The
+  // sealed blocks are recovered, the torn one is cut off.
+  writeFile();
+  offsets = blockOffsets();
+  {
+    std::fstream file(TEST_FILE,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    FileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.flags = 0;  // Not closed
+    header.msg_count = 3 * BLOCK;
+    header.last_seq = 3 * BLOCK - 1;
+    header.data_end = offsets[3];
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<char> torn(200);
+    file.seekg(offsets[9]);
+    file.read(torn.data(), static_cast<std::streamsize>(torn.size()));
+    file.seekp(0, std::ios::end);
+    file.write(torn.data(), static_cast<std::streamsize>(torn.size()));
+  }
+  {
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_FALSE(reader.wasCleanlyClose());
+    ASSERT_EQ(reader.getMessageCount(), BLOCKS * BLOCK);
+    ASSERT_EQ(reader.getFileLastSeq(), BLOCKS * BLOCK - 1);
+    ASSERT_EQ(readAll(reader), BLOCKS * BLOCK);
+  }
+
+  // A flipped bit in the unflushed tail ends it at that block, for readers
+  // and for crash-restart append alike
+  flipByte(offsets[8] + static_cast<int64_t>(sizeof(BlockHeader)) + 1);
+  {
+    FileChannel reader(TEST_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_EQ(reader.getMessageCount(), 8 * BLOCK);
+    ASSERT_EQ(reader.getFileLastSeq(), 8 * BLOCK - 1);
+  }
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.openAppend());
+    ASSERT_EQ(writer.getMessageCount(), 8 * BLOCK);
+    ASSERT_EQ(writer.getTrimmedCount(), 2 * BLOCK);  // Blocks 8 and 9
+    for (int i = 8 * BLOCK; i < 12 * static_cast<int>(BLOCK); ++i) {
+      ASSERT_TRUE(writer.write(Msg(i, 1000 + i, i * 0.5)));
+    }
+  }
+  FileChannel reader(TEST_FILE);
+  reader.setVerifyThreads(2);
+  ASSERT_TRUE(reader.open());
+  ASSERT_FALSE(reader.getVerifyStats().corrupt);
+  ASSERT_EQ(reader.getVerifyStats().verified_blocks, 12u);
+  ASSERT_EQ(readAll(reader), 12 * BLOCK);
+}
+
+// Filtered reads: selection kernels, zone-map skipping and the read paths
+TEST(Consistency, ZoneMapFilter) {
+  std::mt19937_64 rng(45);
+  std::vector<Msg> msgs(1003);
+  for (Msg& msg : msgs) {
+    msg = Msg(static_cast<int64_t>(rng() % 1000),
+              static_cast<int64_t>(rng() % 1000),
+              rng() % 11 == 0 ? std::nan("")
+                              : static_cast<double>(rng() % 1000) - 500.0);
+  }
+  MessageFilter narrow;
+  narrow.min_seq = 100;
+  narrow.max_seq = 800;
+  narrow.min_timestamp_ns = 200;
+  narrow.max_payload = 250.0;
+  std::vector<uint32_t> expected;
+  for (uint32_t i = 0; i < msgs.size(); ++i) {
+    if (narrow.matches(msgs[i])) {
+      expected.push_back(i);
+    }
+  }
+  for (SelectKernel kernel :
+       {SelectKernel::SCALAR, SelectKernel::AVX2, SelectKernel::AVX512}) {
+    std::vector<uint32_t> selection(msgs.size());
+    selection.resize(
+        selectMessages(msgs, narrow, selection.data(), kernel));
+    ASSERT_TRUE(selection == expected);
+  }
+  // NaN only matches an unbounded payload range
+  ZoneMap zone = ZoneMap::of(msgs);
+  ASSERT_TRUE(zone.min_payload == -std::numeric_limits<double>::infinity());
+  ASSERT_TRUE(MessageFilter{}.matches(Msg(1, 1, std::nan(""))));
+  ASSERT_FALSE(narrow.matches(Msg(500, 500, std::nan(""))));
+
+  // Recording: ts every us, a payload cycling over 100 values
+  const std::string V3_FILE = "data/test_zone_map.bin";
+  const std::string V2_FILE = "data/test_zone_map_v2.bin";
+  const uint32_t BLOCK = 64;
+  const int MSG_COUNT = 3000;
+  auto message = [](int i) {
+    return Msg(i, 1'000'000 + i * 1000LL, 100.0 + (i * 37 % 100) * 0.1);
+  };
+  for (FileFormat format : {FileFormat::COLUMNAR, FileFormat::RAW}) {
+    FileWriteChannel writer(format == FileFormat::COLUMNAR ? V3_FILE : V2_FILE,
+                            format);
+    writer.setBlockMessages(BLOCK);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      ASSERT_TRUE(writer.write(message(i)));
+    }
+  }
+  const size_t blocks = (MSG_COUNT + BLOCK - 1) / BLOCK;
+
+  MessageFilter window;  // Seq 1000..1099 by timestamp, payload >= 105
+  window.min_timestamp_ns = 1'000'000 + 1000 * 1000LL;
+  window.max_timestamp_ns = 1'000'000 + 1099 * 1000LL;
+  window.min_payload = 105.0;
+  MessageFilter seqs;  // Three blocks exactly
+  seqs.min_seq = 2 * BLOCK;
+  seqs.max_seq = 5 * BLOCK - 1;
+  MessageFilter none;
+  none.min_payload = 1000.0;
+
+  for (const MessageFilter* filter : {&window, &seqs, &none}) {
+    std::vector<Msg> want;
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      if (filter->matches(message(i))) {
+        want.push_back(message(i));
+      }
+    }
+    for (const std::string& file : {V3_FILE, V2_FILE}) {
+      for (size_t threads : {size_t(0), size_t(2)}) {
+        FileChannel reader(file);
+        reader.setDecodeThreads(threads);
+        ASSERT_TRUE(reader.open());
+        reader.setFilter(*filter);
+        std::vector<Msg> got;
+        while (auto peeked = reader.peek()) {
+          auto msg = reader.readNext();
+          ASSERT_TRUE(msg.has_value() && *msg == *peeked);
+          got.push_back(*msg);
+        }
+        ASSERT_TRUE(got == want);
+
+        // Batches straddling blocks, after a seek back
+        ASSERT_TRUE(reader.seek(0));
+        got.clear();
+        std::vector<Msg> batch(7);
+        while (size_t n = reader.readBatch(batch)) {
+          got.insert(got.end(), batch.begin(), batch.begin() + n);
+        }
+        ASSERT_TRUE(got == want);
+        ASSERT_EQ(reader.getCurrentSeq(), MSG_COUNT);
+      }
+    }
+  }
+
+  // Only the blocks around the window are read
+  FileChannel reader(V3_FILE);
+  ASSERT_TRUE(reader.open());
+  reader.setFilter(seqs);
+  std::vector<Msg> batch(MSG_COUNT);
+  ASSERT_EQ(reader.readBatch(batch), 3 * BLOCK);
+  ASSERT_EQ(reader.getFilterStats().blocks_whole, 3u);
+  ASSERT_EQ(reader.getFilterStats().blocks_selected, 0u);
+  ASSERT_EQ(reader.getFilterStats().blocks_skipped, blocks - 3);
+  reader.setFilter(window);
+  ASSERT_TRUE(reader.seek(0));
+  reader.readBatch(batch);
+  ASSERT_LE(reader.getFilterStats().blocks_selected, 3u);
+  ASSERT_LT(reader.getFilterStats().bytes_read,
+            static_cast<int64_t>(std::filesystem::file_size(V3_FILE)) / 10);
+
+  // The engine replays the filtered stream, and everything once cleared
+  ReplayEngine engine(V3_FILE);
+  ASSERT_TRUE(engine.open());
+  engine.setFilter(seqs);
+  int64_t count = 0;
+  while (auto msg = engine.nextMessage()) {
+    ASSERT_EQ(msg->seq_num, 2 * BLOCK + count);
+    ++count;
+  }
+  ASSERT_EQ(count, 3 * BLOCK);
+  ASSERT_EQ(engine.getSeqViolationCount(), 0);
+  engine.clearFilter();
+  engine.reset();
+  ASSERT_EQ(static_cast<int64_t>(engine.readBatch(MSG_COUNT).size()),
+            MSG_COUNT);
+}
+
+// K-way timestamp merge: stable order by (timestamp, feed, position)
+TEST(Consistency, MergedReplay) {
+  // Five feeds (tree padded to eight): ties across feeds, an empty feed, a
+  // v2 feed, and lengths spanning several refills
+  const int FEEDS = 5;
+  const int LENGTHS[FEEDS] = {3000, 0, 2500, 1, 4100};
+  const int64_t STEPS[FEEDS] = {1000, 1000, 3000, 500, 700};
+  struct Tagged {
+    Msg msg;
+    uint32_t feed;
+  };
+  std::vector<std::string> files;
+  std::vector<Tagged> expected;
+  for (int f = 0; f < FEEDS; ++f) {
+    files.push_back("data/test_merge_" + std::to_string(f) + ".bin");
+    FileWriteChannel writer(files.back(),
+                            f == 2 ? FileFormat::RAW : FileFormat::COLUMNAR);
+    writer.setBlockMessages(256);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < LENGTHS[f]; ++i) {
+      Msg msg(i, 1'000'000 + i * STEPS[f], f * 1000.0 + i);
+      ASSERT_TRUE(writer.write(msg));
+      expected.push_back({msg, static_cast<uint32_t>(f)});
+    }
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Tagged& a, const Tagged& b) {
+                     return a.msg.timestamp_ns < b.msg.timestamp_ns ||
+                            (a.msg.timestamp_ns == b.msg.timestamp_ns &&
+                             a.feed < b.feed);
+                   });
+
+  {
+    MergedReplayEngine engine(files);
+    ASSERT_TRUE(engine.open());
+    ASSERT_EQ(engine.getMessageCount(), static_cast<int64_t>(expected.size()));
+    size_t i = 0;
+    while (auto msg = engine.nextMessage()) {
+      ASSERT_TRUE(i < expected.size());
+      ASSERT_TRUE(*msg == expected[i].msg);
+      ASSERT_EQ(engine.getLastFeed(), expected[i].feed);
+      ++i;
+    }
+    ASSERT_EQ(i, expected.size());
+    for (int f = 0; f < FEEDS; ++f) {
+      ASSERT_EQ(engine.getMergedCount(f), LENGTHS[f]);
+    }
+    ASSERT_EQ(engine.getOrderViolationCount(), 0);
+  }
+
+  // Batches with feed ids, decoding ahead
+  {
+    MergedReplayEngine engine(files);
+    engine.setDecodeThreads(2);
+    ASSERT_TRUE(engine.open());
+    std::vector<Msg> batch(13);
+    std::vector<uint32_t> feeds(13);
+    size_t i = 0;
+    while (size_t n = engine.readBatch(batch, feeds)) {
+      for (size_t k = 0; k < n; ++k, ++i) {
+        ASSERT_TRUE(batch[k] == expected[i].msg);
+        ASSERT_EQ(feeds[k], expected[i].feed);
+      }
+    }
+    ASSERT_EQ(i, expected.size());
+  }
+
+  // A time window across all feeds
+  MessageFilter window;
+  window.min_timestamp_ns = 1'500'000;
+  window.max_timestamp_ns = 2'000'000;
+  {
+    MergedReplayEngine engine(files);
+    engine.setFilter(window);
+    ASSERT_TRUE(engine.open());
+    size_t i = 0;
+    for (const Tagged& tagged : expected) {
+      if (!window.matches(tagged.msg)) {
+        continue;
+      }
+      auto msg = engine.nextMessage();
+      ASSERT_TRUE(msg.has_value() && *msg == tagged.msg);
+      ++i;
+    }
+    ASSERT_GT(i, 0u);
+    ASSERT_FALSE(engine.nextMessage().has_value());
+  }
+
+  // A feed stepping back in time keeps its own order; the steps are counted
+  const std::string BACK_FILE = "data/test_merge_back.bin";
+  {
+    FileWriteChannel writer(BACK_FILE, FileFormat::COLUMNAR);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < 10; ++i) {
+      ASSERT_TRUE(writer.write(Msg(i, i == 5 ? 0 : 1'000'000 + i, 0.0)));
+    }
+  }
+  {
+    MergedReplayEngine engine({BACK_FILE, files[3]});
+    ASSERT_TRUE(engine.open());
+    SeqNum prev = INVALID_SEQ;
+    while (auto msg = engine.nextMessage()) {
+      if (engine.getLastFeed() == 0) {
+        ASSERT_EQ(msg->seq_num, prev + 1);
+        prev = msg->seq_num;
+      }
+    }
+    ASSERT_EQ(prev, 9);
+    ASSERT_GT(engine.getOrderViolationCount(), 0);
+  }
+
+  MergedReplayEngine missing({files[0], "data/no_such_feed.bin"});
+  ASSERT_FALSE(missing.open());
+}
+
+TEST(Consistency, LineArbitration) {
+  using Ring = LineArbitrator::RingBufferType;
+  auto line_a = std::make_unique<Ring>();
+  auto line_b = std::make_unique<Ring>();
+  auto downstream = std::make_unique<Ring>();
+
+  // Feed 100..199: A misses 110-114 and 150, B misses 120, 150 and 160-169
+  auto feed = [](SeqNum seq) { return Msg(seq, seq * 10, seq * 0.5); };
+  std::vector<Msg> a_msgs;
+  std::vector<Msg> b_msgs;
+  for (SeqNum seq = 100; seq < 200; ++seq) {
+    if (!(seq >= 110 && seq < 115) && seq != 150) {
+      a_msgs.push_back(feed(seq));
+    }
+    if (seq != 120 && seq != 150 && !(seq >= 160 && seq < 170)) {
+      b_msgs.push_back(feed(seq));
+    }
+  }
+  line_a->pushBatchKeepSeq(a_msgs);
+  line_b->pushBatchKeepSeq(b_msgs);
+  ASSERT_EQ(line_a->read(0)->seq_num, 100);  // Feed seq kept
+
+  MetricsRegistry registry;
+  LineArbitrator arbitrator(*line_a, *line_b, *downstream);
+  arbitrator.attachMetrics(registry);
+  ASSERT_EQ(arbitrator.getNextSeq(), INVALID_SEQ);
+
+  // First pass drains A first: A stops at its gap and B fills it, then both
+  // are past 150, which is lost
+  ASSERT_EQ(arbitrator.poll(), 99u);
+  ASSERT_EQ(arbitrator.poll(), 0u);
+  ASSERT_EQ(arbitrator.getNextSeq(), 200);
+
+  SeqNum expected_seq = 100;
+  for (SeqNum i = 0; i < 99; ++i, ++expected_seq) {
+    expected_seq += expected_seq == 150;
+    auto msg = downstream->read(i);
+    ASSERT_TRUE(msg.has_value());
+    ASSERT_EQ(msg->seq_num, expected_seq);
+    ASSERT_TRUE(*msg == feed(expected_seq));
+  }
+  ASSERT_FALSE(downstream->tryRead(99).has_value());
+
+  ArbitrationStats stats = arbitrator.getStats();
+  const LineStats& a = stats.line(FeedLine::A);
+  const LineStats& b = stats.line(FeedLine::B);
+  ASSERT_EQ(stats.published, 99);
+  ASSERT_EQ(stats.lost, 1);
+  ASSERT_EQ(stats.timeouts, 0);
+  ASSERT_EQ(a.received, 94);
+  ASSERT_EQ(a.wins, 89);  // 100-109, 120-149, 151-199
+  ASSERT_EQ(a.duplicates, 5);
+  ASSERT_EQ(a.gaps, 2);
+  ASSERT_EQ(a.gap_messages, 6);
+  ASSERT_EQ(b.received, 88);
+  ASSERT_EQ(b.wins, 10);  // 110-119
+  ASSERT_EQ(b.duplicates, 78);
+  ASSERT_EQ(b.gaps, 3);
+  ASSERT_EQ(b.gap_messages, 12);
+  ASSERT_EQ(a.wins + b.wins, stats.published);
+  ASSERT_TRUE(stats.winRate(FeedLine::A) > 0.89 &&
+              stats.winRate(FeedLine::A) < 0.9);
+
+  std::vector<MetricSample> samples;
+  ASSERT_TRUE(registry.sample(samples));
+  auto metric = [&](const std::string& name) {
+    for (const MetricSample& entry : samples) {
+      if (entry.name == name) {
+        return entry.value;
+      }
+    }
+    return int64_t{-1};
+  };
+  ASSERT_EQ(metric("arb.published"), 99);
+  ASSERT_EQ(metric("arb.seq"), 199);
+  ASSERT_EQ(metric("arb.lost"), 1);
+  ASSERT_EQ(metric("arb.a.wins"), 89);
+  ASSERT_EQ(metric("arb.b.duplicates"), 78);
+  ASSERT_EQ(metric("arb.b.gaps"), 3);
+
+  // B goes silent while A skips 210-214: the gap is given up on once the
+  // timeout passes, and B's late copies are duplicates
+  arbitrator.setGapTimeout(0);
+  std::vector<Msg> late;
+  for (SeqNum seq = 200; seq < 220; ++seq) {
+    if (seq < 210 || seq >= 215) {
+      line_a->pushBatchKeepSeq(std::vector<Msg>{feed(seq)});
+    }
+    late.push_back(feed(seq));
+  }
+  ASSERT_EQ(arbitrator.poll(), 10u);  // Waits at 215
+  ASSERT_EQ(arbitrator.poll(), 5u);   // Timed out
+  ASSERT_EQ(arbitrator.getNextSeq(), 220);
+  line_b->pushBatchKeepSeq(late);
+  ASSERT_EQ(arbitrator.poll(), 0u);
+  stats = arbitrator.getStats();
+  ASSERT_EQ(stats.published, 114);
+  ASSERT_EQ(stats.lost, 6);
+  ASSERT_EQ(stats.timeouts, 1);
+  ASSERT_EQ(stats.line(FeedLine::B).duplicates, 98);
+  ASSERT_EQ(stats.line(FeedLine::A).gaps, 3);
+
+  // Threaded, with random losses on both lines and the lines pushed in
+  // interleaved batches: every message not lost on both is published once
+  auto line_c = std::make_unique<Ring>();
+  auto line_d = std::make_unique<Ring>();
+  auto clean = std::make_unique<Ring>();
+  LineArbitrator threaded(*line_c, *line_d, *clean);
+  threaded.start();
+  std::mt19937_64 rng(47);
+  const SeqNum COUNT = 200000;
+  int64_t lost_both = 0;
+  std::vector<Msg> c_batch;
+  std::vector<Msg> d_batch;
+  for (SeqNum seq = 0; seq < COUNT; ++seq) {
+    bool c_lost = rng() % 100 == 0;
+    bool d_lost = rng() % 100 == 0;
+    lost_both += c_lost && d_lost;
+    if (!c_lost || seq == COUNT - 1) {
+      c_batch.push_back(feed(seq));
+    }
+    if (!d_lost || seq == COUNT - 1) {
+      d_batch.push_back(feed(seq));
+    }
+    if (seq % 64 == 63 || seq == COUNT - 1) {
+      line_c->pushBatchKeepSeq(c_batch);
+      line_d->pushBatchKeepSeq(d_batch);
+      c_batch.clear();
+      d_batch.clear();
+    }
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (threaded.getNextSeq() != COUNT &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  threaded.stop();
+  ASSERT_EQ(threaded.getNextSeq(), COUNT);
+  stats = threaded.getStats();
+  ASSERT_EQ(stats.published + stats.lost, COUNT);
+  SeqNum prev = -1;
+  for (SeqNum i = 0; i < stats.published; ++i) {
+    auto msg = clean->read(i);
+    ASSERT_TRUE(msg.has_value());
+    ASSERT_TRUE(msg->seq_num > prev);
+    prev = msg->seq_num;
+  }
+  ASSERT_EQ(prev, COUNT - 1);
+  // Gaps the line fills in time are not lost; only a timeout can add more
+  ASSERT_TRUE(stats.lost >= lost_both);
+  ASSERT_EQ(stats.lost - lost_both == 0, stats.timeouts == 0);
+}
+
+// Test that the client and recorder check seq_nums inside a readBatch() run:
+// a ring fed by pushBatchKeepSeq() carries the feed's seq_nums, which may skip
+// or repeat within one batch
+TEST(Consistency, KeepSeqConsumers) {
+  const std::string TEST_FILE = "data/test_keep_seq.bin";
+  auto buffer = std::make_unique<MktDataClient::RingBufferType>();
+
+  // Feed 0..99 in one batch: 10-14 missing, 50 repeated
+  std::vector<Msg> feed;
+  double expected_sum = 0.0;
+  for (SeqNum seq = 0; seq < 100; ++seq) {
+    if (seq >= 10 && seq < 15) {
+      continue;
+    }
+    feed.push_back(Msg(seq, seq, seq * 0.5));
+    expected_sum += seq * 0.5;
+    if (seq == 50) {
+      feed.push_back(Msg(seq, seq, seq * 0.5));
+    }
+  }
+  buffer->pushBatchKeepSeq(feed);
+
+  MktDataClient client(*buffer, TEST_FILE);
+  MktDataRecorder recorder(*buffer, TEST_FILE);
+  recorder.start();
+  client.start();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while ((client.getLastSeq() != 99 || recorder.getRecordedCount() != 95) &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  client.stop();
+  recorder.stop();
+
+  ASSERT_EQ(client.getProcessedCount(), 95);
+  ASSERT_EQ(client.getSum(), expected_sum);
+  ASSERT_EQ(client.getMetrics().seq_gap_count.load(), 6);  // 5 skipped + 1
+  ASSERT_EQ(recorder.getRecordedCount(), 95);
+  ASSERT_EQ(recorder.getExpectedSum(), expected_sum);
+  ASSERT_EQ(recorder.getMetrics().seq_gap_count.load(), 5);
+
+  FileChannel file(TEST_FILE);
+  ASSERT_TRUE(file.open());
+  ASSERT_EQ(file.getMessageCount(), 95);
+  SeqNum prev = INVALID_SEQ;
+  while (auto msg = file.readNext()) {
+    ASSERT_TRUE(msg->seq_num > prev);
+    prev = msg->seq_num;
+  }
+  ASSERT_EQ(prev, 99);
+}
+
+// A 64-byte record: its ring slots take two cache lines
+struct WideRecord {
+  static constexpr uint32_t SCHEMA_ID = 100;
+
+  SeqNum seq_num = INVALID_SEQ;
+  int64_t timestamp_ns = 0;
+  double levels[6] = {};
+};
+
+// Test rings, files and the recorder over records other than Msg
+TEST(Consistency, RecordTypes) {
+  static_assert(RingBuffer<1024>::slotSize() == 64);
+  static_assert(RingBuffer<1024, TickRecord>::slotSize() == 64);
+  static_assert(RingBuffer<1024, WideRecord>::slotSize() == 128);
+
+  const int COUNT = 1000;
+  std::vector<TickRecord> ticks(COUNT);
+  for (int i = 0; i < COUNT; ++i) {
+    TickRecord& tick = ticks[i];
+    tick.timestamp_ns = tscTimestampNs();
+    tick.price = 100.0 + i * 0.01;
+    tick.size = i % 7 + 1;
+    tick.instrument_id = static_cast<uint32_t>(i % 5);
+    tick.side = i % 2 == 0 ? Side::BID : Side::ASK;
+    tick.flags = i % 3 == 0 ? TICK_FLAG_TRADE : 0;
+  }
+
+  // Ring: sequence numbers are assigned on push, the rest is kept
+  auto ring = std::make_unique<RingBuffer<4096, TickRecord>>();
+  ASSERT_EQ(ring->pushBatch(std::span<const TickRecord>(ticks)), 0);
+  for (int i = 0; i < COUNT; ++i) {
+    ticks[i].seq_num = i;
+  }
+  std::vector<TickRecord> read(COUNT);
+  ASSERT_EQ(ring->readBatch(0, read), static_cast<size_t>(COUNT));
+  ASSERT_TRUE(read == ticks);
+  ASSERT_TRUE(ring->readEx(COUNT).status == ReadStatus::NOT_READY);
+
+  // File round trip with the schema in the header
+  const std::string TICK_FILE = "data/test_ticks.bin";
+  {
+    RecordFileWriteChannel<TickRecord> writer(TICK_FILE);
+    ASSERT_TRUE(writer.open());
+    ASSERT_TRUE(writer.write(ticks[0]));
+    ASSERT_TRUE(
+        writer.writeBatch(std::span<const TickRecord>(ticks).subspan(1)));
+    ASSERT_EQ(writer.getMessageCount(), COUNT);
+  }
+  // Records, then the instrument index
+  const auto tick_file_size = std::filesystem::file_size(TICK_FILE);
+  {
+    std::ifstream file(TICK_FILE, std::ios::binary);
+    FileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    ASSERT_EQ(header.schema_id, SCHEMA_TICK);
+    ASSERT_EQ(header.record_size, sizeof(TickRecord));
+    ASSERT_TRUE(header.isComplete());
+    ASSERT_TRUE(header.flags & FILE_FLAG_INSTRUMENT_INDEX);
+    ASSERT_EQ(header.data_end,
+              static_cast<int64_t>(sizeof(FileHeader) +
+                                   COUNT * sizeof(TickRecord)));
+    ASSERT_TRUE(tick_file_size > static_cast<uintmax_t>(header.data_end));
+  }
+  {
+    RecordFileChannel<TickRecord> reader(TICK_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_EQ(reader.getMessageCount(), COUNT);
+    ASSERT_EQ(reader.getFirstSeq(), 0);
+    ASSERT_EQ(reader.getFileLastSeq(), COUNT - 1);
+    ASSERT_TRUE(reader.wasCleanlyClose());
+    std::vector<TickRecord> out(COUNT + 10);
+    ASSERT_EQ(reader.readBatch(out), static_cast<size_t>(COUNT));
+    out.resize(COUNT);
+    ASSERT_TRUE(out == ticks);
+    ASSERT_FALSE(reader.readNext().has_value());
+
+    ASSERT_TRUE(reader.seek(500));
+    ASSERT_TRUE(*reader.peek() == ticks[500]);
+    ASSERT_TRUE(*reader.readNext() == ticks[500]);
+    ASSERT_EQ(reader.getCurrentSeq(), 501);
+    ASSERT_FALSE(reader.seek(COUNT));
+  }
+
+  // A file is only opened as the record type it holds
+  {
+    FileChannel msg_reader(TICK_FILE);
+    ASSERT_FALSE(msg_reader.open());
+    RecordFileChannel<WideRecord> wide_reader(TICK_FILE);
+    ASSERT_FALSE(wide_reader.open());
+    FileWriteChannel msg_writer(TICK_FILE);
+    ASSERT_FALSE(msg_writer.openAppend());
+  }
+  ASSERT_EQ(std::filesystem::file_size(TICK_FILE), tick_file_size);
+
+  const std::string MSG_FILE = "data/test_ticks_msg.bin";
+  {
+    FileWriteChannel writer(MSG_FILE);
+    ASSERT_TRUE(writer.open());
+    ASSERT_TRUE(writer.write(Msg(0, 0, 1.0)));
+  }
+  {
+    RecordFileChannel<TickRecord> tick_reader(MSG_FILE);
+    ASSERT_FALSE(tick_reader.open());
+    RecordFileChannel<Msg> msg_reader(MSG_FILE);
+    ASSERT_TRUE(msg_reader.open());
+    ASSERT_EQ(msg_reader.readNext()->payload, 1.0);
+  }
+
+  // Recorder over a tick ring
+  auto tick_ring =
+      std::make_unique<BasicMktDataRecorder<TickRecord>::RingBufferType>();
+  {
+    BasicMktDataRecorder<TickRecord> recorder(*tick_ring, TICK_FILE);
+    recorder.start();
+    tick_ring->pushBatch(std::span<const TickRecord>(ticks));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (recorder.getRecordedCount() < COUNT &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    recorder.stop();
+    ASSERT_EQ(recorder.getRecordedCount(), COUNT);
+    ASSERT_EQ(recorder.getLastSeq(), COUNT - 1);
+  }
+  {
+    RecordFileChannel<TickRecord> reader(TICK_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_EQ(reader.getMessageCount(), COUNT);
+    std::vector<TickRecord> out(COUNT);
+    ASSERT_EQ(reader.readBatch(out), static_cast<size_t>(COUNT));
+    ASSERT_TRUE(out == ticks);
+  }
+}
+
+// Events of three sizes for the variable-length frame tests
+enum : uint16_t { EVENT_TRADE = 1, EVENT_QUOTE = 2, EVENT_BOOK = 3 };
+
+struct TradeEvent {
+  double price;
+  int64_t size;
+};
+
+struct QuoteEvent {
+  double bid;
+  double ask;
+  int64_t bid_size;
+  int64_t ask_size;
+};
+
+struct BookEvent {
+  double prices[5];
+  int64_t sizes[5];
+};
+
+// Push event i of a mixed stream; every event carries i so a reader can
+// check it arrived whole
+template <size_t Cap>
+SeqNum pushMixedEvent(VarRingBuffer<Cap>& ring, int64_t i) {
+  switch (i % 3) {
+    case 0:
+      return ring.pushEvent(EVENT_TRADE, i, TradeEvent{100.0 + i, i});
+    case 1:
+      return ring.pushEvent(EVENT_QUOTE, i,
+                            QuoteEvent{99.0 + i, 101.0 + i, i, i});
+    default: {
+      BookEvent book{};
+      for (int level = 0; level < 5; ++level) {
+        book.prices[level] = 100.0 + level;
+        book.sizes[level] = i;
+      }
+      return ring.pushEvent(EVENT_BOOK, i, book);
+    }
+  }
+}
+
+// The event index a mixed-stream frame carries, or -1 if it is not one
+int64_t mixedEventIndex(const FrameHeader& header,
+                        std::span<const std::byte> payload) {
+  FrameView frame{header, payload};
+  switch (header.type) {
+    case EVENT_TRADE:
+      return header.length == sizeof(TradeEvent) ? frame.as<TradeEvent>().size
+                                                 : -1;
+    case EVENT_QUOTE:
+      return header.length == sizeof(QuoteEvent)
+                 ? frame.as<QuoteEvent>().bid_size
+                 : -1;
+    case EVENT_BOOK: {
+      if (header.length != sizeof(BookEvent)) {
+        return -1;
+      }
+      auto book = frame.as<BookEvent>();
+      return book.sizes[0] == book.sizes[4] ? book.sizes[0] : -1;
+    }
+    default:
+      return -1;
+  }
+}
+
+// Test the variable-length frame ring: mixed event sizes, padding at the
+// wrap, overwrite and resync, batch reads recorded as a v4 file, torn-tail
+// recovery, frame replay with a type filter, and a concurrent reader
+TEST(Consistency, VarRingBuffer) {
+  static_assert(frameBytes(sizeof(TradeEvent)) == 40);
+  static_assert(frameBytes(sizeof(QuoteEvent)) == 56);
+  static_assert(frameBytes(sizeof(BookEvent)) == 104);
+  static_assert(frameBytes(1) == 32);
+
+  // Frames in push order, each only as long as its payload
+  {
+    VarRingBuffer<4096> ring;
+    for (int64_t i = 0; i < 3; ++i) {
+      ASSERT_EQ(pushMixedEvent(ring, i), i);
+    }
+    ASSERT_EQ(ring.getBytesWritten(), 40u + 56u + 104u);
+    ASSERT_EQ(ring.getLatestSeq(), 2);
+
+    FrameCursor cursor;
+    std::array<std::byte, 128> payload;
+    for (int64_t i = 0; i < 3; ++i) {
+      auto result = ring.readEx(cursor, payload);
+      ASSERT_TRUE(result.status == ReadStatus::OK);
+      ASSERT_EQ(result.header.seq_num, i);
+      ASSERT_EQ(result.header.timestamp_ns, i);
+      ASSERT_EQ(result.header.type, i + 1);
+      ASSERT_EQ(mixedEventIndex(result.header, payload), i);
+    }
+    ASSERT_TRUE(ring.readEx(cursor, payload).status == ReadStatus::NOT_READY);
+
+    std::vector<std::byte> too_long(ring.maxPayloadSize() + 1);
+    ASSERT_EQ(ring.push(FrameRef{EVENT_BOOK, 0, too_long}), INVALID_SEQ);
+    too_long.pop_back();
+    ASSERT_EQ(ring.push(FrameRef{EVENT_BOOK, 0, too_long}), 3);
+  }
+
+  // Wrap, overwrite and resync from oldest()
+  {
+    const int64_t COUNT = 300;
+    VarRingBuffer<4096> ring;
+    for (int64_t i = 0; i < COUNT; ++i) {
+      ASSERT_EQ(pushMixedEvent(ring, i), i);
+    }
+    ASSERT_TRUE(ring.getOverwriteCount() > 0);
+    ASSERT_TRUE(ring.getPaddingBytes() > 0);
+
+    FrameCursor cursor;
+    std::array<std::byte, 128> payload;
+    ASSERT_TRUE(ring.readEx(cursor, payload).status ==
+                ReadStatus::OVERWRITTEN);
+    cursor = ring.oldest();
+    int64_t expected = -1;
+    int64_t frames = 0;
+    while (true) {
+      auto result = ring.readEx(cursor, payload);
+      if (result.status == ReadStatus::NOT_READY) {
+        break;
+      }
+      ASSERT_TRUE(result.status == ReadStatus::OK);
+      if (expected >= 0) {
+        ASSERT_EQ(result.header.seq_num, expected);
+      }
+      ASSERT_EQ(mixedEventIndex(result.header, payload),
+                result.header.seq_num);
+      expected = result.header.seq_num + 1;
+      ++frames;
+    }
+    ASSERT_EQ(expected, COUNT);
+    ASSERT_EQ(frames + ring.getOverwriteCount(), COUNT);
+    ASSERT_EQ(ring.lagOf(cursor), 0u);
+  }
+
+  // Batch reads straight into a v4 recording
+  const int64_t COUNT = 10000;
+  const std::string FRAME_FILE = "data/test_frames.bin";
+  auto ring = std::make_unique<VarRingBuffer<1 << 20>>();
+  for (int64_t i = 0; i < COUNT; ++i) {
+    pushMixedEvent(*ring, i);
+  }
+  int64_t flushed_count = 0;
+  int64_t flushed_bytes = 0;
+  {
+    FrameFileWriteChannel writer(FRAME_FILE);
+    ASSERT_TRUE(writer.open());
+    FrameCursor cursor;
+    std::vector<std::byte> batch(64 * 1024);
+    while (true) {
+      auto result = ring->readBatch(cursor, batch);
+      if (result.status != ReadStatus::OK) {
+        ASSERT_TRUE(result.status == ReadStatus::NOT_READY);
+        break;
+      }
+      ASSERT_TRUE(writer.writeFrames(std::span(batch).first(result.bytes)));
+      if (flushed_count == 0 && writer.getFrameCount() >= COUNT / 2) {
+        writer.flush();
+        flushed_count = writer.getFrameCount();
+        flushed_bytes = writer.getBytesWritten();
+      }
+    }
+    ASSERT_EQ(writer.getFrameCount(), COUNT);
+    ASSERT_EQ(writer.getLastSeq(), COUNT - 1);
+    // Not on a frame boundary: nothing is written
+    ASSERT_FALSE(writer.writeFrames(std::span(batch).first(30)));
+    ASSERT_EQ(writer.getFrameCount(), COUNT);
+  }
+  ASSERT_EQ(std::filesystem::file_size(FRAME_FILE),
+            sizeof(FileHeader) + ring->getBytesWritten() -
+                ring->getPaddingBytes());
+
+  auto checkFrames = [&](FrameFileChannel& reader) {
+    for (int64_t i = 0; i < COUNT; ++i) {
+      auto frame = reader.readNext();
+      ASSERT_TRUE(frame.has_value());
+      ASSERT_EQ(frame->header.seq_num, i);
+      ASSERT_EQ(frame->header.type, i % 3 + 1);
+      ASSERT_EQ(mixedEventIndex(frame->header, frame->payload), i);
+    }
+    ASSERT_FALSE(reader.readNext().has_value());
+  };
+  {
+    FrameFileChannel reader(FRAME_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_TRUE(reader.wasCleanlyClose());
+    ASSERT_EQ(reader.getFrameCount(), COUNT);
+    ASSERT_EQ(reader.getFirstSeq(), 0);
+    ASSERT_EQ(reader.getFileLastSeq(), COUNT - 1);
+    checkFrames(reader);
+
+    // Random access, forward and back across seek index entries
+    for (int64_t index : {int64_t{9000}, int64_t{4097}, int64_t{10},
+                          COUNT - 1}) {
+      ASSERT_TRUE(reader.seek(index));
+      auto frame = reader.readNext();
+      ASSERT_TRUE(frame.has_value());
+      ASSERT_EQ(frame->header.seq_num, index);
+    }
+    ASSERT_FALSE(reader.seek(COUNT));
+
+    // Other layouts do not open as frames, nor frames as records
+    FileChannel msg_reader(FRAME_FILE);
+    ASSERT_FALSE(msg_reader.open());
+    FrameFileChannel tick_reader("data/test_ticks.bin");
+    ASSERT_FALSE(tick_reader.open());
+  }
+
+  // Frame replay: type filter and max-speed pacing
+  {
+    FrameReplayEngine engine(FRAME_FILE);
+    ASSERT_TRUE(engine.open());
+    engine.setPacing(PacingConfig{0.0, -1, IdleGapPolicy::COMPRESS, 0});
+    engine.setTypeFilter(uint64_t{1} << EVENT_TRADE |
+                         uint64_t{1} << EVENT_BOOK);
+    int64_t count = 0;
+    while (auto frame = engine.nextPacedFrame()) {
+      ASSERT_TRUE(frame->header.type != EVENT_QUOTE);
+      ASSERT_EQ(mixedEventIndex(frame->header, frame->payload),
+                frame->header.seq_num);
+      ++count;
+    }
+    ASSERT_EQ(count + engine.getFilteredCount(), COUNT);
+    ASSERT_EQ(engine.getFilteredCount(), COUNT / 3);
+    ASSERT_EQ(engine.getSeqViolationCount(), 0);
+
+    engine.clearTypeFilter();
+    ASSERT_TRUE(engine.seek(COUNT - 2));
+    ASSERT_EQ(engine.nextFrame()->header.seq_num, COUNT - 2);
+    ASSERT_EQ(engine.peekFrame()->header.seq_num, COUNT - 1);
+    engine.reset();
+    ASSERT_EQ(engine.nextFrame()->header.seq_num, 0);
+  }
+
+  // Crash: header as of the flush, a torn frame at the tail
+  {
+    std::fstream file(FRAME_FILE,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    FileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.flags &= ~FILE_FLAG_COMPLETE;
+    header.msg_count = flushed_count;
+    header.last_seq = flushed_count - 1;
+    header.data_end = flushed_bytes;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.seekp(0, std::ios::end);
+    FrameHeader torn{COUNT, COUNT, sizeof(BookEvent), EVENT_BOOK, 0};
+    file.write(reinterpret_cast<const char*>(&torn), sizeof(torn));
+    file.write("torn", 4);
+  }
+  {
+    FrameFileChannel reader(FRAME_FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_FALSE(reader.wasCleanlyClose());
+    ASSERT_EQ(reader.getFrameCount(), COUNT);
+    ASSERT_EQ(reader.getRecoveredCount(), COUNT - flushed_count);
+    ASSERT_EQ(reader.getFileLastSeq(), COUNT - 1);
+    checkFrames(reader);
+  }
+
+  // A concurrent reader sees whole frames in order, resyncing when lapped
+  {
+    const int64_t EVENTS = 200000;
+    auto shared = std::make_unique<VarRingBuffer<64 * 1024>>();
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+      for (int64_t i = 0; i < EVENTS; ++i) {
+        pushMixedEvent(*shared, i);
+      }
+      done.store(true, std::memory_order_release);
+    });
+
+    FrameCursor cursor;
+    std::array<std::byte, 128> payload;
+    int64_t last = -1;
+    int64_t received = 0;
+    int64_t resyncs = 0;
+    bool intact = true;
+    while (true) {
+      auto result = shared->readEx(cursor, payload);
+      if (result.status == ReadStatus::OK) {
+        intact = intact && result.header.seq_num > last &&
+                 mixedEventIndex(result.header, payload) ==
+                     result.header.seq_num;
+        last = result.header.seq_num;
+        ++received;
+      } else if (result.status == ReadStatus::OVERWRITTEN) {
+        cursor = shared->oldest();
+        ++resyncs;
+      } else if (done.load(std::memory_order_acquire) &&
+                 shared->lagOf(cursor) == 0) {
+        break;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    producer.join();
+    ASSERT_TRUE(intact);
+    ASSERT_EQ(last, EVENTS - 1);
+    // Without a resync every event was received
+    ASSERT_TRUE(resyncs > 0 || received == EVENTS);
+  }
+}
+
+// Test instrument-filtered reads of record files: the index written on
+// close, blocks skipped for rare instruments, the same records as a scan,
+// and the fallback to a scan without a usable index
+TEST(Consistency, InstrumentIndex) {
+  const int64_t COUNT = 20000;
+  const uint32_t BLOCK = 256;
+  const uint32_t RARE = 1000;
+  const std::vector<int64_t> RARE_AT = {5, 7000, 7001, 19999};
+
+  std::vector<TickRecord> ticks(COUNT);
+  for (int64_t i = 0; i < COUNT; ++i) {
+    ticks[i].seq_num = i;
+    ticks[i].timestamp_ns = i * 1000;
+    ticks[i].price = 100.0 + static_cast<double>(i % 100);
+    ticks[i].instrument_id = static_cast<uint32_t>(i % 50);
+    // A run of instrument 2000 in the middle of the file
+    if (i >= 10000 && i < 10600) {
+      ticks[i].instrument_id = 2000;
+    }
+  }
+  for (int64_t i : RARE_AT) {
+    ticks[i].instrument_id = RARE;
+  }
+
+  const std::string FILE = "data/test_instruments.bin";
+  {
+    RecordFileWriteChannel<TickRecord> writer(FILE);
+    writer.setIndexBlockRecords(BLOCK);
+    ASSERT_TRUE(writer.open());
+    for (int64_t begin = 0; begin < COUNT; begin += 999) {
+      auto batch = std::span<const TickRecord>(ticks).subspan(
+          begin, std::min<int64_t>(999, COUNT - begin));
+      ASSERT_TRUE(writer.writeBatch(batch));
+    }
+  }
+
+  auto expected = [&](std::vector<uint32_t> instruments, int64_t from = 0) {
+    std::vector<TickRecord> out;
+    for (int64_t i = from; i < COUNT; ++i) {
+      if (std::find(instruments.begin(), instruments.end(),
+                    ticks[i].instrument_id) != instruments.end()) {
+        out.push_back(ticks[i]);
+      }
+    }
+    return out;
+  };
+  auto readAll = [](RecordFileChannel<TickRecord>& reader, size_t batch) {
+    std::vector<TickRecord> out;
+    std::vector<TickRecord> buffer(batch);
+    while (size_t got = reader.readBatch(buffer)) {
+      out.insert(out.end(), buffer.begin(), buffer.begin() + got);
+    }
+    return out;
+  };
+  const int64_t BLOCKS = (COUNT + BLOCK - 1) / BLOCK;
+  const int64_t RECORD_BYTES = COUNT * sizeof(TickRecord);
+
+  {
+    RecordFileChannel<TickRecord> reader(FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_TRUE(reader.hasInstrumentIndex());
+    ASSERT_EQ(reader.getMessageCount(), COUNT);
+
+    // Only the three blocks holding the rare instrument are read
+    const uint32_t rare[] = {RARE};
+    reader.setInstrumentFilter(rare);
+    ASSERT_TRUE(reader.usesInstrumentIndex());
+    ASSERT_TRUE(readAll(reader, 64) == expected({RARE}));
+    const FilterStats& stats = reader.getFilterStats();
+    ASSERT_EQ(stats.blocks_selected, 3u);
+    ASSERT_EQ(stats.blocks_skipped, static_cast<size_t>(BLOCKS - 3));
+    ASSERT_TRUE(stats.bytes_read <
+                static_cast<int64_t>(4 * BLOCK * sizeof(TickRecord)));
+    ASSERT_EQ(reader.getCurrentSeq(), COUNT);
+
+    // Several instruments, one record at a time, with peek()
+    ASSERT_TRUE(reader.seek(0));
+    const uint32_t mixed[] = {2000, 7, RARE, 7};
+    reader.setInstrumentFilter(mixed);
+    std::vector<TickRecord> one_by_one;
+    while (auto next = reader.peek()) {
+      auto tick = reader.readNext();
+      ASSERT_TRUE(tick.has_value());
+      ASSERT_TRUE(*tick == *next);
+      one_by_one.push_back(*tick);
+    }
+    ASSERT_TRUE(one_by_one == expected({2000, 7, RARE}));
+
+    // From a seek position; then back to every record
+    ASSERT_TRUE(reader.seek(7001));
+    reader.setInstrumentFilter(rare);
+    auto tick = reader.readNext();
+    ASSERT_TRUE(tick.has_value());
+    ASSERT_EQ(tick->seq_num, 7001);
+    reader.clearInstrumentFilter();
+    ASSERT_EQ(reader.readNext()->seq_num, 7002);
+
+    // An instrument that is not in the file reads nothing
+    ASSERT_TRUE(reader.seek(0));
+    const uint32_t absent[] = {12345};
+    reader.setInstrumentFilter(absent);
+    ASSERT_EQ(readAll(reader, 64).size(), 0u);
+    ASSERT_EQ(reader.getFilterStats().blocks_selected, 0u);
+    ASSERT_EQ(reader.getFilterStats().blocks_skipped,
+              static_cast<size_t>(BLOCKS));
+  }
+
+  // A damaged index (or none, after a crash) falls back to a scan
+  auto scanMatches = [&](bool index_expected) {
+    RecordFileChannel<TickRecord> reader(FILE);
+    ASSERT_TRUE(reader.open());
+    ASSERT_EQ(reader.hasInstrumentIndex(), index_expected);
+    const uint32_t mixed[] = {RARE, 2000};
+    reader.setInstrumentFilter(mixed);
+    ASSERT_FALSE(reader.usesInstrumentIndex());
+    ASSERT_TRUE(readAll(reader, 1000) == expected({RARE, 2000}));
+    ASSERT_EQ(reader.getFilterStats().bytes_read, RECORD_BYTES);
+  };
+  {
+    std::fstream file(FILE, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(sizeof(FileHeader) + RECORD_BYTES +
+                                           sizeof(InstrumentIndexHeader)));
+    file.put('\xff');
+  }
+  scanMatches(true);
+  {
+    std::fstream file(FILE, std::ios::binary | std::ios::in | std::ios::out);
+    FileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.flags = 0;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  scanMatches(false);
+}
+
 // Test sum consistency
 TEST(Consistency, SumConsistency) {
   const int64_t MSG_COUNT = 5000;
@@ -191,9 +1786,523 @@ TEST(Consistency, SequenceNumbers) {
   ASSERT_EQ(buffer.getLatestSeq(), 499);
 }
 
+// Test exact summation: cancellation, order independence and merging
+TEST(Consistency, ExactSum) {
+  // Catastrophic cancellation that naive and Kahan summation get wrong
+  ExactSum cancel;
+  for (double x : {1e100, 1.0, -1e100, 1e-300, 3.0}) {
+    cancel.add(x);
+  }
+  ASSERT_EQ(cancel.value(), 4.0);
+
+  // Subnormals and signs
+  ExactSum tiny;
+  tiny.add(5e-324);
+  tiny.add(5e-324);
+  tiny.add(-1e-323);
+  ASSERT_EQ(tiny.value(), 0.0);
+
+  // Same multiset in different orders and splits gives identical bits
+  std::vector<double> values;
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  for (int i = 0; i < 100000; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    double mag = std::ldexp(static_cast<double>(state >> 11),
+                            static_cast<int>(state % 80) - 100);
+    values.push_back((state & 1) ? -mag : mag);
+  }
+
+  ExactSum forward;
+  for (double v : values) forward.add(v);
+
+  ExactSum backward;
+  for (auto it = values.rbegin(); it != values.rend(); ++it) backward.add(*it);
+
+  ExactSum merged;
+  for (size_t part = 0; part < 7; ++part) {
+    ExactSum slice;
+    for (size_t i = part; i < values.size(); i += 7) slice.add(values[i]);
+    merged.merge(slice);
+  }
+
+  ASSERT_EQ(forward.value(), backward.value());
+  ASSERT_EQ(forward.value(), merged.value());
+
+  // Correct rounding: 1 + 2^-53 ties to even (1.0), + 2^-105 breaks the tie
+  ExactSum tie;
+  tie.add(1.0);
+  tie.add(std::ldexp(1.0, -53));
+  ASSERT_EQ(tie.value(), 1.0);
+  tie.add(std::ldexp(1.0, -105));
+  ASSERT_EQ(tie.value(), 1.0 + std::ldexp(1.0, -52));
+}
+
+// Test that a parallel reduction of a file is bit-identical to a sequential
+// one for any thread count
+TEST(Consistency, ParallelReduce) {
+  const std::string TEST_FILE = "data/test_parallel_reduce.bin";
+  const int MSG_COUNT = 200000;
+
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.open());
+    for (int i = 0; i < MSG_COUNT; ++i) {
+      double payload = std::sin(static_cast<double>(i)) * 1e6 + 1e-3 * i;
+      ASSERT_TRUE(writer.write(Msg(i, i, payload)));
+    }
+    writer.close();
+  }
+
+  auto sequential = ReplayEngine::reduce(TEST_FILE);
+  ASSERT_TRUE(sequential.has_value());
+  ASSERT_EQ(sequential->msg_count, MSG_COUNT);
+  ASSERT_EQ(sequential->first_seq, 0);
+  ASSERT_EQ(sequential->last_seq, MSG_COUNT - 1);
+  ASSERT_EQ(sequential->seq_violation_count, 0);
+  ASSERT_EQ(sequential->seq_gap_count, 0);
+
+  for (size_t threads : {2, 3, 8}) {
+    auto parallel = ReplayEngine::parallelReduce(TEST_FILE, threads);
+    ASSERT_TRUE(parallel.has_value());
+    ASSERT_EQ(parallel->msg_count, MSG_COUNT);
+    ASSERT_EQ(parallel->last_seq, MSG_COUNT - 1);
+    ASSERT_EQ(parallel->seq_violation_count, 0);
+    ASSERT_EQ(parallel->sum.value(), sequential->sum.value());
+  }
+
+  // Sub-range reduction
+  auto part = ReplayEngine::parallelReduce(TEST_FILE, 4, 1000, 150000);
+  ASSERT_TRUE(part.has_value());
+  ASSERT_EQ(part->msg_count, 149000);
+  ASSERT_EQ(part->first_seq, 1000);
+  ASSERT_EQ(part->last_seq, 149999);
+}
+
+// Test that every SIMD summation kernel stays within the documented error
+// bound of the exact sum, including batch sizes that leave a scalar tail
+TEST(Consistency, PayloadSumKernels) {
+  std::vector<Msg> msgs;
+  uint64_t state = 0x2545F4914F6CDD1Dull;
+  for (int i = 0; i < 10007; ++i) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    double mag = std::ldexp(static_cast<double>(state >> 11),
+                            static_cast<int>(state % 40) - 60);
+    msgs.emplace_back(i, i, (state & 1) ? -mag : mag);
+  }
+
+  const double u = std::ldexp(1.0, -53);
+  for (size_t n : {0, 1, 7, 8, 15, 16, 17, 1000, 10007}) {
+    std::span<const Msg> batch(msgs.data(), n);
+
+    ExactSum exact;
+    double abs_sum = 0.0;
+    for (const Msg& m : batch) {
+      exact.add(m.payload);
+      abs_sum += std::fabs(m.payload);
+    }
+    double s = exact.value();
+    double bound = 2.0 * u * std::fabs(s) +
+                   4.0 * static_cast<double>(n) * u * u * abs_sum;
+
+    for (SumKernel kernel :
+         {SumKernel::SCALAR, SumKernel::AVX2, SumKernel::AVX512}) {
+      // Unsupported kernels fall back to scalar
+      double got = sumPayloads(batch, kernel);
+      ASSERT_LE(std::fabs(got - s), bound);
+    }
+  }
+
+  // Classic cancellation case that plain summation loses entirely
+  std::vector<Msg> cancel(64, Msg(0, 0, 1.0));
+  cancel[0].payload = 1e100;
+  cancel[33].payload = -1e100;
+  ASSERT_EQ(sumPayloads(cancel), 62.0);
+}
+
+// Test the bulk payload RNG: seeded streams are reproducible whatever the
+// fill sizes, values stay in range, and moments match a uniform distribution
+TEST(Consistency, FastUniformRng) {
+  const size_t N = 100003;
+  std::vector<double> whole(N);
+  FastUniformRng rng(12345);
+  rng.fill(whole, 0.0, 100.0);
+
+  // Same seed, fills that are multiples of the lane count
+  std::vector<double> chunked(N);
+  FastUniformRng again(12345);
+  size_t pos = 0;
+  while (pos < N) {
+    size_t n = std::min<size_t>(FastUniformRng::LANES * 31, N - pos);
+    again.fill(std::span<double>(chunked.data() + pos, n), 0.0, 100.0);
+    pos += n;
+  }
+  ASSERT_TRUE(whole == chunked);
+
+  double sum = 0.0;
+  double sum_sq = 0.0;
+  for (double x : whole) {
+    ASSERT_TRUE(x >= 0.0 && x < 100.0);
+    sum += x;
+    sum_sq += x * x;
+  }
+  double mean = sum / N;
+  double variance = sum_sq / N - mean * mean;
+  ASSERT_LT(std::abs(mean - 50.0), 0.5);                 // ~5 sigma
+  ASSERT_LT(std::abs(variance - 10000.0 / 12.0), 15.0);  // ~5 sigma
+
+  std::vector<double> other(N);
+  FastUniformRng different(54321);
+  different.fill(other, 0.0, 100.0);
+  ASSERT_FALSE(whole == other);
+}
+
+// Test the TSC clock: it tracks the system clock, never goes backwards, and a
+// reader of a shared calibration converts exactly like its owner; with no
+// calibration published a reader falls back to the system clock
+TEST(Consistency, TscClock) {
+  auto& clock = TscClock::global();
+
+  std::vector<int64_t> offsets;
+  for (int i = 0; i < 1001; ++i) {
+    int64_t system = getCurrentTimestampNs();
+    offsets.push_back(std::llabs(clock.nowNs() - system));
+  }
+  std::nth_element(offsets.begin(), offsets.begin() + 500, offsets.end());
+  ASSERT_LT(offsets[500], 100000);  // Median within 100 us
+
+  int64_t prev = clock.nowNs();
+  for (int i = 0; i < 1000000; ++i) {
+    int64_t now = clock.nowNs();
+    ASSERT_GE(now, prev);
+    prev = now;
+  }
+
+  TscCalibration shared;
+  TscClock reader(shared, TscClock::Role::READER);
+  ASSERT_FALSE(reader.usesTsc());
+  int64_t before = getCurrentTimestampNs();
+  int64_t fallback = reader.nowNs();
+  ASSERT_GE(fallback, before);
+  ASSERT_LE(fallback, getCurrentTimestampNs());
+
+  TscClock owner(shared, TscClock::Role::OWNER);
+  ASSERT_EQ(owner.usesTsc(), TscClock::isInvariantTscSupported());
+  ASSERT_EQ(reader.usesTsc(), owner.usesTsc());
+  TscParams params = reader.getParams();
+  ASSERT_EQ(params.mult, owner.getParams().mult);
+  uint64_t tsc = TscClock::readTsc();
+  ASSERT_EQ(params.toNs(tsc), owner.getParams().toNs(tsc));
+
+  // The multiply without 128-bit integers is exact wherever the result fits,
+  // including deltas of years at GHz rates and rates of many ns per tick
+  const int64_t deltas[] = {0,
+                            1,
+                            -1,
+                            4294967295,
+                            1LL << 40,
+                            -(1LL << 40),
+                            123456789012345,
+                            -987654321098765,
+                            (1LL << 62) / 3};
+  const uint64_t mults[] = {1, 0x55555555, 0xFFFFFFFFull, 1ull << 32,
+                            0x1FFFFFFFFull};
+  for (int64_t delta : deltas) {
+    for (uint64_t mult : mults) {
+      long double exact = std::floor(static_cast<long double>(delta) *
+                                     static_cast<long double>(mult) /
+                                     4294967296.0L);
+      if (std::fabs(exact) >= 9.0e18L) {
+        continue;  // Does not fit in int64_t
+      }
+      ASSERT_EQ(detail::tscMulShiftSplit(delta, mult),
+                detail::tscMulShift(delta, mult));
+    }
+  }
+}
+
+// Test the log-linear latency histogram: every value lands in a bucket whose
+// bounds contain it, percentiles are within one bucket width (~3%), and
+// merge() / since() compose snapshots exactly
+TEST(Consistency, LatencyHistogram) {
+  using namespace latency_buckets;
+  for (size_t i = 0; i + 1 < BUCKET_COUNT; ++i) {
+    ASSERT_EQ(upperBound(i) + 1, lowerBound(i + 1));
+    ASSERT_EQ(indexOf(lowerBound(i)), i);
+    ASSERT_EQ(indexOf(upperBound(i)), i);
+  }
+  ASSERT_EQ(indexOf(-5), 0u);
+  ASSERT_EQ(indexOf(INT64_MAX), BUCKET_COUNT - 1);
+
+  // 1..100000 ns once each
+  LatencyHistogram first;
+  LatencyHistogram second;
+  for (int64_t v = 1; v <= 100000; ++v) {
+    (v % 2 ? first : second).record(v);
+  }
+  HistogramSnapshot merged = first.snapshot();
+  merged.merge(second.snapshot());
+  ASSERT_EQ(merged.total_count, 100000);
+  ASSERT_EQ(merged.max_ns, 100000);
+  ASSERT_LT(std::abs(merged.meanNs() - 50000.5), 1e-9);
+  for (double q : {0.5, 0.9, 0.99, 0.999}) {
+    double exact = q * 100000.0;
+    double got = static_cast<double>(merged.percentileNs(q));
+    ASSERT_GE(got, exact - 1.0);
+    ASSERT_LE(got, exact * (1.0 + 1.0 / SUB_COUNT));
+  }
+  ASSERT_EQ(merged.percentileNs(1.0), 100000);
+
+  // Interval delta: only what was recorded after the earlier snapshot
+  HistogramSnapshot before = first.snapshot();
+  first.record(7, 3);
+  HistogramSnapshot delta = first.snapshot().since(before);
+  ASSERT_EQ(delta.total_count, 3);
+  ASSERT_EQ(delta.sum_ns, 21);
+  ASSERT_EQ(delta.percentileNs(0.5), 7);
+
+  ASSERT_EQ(HistogramSnapshot{}.percentileNs(0.99), 0);
+}
+
+// Test the metrics registry: bound handles publish into their slots, unbound
+// handles keep their value locally, re-binding a name reuses its slot, and a
+// read-only monitor mapping of a shared page sees what a publisher wrote
+TEST(Consistency, MetricsRegistry) {
+  MetricsRegistry registry;
+  std::vector<MetricSample> samples;
+  ASSERT_TRUE(registry.sample(samples));
+  ASSERT_TRUE(samples.empty());
+
+  Counter counter;
+  counter.add(5);  // Carried over on bind
+  Gauge gauge;
+  ASSERT_TRUE(registry.bind(counter, "test.count"));
+  ASSERT_TRUE(registry.bind(gauge, "test.level"));
+  counter.add(2);
+  gauge.set(-3);
+
+  registry.sample(samples);
+  ASSERT_EQ(samples.size(), 2u);
+  ASSERT_TRUE(samples[0].name == "test.count");
+  ASSERT_TRUE(samples[0].kind == MetricKind::COUNTER);
+  ASSERT_EQ(samples[0].value, 7);
+  ASSERT_TRUE(samples[1].name == "test.level");
+  ASSERT_EQ(samples[1].value, -3);
+
+  // A restarted writer re-binds to the same slot
+  Counter restarted;
+  ASSERT_TRUE(registry.bind(restarted, "test.count"));
+  restarted.add(1);
+  registry.sample(samples);
+  ASSERT_EQ(samples.size(), 2u);
+  ASSERT_EQ(samples[0].value, 1);
+
+  ASSERT_FALSE(registry.bind(gauge, std::string(METRIC_NAME_SIZE, 'x')));
+
+  // Page full: the handle stays local and still counts
+  for (size_t i = 2; i < METRICS_CAPACITY; ++i) {
+    Gauge filler;
+    ASSERT_TRUE(registry.bind(filler, "fill." + std::to_string(i)));
+  }
+  Counter overflow;
+  ASSERT_FALSE(registry.bind(overflow, "test.overflow"));
+  overflow.add(4);
+  ASSERT_EQ(overflow.load(), 4);
+
+  // Shared page seen through a second, read-only mapping
+  std::string shm_name = "/replay_metrics_test_" + std::to_string(getpid());
+  {
+    auto publisher = MetricsRegistry::openShared(
+        shm_name, MetricsRegistry::Access::PUBLISH);
+    ASSERT_TRUE(publisher != nullptr);
+    auto monitor = MetricsRegistry::openShared(
+        shm_name, MetricsRegistry::Access::MONITOR);
+    ASSERT_TRUE(monitor != nullptr);
+
+    Gauge shared_gauge;
+    ASSERT_TRUE(publisher->bind(shared_gauge, "shared.seq"));
+    shared_gauge.set(42);
+    ASSERT_FALSE(monitor->bind(shared_gauge, "monitor.seq"));
+
+    ASSERT_TRUE(monitor->sample(samples));
+    ASSERT_EQ(samples.size(), 1u);
+    ASSERT_TRUE(samples[0].name == "shared.seq");
+    ASSERT_EQ(samples[0].value, 42);
+  }
+  MetricsRegistry::unlinkShared(shm_name);
+  ASSERT_TRUE(MetricsRegistry::openShared(
+                  shm_name, MetricsRegistry::Access::MONITOR) == nullptr);
+}
+
+// Test the consumer table: registration, published cursors and the
+// slowest-live-consumer watermark, stale slot takeover, and the ring's lapped
+// count (only messages a live consumer had not read) next to its overwrite
+// count (every slot reuse)
+TEST(Consistency, ConsumerTable) {
+  RingBuffer<16> buffer;
+  ConsumerTable& table = buffer.consumers();
+  const int64_t now = tscTimestampNs();
+
+  int fast = table.registerConsumer("fast", 0, now);
+  ASSERT_EQ(fast, 0);
+  ASSERT_EQ(table.minLiveCursor(now), 0);
+
+  // A consumer that keeps up: slots are reused but nothing is lapped
+  for (int i = 0; i < 48; ++i) {
+    SeqNum seq = buffer.push(Msg(INVALID_SEQ, i, 1.0));
+    table.publish(fast, seq + 1, now);
+  }
+  ASSERT_EQ(buffer.getOverwriteCount(), 32);
+  ASSERT_EQ(buffer.getLappedCount(), 0);
+  ASSERT_EQ(buffer.lagOf(48), 0);
+
+  // A registered consumer that stalls at 48 is lapped once the producer
+  // overwrites seq 48
+  int slow = table.registerConsumer("slow", 48, now);
+  ASSERT_EQ(slow, 1);
+  for (int i = 0; i < 16; ++i) {
+    SeqNum seq = buffer.push(Msg(INVALID_SEQ, i, 1.0));
+    table.publish(fast, seq + 1, now);
+  }
+  ASSERT_EQ(buffer.getLappedCount(), 0);
+  ASSERT_EQ(table.minLiveCursor(now), 48);
+  std::array<Msg, 4> batch{};
+  buffer.pushBatch(batch);
+  ASSERT_TRUE(buffer.getLappedCount() > 0);
+  ASSERT_TRUE(buffer.getLappedCount() <= 4);
+  ASSERT_EQ(buffer.lagOf(48), 20);
+
+  ASSERT_TRUE(buffer.readEx(48).status == ReadStatus::OVERWRITTEN);
+  table.recordLapped(slow);
+  std::vector<ConsumerInfo> infos;
+  table.snapshot(infos, now);
+  ASSERT_EQ(infos.size(), 2u);
+  ASSERT_TRUE(infos[1].name == "slow");
+  ASSERT_EQ(infos[1].pid, static_cast<int32_t>(getpid()));
+  ASSERT_EQ(infos[1].cursor, 48);
+  ASSERT_EQ(infos[1].lapped_count, 1);
+  ASSERT_TRUE(infos[1].live);
+
+  // Silent consumers stop holding back the watermark
+  const int64_t later = now + 2 * CONSUMER_STALE_NS;
+  ASSERT_EQ(table.minLiveCursor(later), std::numeric_limits<SeqNum>::max());
+  table.heartbeat(fast, later);
+  ASSERT_EQ(table.minLiveCursor(later), 64);
+  table.heartbeat(slow, later);
+
+  // Full table: only a stale slot can be taken over
+  for (size_t i = 2; i < MAX_CONSUMERS; ++i) {
+    ASSERT_TRUE(table.registerConsumer("filler", 0, later) >= 0);
+  }
+  ASSERT_EQ(table.registerConsumer("late", 0, later), -1);
+  ASSERT_EQ(table.registerConsumer("late", 0, later + 2 * CONSUMER_STALE_NS),
+            0);
+  ASSERT_EQ(table.registerConsumer(std::string(CONSUMER_NAME_SIZE, 'x'), 0,
+                                   later),
+            -1);
+
+  table.unregisterConsumer(slow);
+  ASSERT_EQ(table.registerConsumer("again", 0, later), slow);
+  ASSERT_EQ(table.reapDeadProcesses(), 0u);
+}
+
+// Test consumer resumption: a restarted consumer reclaims the slot its
+// predecessor left (unregistered or stale) with the cursor it published,
+// and new consumers prefer never-used slots over such leftovers
+TEST(Consistency, ConsumerResume) {
+  ConsumerTable table{};
+  const int64_t now = tscTimestampNs();
+
+  SeqNum cursor = -1;
+  int client = table.resumeConsumer("client", 0, now, cursor);
+  ASSERT_EQ(client, 0);
+  ASSERT_EQ(cursor, 0);
+  table.publish(client, 5000, now);
+  table.unregisterConsumer(client);
+
+  // A newcomer does not take the departed client's slot
+  int recorder = table.registerConsumer("recorder", 0, now);
+  ASSERT_EQ(recorder, 1);
+  table.publish(recorder, 4000, now);
+
+  client = table.resumeConsumer("client", 0, now, cursor);
+  ASSERT_EQ(client, 0);
+  ASSERT_EQ(cursor, 5000);
+
+  // A live consumer's slot is not resumed; a stale one is
+  SeqNum other = -1;
+  ASSERT_EQ(table.resumeConsumer("recorder", 0, now, other), 2);
+  ASSERT_EQ(other, 0);
+  table.unregisterConsumer(2);
+  const int64_t later = now + 2 * CONSUMER_STALE_NS;
+  table.heartbeat(client, later);
+  ASSERT_EQ(table.resumeConsumer("recorder", 0, later, other), recorder);
+  ASSERT_EQ(other, 4000);
+
+  // A cleared table (ring re-initialized) has no cursors left to resume
+  table.clear();
+  ASSERT_EQ(table.resumeConsumer("client", 7, later, cursor), 0);
+  ASSERT_EQ(cursor, 7);
+}
+
+// Test the overflow log: messages read back by sequence number, wrapped-over
+// and never-written slots are misses, and a ring with the log attached
+// serves overwritten messages from it
+TEST(Consistency, OverflowLog) {
+  const std::string path = "data/test_overflow.log";
+  ASSERT_TRUE(OverflowLog::create(path, 100) == nullptr);
+  auto log = OverflowLog::create(path, 64);
+  ASSERT_TRUE(log != nullptr);
+  ASSERT_EQ(log->getNextSeq(), 0);
+
+  Msg out;
+  ASSERT_FALSE(log->read(0, out));  // Sparse, never written
+
+  std::vector<Msg> messages;
+  for (SeqNum seq = 0; seq < 80; ++seq) {
+    messages.emplace_back(seq, seq * 10, static_cast<double>(seq));
+  }
+  log->append(messages);
+  ASSERT_EQ(log->getNextSeq(), 80);
+  ASSERT_FALSE(log->read(15, out));  // Wrapped over by seq 79
+  ASSERT_TRUE(log->read(16, out));
+  ASSERT_TRUE(out == messages[16]);
+  ASSERT_TRUE(log->read(79, out));
+  ASSERT_TRUE(out == messages[79]);
+  ASSERT_FALSE(log->read(80, out));
+  ASSERT_FALSE(log->read(-1, out));
+
+  // Ring of 16 backed by the log: everything the log holds stays readable
+  RingBuffer<16> buffer;
+  for (const Msg& msg : messages) {
+    buffer.push(msg);
+  }
+  ASSERT_TRUE(buffer.readEx(16).status == ReadStatus::OVERWRITTEN);
+  buffer.attachOverflow(log.get());
+  ASSERT_TRUE(buffer.readEx(15).status == ReadStatus::OVERWRITTEN);
+  auto result = buffer.readEx(16);
+  ASSERT_TRUE(result.status == ReadStatus::OK);
+  ASSERT_TRUE(result.msg == messages[16]);
+  ASSERT_TRUE(buffer.readEx(80).status == ReadStatus::NOT_READY);
+
+  // A batch read runs from the log straight into the ring
+  std::array<Msg, 64> batch;
+  ASSERT_EQ(buffer.readBatch(16, batch), 64u);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    ASSERT_EQ(batch[i].seq_num, static_cast<SeqNum>(16 + i));
+  }
+
+  buffer.attachOverflow(nullptr);
+  ASSERT_TRUE(buffer.readEx(16).status == ReadStatus::OVERWRITTEN);
+}
+
 #ifndef GTEST_FOUND
 
 int main() {
+  TscClock::global();  // Calibrate before anything is timed
   std::cout << "=== Consistency Test ===" << std::endl;
 
   RUN_TEST(Consistency, MessageStructure);
@@ -201,8 +2310,30 @@ int main() {
   RUN_TEST(Consistency, RingBufferConcurrent);
   RUN_TEST(Consistency, SpinLock);
   RUN_TEST(Consistency, FileIO);
+  RUN_TEST(Consistency, FileAppendResume);
+  RUN_TEST(Consistency, ColumnarFile);
+  RUN_TEST(Consistency, PayloadCodec);
+  RUN_TEST(Consistency, BlockCodec);
+  RUN_TEST(Consistency, BlockChecksum);
+  RUN_TEST(Consistency, ZoneMapFilter);
+  RUN_TEST(Consistency, MergedReplay);
+  RUN_TEST(Consistency, LineArbitration);
+  RUN_TEST(Consistency, KeepSeqConsumers);
+  RUN_TEST(Consistency, RecordTypes);
+  RUN_TEST(Consistency, VarRingBuffer);
+  RUN_TEST(Consistency, InstrumentIndex);
   RUN_TEST(Consistency, SumConsistency);
   RUN_TEST(Consistency, SequenceNumbers);
+  RUN_TEST(Consistency, ExactSum);
+  RUN_TEST(Consistency, ParallelReduce);
+  RUN_TEST(Consistency, PayloadSumKernels);
+  RUN_TEST(Consistency, FastUniformRng);
+  RUN_TEST(Consistency, TscClock);
+  RUN_TEST(Consistency, LatencyHistogram);
+  RUN_TEST(Consistency, MetricsRegistry);
+  RUN_TEST(Consistency, ConsumerTable);
+  RUN_TEST(Consistency, ConsumerResume);
+  RUN_TEST(Consistency, OverflowLog);
 
   std::cout << "\nAll tests passed!" << std::endl;
   return 0;
@@ -1,10 +1,14 @@
 #include <chrono>
 #include <cmath>
+#include <cstdio>
 #include <memory>
 #include <thread>
 
+#include "channel/FileChannel.hpp"
 #include "client/MktDataClient.hpp"
+#include "common/Checkpoint.hpp"
 #include "common/RingBuffer.hpp"
+#include "common/TscClock.hpp"
 #include "recorder/MktDataRecorder.hpp"
 #include "server/MktDataServer.hpp"
 #include "test_main.cpp"
@@ -124,14 +128,328 @@ TEST(Recovery, MultipleFaults) {
   ASSERT_GT(client.getProcessedCount(), 0);
 }
 
+// Test that a crash with the whole history still resident is recovered from
+// the ring buffer without touching the disk file
+TEST(Recovery, RingResidentRecovery) {
+  const int64_t MSG_COUNT = 2000;
+  const std::string TEST_FILE = "data/test_ring_recovery.bin";
+
+  auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  MktDataServer server(*buffer);
+  MktDataClient client(*buffer, TEST_FILE);
+  MktDataRecorder recorder(*buffer, TEST_FILE);
+
+  server.setMessageCount(MSG_COUNT);
+  server.setMessageRate(10000);
+
+  recorder.start();
+  client.start();
+  server.start();
+
+  while (client.getLastSeq() < MSG_COUNT / 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  client.triggerFault(FaultType::CLIENT_CRASH);
+  client.waitForRecovery();
+
+  server.waitForComplete();
+  while (client.getLastSeq() < MSG_COUNT - 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  client.stop();
+  recorder.stop();
+
+  const auto& m = client.getMetrics();
+  ASSERT_EQ(m.ring_recovery_count.load(), 1);
+  ASSERT_EQ(m.disk_recovery_count.load(), 0);
+  ASSERT_EQ(m.disk_replayed_count.load(), 0);
+  ASSERT_EQ(client.getProcessedCount(), MSG_COUNT);
+
+  double diff = std::abs(client.getSum() - recorder.getExpectedSum());
+  ASSERT_LT(diff, 1e-6);
+}
+
+// Drive the ring past one full wrap, crash the client after everything was
+// recorded, and return the client metrics after it caught up again
+static void runDiskPrefixRecovery(const std::string& test_file,
+                                  size_t recovery_threads,
+                                  int64_t& disk_recoveries,
+                                  int64_t& ring_recoveries,
+                                  int64_t& disk_replayed,
+                                  int64_t& parallel_recoveries) {
+  const int64_t MSG_COUNT =
+      DEFAULT_RING_BUFFER_SIZE + DEFAULT_RING_BUFFER_SIZE / 4;
+
+  auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  MktDataServer server(*buffer);
+  MktDataClient client(*buffer, test_file);
+  MktDataRecorder recorder(*buffer, test_file);
+
+  server.setMessageCount(MSG_COUNT);
+  server.setMessageRate(2000000);
+  client.setRecoveryThreads(recovery_threads);
+
+  recorder.start();
+  client.start();
+  server.start();
+  server.waitForComplete();
+
+  // Let both consumers drain so the prefix is on disk
+  while (client.getLastSeq() < MSG_COUNT - 1 ||
+         recorder.getLastSeq() < MSG_COUNT - 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  recorder.flush();
+
+  client.triggerFault(FaultType::CLIENT_CRASH);
+  client.waitForRecovery();
+
+  while (client.getLastSeq() < MSG_COUNT - 1) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  client.stop();
+  recorder.stop();
+
+  const auto& m = client.getMetrics();
+  disk_recoveries = m.disk_recovery_count.load();
+  ring_recoveries = m.ring_recovery_count.load();
+  disk_replayed = m.disk_replayed_count.load();
+  parallel_recoveries = m.parallel_recovery_count.load();
+
+  ASSERT_EQ(client.getProcessedCount(), MSG_COUNT);
+  ASSERT_EQ(client.getMetrics().seq_gap_count.load(), 0);
+
+  double diff = std::abs(client.getSum() - recorder.getExpectedSum());
+  ASSERT_LT(diff, 1e-6);
+}
+
+// Test that once the ring has wrapped, only the overwritten prefix is read
+// from disk and the rest comes from the ring
+TEST(Recovery, DiskPrefixThenRing) {
+  int64_t disk = 0, ring = 0, replayed = 0, parallel = 0;
+  runDiskPrefixRecovery("data/test_disk_prefix.bin", 1, disk, ring, replayed,
+                        parallel);
+
+  ASSERT_EQ(disk, 1);
+  ASSERT_EQ(ring, 0);
+  ASSERT_EQ(parallel, 0);
+  // Only the overwritten prefix (plus the safety margin) came from disk
+  ASSERT_GT(replayed, 0);
+  ASSERT_LT(replayed, static_cast<int64_t>(DEFAULT_RING_BUFFER_SIZE) / 2);
+}
+
+// Same as above with the disk prefix reduced on several threads
+TEST(Recovery, ParallelDiskPrefix) {
+  int64_t disk = 0, ring = 0, replayed = 0, parallel = 0;
+  runDiskPrefixRecovery("data/test_parallel_prefix.bin", 4, disk, ring,
+                        replayed, parallel);
+
+  ASSERT_EQ(disk, 1);
+  ASSERT_EQ(parallel, 1);
+  ASSERT_GT(replayed, 0);
+  ASSERT_LT(replayed, static_cast<int64_t>(DEFAULT_RING_BUFFER_SIZE) / 2);
+}
+
+// Start client on a stream that is already past its first wrap and wait
+// until it has caught up with the producer and drained up to last_seq
+static void joinAndDrain(MktDataClient& client, SeqNum last_seq) {
+  client.start();
+  while (client.getMetrics().time_to_live_ns.load() < 0 ||
+         client.getLastSeq() < last_seq) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  client.stop();
+  std::cout << "  join=" << toString(client.getJoinPolicy())
+            << " time_to_live_us="
+            << client.getMetrics().time_to_live_ns.load() / 1000
+            << " disk_replayed="
+            << client.getMetrics().disk_replayed_count.load() << std::endl;
+}
+
+// Test that a client started after the first wrap joins according to its
+// policy instead of hitting OVERWRITTEN and falling into a full recovery
+TEST(Recovery, LateJoinPolicies) {
+  const int64_t MSG_COUNT =
+      DEFAULT_RING_BUFFER_SIZE + DEFAULT_RING_BUFFER_SIZE / 4;
+  const std::string TEST_FILE = "data/test_late_join.bin";
+  const std::string CHECKPOINT_FILE = "data/test_late_join.ckpt";
+  using Buffer = MktDataClient::RingBufferType;
+
+  // Wrapped ring plus the matching recording (payloads are multiples of 0.5,
+  // so every sum below is exact)
+  auto buffer = std::make_unique<Buffer>();
+  double expected_sum = 0.0;
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.open());
+    for (SeqNum seq = 0; seq < MSG_COUNT; ++seq) {
+      Msg msg(seq, seq, static_cast<double>(seq % 1000) * 0.5);
+      ASSERT_TRUE(writer.write(msg));
+      buffer->push(msg);
+      expected_sum += msg.payload;
+    }
+  }
+  std::remove(CHECKPOINT_FILE.c_str());
+
+  // Oldest resident: the overwritten history and the margin are skipped
+  {
+    MktDataClient client(*buffer, TEST_FILE, JoinPolicy::OLDEST_RESIDENT);
+    joinAndDrain(client, MSG_COUNT - 1);
+    ASSERT_EQ(client.getProcessedCount(),
+              static_cast<int64_t>(Buffer::capacity()) -
+                  MktDataClient::RING_RECOVERY_MARGIN);
+    ASSERT_EQ(client.getMetrics().overwrite_count.load(), 0);
+    ASSERT_EQ(client.getMetrics().disk_replayed_count.load(), 0);
+  }
+
+  // Disk then ring: the full history, only the prefix read from disk; the
+  // ring part leaves checkpoints behind
+  double full_sum = 0.0;
+  {
+    MktDataClient client(*buffer, TEST_FILE, JoinPolicy::DISK_THEN_RING);
+    client.setRecoveryThreads(1);
+    client.setCheckpoint(CHECKPOINT_FILE, 4096);
+    joinAndDrain(client, MSG_COUNT - 1);
+    const auto& m = client.getMetrics();
+    ASSERT_EQ(client.getProcessedCount(), MSG_COUNT);
+    ASSERT_EQ(m.overwrite_count.load(), 0);
+    ASSERT_EQ(m.recovery_count.load(), 0);
+    ASSERT_GT(m.disk_replayed_count.load(), 0);
+    ASSERT_LT(m.disk_replayed_count.load(),
+              static_cast<int64_t>(Buffer::capacity()) / 2);
+    ASSERT_GT(m.checkpoint_count.load(), 0);
+    full_sum = client.getSum();
+    ASSERT_EQ(full_sum, expected_sum);
+  }
+
+  // Checkpoint then ring: same result without touching the disk
+  {
+    MktDataClient client(*buffer, TEST_FILE,
+                         JoinPolicy::CHECKPOINT_THEN_RING);
+    client.setCheckpoint(CHECKPOINT_FILE);
+    joinAndDrain(client, MSG_COUNT - 1);
+    ASSERT_EQ(client.getProcessedCount(), MSG_COUNT);
+    ASSERT_EQ(client.getMetrics().disk_replayed_count.load(), 0);
+    ASSERT_EQ(client.getSum(), full_sum);
+  }
+
+  // A checkpoint that does not match the stream is ignored (full catch-up)
+  {
+    auto checkpoint = loadCheckpoint(CHECKPOINT_FILE);
+    ASSERT_TRUE(checkpoint.has_value());
+    checkpoint->last_payload += 1.0;
+    ASSERT_TRUE(saveCheckpoint(CHECKPOINT_FILE, *checkpoint));
+
+    MktDataClient client(*buffer, TEST_FILE,
+                         JoinPolicy::CHECKPOINT_THEN_RING);
+    client.setRecoveryThreads(1);
+    client.setCheckpoint(CHECKPOINT_FILE);
+    joinAndDrain(client, MSG_COUNT - 1);
+    ASSERT_EQ(client.getProcessedCount(), MSG_COUNT);
+    ASSERT_GT(client.getMetrics().disk_replayed_count.load(), 0);
+    ASSERT_EQ(client.getSum(), full_sum);
+  }
+
+  // Head: nothing of the history, only what is published after the join
+  {
+    MktDataClient client(*buffer, TEST_FILE, JoinPolicy::HEAD);
+    client.start();
+    while (client.getMetrics().time_to_live_ns.load() < 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(client.getProcessedCount(), 0);
+    for (int i = 0; i < 10; ++i) {
+      buffer->push(Msg(0, 0, 2.0));
+    }
+    while (client.getLastSeq() < MSG_COUNT + 9) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    client.stop();
+    ASSERT_EQ(client.getProcessedCount(), 10);
+    ASSERT_EQ(client.getSum(), 20.0);
+  }
+}
+
+// Test disk catch-up on a recording with a recorder gap (a lapped recorder
+// jumps ahead): positions past the gap are not seq - first_seq, so resuming
+// from a checkpoint behind the gap must look them up by seq, on the
+// sequential and the parallel path alike
+TEST(Recovery, RecorderGapRecovery) {
+  const int64_t MSG_COUNT =
+      DEFAULT_RING_BUFFER_SIZE + DEFAULT_RING_BUFFER_SIZE / 4;
+  const SeqNum GAP_BEGIN = 1000;
+  const SeqNum GAP_END = 51000;  // Seqs [GAP_BEGIN, GAP_END) not recorded
+  const SeqNum CHECKPOINT_SEQ = 60000;
+  const std::string CHECKPOINT_FILE = "data/test_recorder_gap.ckpt";
+  using Buffer = MktDataClient::RingBufferType;
+
+  for (FileFormat format : {FileFormat::RAW, FileFormat::COLUMNAR}) {
+    const std::string test_file =
+        format == FileFormat::RAW ? "data/test_recorder_gap_v2.bin"
+                                  : "data/test_recorder_gap_v3.bin";
+    auto buffer = std::make_unique<Buffer>();
+    ClientCheckpoint checkpoint;
+    double expected_sum = 0.0;
+    {
+      FileWriteChannel writer(test_file, format);
+      ASSERT_TRUE(writer.open());
+      for (SeqNum seq = 0; seq < MSG_COUNT; ++seq) {
+        Msg msg(seq, seq, static_cast<double>(seq % 1000) * 0.5);
+        buffer->push(msg);
+        if (seq >= GAP_BEGIN && seq < GAP_END) {
+          continue;
+        }
+        ASSERT_TRUE(writer.write(msg));
+        if (seq > CHECKPOINT_SEQ) {
+          expected_sum += msg.payload;
+        } else {
+          checkpoint.sum += msg.payload;
+          checkpoint.processed_count++;
+        }
+      }
+    }
+    checkpoint.last_seq = CHECKPOINT_SEQ;
+    checkpoint.last_timestamp_ns = CHECKPOINT_SEQ;
+    checkpoint.last_payload = static_cast<double>(CHECKPOINT_SEQ % 1000) * 0.5;
+    expected_sum += checkpoint.sum;
+
+    for (size_t threads : {size_t{1}, size_t{4}}) {
+      ASSERT_TRUE(saveCheckpoint(CHECKPOINT_FILE, checkpoint));
+      MktDataClient client(*buffer, test_file,
+                           JoinPolicy::CHECKPOINT_THEN_RING);
+      client.setRecoveryThreads(threads);
+      client.setCheckpoint(CHECKPOINT_FILE);
+      joinAndDrain(client, MSG_COUNT - 1);
+      const auto& m = client.getMetrics();
+      ASSERT_GT(m.disk_replayed_count.load(), 0);
+      ASSERT_EQ(m.seq_gap_count.load(), 0);
+      ASSERT_EQ(client.getProcessedCount(),
+                MSG_COUNT - (GAP_END - GAP_BEGIN));
+      ASSERT_EQ(client.getSum(), expected_sum);
+      if (threads > 1) {
+        ASSERT_EQ(m.parallel_recovery_count.load(), 1);
+      }
+    }
+  }
+}
+
 #ifndef GTEST_FOUND
 
 int main() {
+  TscClock::global();  // Calibrate before anything is timed
   std::cout << "=== Fault Recovery Test ===" << std::endl;
 
   RUN_TEST(Recovery, ClientCrashRecovery);
   RUN_TEST(Recovery, ImmediateFault);
   RUN_TEST(Recovery, MultipleFaults);
+  RUN_TEST(Recovery, RingResidentRecovery);
+  RUN_TEST(Recovery, DiskPrefixThenRing);
+  RUN_TEST(Recovery, ParallelDiskPrefix);
+  RUN_TEST(Recovery, LateJoinPolicies);
+  RUN_TEST(Recovery, RecorderGapRecovery);
 
   std::cout << "\nAll tests passed!" << std::endl;
   return 0;
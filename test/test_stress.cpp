@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <fstream>
@@ -6,11 +7,16 @@
 
 #include "channel/FileChannel.hpp"
 #include "client/MktDataClient.hpp"
+#include "common/ConsumerTable.hpp"
 #include "common/Message.hpp"
+#include "common/MetricsRegistry.hpp"
 #include "common/RingBuffer.hpp"
+#include "common/TscClock.hpp"
 #include "recorder/MktDataRecorder.hpp"
+#include "relay/OverflowRelay.hpp"
 #include "replay/ReplayEngine.hpp"
 #include "server/MktDataServer.hpp"
+#include "server/RatePacer.hpp"
 #include "test_main.cpp"
 
 using namespace replay;
@@ -448,9 +454,572 @@ TEST(Stress, MetricsObservability) {
   ASSERT_EQ(buffer->getOverwriteCount(), 0);
 }
 
+// ---------------------------------------------------------------------------
+// Test 10: Paced replay reproduces recorded timing.
+//
+// Write a file with 100 us spacing and one 500 ms idle gap, then replay it at
+// 10x with the gap compressed to 1 ms, then with it dropped. No message may
+// be emitted before its schedule, the shortened gap must be reported, and
+// cancelling a wait must not lose the message.
+// ---------------------------------------------------------------------------
+TEST(Stress, PacedReplayTiming) {
+  const std::string TEST_FILE = "data/test_stress_paced.bin";
+  const int64_t MSG_COUNT = 200;
+  const int64_t SPACING_NS = 100000;
+  const int64_t IDLE_GAP_NS = 500000000;
+
+  {
+    FileWriteChannel writer(TEST_FILE);
+    ASSERT_TRUE(writer.open());
+    int64_t ts = 1000000000;
+    for (int64_t i = 0; i < MSG_COUNT; ++i) {
+      ts += (i == MSG_COUNT / 2) ? IDLE_GAP_NS : SPACING_NS;
+      ASSERT_TRUE(writer.write(Msg(i, ts, 1.0)));
+    }
+    writer.close();
+  }
+
+  ReplayEngine engine(TEST_FILE);
+  ASSERT_TRUE(engine.open());
+
+  PacingConfig pacing;
+  pacing.speed = 10.0;
+  pacing.idle_gap_ns = 1000000;
+  engine.setPacing(pacing);
+
+  auto start = PacingClock::now();
+  int64_t count = 0;
+  while (auto msg = engine.nextPacedMessage()) {
+    ASSERT_EQ(msg->seq_num, count);
+    ++count;
+  }
+  auto elapsed_ns = (PacingClock::now() - start).count();
+
+  // Schedule: (MSG_COUNT - 2) spacings + one 1 ms gap, all at 10x
+  const int64_t scheduled_ns =
+      ((MSG_COUNT - 2) * SPACING_NS + pacing.idle_gap_ns) / 10;
+  const auto& stats = engine.getPacingStats();
+  ASSERT_EQ(count, MSG_COUNT);
+  ASSERT_EQ(stats.emitted_count, MSG_COUNT);
+  ASSERT_EQ(stats.compressed_gap_count, 1);
+  ASSERT_EQ(stats.compressed_ns, IDLE_GAP_NS - pacing.idle_gap_ns);
+  ASSERT_GE(elapsed_ns, scheduled_ns);
+  ASSERT_LT(elapsed_ns, scheduled_ns + 500000000);
+
+  // Dropped idle gaps cost nothing; the shorter spacings are kept
+  pacing.idle_gap_policy = IdleGapPolicy::DROP;
+  engine.setPacing(pacing);
+  engine.reset();
+  start = PacingClock::now();
+  count = 0;
+  while (engine.nextPacedMessage()) {
+    ++count;
+  }
+  elapsed_ns = (PacingClock::now() - start).count();
+  const int64_t dropped_ns = (MSG_COUNT - 2) * SPACING_NS / 10;
+  ASSERT_EQ(count, MSG_COUNT);
+  ASSERT_EQ(engine.getPacingStats().compressed_gap_count, 1);
+  ASSERT_EQ(engine.getPacingStats().compressed_ns, IDLE_GAP_NS);
+  ASSERT_GE(elapsed_ns, dropped_ns);
+  ASSERT_LT(elapsed_ns, dropped_ns + 500000000);
+  pacing.idle_gap_policy = IdleGapPolicy::COMPRESS;
+
+  // Max speed ignores timestamps entirely
+  pacing.speed = 0.0;
+  engine.setPacing(pacing);
+  engine.reset();
+  start = PacingClock::now();
+  count = 0;
+  while (engine.nextPacedMessage()) {
+    ++count;
+  }
+  ASSERT_EQ(count, MSG_COUNT);
+  ASSERT_LT((PacingClock::now() - start).count(), scheduled_ns);
+
+  // A cancelled wait keeps the message for the next read
+  pacing.speed = 1.0;
+  pacing.idle_gap_ns = -1;
+  engine.setPacing(pacing);
+  ASSERT_TRUE(engine.seek(MSG_COUNT / 2 - 1));
+  ASSERT_TRUE(engine.nextPacedMessage().has_value());  // Anchors schedule
+  std::atomic<bool> cancel{true};
+  ASSERT_FALSE(engine.nextPacedMessage(&cancel).has_value());
+  ASSERT_EQ(engine.getCurrentSeq(), MSG_COUNT / 2);
+  auto held = engine.nextMessage();
+  ASSERT_TRUE(held.has_value());
+  ASSERT_EQ(held->seq_num, MSG_COUNT / 2);
+
+  engine.close();
+}
+
+// ---------------------------------------------------------------------------
+// Test 11: Server republishes a recording as load.
+//
+// Record 1000 messages 20 us apart, then let the server loop over the file
+// at 10x until 2500 messages are out. The client must see exactly the
+// recorded payloads (two full passes plus half of a third), with fresh
+// contiguous sequence numbers, and no earlier than the recorded schedule.
+// ---------------------------------------------------------------------------
+TEST(Stress, ServerReplaySource) {
+  const std::string SOURCE_FILE = "data/test_stress_source.bin";
+  const std::string TEST_FILE = "data/test_stress_source_out.bin";
+  const int64_t FILE_MSGS = 1000;
+  const int64_t SPACING_NS = 20000;
+  const int64_t TOTAL = 2500;
+
+  double pass_sum = 0.0;
+  double half_sum = 0.0;
+  {
+    FileWriteChannel writer(SOURCE_FILE);
+    ASSERT_TRUE(writer.open());
+    for (int64_t i = 0; i < FILE_MSGS; ++i) {
+      double payload = static_cast<double>(i % 7) + 0.25;
+      ASSERT_TRUE(writer.write(Msg(i, i * SPACING_NS, payload)));
+      pass_sum += payload;
+      if (i < TOTAL - 2 * FILE_MSGS) {
+        half_sum += payload;
+      }
+    }
+    writer.close();
+  }
+
+  auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  MktDataServer server(*buffer);
+  MktDataClient client(*buffer, TEST_FILE);
+
+  ReplaySourceConfig source;
+  source.filepath = SOURCE_FILE;
+  source.pacing.speed = 10.0;
+  source.loop = true;
+  source.max_messages = TOTAL;
+  server.setReplaySource(source);
+
+  client.start();
+  auto start = PacingClock::now();
+  server.start();
+  server.waitForComplete();
+  auto elapsed_ns = (PacingClock::now() - start).count();
+
+  while (client.getProcessedCount() < TOTAL) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  client.stop();
+
+  ASSERT_EQ(server.getSentCount(), TOTAL);
+  ASSERT_EQ(server.getReplayLoopCount(), 2);
+  ASSERT_EQ(client.getLastSeq(), TOTAL - 1);
+  ASSERT_EQ(client.getMetrics().seq_gap_count.load(), 0);
+
+  double expected = 2 * pass_sum + half_sum;
+  ASSERT_LT(std::abs(client.getSum() - expected), 1e-9);
+
+  // Each pass re-anchors, so only the spacing within passes is scheduled
+  const int64_t scheduled_ns = (TOTAL - 3) * SPACING_NS / 10;
+  ASSERT_GE(elapsed_ns, scheduled_ns);
+  ASSERT_EQ(server.getReplayPacingStats().emitted_count, TOTAL);
+}
+
+// ---------------------------------------------------------------------------
+// Test 12: Traffic shapes hit their requested rates.
+//
+// Drives RatePacer directly for each shape and checks the achieved rate
+// against the long-run mean, the shape-specific timing (token bucket burst
+// cap, on/off silence, profile start), and that rate 0 never blocks —
+// including through the server, whose old integer-interval pacing divided
+// by the rate.
+// ---------------------------------------------------------------------------
+namespace {
+
+// Acquire count messages in bursts of up to max_burst; returns elapsed ns
+int64_t drainPacer(RatePacer& pacer, int64_t count, size_t max_burst = 64) {
+  auto start = PacingClock::now();
+  int64_t sent = 0;
+  while (sent < count) {
+    auto want = std::min(max_burst, static_cast<size_t>(count - sent));
+    sent += static_cast<int64_t>(pacer.acquire(want));
+  }
+  return (PacingClock::now() - start).count();
+}
+
+}  // namespace
+
+TEST(Stress, TrafficShapes) {
+  // Uniform and Poisson at 100k msg/s
+  for (auto shape : {TrafficShape::UNIFORM, TrafficShape::POISSON}) {
+    TrafficConfig traffic;
+    traffic.shape = shape;
+    traffic.rate = 100000.0;
+    traffic.seed = 42;
+    RatePacer pacer(traffic);
+    drainPacer(pacer, 5000);
+
+    auto stats = pacer.getStats();
+    ASSERT_EQ(stats.sent_count, 5000);
+    ASSERT_EQ(stats.requested_rate, 100000.0);
+    double tolerance = shape == TrafficShape::POISSON ? 0.1 : 0.02;
+    ASSERT_LT(std::abs(stats.achieved_rate / stats.requested_rate - 1.0),
+              tolerance);
+  }
+
+  // Token bucket: a full bucket releases burst_size at once, then one at a
+  // time at the sustained rate
+  {
+    TrafficConfig traffic;
+    traffic.shape = TrafficShape::TOKEN_BUCKET;
+    traffic.rate = 10000.0;
+    traffic.burst_size = 8;
+    RatePacer pacer(traffic);
+    ASSERT_EQ(pacer.acquire(100), 8u);
+    ASSERT_EQ(pacer.acquire(100), 1u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_EQ(pacer.acquire(100), 8u);  // Idle time never exceeds the depth
+  }
+
+  // On/off: 1000 messages per 1 ms on window, then 1 ms of silence
+  {
+    TrafficConfig traffic;
+    traffic.shape = TrafficShape::ON_OFF;
+    traffic.rate = 1000000.0;
+    traffic.on_ns = 1000000;
+    traffic.off_ns = 1000000;
+    RatePacer pacer(traffic);
+    int64_t elapsed_ns = drainPacer(pacer, 3500);
+
+    ASSERT_EQ(pacer.getStats().requested_rate, 500000.0);
+    ASSERT_GE(elapsed_ns, 6000000);  // Three on/off periods precede the last
+  }
+
+  // Profile: 2 ms silent, then 500k msg/s for 2 ms
+  {
+    TrafficConfig traffic;
+    traffic.shape = TrafficShape::PROFILE;
+    traffic.profile = {{2000000, 0.0}, {2000000, 500000.0}};
+    RatePacer pacer(traffic);
+    auto start = PacingClock::now();
+    ASSERT_EQ(pacer.acquire(1), 1u);
+    ASSERT_GE((PacingClock::now() - start).count(), 2000000);
+    ASSERT_EQ(pacer.getStats().requested_rate, 250000.0);
+  }
+
+  // Rate 0 is unthrottled
+  {
+    TrafficConfig traffic;
+    traffic.rate = 0.0;
+    RatePacer pacer(traffic);
+    ASSERT_EQ(pacer.acquire(100), 100u);
+
+    auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+    MktDataServer server(*buffer);
+    server.setMessageCount(10000);
+    server.setMessageRate(0);
+    server.start();
+    server.waitForComplete();
+    ASSERT_EQ(server.getSentCount(), 10000);
+    ASSERT_EQ(server.getRateStats().sent_count, 10000);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Test 13: Batched generator output is well-formed.
+//
+// Generates 200000 messages unthrottled (batches of GENERATE_BATCH_SIZE
+// published with pushBatch) into a ring large enough to hold them all, and
+// checks contiguous sequence numbers, non-decreasing interpolated
+// timestamps within the run's wall-clock window, and payloads in range.
+// ---------------------------------------------------------------------------
+TEST(Stress, BatchedGeneratorOutput) {
+  const int64_t MSG_COUNT = 200000;
+
+  auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  MktDataServer server(*buffer);
+  server.setMessageCount(MSG_COUNT);
+  server.setMessageRate(0);
+
+  int64_t before_ns = getCurrentTimestampNs();
+  server.start();
+  server.waitForComplete();
+  int64_t after_ns = getCurrentTimestampNs();
+
+  ASSERT_EQ(server.getSentCount(), MSG_COUNT);
+  ASSERT_EQ(buffer->getLatestSeq(), MSG_COUNT - 1);
+  ASSERT_EQ(buffer->getOverwriteCount(), 0);
+
+  int64_t prev_ts = before_ns;
+  for (SeqNum seq = 0; seq < MSG_COUNT; ++seq) {
+    auto result = buffer->readEx(seq);
+    ASSERT_TRUE(result.status == ReadStatus::OK);
+    ASSERT_EQ(result.msg.seq_num, seq);
+    ASSERT_GE(result.msg.timestamp_ns, prev_ts);
+    ASSERT_TRUE(result.msg.payload >= 0.0 && result.msg.payload < 100.0);
+    prev_ts = result.msg.timestamp_ns;
+  }
+  ASSERT_LE(prev_ts, after_ns);
+
+  // A custom payload fill is called once per batch
+  auto custom = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  MktDataServer filled(*custom);
+  int64_t fill_calls = 0;
+  filled.setMessageCount(1000);
+  filled.setMessageRate(0);
+  filled.setPayloadFill([&fill_calls](std::span<double> out) {
+    ++fill_calls;
+    std::fill(out.begin(), out.end(), 2.0);
+  });
+  filled.start();
+  filled.waitForComplete();
+  ASSERT_EQ(filled.getSentCount(), 1000);
+  ASSERT_TRUE(fill_calls > 0 && fill_calls < 1000);
+  for (SeqNum seq = 0; seq < 1000; ++seq) {
+    ASSERT_EQ(custom->readEx(seq).msg.payload, 2.0);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Test 14: Per-stage latency histograms cover every message.
+//
+// After a paced run the client's consume histogram and the recorder's read
+// and write histograms must each hold one sample per message, with ordered
+// percentiles and a plausible (non-zero, sub-second) median. In v3 a message
+// counts as written when its block is sealed, so its write latency includes
+// the wait for the block to fill.
+// ---------------------------------------------------------------------------
+TEST(Stress, LatencyHistograms) {
+  const int64_t MSG_COUNT = 20000;
+  const std::string TEST_FILE = "data/test_stress_latency.bin";
+
+  for (FileFormat format : {FileFormat::RAW, FileFormat::COLUMNAR}) {
+    auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+    MktDataServer server(*buffer);
+    MktDataClient client(*buffer, TEST_FILE);
+    MktDataRecorder recorder(*buffer, TEST_FILE);
+    recorder.setFileFormat(format);
+
+    server.setMessageCount(MSG_COUNT);
+    server.setMessageRate(200000);
+
+    recorder.start();
+    client.start();
+    server.start();
+    server.waitForComplete();
+
+    while (client.getProcessedCount() < MSG_COUNT ||
+           recorder.getRecordedCount() < MSG_COUNT) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    client.stop();
+    recorder.stop();
+
+    auto consume = client.getMetrics().consume_latency_ns.snapshot();
+    auto read = recorder.getMetrics().read_latency_ns.snapshot();
+    auto write = recorder.getMetrics().write_latency_ns.snapshot();
+
+    for (const auto* snap : {&consume, &read, &write}) {
+      ASSERT_EQ(snap->total_count, MSG_COUNT);
+      int64_t p50 = snap->percentileNs(0.5);
+      ASSERT_LT(p50, 1000000000);
+      ASSERT_LE(p50, snap->percentileNs(0.99));
+      ASSERT_LE(snap->percentileNs(0.99), snap->max_ns);
+    }
+    ASSERT_GT(write.percentileNs(0.5), 0);  // A flush takes time
+    if (format == FileFormat::COLUMNAR) {
+      // A 4096-message block takes ~20 ms to fill at this rate
+      ASSERT_GT(write.percentileNs(0.5), 1000000);
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Test 15: Components publish live metrics into a registry.
+//
+// Server, client and recorder attached to one registry must end a run with
+// published totals equal to their own counts and every consumer at the
+// server's last sequence number (zero lag).
+// ---------------------------------------------------------------------------
+TEST(Stress, MetricsPublishing) {
+  const int64_t MSG_COUNT = 50000;
+  const std::string TEST_FILE = "data/test_stress_metrics.bin";
+
+  MetricsRegistry registry;
+  auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  MktDataServer server(*buffer);
+  MktDataClient client(*buffer, TEST_FILE);
+  MktDataRecorder recorder(*buffer, TEST_FILE);
+  server.attachMetrics(registry);
+  client.attachMetrics(registry);
+  recorder.attachMetrics(registry);
+
+  server.setMessageCount(MSG_COUNT);
+  server.setMessageRate(0);
+
+  recorder.start();
+  client.start();
+  server.start();
+  server.waitForComplete();
+
+  while (client.getProcessedCount() < MSG_COUNT ||
+         recorder.getRecordedCount() < MSG_COUNT) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  client.stop();
+  recorder.stop();
+
+  std::vector<MetricSample> samples;
+  registry.sample(samples);
+  auto value = [&](const std::string& name) {
+    for (const auto& sample : samples) {
+      if (sample.name == name) {
+        return sample.value;
+      }
+    }
+    return INT64_MIN;
+  };
+
+  ASSERT_EQ(samples.size(), 16u);
+  ASSERT_EQ(value("server.sent"), MSG_COUNT);
+  ASSERT_EQ(value("server.seq"), MSG_COUNT - 1);
+  ASSERT_EQ(value("client.processed"), MSG_COUNT);
+  ASSERT_EQ(value("client.seq"), MSG_COUNT - 1);
+  ASSERT_EQ(value("recorder.recorded"), MSG_COUNT);
+  ASSERT_EQ(value("recorder.written"), MSG_COUNT);
+  ASSERT_EQ(value("recorder.seq"), MSG_COUNT - 1);
+  ASSERT_EQ(value("client.overwrites"),
+            client.getMetrics().overwrite_count.load());
+  ASSERT_EQ(value("recorder.gaps"), recorder.getMetrics().seq_gap_count.load());
+  ASSERT_GE(value("client.batch"), 1);
+  ASSERT_LE(value("client.batch"), static_cast<int64_t>(CONSUME_BATCH_SIZE));
+  ASSERT_EQ(value("client.time_to_live_ns"),
+            client.getMetrics().time_to_live_ns.load());
+}
+
+// ---------------------------------------------------------------------------
+// Test 16: Consumers publish their cursors and the ring counts laps.
+//
+// While running, client and recorder appear in the ring's consumer table and
+// release their slots when stopped. A registered consumer that stays live
+// but never reads loses every message the server overwrites: the lapped
+// count must track the overwrite count to within one rescan interval.
+// ---------------------------------------------------------------------------
+TEST(Stress, ConsumerLag) {
+  const int64_t MSG_COUNT = 50000;
+  const std::string TEST_FILE = "data/test_stress_consumers.bin";
+
+  {
+    auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+    MktDataServer server(*buffer);
+    MktDataClient client(*buffer, TEST_FILE);
+    MktDataRecorder recorder(*buffer, TEST_FILE);
+    server.setMessageCount(MSG_COUNT);
+    server.setMessageRate(0);
+
+    recorder.start();
+    client.start();
+    std::vector<ConsumerInfo> consumers;
+    while (consumers.size() < 2) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      buffer->consumers().snapshot(consumers, tscTimestampNs());
+    }
+    server.start();
+    server.waitForComplete();
+    while (client.getProcessedCount() < MSG_COUNT ||
+           recorder.getRecordedCount() < MSG_COUNT) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    buffer->consumers().snapshot(consumers, tscTimestampNs());
+    ASSERT_EQ(consumers.size(), 2u);
+    for (const auto& consumer : consumers) {
+      ASSERT_TRUE(consumer.name == "client" || consumer.name == "recorder");
+      ASSERT_EQ(buffer->lagOf(consumer.cursor), 0);
+      ASSERT_EQ(consumer.lapped_count, 0);
+    }
+    ASSERT_EQ(buffer->getLappedCount(), 0);
+
+    client.stop();
+    recorder.stop();
+    buffer->consumers().snapshot(consumers, tscTimestampNs());
+    ASSERT_TRUE(consumers.empty());
+  }
+
+  // A stalled consumer, kept live by heartbeats from this thread
+  const int64_t OVERWRITES = 100000;
+  auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  MktDataServer server(*buffer);
+  server.setMessageCount(static_cast<int64_t>(DEFAULT_RING_BUFFER_SIZE) +
+                         OVERWRITES);
+  server.setMessageRate(0);
+  ConsumerTable& table = buffer->consumers();
+  int stalled = table.registerConsumer("stalled", 0, tscTimestampNs());
+  ASSERT_TRUE(stalled >= 0);
+
+  server.start();
+  while (server.isRunning()) {
+    table.heartbeat(stalled, tscTimestampNs());
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  server.waitForComplete();
+
+  ASSERT_EQ(buffer->getOverwriteCount(), OVERWRITES);
+  ASSERT_LE(buffer->getLappedCount(), OVERWRITES);
+  ASSERT_GE(buffer->getLappedCount(), OVERWRITES - LAP_RESCAN_INTERVAL);
+  ASSERT_EQ(buffer->lagOf(0),
+            static_cast<int64_t>(DEFAULT_RING_BUFFER_SIZE) + OVERWRITES);
+}
+
+// ---------------------------------------------------------------------------
+// Test 17: A stalled consumer reads on from the overflow log.
+//
+// The server publishes well past one ring capacity while a consumer that has
+// not read anything waits. With the relay filling the overflow log, every
+// message the relay did not lose is still readable from seq 0, in order and
+// with the right payloads, although the ring itself has long wrapped.
+// ---------------------------------------------------------------------------
+TEST(Stress, OverflowRelay) {
+  const int64_t MSG_COUNT =
+      static_cast<int64_t>(DEFAULT_RING_BUFFER_SIZE) + 200000;
+
+  auto log = OverflowLog::create("data/test_stress_overflow.log",
+                                 DEFAULT_RING_BUFFER_SIZE * 2);
+  ASSERT_TRUE(log != nullptr);
+  auto buffer = std::make_unique<RingBuffer<DEFAULT_RING_BUFFER_SIZE>>();
+  OverflowRelay relay(*buffer, *log);
+  MktDataServer server(*buffer);
+  server.setMessageCount(MSG_COUNT);
+  server.setMessageRate(0);
+
+  relay.start();
+  server.start();
+  server.waitForComplete();
+  while (relay.getRelayedCount() + relay.getLostCount() < MSG_COUNT) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  relay.stop();
+
+  ASSERT_TRUE(buffer->readEx(0).status != ReadStatus::NOT_READY);
+  ASSERT_EQ(relay.getRelayedCount() + relay.getLostCount(), MSG_COUNT);
+
+  // The stalled consumer catches up through both tiers
+  std::array<Msg, CONSUME_BATCH_SIZE> batch;
+  SeqNum seq = 0;
+  int64_t read_count = 0;
+  while (seq < MSG_COUNT) {
+    size_t count = buffer->readBatch(seq, batch);
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_EQ(batch[i].seq_num, seq + static_cast<SeqNum>(i));
+    }
+    read_count += static_cast<int64_t>(count);
+    seq += static_cast<SeqNum>(count);
+    if (count == 0) {
+      ASSERT_TRUE(buffer->readEx(seq).status == ReadStatus::OVERWRITTEN);
+      ++seq;  // Lost by the relay
+    }
+  }
+  ASSERT_EQ(read_count, relay.getRelayedCount());
+}
+
 #ifndef GTEST_FOUND
 
 int main() {
+  TscClock::global();  // Calibrate before anything is timed
   std::cout << "=== Stress & Regression Test ===" << std::endl;
 
   RUN_TEST(Stress, RingBufferOverwriteDetection);
@@ -462,6 +1031,14 @@ int main() {
   RUN_TEST(Stress, RapidMultipleFaults);
   RUN_TEST(Stress, ReplayLiveBoundaryContinuity);
   RUN_TEST(Stress, MetricsObservability);
+  RUN_TEST(Stress, PacedReplayTiming);
+  RUN_TEST(Stress, ServerReplaySource);
+  RUN_TEST(Stress, TrafficShapes);
+  RUN_TEST(Stress, BatchedGeneratorOutput);
+  RUN_TEST(Stress, LatencyHistograms);
+  RUN_TEST(Stress, MetricsPublishing);
+  RUN_TEST(Stress, ConsumerLag);
+  RUN_TEST(Stress, OverflowRelay);
 
   std::cout << "\nAll stress tests passed!" << std::endl;
   return 0;